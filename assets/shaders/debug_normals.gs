@@ -0,0 +1,19 @@
+#version 330 core
+// One line per vertex, from the position along the normal, read straight from the mesh VBO
+layout (points) in;
+layout (line_strip, max_vertices = 2) out;
+
+in vec3 WorldNormal[];
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float normalLength;
+
+void main() {
+    vec4 position = gl_in[0].gl_Position;
+    gl_Position = projection * view * position;
+    EmitVertex();
+    gl_Position = projection * view * (position + vec4(WorldNormal[0] * normalLength, 0.0));
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 WorldNormal;
+
+uniform mat4 model;
+
+void main() {
+    WorldNormal = normalize(mat3(transpose(inverse(model))) * aNormal);
+    gl_Position = model * vec4(aPos, 1.0);
+}
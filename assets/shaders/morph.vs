@@ -0,0 +1,55 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// Same block as multiple_lights.vs, so its fragment stage and wireframe_overlay.gs work unchanged
+out Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;     // Set by the geometry shader, unused without it
+} vs_out;
+
+// Keep in sync with MORPH_MAX_TARGETS in morph.h
+const int MAX_TARGETS = 64;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Entries of vertex v are [morphOffsets[v], morphOffsets[v + 1]), two texels each:
+// position delta and target index, then normal delta
+uniform usamplerBuffer morphOffsets;
+uniform samplerBuffer morphDeltas;
+uniform isamplerBuffer morphDeltasQuantized;
+uniform bool morphQuantized;
+uniform vec4 morphWeights[MAX_TARGETS];    // x scales position deltas, y normal deltas
+
+void main()
+{
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    int first = int(texelFetch(morphOffsets, gl_VertexID).r);
+    int last = int(texelFetch(morphOffsets, gl_VertexID + 1).r);
+    for (int entry = first; entry < last; entry++) {
+        vec4 dp, dn;
+        if (morphQuantized) {
+            dp = vec4(texelFetch(morphDeltasQuantized, entry * 2));
+            dn = vec4(texelFetch(morphDeltasQuantized, entry * 2 + 1));
+        } else {
+            dp = texelFetch(morphDeltas, entry * 2);
+            dn = texelFetch(morphDeltas, entry * 2 + 1);
+        }
+        vec4 weight = morphWeights[int(dp.w)];
+        position += weight.x * dp.xyz;
+        normal += weight.y * dn.xyz;
+    }
+
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));
+    vs_out.Normal = mat3(transpose(inverse(model))) * normalize(normal);
+    vs_out.TexCoords = aTexCoords;
+    vs_out.BarycentricCoords = vec3(1.0);
+
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -5,6 +5,8 @@ struct Material {
     vec3 diffuse;
     vec3 specular;
     float shininess;
+    sampler2D diffuseMap;   // Multiplied with diffuse, white when unset
+    sampler2D specularMap;  // Multiplied with specular, white when unset
 }; 
 
 struct DirLight {
@@ -39,16 +41,25 @@ struct SpotLight {
 
 #define NR_POINT_LIGHTS 3
 
-in vec3 FragPos;
-in vec3 Normal;
-in vec3 BarycentricCoords;
+in Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;
+} fs_in;
 
 uniform vec3 viewPos;
 uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 uniform Material material;
-uniform bool enableWireframe = false;
+uniform bool enableWireframe = false;     // Only with wireframe_overlay.gs, which provides the barycentrics
+uniform vec3 wireframeColor = vec3(0.0, 1.0, 0.0);
+uniform float wireframeWidth = 1.0;         // Pixels
+
+// material colors after texturing
+vec3 diffuseColor;
+vec3 specularColor;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -58,8 +69,10 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 void main()
 {    
     // properties
-    vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 norm = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    diffuseColor = material.diffuse * texture(material.diffuseMap, fs_in.TexCoords).rgb;
+    specularColor = material.specular * texture(material.specularMap, fs_in.TexCoords).rgb;
     
     // == =====================================================
     // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
@@ -71,20 +84,19 @@ void main()
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+        result += CalcPointLight(pointLights[i], norm, fs_in.FragPos, viewDir);    
     // phase 3: spot light
-    // result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
+    // result += CalcSpotLight(spotLight, norm, fs_in.FragPos, viewDir);    
     
-    // Wireframe overlay rendering
+    // Wireframe overlay: distance to the nearest edge in pixels from the
+    // barycentric derivatives, so lines keep their width at any distance
     if (enableWireframe)
     {
-        float edgeThreshold = 0.01;
-        vec3 barycentric = BarycentricCoords;
-        float minBarycentric = min(min(barycentric.x, barycentric.y), barycentric.z);
-        float glowFactor = smoothstep(0.0, edgeThreshold, edgeThreshold - minBarycentric);
-        vec3 wireframeColor = vec3(1.0, 0.0, 0.0);
-        vec3 emissive = wireframeColor * glowFactor; // Adjust the intensity of the glow
-        result = mix(result, wireframeColor + emissive, glowFactor);
+        vec3 barycentric = fs_in.BarycentricCoords;
+        vec3 pixels = barycentric / max(fwidth(barycentric), vec3(1e-6));
+        float edgeDistance = min(min(pixels.x, pixels.y), pixels.z);
+        float coverage = 1.0 - smoothstep(wireframeWidth * 0.5 - 0.5, wireframeWidth * 0.5 + 0.5, edgeDistance);
+        result = mix(result, wireframeColor, coverage);
     }
     
     FragColor = vec4(result, 1.0);
@@ -100,9 +112,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     return (ambient + diffuse + specular);
 }
 
@@ -119,9 +131,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -145,9 +157,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
-    vec3 specular = light.specular * spec * material.specular;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
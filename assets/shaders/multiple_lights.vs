@@ -1,10 +1,15 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
 
-out vec3 FragPos;
-out vec3 Normal;
-out vec3 BarycentricCoords;
+// Block so wireframe_overlay.gs can pass it through per triangle
+out Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;     // Set by the geometry shader, unused without it
+} vs_out;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -12,16 +17,10 @@ uniform mat4 projection;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
-    
-    // Calculate barycentric coordinates
-    if (gl_VertexID % 3 == 0)
-        BarycentricCoords = vec3(1.0, 0.0, 0.0);
-    else if (gl_VertexID % 3 == 1)
-        BarycentricCoords = vec3(0.0, 1.0, 0.0);
-    else
-        BarycentricCoords = vec3(0.0, 0.0, 1.0);
-    
-    gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
+    vs_out.TexCoords = aTexCoords;
+    vs_out.BarycentricCoords = vec3(1.0);
+
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -1,17 +1,21 @@
 #version 330 core
 layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in float radius;    // World units, 0 uses default_radius
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
-uniform float sphere_radius;
+uniform float viewport_height;  // Pixels
+uniform float default_radius;
 
-out vec3 frag_position; // Pass the world-space position to the fragment shader
+out vec3 point_color;
 
 void main() {
     gl_Position = projection * view * model * vec4(position, 1.0); // Transform point to clip space
-    frag_position = vec3(model * vec4(position, 1.0));            // World-space position
+    point_color = color.rgb;
 
-    // Scale the point
-    gl_PointSize = sphere_radius / length(frag_position);
+    // Scale the point with its projected diameter
+    float world_radius = radius > 0.0 ? radius : default_radius;
+    gl_PointSize = clamp(viewport_height * projection[1][1] * world_radius / gl_Position.w, 1.0, 64.0);
 }
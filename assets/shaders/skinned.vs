@@ -0,0 +1,39 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+
+// Same block as multiple_lights.vs, so its fragment stage and wireframe_overlay.gs work unchanged
+out Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;     // Set by the geometry shader, unused without it
+} vs_out;
+
+// Keep in sync with SKINNING_MAX_JOINTS in skinning.h
+const int MAX_JOINTS = 128;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 joints[MAX_JOINTS];   // Model space joint transform times inverse bind matrix
+
+void main()
+{
+    mat4 skin = aWeights.x * joints[aJoints.x]
+              + aWeights.y * joints[aJoints.y]
+              + aWeights.z * joints[aJoints.z]
+              + aWeights.w * joints[aJoints.w];
+    vec4 skinnedPos = skin * vec4(aPos, 1.0);
+    vec3 skinnedNormal = mat3(skin) * aNormal;
+
+    vs_out.FragPos = vec3(model * skinnedPos);
+    vs_out.Normal = mat3(transpose(inverse(model))) * skinnedNormal;
+    vs_out.TexCoords = aTexCoords;
+    vs_out.BarycentricCoords = vec3(1.0);
+
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+// Gives every triangle its own barycentric corners, which shared vertices of
+// an indexed mesh cannot carry, for the single-pass wireframe overlay
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;
+} gs_in[];
+
+out Vertex {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec3 BarycentricCoords;
+} gs_out;
+
+void main() {
+    for (int i = 0; i < 3; i++) {
+        gl_Position = gl_in[i].gl_Position;
+        gs_out.FragPos = gs_in[i].FragPos;
+        gs_out.Normal = gs_in[i].Normal;
+        gs_out.TexCoords = gs_in[i].TexCoords;
+        gs_out.BarycentricCoords = vec3(i == 0, i == 1, i == 2);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
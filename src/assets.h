@@ -0,0 +1,423 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "texture.h"
+#include "jobs.h"
+#include "memory.h"
+
+enum class AssetState { Pending, Ready, Failed };
+
+template <typename T>
+struct Asset {
+    std::atomic<AssetState> state{AssetState::Pending};
+    T value;
+    std::string name;
+    std::string error;
+};
+
+// Shared handle to an asset that may still be loading. get() returns nullptr
+// until the asset has been processed and uploaded.
+template <typename T>
+struct AssetHandle {
+    std::shared_ptr<Asset<T>> asset;
+
+    bool valid() const { return asset != nullptr; }
+    AssetState state() const { return asset ? asset->state.load(std::memory_order_acquire) : AssetState::Failed; }
+    bool pending() const { return state() == AssetState::Pending; }
+    bool ready() const { return state() == AssetState::Ready; }
+    bool failed() const { return state() == AssetState::Failed; }
+    T* get() const { return ready() ? &asset->value : nullptr; }
+};
+
+typedef AssetHandle<RenderMesh> MeshHandle;
+typedef AssetHandle<Texture> TextureHandle;
+
+struct AssetStats {
+    size_t loading = 0;             // Requests waiting for or on the loader thread
+    size_t uploading = 0;           // Processed assets waiting for GPU upload
+    size_t frame_bytes = 0;         // Bytes uploaded during the last update()
+    float frame_ms = 0.0f;          // Time spent in the last update()
+    size_t total_bytes = 0;
+    size_t completed = 0;
+};
+
+// Loads assets off the GL thread. A dedicated loader thread reads and parses
+// files, heavy processing (normals, texture decode and mips) goes through the
+// job system, and update() on the GL thread streams finished assets to the GPU
+// through a staging buffer within a per-frame time and byte budget.
+class AssetManager {
+public:
+    explicit AssetManager(JobSystem& jobs);
+    ~AssetManager();
+
+    // A weld_epsilon of 0 or more merges duplicate vertices (RenderMesh::weld()) before normals are computed
+    MeshHandle load_mesh(const std::string& filename, bool compute_normals = true, float weld_epsilon = -1.0f);
+    MeshHandle build_mesh(const std::string& name, std::function<RenderMesh()> generator);
+    TextureHandle load_texture(const std::string& filename, MipFilter filter = MipFilter::Kaiser);
+
+    // GL thread, once per frame
+    void update(float budget_ms = 2.0f, size_t budget_bytes = 8 << 20);
+    // GL thread, deletes the staging buffer while the context is still current
+    void release();
+    const AssetStats& stats() const { return frame_stats; }
+
+private:
+    static constexpr size_t STAGING_SIZE = 4 << 20;
+
+    struct Upload {
+        std::shared_ptr<Asset<RenderMesh>> mesh;
+        std::shared_ptr<Asset<Texture>> texture;
+        std::vector<unsigned char> data;    // Meshes: packed vertices then indices
+        size_t vertex_bytes = 0;
+        size_t offset = 0;                  // Bytes uploaded so far (of the current level for textures)
+        TextureData texture_data;           // Textures: every mip level, owned or mapped from the cache
+        int level = 0;
+        bool started = false;
+        bool done = false;
+    };
+
+    JobSystem& jobs;
+    std::thread loader;
+    std::mutex loader_mutex;
+    std::condition_variable loader_wake;
+    std::deque<std::function<void()>> requests;
+    std::atomic<bool> running{true};
+    std::atomic<size_t> in_flight{0};
+    JobCounter worker_jobs;                 // Processing handed off to the job system
+
+    std::mutex processed_mutex;
+    std::deque<Upload> processed;
+    std::deque<Upload> uploads;             // GL thread only
+
+    unsigned int staging = 0;
+    size_t staging_capacity = 0;
+    AssetStats frame_stats;
+
+    void submit(std::function<void()> request);
+    void loader_main();
+    void finish_processing(Upload&& upload);
+    void finish_mesh(std::shared_ptr<Asset<RenderMesh>> asset, const AllocationCounters& start);
+    void* map_staging(GLenum target, size_t size);
+    size_t upload_mesh_chunk(Upload& upload, size_t max_bytes);
+    size_t upload_texture_chunk(Upload& upload, size_t max_bytes);
+};
+
+AssetManager::AssetManager(JobSystem& jobs) : jobs(jobs) {
+    loader = std::thread(&AssetManager::loader_main, this);
+}
+
+AssetManager::~AssetManager() {
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        running.store(false);
+    }
+    loader_wake.notify_all();
+    loader.join();
+    jobs.wait(worker_jobs);
+}
+
+void AssetManager::release() {
+    if (staging) glDeleteBuffers(1, &staging);
+    staging = 0;
+    staging_capacity = 0;
+}
+
+void AssetManager::submit(std::function<void()> request) {
+    in_flight.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex);
+        requests.push_back(std::move(request));
+    }
+    loader_wake.notify_one();
+}
+
+void AssetManager::loader_main() {
+    Profiler::instance().set_thread_name("Loader");
+    while (true) {
+        std::function<void()> request;
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex);
+            loader_wake.wait(lock, [this] { return !running.load() || !requests.empty(); });
+            if (!running.load()) return;
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+        {
+            PROFILE_SCOPE("Load Asset");
+            request();
+        }
+        in_flight.fetch_sub(1);
+    }
+}
+
+MeshHandle AssetManager::load_mesh(const std::string& filename, bool compute_normals, float weld_epsilon) {
+    auto asset = std::make_shared<Asset<RenderMesh>>();
+    asset->name = filename;
+
+    submit([this, asset, filename, compute_normals, weld_epsilon] {
+        AllocationCounters start = thread_allocation_counters();
+        std::ifstream probe(filename);
+        if (!probe) {
+            asset->error = "Failed to open " + filename;
+            asset->state.store(AssetState::Failed, std::memory_order_release);
+            std::cerr << asset->error << std::endl;
+            return;
+        }
+        probe.close();
+
+        asset->value = RenderMesh::from_obj(filename);
+        if (weld_epsilon >= 0.0f) {
+            WeldStats weld = asset->value.weld(weld_epsilon, &jobs);
+            std::cout << "Welded " << filename << ": " << weld.vertices_before << " -> " << weld.vertices_after << " vertices ("
+                      << (weld.vertices_before ? 100 * (weld.vertices_before - weld.vertices_after) / weld.vertices_before : 0) << "% fewer), "
+                      << weld.triangles_before - weld.triangles_after << " degenerate triangles dropped in " << weld.ms << " ms" << std::endl;
+        }
+        if (compute_normals && !asset->value.has_vertex_normals) {
+            asset->value.compute_vertex_normals(&jobs);
+        }
+        finish_mesh(asset, start);
+    });
+
+    return MeshHandle{asset};
+}
+
+MeshHandle AssetManager::build_mesh(const std::string& name, std::function<RenderMesh()> generator) {
+    auto asset = std::make_shared<Asset<RenderMesh>>();
+    asset->name = name;
+
+    submit([this, asset, generator] {
+        AllocationCounters start = thread_allocation_counters();
+        asset->value = generator();
+        finish_mesh(asset, start);
+    });
+
+    return MeshHandle{asset};
+}
+
+TextureHandle AssetManager::load_texture(const std::string& filename, MipFilter filter) {
+    auto asset = std::make_shared<Asset<Texture>>();
+    asset->name = filename;
+
+    auto process = [this, asset, filename, filter] {
+        Upload upload;
+        if (!load_texture_data(filename, upload.texture_data, filter)) {
+            asset->error = "Failed to load " + filename + ": " + stbi_failure_reason();
+            asset->state.store(AssetState::Failed, std::memory_order_release);
+            std::cerr << asset->error << std::endl;
+            return;
+        }
+        std::cout << "Texture " << filename << " " << upload.texture_data.levels.size() << " levels, "
+                  << (upload.texture_data.from_cache ? "warm" : "cold") << " load " << upload.texture_data.load_ms << " ms" << std::endl;
+        upload.texture = asset;
+        finish_processing(std::move(upload));
+    };
+
+    // Decoding and mip filtering are the expensive part, hand them to a worker
+    // when there are any so several textures process in parallel
+    submit([this, process] {
+        if (jobs.thread_count() > 1) {
+            in_flight.fetch_add(1);
+            jobs.run(jobs.create([this, process] {
+                process();
+                in_flight.fetch_sub(1);
+            }), &worker_jobs);
+        } else {
+            process();
+        }
+    });
+
+    return TextureHandle{asset};
+}
+
+void AssetManager::finish_mesh(std::shared_ptr<Asset<RenderMesh>> asset, const AllocationCounters& start) {
+    RenderMesh& mesh = asset->value;
+    mesh.compute_bounds();
+    // Reorders the indices, so before packing. Strip meshes are drawn whole instead.
+    if (mesh.meshlets.empty() && mesh.strip_indices.empty()) mesh.build_meshlets();
+
+    // Pack on the loader thread straight into the upload so the GL thread only copies bytes
+    Upload upload;
+    upload.mesh = asset;
+    mesh.choose_index_type();
+    upload.vertex_bytes = mesh.positions.size() * mesh.vertex_stride();
+    upload.data.resize(upload.vertex_bytes + mesh.index_bytes());
+    mesh.write_vertex_data(reinterpret_cast<float*>(upload.data.data()));
+    mesh.write_index_data(upload.data.data() + upload.vertex_bytes);
+
+    // Heap traffic of this build on the loader thread (job system workers not included)
+    AllocationCounters allocations = thread_allocation_counters() - start;
+    std::cout << "Mesh " << asset->name << " " << mesh.positions.size() << " vertices, " << allocations.count << " allocations ("
+              << allocations.bytes / 1024 << " KB), " << mesh.index_size() * 8 << "-bit " << (mesh.uses_strips() ? "strip" : "list")
+              << " indices (" << mesh.index_bytes() << " bytes, " << 100 * mesh.index_bytes() / std::max<size_t>(mesh.indices.size() * sizeof(unsigned int), 1)
+              << "% of 32-bit list)" << std::endl;
+
+    finish_processing(std::move(upload));
+}
+
+void AssetManager::finish_processing(Upload&& upload) {
+    std::lock_guard<std::mutex> lock(processed_mutex);
+    processed.push_back(std::move(upload));
+}
+
+void AssetManager::update(float budget_ms, size_t budget_bytes) {
+    PROFILE_SCOPE("Asset Upload");
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&] {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(processed_mutex);
+        while (!processed.empty()) {
+            uploads.push_back(std::move(processed.front()));
+            processed.pop_front();
+        }
+    }
+
+    if (staging == 0) glGenBuffers(1, &staging);
+
+    size_t bytes = 0;
+    while (!uploads.empty() && bytes < budget_bytes && elapsed_ms() < budget_ms) {
+        Upload& upload = uploads.front();
+        size_t max_bytes = std::min(budget_bytes - bytes, STAGING_SIZE);
+
+        if (upload.mesh) bytes += upload_mesh_chunk(upload, max_bytes);
+        else bytes += upload_texture_chunk(upload, max_bytes);
+
+        if (upload.done) {
+            if (upload.mesh) upload.mesh->state.store(AssetState::Ready, std::memory_order_release);
+            else upload.texture->state.store(AssetState::Ready, std::memory_order_release);
+            uploads.pop_front();
+            frame_stats.completed++;
+        }
+    }
+
+    frame_stats.loading = in_flight.load();
+    frame_stats.uploading = uploads.size();
+    frame_stats.frame_bytes = bytes;
+    frame_stats.frame_ms = elapsed_ms();
+    frame_stats.total_bytes += bytes;
+    RenderStats::instance().buffer_upload(bytes);
+}
+
+void* AssetManager::map_staging(GLenum target, size_t size) {
+    glBindBuffer(target, staging);
+    if (size > staging_capacity) {
+        staging_capacity = std::max(size, (size_t)STAGING_SIZE);
+        glBufferData(target, staging_capacity, nullptr, GL_STREAM_DRAW);
+    }
+    // Invalidating lets the driver hand out fresh storage instead of waiting for the last copy
+    return glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+size_t AssetManager::upload_mesh_chunk(Upload& upload, size_t max_bytes) {
+    RenderMesh& mesh = upload.mesh->value;
+
+    if (!upload.started) {
+        // Allocate storage and describe the layout once, data follows in chunks
+        glGenVertexArrays(1, &mesh.gpu.VAO);
+        glGenBuffers(1, &mesh.gpu.VBO);
+        glGenBuffers(1, &mesh.gpu.EBO);
+
+        glBindVertexArray(mesh.gpu.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.gpu.VBO);
+        glBufferData(GL_ARRAY_BUFFER, upload.vertex_bytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.gpu.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, upload.data.size() - upload.vertex_bytes, nullptr, GL_STATIC_DRAW);
+        mesh.setup_vertex_attributes();
+        glBindVertexArray(0);
+        // What RenderMesh::update() compares edits against
+        mesh.gpu.vertex_capacity = upload.vertex_bytes;
+        mesh.gpu.index_capacity = upload.data.size() - upload.vertex_bytes;
+        mesh.gpu.vertex_count = mesh.positions.size();
+        mesh.gpu.index_count = mesh.gpu_indices().size();
+        mesh.gpu.triangle_count = mesh.indices.size() / 3;
+        mesh.gpu.vertex_stride = mesh.vertex_stride();
+        upload.started = true;
+    }
+
+    // Don't let a chunk straddle the vertex/index boundary
+    bool vertices = upload.offset < upload.vertex_bytes;
+    size_t end = vertices ? upload.vertex_bytes : upload.data.size();
+    size_t size = std::min(max_bytes, end - upload.offset);
+    if (size == 0) {
+        upload.done = true;     // Empty mesh
+        return 0;
+    }
+
+    void* dst = map_staging(GL_COPY_READ_BUFFER, size);
+    std::memcpy(dst, upload.data.data() + upload.offset, size);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertices ? mesh.gpu.VBO : mesh.gpu.EBO);
+    size_t dst_offset = vertices ? upload.offset : upload.offset - upload.vertex_bytes;
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dst_offset, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    upload.offset += size;
+    upload.done = upload.offset == upload.data.size();
+    return size;
+}
+
+size_t AssetManager::upload_texture_chunk(Upload& upload, size_t max_bytes) {
+    const TextureData& data = upload.texture_data;
+    Texture& texture = upload.texture->value;
+
+    if (!upload.started) {
+        // Allocate every level up front, precomputed mips follow in chunks
+        glGenTextures(1, &texture.ID);
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        for (int i = 0; i < (int)data.levels.size(); i++) {
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, data.levels[i].width, data.levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        set_texture_parameters((int)data.levels.size());
+        texture.width = data.width;
+        texture.height = data.height;
+        texture.levels = (int)data.levels.size();
+        upload.started = true;
+    }
+
+    // Whole rows of the current level per chunk, at least one even if that exceeds the budget
+    const TextureData::Level& level = data.levels[upload.level];
+    size_t row_bytes = (size_t)level.width * 4;
+    int first_row = (int)(upload.offset / row_bytes);
+    int rows = std::max(1, (int)(max_bytes / row_bytes));
+    rows = std::min(rows, level.height - first_row);
+    size_t size = rows * row_bytes;
+
+    // Stream rows through the staging buffer bound as a pixel unpack buffer (PBO)
+    void* dst = map_staging(GL_PIXEL_UNPACK_BUFFER, size);
+    std::memcpy(dst, data.level_data(upload.level) + upload.offset, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture.ID);
+    glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, first_row, level.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    upload.offset += size;
+    if (upload.offset == level.size) {
+        upload.offset = 0;
+        upload.level++;
+        upload.done = upload.level == (int)data.levels.size();
+        // Release the pixels (or the cache mapping) as soon as the GPU has them
+        if (upload.done) upload.texture_data = TextureData();
+    }
+    return size;
+}
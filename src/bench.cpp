@@ -0,0 +1,1369 @@
+// OpenGL Stuff
+#include <glad/glad.h>
+
+// GLM Stuff
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Image Loading
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// My Stuff
+#include "mesh.h"
+#include "scene.h"
+#include "jobs.h"
+#include "culling.h"
+#include "texture.h"
+#include "shader.h"
+#include "headless.h"
+#include "render_thread.h"
+#include "stream_buffer.h"
+#include "point_cloud.h"
+#include "subdivision.h"
+#include "skinning.h"
+#include "morph.h"
+#include "isosurface.h"
+#include "memory.h"
+
+// Standard Library
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <deque>
+
+// Reproducible benchmark suite. Every case runs `warmup` untimed and `reps`
+// timed repetitions and reports min/mean/percentiles. --json writes one result
+// per line so two runs can be diffed, --compare prints the p50 change per case.
+//
+// bench [--reps N] [--warmup N] [--filter TEXT] [--json FILE] [--max-obj-tris N]
+//       [--max-instances N] [--max-points N] [--output DIR] [--no-gl] [file.obj ...]
+// bench --compare OLD.json NEW.json
+struct BenchOptions {
+    int warmup = 2;
+    int reps = 10;
+    std::string filter;
+    std::string json;
+    std::string output_dir = "bench_output";
+    size_t max_obj_triangles = 1000000;         // Synthetic OBJ sizes run up to this
+    int max_instances = 100000;
+    size_t max_points = 4000000;                // Synthetic point clouds run up to this
+    bool gl = true;
+    std::vector<std::string> obj_files;
+};
+
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+    std::vector<double> samples;                // Milliseconds per repetition
+    int warmup = 0;
+
+    std::string key() const;
+    double mean() const;
+};
+
+using BenchParams = std::vector<std::pair<std::string, std::string>>;
+
+BenchOptions options;
+std::deque<BenchResult> results;           // Stable addresses for the returned pointers
+
+std::string BenchResult::key() const {
+    std::string key = name;
+    for (const auto& param : params) key += " " + param.first + "=" + param.second;
+    return key;
+}
+
+double BenchResult::mean() const {
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+void print_result(const BenchResult& result) {
+    std::cout << std::left << std::setw(52) << result.key() << std::right << std::fixed << std::setprecision(3)
+              << " p50 " << std::setw(10) << percentile(result.samples, 50.0)
+              << " min " << std::setw(10) << percentile(result.samples, 0.0)
+              << " p99 " << std::setw(10) << percentile(result.samples, 99.0) << " ms";
+    for (const auto& metric : result.metrics) std::cout << "  " << metric.first << " " << std::setprecision(2) << metric.second;
+    std::cout << std::endl;
+}
+
+// Times `fn`. `setup` runs untimed before every repetition, e.g. to reset state
+// the timed code consumes. Heap allocations inside `fn` (any thread) are
+// reported as the "allocs" metric per repetition. Returns nullptr if the case
+// is filtered out.
+BenchResult* bench(const std::string& name, const BenchParams& params, const std::function<void()>& fn,
+                   const std::function<void()>& setup = nullptr, int reps = -1, int warmup = -1) {
+    BenchResult result;
+    result.name = name;
+    result.params = params;
+    if (!options.filter.empty() && result.key().find(options.filter) == std::string::npos) return nullptr;
+
+    result.warmup = warmup < 0 ? options.warmup : warmup;
+    reps = reps < 0 ? options.reps : reps;
+    uint64_t allocations = 0;
+    for (int i = 0; i < result.warmup + reps; i++) {
+        if (setup) setup();
+        AllocationCounters before = allocation_counters();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        if (i >= result.warmup) {
+            result.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            allocations += (allocation_counters() - before).count;
+        }
+    }
+    result.metrics.push_back({"allocs", reps > 0 ? (double)allocations / reps : 0.0});
+
+    results.push_back(std::move(result));
+    return &results.back();
+}
+
+// Sections skip their setup when --filter excludes all of their cases
+bool selected(std::initializer_list<const char*> names) {
+    if (options.filter.empty()) return true;
+    for (const char* name : names) {
+        if (std::string(name).find(options.filter) != std::string::npos || options.filter.find(name) != std::string::npos) return true;
+    }
+    return false;
+}
+
+// Metrics are added after the timing, so print once a case is complete
+void finish(BenchResult* result) {
+    if (result) print_result(*result);
+}
+
+void add_throughput(BenchResult* result, const char* name, double items) {
+    if (!result) return;
+    double seconds = percentile(result->samples, 50.0) / 1000.0;
+    result->metrics.push_back({name, seconds > 0.0 ? items / seconds / 1.0e6 : 0.0});
+}
+
+// Thread counts 1, 2, 4, ... up to and including the hardware thread count
+std::vector<unsigned> thread_counts() {
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n < max_threads; n *= 2) counts.push_back(n);
+    counts.push_back(max_threads);
+    return counts;
+}
+
+void bench_mesh(const std::string& name, const BenchParams& params, const std::function<RenderMesh()>& generate) {
+    if (!selected({name.c_str(), "generate", "compute_vertex_normals", "get_vertex_data", "build_meshlets"})) return;
+    RenderMesh mesh;
+    BenchResult* result = bench(name + "/generate", params, [&] { mesh = generate(); });
+    if (mesh.positions.empty()) mesh = generate();     // Generation itself was filtered out
+    double triangles = (double)mesh.indices.size() / 3;
+    add_throughput(result, "Mtris/s", triangles);
+    finish(result);
+
+    result = bench(name + "/compute_vertex_normals", params, [&] { mesh.compute_vertex_normals(); });
+    add_throughput(result, "Mtris/s", triangles);
+    finish(result);
+
+    std::vector<float> vertices;
+    result = bench(name + "/get_vertex_data", params, [&] { vertices = mesh.get_vertex_data(); });
+    add_throughput(result, "Mverts/s", (double)mesh.positions.size());
+    finish(result);
+
+    mesh.compute_bounds();
+    result = bench(name + "/build_meshlets", params, [&] { mesh.build_meshlets(); });
+    add_throughput(result, "Mtris/s", triangles);
+    finish(result);
+}
+
+void bench_generators() {
+    for (int resolution : {64, 256, 1024}) {
+        bench_mesh("uvsphere", {{"rings", std::to_string(resolution)}, {"sectors", std::to_string(resolution)}},
+                   [=] { return RenderMesh::uvsphere(resolution, resolution); });
+    }
+    for (int sectors : {64, 4096, 262144}) {
+        bench_mesh("cylinder", {{"sectors", std::to_string(sectors)}}, [=] { return RenderMesh::cylinder(sectors); });
+    }
+    for (int subdivisions : {3, 6, 9}) {
+        bench_mesh("icosphere", {{"subdivisions", std::to_string(subdivisions)}}, [=] { return RenderMesh::icosphere(subdivisions); });
+    }
+    bench_mesh("torus", {{"rings", "1024"}, {"sides", "512"}}, [] { return RenderMesh::torus(1024, 512); });
+    bench_mesh("capsule", {{"rings", "256"}, {"sectors", "1024"}}, [] { return RenderMesh::capsule(256, 1024); });
+    bench_mesh("grid", {{"size", "1024"}}, [] {
+        return RenderMesh::grid(1024, 1024, [](float x, float z) { return 0.05f * std::sin(20.0f * x) * std::cos(20.0f * z); });
+    });
+    bench_mesh("rounded_box", {{"segments", "128"}}, [] { return RenderMesh::rounded_box(128, 0.1f); });
+}
+
+// Synthetic OBJ files from a uvsphere with roughly the requested triangle count
+void bench_obj() {
+    if (!selected({"obj/export", "obj/import"})) return;
+    std::error_code ec;
+    std::filesystem::create_directories(options.output_dir, ec);
+
+    for (size_t target : {(size_t)1000000, (size_t)5000000, (size_t)10000000, (size_t)50000000}) {
+        if (target > options.max_obj_triangles) break;
+
+        int resolution = (int)std::ceil(std::sqrt(target / 2.0));
+        RenderMesh mesh = RenderMesh::uvsphere(resolution, resolution);
+        std::string filename = options.output_dir + "/synthetic_" + std::to_string(target / 1000000) + "m.obj";
+        BenchParams params = {{"tris", std::to_string(mesh.indices.size() / 3)}};
+
+        // IO is slow at these sizes, a few repetitions are enough
+        int reps = std::min(options.reps, 3);
+        BenchResult* result = bench("obj/export", params, [&] { mesh.to_obj(filename); }, nullptr, reps, 0);
+        if (!std::filesystem::exists(filename)) mesh.to_obj(filename);
+        double megabytes = std::filesystem::file_size(filename, ec) / (1024.0 * 1024.0);
+        if (result) result->metrics.push_back({"MB", megabytes});
+        add_throughput(result, "Mtris/s", mesh.indices.size() / 3.0);
+        finish(result);
+
+        RenderMesh imported;
+        result = bench("obj/import", params, [&] { imported = RenderMesh::from_obj(filename); }, nullptr, reps, 0);
+        if (result && imported.indices.size() != mesh.indices.size()) {
+            std::cerr << "obj/import: read " << imported.indices.size() / 3 << " triangles, expected " << mesh.indices.size() / 3 << std::endl;
+        }
+        if (result) result->metrics.push_back({"MB/s", megabytes / (percentile(result->samples, 50.0) / 1000.0)});
+        add_throughput(result, "Mtris/s", mesh.indices.size() / 3.0);
+        finish(result);
+    }
+}
+
+// Welds a copy of `input` every rep. Reports the vertex reduction and throughput
+// over the input vertices.
+void bench_weld(const std::string& name, const RenderMesh& input, float epsilon, JobSystem& jobs) {
+    RenderMesh mesh;
+    WeldStats stats;
+    std::ostringstream eps;
+    eps << epsilon;
+    BenchResult* result = bench("mesh/weld", {{"mesh", name}, {"eps", eps.str()}}, [&] { stats = mesh.weld(epsilon, &jobs); }, [&] { mesh = input; });
+    if (result) {
+        result->metrics.push_back({"verts", (double)stats.vertices_after});
+        result->metrics.push_back({"reduction%", stats.vertices_before ? 100.0 * (stats.vertices_before - stats.vertices_after) / stats.vertices_before : 0.0});
+    }
+    add_throughput(result, "Mverts/s", (double)input.positions.size());
+    finish(result);
+}
+
+// Triangle soup, every corner its own vertex, as an exporter without index sharing writes it
+RenderMesh triangle_soup(const RenderMesh& mesh) {
+    RenderMesh soup;
+    soup.resize(mesh.indices.size(), mesh.indices.size() / 3, mesh.has_vertex_normals, mesh.has_tex_coords);
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        unsigned int v = mesh.indices[i];
+        soup.positions[i] = mesh.positions[v];
+        if (mesh.has_vertex_normals) soup.normals[i] = mesh.normals[v];
+        if (mesh.has_tex_coords) soup.tex_coords[i] = mesh.tex_coords[v];
+        soup.indices[i] = (unsigned int)i;
+    }
+    return soup;
+}
+
+void bench_welding() {
+    if (!selected({"mesh/weld"})) return;
+    JobSystem jobs;
+    for (int resolution : {100, 500}) {
+        RenderMesh soup = triangle_soup(RenderMesh::uvsphere(resolution, resolution));
+        std::string name = "soup uvsphere " + std::to_string(resolution) + "x" + std::to_string(resolution);
+        bench_weld(name, soup, 0.0f, jobs);
+        bench_weld(name, soup, 1e-5f, jobs);
+    }
+    for (const auto& filename : options.obj_files) bench_weld(filename, RenderMesh::from_obj(filename), 1e-5f, jobs);
+}
+
+// Flat scenes of N instances in a grid, ten children per root
+void bench_scenes() {
+    if (!selected({"scene/update", "scene/cull"})) return;
+    RenderMesh sphere = RenderMesh::uvsphere(16, 16);
+    sphere.compute_bounds();
+    JobSystem jobs;
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 40.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::from_matrix(projection * view);
+
+    for (int instances : {1000, 10000, 100000}) {
+        if (instances > options.max_instances) break;
+
+        Scene scene;
+        int side = (int)std::ceil(std::sqrt(instances / 10.0));
+        for (int i = 0; i < instances / 10; i++) {
+            Entity root = scene.create("root", NULL_ENTITY, &sphere);
+            scene.set_translation(root, glm::vec3((i % side - side / 2) * 3.0f, 0.0f, (i / side - side / 2) * -3.0f));
+            for (int j = 0; j < 9; j++) {
+                Entity child = scene.create("child", root, &sphere);
+                scene.set_translation(child, glm::vec3(0.0f, (j + 1) * 1.5f, 0.0f));
+            }
+        }
+        scene.update();
+
+        BenchParams params = {{"instances", std::to_string(scene.size())}, {"threads", std::to_string(jobs.thread_count())}};
+        auto dirty_all = [&] {
+            for (size_t i = 0; i < scene.size(); i++) scene.mark_dirty(scene.entities[i]);
+        };
+        BenchResult* result = bench("scene/update", params, [&] { scene.update(jobs); }, dirty_all);
+        add_throughput(result, "Mnodes/s", (double)scene.size());
+        finish(result);
+
+        std::vector<uint8_t> visible;
+        size_t visible_count = 0;
+        result = bench("scene/cull", params, [&] { visible_count = cull_scene(scene, frustum, visible, &jobs); });
+        if (result) result->metrics.push_back({"visible%", 100.0 * visible_count / scene.size()});
+        add_throughput(result, "Mnodes/s", (double)scene.size());
+        finish(result);
+    }
+}
+
+void bench_job_scaling() {
+    if (!selected({"scaling/generate", "scaling/compute_vertex_normals", "scaling/scene_update", "scaling/cull_scene"})) return;
+    RenderMesh sphere = RenderMesh::uvsphere(1000, 1000);
+    sphere.compute_bounds();
+
+    // Wide, shallow hierarchy: 1000 roots with 100 children each
+    Scene scene;
+    for (int i = 0; i < 1000; i++) {
+        Entity root = scene.create("root", NULL_ENTITY, &sphere);
+        scene.set_translation(root, glm::vec3((i % 32) * 3.0f, 0.0f, (i / 32) * -3.0f));
+        for (int j = 0; j < 100; j++) {
+            Entity child = scene.create("child", root, &sphere);
+            scene.set_translation(child, glm::vec3(0.0f, j * 0.1f, 0.0f));
+        }
+    }
+    scene.update();
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::from_matrix(projection * view);
+    std::vector<uint8_t> visible;
+
+    double generate_base = 0.0, normals_base = 0.0, scene_base = 0.0, cull_base = 0.0;
+    for (unsigned threads : thread_counts()) {
+        JobSystem jobs(threads);
+        BenchParams params = {{"threads", std::to_string(threads)}};
+
+        // Speedup over the single-threaded run of the same case
+        auto speedup = [&](BenchResult* result, double& base) {
+            if (!result) return;
+            double p50 = percentile(result->samples, 50.0);
+            if (threads == 1) base = p50;
+            result->metrics.push_back({"speedup", base > 0.0 ? base / p50 : 0.0});
+            finish(result);
+        };
+
+        speedup(bench("scaling/generate", params, [&] { RenderMesh generated = RenderMesh::uvsphere(1000, 1000, &jobs); }), generate_base);
+        speedup(bench("scaling/compute_vertex_normals", params, [&] { sphere.compute_vertex_normals(&jobs); }), normals_base);
+        speedup(bench("scaling/scene_update", params, [&] { scene.update(jobs); }, [&] {
+            for (size_t i = 0; i < scene.size(); i += 101) scene.mark_dirty(scene.entities[i]);
+        }), scene_base);
+        speedup(bench("scaling/cull_scene", params, [&] { cull_scene(scene, frustum, visible, &jobs); }), cull_base);
+    }
+}
+
+// Loop subdivision of a closed icosphere cage: the one-time stencil build, then
+// re-evaluation while the cage vertices move every rep
+void bench_subdivision() {
+    if (!selected({"subdivision/build", "subdivision/evaluate"})) return;
+    ProcMesh cage = RenderMesh::icosphere(1).to_procmesh();
+    std::vector<glm::vec3> rest;
+    for (const ProcMesh::Vertex& vertex : cage.vertices) rest.push_back(vertex.position);
+    JobSystem jobs;
+
+    for (int levels : {3, 4, 5}) {
+        BenchParams params = {{"cage", std::to_string(cage.faces.size())}, {"levels", std::to_string(levels)}};
+        LoopSubdivision subdivision;
+        BenchResult* result = bench("subdivision/build", params, [&] { subdivision.build(cage, levels, &jobs); });
+        if (subdivision.levels() != levels) subdivision.build(cage, levels, &jobs);
+        if (result) result->metrics.push_back({"entries/row", (double)subdivision.stencils().entries() / subdivision.vertex_count()});
+        finish(result);
+
+        RenderMesh refined;
+        float time = 0.0f;
+        result = bench("subdivision/evaluate", params, [&] { subdivision.evaluate(cage, refined, &jobs); }, [&] {
+            time += 0.1f;
+            for (size_t i = 0; i < rest.size(); i++) cage.vertices[i].position = rest[i] * (1.0f + 0.2f * std::sin(time + i));
+        });
+        add_throughput(result, "Mverts/s", (double)subdivision.vertex_count());
+        finish(result);
+    }
+}
+
+// Animation: clip sampling and pose evaluation per character, then linear
+// blend skinning of a tentacle rig on the CPU at each thread count
+void bench_skinning() {
+    if (!selected({"skinning/sample", "skinning/pose", "skinning/cpu"})) return;
+    for (int joints : {32, 128}) {
+        SkinnedModel model = skinned_tentacle(joints, 4, 4);
+        BenchParams params = {{"joints", std::to_string(joints)}};
+        const int characters = 1000;
+        JointPoses pose;
+        std::vector<glm::mat4> skin(joints);
+        float time = 0.0f;
+        BenchResult* result = bench("skinning/sample", params, [&] {
+            for (int i = 0; i < characters; i++) model.clip.sample(time + i * 0.013f, pose);
+        }, [&] { time += 0.1f; });
+        add_throughput(result, "Mjoints/s", (double)characters * joints);
+        finish(result);
+
+        model.clip.sample(0.5f, pose);
+        result = bench("skinning/pose", params, [&] {
+            for (int i = 0; i < characters; i++) model.skeleton.skin_matrices(pose, skin.data());
+        });
+        add_throughput(result, "Mjoints/s", (double)characters * joints);
+        finish(result);
+    }
+
+    for (int rows : {256, 2048}) {
+        SkinnedModel model = skinned_tentacle(64, rows, 256);
+        JointPoses pose;
+        std::vector<glm::mat4> skin(model.skeleton.joint_count());
+        std::vector<float> vertices(model.mesh.positions.size() * model.mesh.vertex_stride() / sizeof(float));
+        float time = 0.0f;
+        auto animate = [&] {
+            time += 0.1f;
+            model.clip.sample(time, pose);
+            model.skeleton.skin_matrices(pose, skin.data());
+        };
+        double base = 0.0;
+        for (unsigned threads : thread_counts()) {
+            JobSystem jobs(threads);
+            BenchParams params = {{"verts", std::to_string(model.mesh.positions.size())}, {"threads", std::to_string(threads)}};
+            BenchResult* result = bench("skinning/cpu", params, [&] { skin_vertices(model.mesh, skin.data(), vertices.data(), &jobs); }, animate);
+            if (result) {
+                double p50 = percentile(result->samples, 50.0);
+                if (threads == 1) base = p50;
+                result->metrics.push_back({"speedup", base > 0.0 ? base / p50 : 0.0});
+            }
+            add_throughput(result, "Mverts/s", (double)model.mesh.positions.size());
+            finish(result);
+        }
+    }
+}
+
+// `count` targets that each push out a cap of about 2% of the sphere
+void add_bench_morph_targets(MorphTargets& targets, const RenderMesh& base, int count) {
+    RenderMesh shape = base;
+    for (int t = 0; t < count; t++) {
+        float z = 1.0f - 2.0f * (t + 0.5f) / count;
+        float angle = t * 2.39996f;
+        glm::vec3 center(std::sqrt(1.0f - z * z) * std::cos(angle), z, std::sqrt(1.0f - z * z) * std::sin(angle));
+        for (size_t v = 0; v < base.positions.size(); v++) {
+            float d = glm::dot(glm::normalize(base.positions[v]), center);
+            shape.positions[v] = d > 0.96f ? base.positions[v] + base.normals[v] * (d - 0.96f) * 4.0f : base.positions[v];
+        }
+        shape.compute_vertex_normals();
+        targets.add_target("cap" + std::to_string(t), base, shape.positions.data(), shape.normals.data());
+    }
+}
+
+void bench_morph() {
+    if (!selected({"morph/apply"})) return;
+    RenderMesh base = RenderMesh::uvsphere(256, 256);
+    base.compute_vertex_normals();
+    size_t vertex_count = base.positions.size();
+    std::vector<float> vertices(vertex_count * base.vertex_stride() / sizeof(float));
+    const int target_count = 64;
+    JobSystem jobs;
+    for (MorphPrecision precision : {MorphPrecision::Float32, MorphPrecision::Snorm16}) {
+        MorphTargets targets(precision);
+        add_bench_morph_targets(targets, base, target_count);
+        // Storage against a full position and normal copy per target
+        double kb_per_target = targets.bytes() / 1024.0 / target_count;
+        double dense_percent = 100.0 * targets.bytes() / (MorphTargets::dense_bytes(vertex_count) * target_count);
+        for (int active : {4, 64}) {
+            std::vector<float> weights(target_count, 0.0f);
+            for (int t = 0; t < active; t++) weights[t * target_count / active] = 0.5f;
+            BenchParams params = {{"verts", std::to_string(vertex_count)}, {"targets", std::to_string(target_count)},
+                                  {"active", std::to_string(active)}, {"format", precision == MorphPrecision::Float32 ? "f32" : "s16"}};
+            BenchResult* result = bench("morph/apply", params, [&] { targets.apply(base, weights.data(), vertices.data(), &jobs); });
+            add_throughput(result, "Mverts/s", (double)vertex_count);
+            if (result) {
+                result->metrics.push_back({"KB/target", kb_per_target});
+                result->metrics.push_back({"%dense", dense_percent});
+            }
+            finish(result);
+        }
+    }
+}
+
+// Marching cubes over the test field sampled into a dense grid and into a
+// narrow-band sparse one: full extraction at each thread count, then the
+// incremental cases, a small iso step and a local edit of the samples
+void bench_isosurface() {
+    if (!selected({"iso/build", "iso/retarget", "iso/edit"})) return;
+    const int size = 128;
+    const float band = 0.1f;
+    double cells = std::pow((double)(size - 1), 3.0);
+    JobSystem fill_jobs;
+    glm::ivec3 samples(size);
+    DenseGrid dense(samples);
+    SparseGrid sparse(samples, band);
+    for (VoxelGrid* grid : {(VoxelGrid*)&dense, (VoxelGrid*)&sparse}) {
+        grid->origin = glm::vec3(-1.0f);
+        grid->spacing = 2.0f / (size - 1);
+    }
+    dense.fill(isosurface_test_field, &fill_jobs);
+    sparse.fill(isosurface_test_field, -band, band, &fill_jobs);
+
+    for (VoxelGrid* grid : {(VoxelGrid*)&dense, (VoxelGrid*)&sparse}) {
+        const char* kind = grid == &dense ? "dense" : "sparse";
+        BenchParams base_params = {{"grid", kind}, {"size", std::to_string(size)}};
+        IsosurfaceMesher mesher;
+        RenderMesh mesh;
+        IsosurfaceStats stats;
+        for (unsigned threads : thread_counts()) {
+            JobSystem jobs(threads);
+            BenchParams params = base_params;
+            params.push_back({"threads", std::to_string(threads)});
+            BenchResult* result = bench("iso/build", params, [&] { stats = mesher.update(*grid, 0.0f, mesh, &jobs); }, [&] { grid->mark_all_changed(); });
+            add_throughput(result, "Mcells/s", cells);
+            if (result) {
+                result->metrics.push_back({"tris", (double)stats.triangles});
+                result->metrics.push_back({"grid MB", grid->bytes() / (1024.0 * 1024.0)});
+            }
+            finish(result);
+        }
+
+        // Steps stay inside the sparse band, so both grids mesh the same surface
+        JobSystem jobs;
+        float iso = 0.0f, step = 0.01f;
+        mesher.update(*grid, iso, mesh, &jobs);
+        BenchResult* result = bench("iso/retarget", base_params, [&] { stats = mesher.update(*grid, iso, mesh, &jobs); }, [&] {
+            if (std::fabs(iso + step) > 0.05f) step = -step;
+            iso += step;
+        });
+        if (result) {
+            result->metrics.push_back({"blocks", (double)stats.blocks_meshed});
+            result->metrics.push_back({"of", (double)grid->block_count()});
+        }
+        finish(result);
+
+        // A sphere of radius 4 samples carved out along a diagonal, each rep undoing the last
+        iso = 0.0f;
+        mesher.update(*grid, iso, mesh, &jobs);
+        int position = 0;
+        auto carve = [&](int at, bool restore) {
+            glm::ivec3 center(size / 4 + at % (size / 2), size / 2, size / 4 + at % (size / 2));
+            for (int z = -4; z <= 4; z++) {
+                for (int y = -4; y <= 4; y++) {
+                    for (int x = -4; x <= 4; x++) {
+                        glm::ivec3 sample = center + glm::ivec3(x, y, z);
+                        float field = isosurface_test_field(grid->position(sample));
+                        if (grid == &sparse) field = glm::clamp(field, -band, band);
+                        float hole = 4.0f * grid->spacing - std::sqrt((float)(x * x + y * y + z * z)) * grid->spacing;
+                        grid->set(sample.x, sample.y, sample.z, restore ? field : std::max(field, hole));
+                    }
+                }
+            }
+        };
+        result = bench("iso/edit", base_params, [&] { stats = mesher.update(*grid, iso, mesh, &jobs); }, [&] {
+            if (position > 0) carve(position - 1, true);
+            carve(position++, false);
+        });
+        if (result) {
+            result->metrics.push_back({"blocks", (double)stats.blocks_meshed});
+            result->metrics.push_back({"of", (double)grid->block_count()});
+        }
+        finish(result);
+    }
+}
+
+void bench_textures() {
+    if (!selected({"texture/mips_box", "texture/mips_kaiser", "texture/load_cold", "texture/load_warm"})) return;
+    // Mip chain generation on a synthetic 2048x2048 RGBA image
+    TextureData texture;
+    texture.width = texture.height = 2048;
+    texture.storage.resize((size_t)2048 * 2048 * 4);
+    for (size_t i = 0; i < texture.storage.size(); i++) texture.storage[i] = (unsigned char)((i * 2654435761u) >> 24);
+    texture.levels = {{2048, 2048, 0, texture.storage.size()}};
+
+    BenchParams params = {{"size", "2048"}};
+    finish(bench("texture/mips_box", params, [&] { generate_mips(texture, MipFilter::Box); }));
+    finish(bench("texture/mips_kaiser", params, [&] { generate_mips(texture, MipFilter::Kaiser); }));
+
+    // Cold load decodes the image, builds mips and writes the cache. Warm load maps the cache.
+    const std::string filename = "assets/textures/checker_diffuse.png";
+    BenchResult* cold = bench("texture/load_cold", {}, [&] {
+        TextureData data;
+        load_texture_data(filename, data);
+    }, [&] { std::remove(texture_cache_path(filename).c_str()); });
+    finish(cold);
+
+    BenchResult* warm = bench("texture/load_warm", {}, [&] {
+        TextureData data;
+        load_texture_data(filename, data);
+    });
+    if (cold && warm) warm->metrics.push_back({"speedup", percentile(cold->samples, 50.0) / percentile(warm->samples, 50.0)});
+    finish(warm);
+}
+
+// Synthetic terrain scan: a colored heightfield with one point per grid cell, 200 units wide
+std::vector<CloudPoint> synthetic_points(size_t count) {
+    size_t side = (size_t)std::ceil(std::sqrt((double)count));
+    std::vector<CloudPoint> points(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = (float)(i % side) / side * 200.0f - 100.0f;
+        float z = (float)(i / side) / side * 200.0f - 100.0f;
+        float y = 4.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f) + 0.5f * std::sin(x * 0.9f + z * 0.4f);
+        float t = glm::clamp((y + 4.5f) / 9.0f, 0.0f, 1.0f);
+        points[i].position = glm::vec3(x, y, z);
+        points[i].color = point_color(0.2 + 0.6 * t, 0.5 + 0.3 * (1.0 - t), 0.2, true);
+        points[i].radius = 0.0f;
+    }
+    return points;
+}
+
+// PLY import, octree build and per-frame node selection over cameras flying across the terrain
+void bench_points() {
+    if (!selected({"points/read_ply", "points/build_octree", "points/select"})) return;
+    std::error_code ec;
+    std::filesystem::create_directories(options.output_dir, ec);
+    JobSystem jobs;
+
+    std::vector<size_t> counts = {std::min<size_t>(1000000, options.max_points)};
+    if (options.max_points > 1000000) counts.push_back(options.max_points);
+    for (size_t count : counts) {
+        std::string filename = options.output_dir + "/synthetic_" + std::to_string(count) + ".ply";
+        if (!std::filesystem::exists(filename) && !write_points_ply(filename, synthetic_points(count))) {
+            std::cerr << "Failed to write " << filename << std::endl;
+            return;
+        }
+        BenchParams params = {{"points", std::to_string(count)}, {"threads", std::to_string(jobs.thread_count())}};
+
+        int reps = std::min(options.reps, 5);
+        std::vector<CloudPoint> points;
+        BenchResult* result = bench("points/read_ply", params, [&] { read_points(filename, points, &jobs); }, nullptr, reps);
+        if (points.empty()) read_points(filename, points, &jobs);
+        add_throughput(result, "Mpts/s", (double)count);
+        finish(result);
+
+        PointCloud cloud;
+        result = bench("points/build_octree", {{"points", std::to_string(count)}}, [&] { cloud.build(points); }, nullptr, reps);
+        if (cloud.nodes.empty()) cloud.build(points);
+        if (result) result->metrics.push_back({"nodes", (double)cloud.nodes.size()});
+        add_throughput(result, "Mpts/s", (double)count);
+        finish(result);
+
+        // 1280x720, 60 degree field of view, 16 cameras along a diagonal pass
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
+        float projection_scale = 720.0f * projection[1][1] * 0.5f;
+        PointLod lod;
+        lod.budget = 1000000;
+        PointSelection selection;
+        double selected_points = 0.0, draws = 0.0;
+        int views = 0;
+        result = bench("points/select", {{"points", std::to_string(count)}, {"budget", std::to_string(lod.budget)}}, [&] {
+            for (int i = 0; i < 16; i++) {
+                float t = i / 15.0f;
+                glm::vec3 eye(-90.0f + 180.0f * t, 15.0f, -90.0f + 180.0f * t);
+                glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(1.0f, -0.4f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                cloud.select(Frustum::from_matrix(projection * view), eye, projection_scale, cloud.points.size(), lod, selection);
+                selected_points += selection.points;
+                draws += selection.firsts.size();
+                views++;
+            }
+        });
+        if (result && views > 0) {
+            result->metrics.push_back({"avg points", selected_points / views});
+            result->metrics.push_back({"avg draws", draws / views});
+        }
+        finish(result);
+    }
+}
+
+// Fraction of triangles removed by meshlet culling over cameras orbiting the mesh
+void bench_meshlet_culling(const std::string& name, RenderMesh mesh) {
+    mesh.compute_bounds();
+    mesh.build_meshlets();
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    MeshletDrawList ranges;
+    const int views = 64;
+    BenchResult* result = bench("meshlets/cull", {{"mesh", name}, {"views", std::to_string(views)}}, [&] {
+        for (int i = 0; i < views; i++) {
+            float angle = i * glm::two_pi<float>() / views;
+            glm::vec3 eye = mesh.bounds_center + mesh.bounds_radius * 2.5f * glm::vec3(glm::cos(angle), 0.5f, glm::sin(angle));
+            glm::mat4 view = glm::lookAt(eye, mesh.bounds_center, glm::vec3(0.0f, 1.0f, 0.0f));
+            cull_meshlets(mesh, glm::mat4(1.0f), Frustum::from_matrix(projection * view), eye, ranges);
+        }
+    }, [&] { ranges.clear(); });
+    if (result) {
+        result->metrics.push_back({"meshlets", (double)mesh.meshlets.size()});
+        result->metrics.push_back({"culled%", 100.0 * (1.0 - (double)ranges.visible_triangles / ranges.triangles)});
+    }
+    finish(result);
+}
+
+// Upload and draw through an offscreen context, timed to completion with glFinish
+void bench_gl() {
+    if (!selected({"gl/upload", "gl/update", "gl/draw", "gl/index_formats"})) return;
+    HeadlessContext context;
+    if (!context.create() || !gladLoadGLLoader(HeadlessContext::loader())) {
+        std::cout << "No headless GL context, skipping GL benchmarks" << std::endl;
+        return;
+    }
+
+    RenderTarget target;
+    target.create(1280, 720);
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+
+    for (int resolution : {256, 1024}) {
+        RenderMesh mesh = RenderMesh::uvsphere(resolution, resolution);
+        BenchParams params = {{"rings", std::to_string(resolution)}, {"sectors", std::to_string(resolution)}};
+        BenchResult* result = bench("gl/upload", params, [&] {
+            mesh.upload();
+            glFinish();
+        }, [&] { mesh.release(); });
+        double megabytes = (mesh.get_vertex_data().size() * sizeof(float) + mesh.index_bytes()) / (1024.0 * 1024.0);
+        double upload_ms = result ? percentile(result->samples, 50.0) : 0.0;
+        if (result) result->metrics.push_back({"MB/s", megabytes / (upload_ms / 1000.0)});
+        finish(result);
+
+        // Edits of a few vertices and triangles against re-uploading the mesh:
+        // contiguous spans, then the same amount scattered over the mesh
+        mesh.upload();
+        size_t vertex_count = mesh.positions.size();
+        for (size_t edited : {vertex_count / 1000, vertex_count / 100}) {
+            for (int spans : {1, 64, 256}) {
+                float offset = 0.0f;
+                auto edit = [&] {
+                    offset += 0.001f;
+                    size_t span = std::max<size_t>(edited / spans, 1);
+                    for (int k = 0; k < spans; k++) {
+                        size_t first = (vertex_count - span) * k / spans;
+                        for (size_t v = first; v < first + span; v++) mesh.positions[v].y += offset;
+                        mesh.mark_vertices_dirty(first, span);
+                        size_t first_index = mesh.indices.size() * k / spans / 3 * 3;
+                        std::swap(mesh.indices[first_index], mesh.indices[first_index + 1]);
+                        mesh.mark_indices_dirty(first_index, 2);
+                    }
+                };
+                size_t bytes = 0;
+                BenchParams update_params = params;
+                update_params.push_back({"edited", std::to_string(edited)});
+                update_params.push_back({"spans", std::to_string(spans)});
+                result = bench("gl/update", update_params, [&] {
+                    bytes = mesh.update();
+                    glFinish();
+                }, edit);
+                if (result) {
+                    double update_ms = percentile(result->samples, 50.0);
+                    result->metrics.push_back({"KB", bytes / 1024.0});
+                    result->metrics.push_back({"vs upload%", upload_ms > 0.0 ? 100.0 * update_ms / upload_ms : 0.0});
+                }
+                finish(result);
+            }
+        }
+        mesh.release();
+    }
+
+    Shader shader("multiple_lights");
+    RenderMesh sphere = RenderMesh::uvsphere(32, 32);
+    sphere.upload();
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
+    shader.setMat4("projection", projection);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 40.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    shader.setMat4("view", view);
+
+    for (int instances : {100, 1000, 10000}) {
+        if (instances > options.max_instances) break;
+        int side = (int)std::ceil(std::sqrt((double)instances));
+        BenchResult* result = bench("gl/draw", {{"instances", std::to_string(instances)}, {"tris", std::to_string(sphere.indices.size() / 3)}}, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < instances; i++) {
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((i % side - side / 2) * 1.5f, 0.0f, (i / side - side / 2) * -1.5f));
+                shader.setMat4("model", model);
+                sphere.draw();
+            }
+            glFinish();
+        });
+        if (result) result->metrics.push_back({"draws/s", instances / (percentile(result->samples, 50.0) / 1000.0)});
+        finish(result);
+    }
+
+    // Spheres whose vertex counts select 8, 16 and 32-bit indices, drawn as
+    // lists and as restart strips to about a million triangles per rep
+    for (int resolution : {8, 64, 400}) {
+        for (bool strips : {false, true}) {
+            RenderMesh mesh = RenderMesh::uvsphere(resolution, resolution, nullptr, strips);
+            mesh.upload();
+            const char* type = mesh.index_size() == 1 ? "u8" : mesh.index_size() == 2 ? "u16" : "u32";
+            size_t triangles = mesh.indices.size() / 3;
+            int instances = std::min(options.max_instances, std::max(1, (int)(1000000 / triangles)));
+            BenchParams params = {{"type", type}, {"mode", strips ? "strip" : "list"}, {"tris", std::to_string(triangles)}};
+            BenchResult* result = bench("gl/index_formats", params, [&] {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                for (int i = 0; i < instances; i++) {
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((i % 32 - 16) * 1.5f, 0.0f, (i / 32) * -1.5f));
+                    shader.setMat4("model", model);
+                    mesh.draw();
+                }
+                glFinish();
+            });
+            if (result) {
+                double seconds = percentile(result->samples, 50.0) / 1000.0;
+                result->metrics.push_back({"index KB", mesh.index_bytes() / 1024.0});
+                result->metrics.push_back({"vs u32 list%", 100.0 * mesh.index_bytes() / (mesh.indices.size() * sizeof(unsigned int))});
+                result->metrics.push_back({"index MB/s", (double)instances * mesh.index_bytes() / (1024.0 * 1024.0) / seconds});
+                add_throughput(result, "Mtris/s", (double)instances * triangles);
+            }
+            finish(result);
+        }
+    }
+
+    sphere.release();
+    target.destroy();
+    context.destroy();
+}
+
+// Frames where the main thread animates, updates and culls a scene and builds
+// the draw list, and the GL side draws it. Serial does both on one thread,
+// threaded records into a RenderThread that draws frame N while frame N+1 is
+// built. overlap% is how much of the shorter half the threaded run hid.
+void bench_render_thread() {
+    if (!selected({"render_thread/cpu", "render_thread/submit", "render_thread/serial", "render_thread/threaded"})) return;
+    HeadlessContext context;
+    if (!context.create() || !gladLoadGLLoader(HeadlessContext::loader())) {
+        std::cout << "No headless GL context, skipping render thread benchmarks" << std::endl;
+        return;
+    }
+
+    RenderTarget target;
+    target.create(320, 180);     // Small, so submission rather than fill dominates on software GL
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+
+    Shader shader("multiple_lights");
+    RenderMesh sphere = RenderMesh::uvsphere(8, 8);
+    sphere.compute_bounds();
+    sphere.upload();
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 320.0f / 180.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 40.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+    Frustum frustum = Frustum::from_matrix(projection * view);
+
+    const int instances = std::min(5000, options.max_instances);
+    const int frames = 20;
+    Scene scene;
+    std::vector<Entity> roots;
+    int side = (int)std::ceil(std::sqrt(instances / 10.0));
+    for (int i = 0; i < instances / 10; i++) {
+        roots.push_back(scene.create("root", NULL_ENTITY, &sphere));
+        for (int j = 0; j < 9; j++) {
+            Entity child = scene.create("child", roots.back(), &sphere);
+            scene.set_translation(child, glm::vec3(0.0f, (j + 1) * 1.5f, 0.0f));
+        }
+    }
+    JobSystem jobs;
+    std::vector<uint8_t> visible;
+    std::vector<glm::mat4> draw_lists[RenderThread::MAX_FRAMES];
+
+    float time = 0.0f;
+    auto build = [&](std::vector<glm::mat4>& draws) {
+        time += 0.016f;
+        for (size_t i = 0; i < roots.size(); i++) {
+            float height = std::sin(time + i * 0.1f);
+            scene.set_translation(roots[i], glm::vec3((i % side - side / 2) * 3.0f, height, (i / side - side / 2) * -3.0f));
+        }
+        scene.update(jobs);
+        cull_scene(scene, frustum, visible, &jobs);
+        draws.clear();
+        for (size_t i = 0; i < scene.size(); i++) {
+            if (visible[i]) draws.push_back(scene.world[i]);
+        }
+    };
+    auto submit = [&](const std::vector<glm::mat4>& draws) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (glm::mat4 model : draws) {
+            shader.setMat4("model", model);
+            sphere.draw();
+        }
+    };
+
+    BenchParams params = {{"instances", std::to_string(scene.size())}, {"frames", std::to_string(frames)}};
+    auto per_frame = [&](BenchResult* result) {
+        double ms = result ? percentile(result->samples, 50.0) / frames : 0.0;
+        if (result) result->metrics.push_back({"ms/frame", ms});
+        return ms;
+    };
+
+    BenchResult* result = bench("render_thread/cpu", params, [&] {
+        for (int frame = 0; frame < frames; frame++) build(draw_lists[0]);
+    });
+    double cpu_ms = per_frame(result);
+    finish(result);
+
+    build(draw_lists[0]);
+    result = bench("render_thread/submit", params, [&] {
+        for (int frame = 0; frame < frames; frame++) submit(draw_lists[0]);
+        glFinish();
+    });
+    double submit_ms = per_frame(result);
+    finish(result);
+
+    result = bench("render_thread/serial", params, [&] {
+        for (int frame = 0; frame < frames; frame++) {
+            build(draw_lists[0]);
+            submit(draw_lists[0]);
+        }
+        glFinish();
+    });
+    double serial_ms = per_frame(result);
+    finish(result);
+
+    for (int lists : {2, 3}) {
+        context.release();
+        RenderThread render_thread;
+        RenderThread::Callbacks callbacks;
+        callbacks.attach = [&] { context.make_current(); };
+        callbacks.detach = [&] { context.release(); };
+        render_thread.start(lists, callbacks);
+
+        BenchParams threaded_params = params;
+        threaded_params.push_back({"lists", std::to_string(lists)});
+        result = bench("render_thread/threaded", threaded_params, [&] {
+            for (int frame = 0; frame < frames; frame++) {
+                int slot = render_thread.acquire();
+                std::vector<glm::mat4>& draws = draw_lists[slot];
+                build(draws);
+                bool last = frame == frames - 1;
+                render_thread.commands(slot).push([&submit, &draws, last] {
+                    submit(draws);
+                    if (last) glFinish();
+                });
+                render_thread.submit();
+            }
+            render_thread.wait_idle();
+        });
+        render_thread.stop();
+        context.make_current();
+
+        double threaded_ms = per_frame(result);
+        if (result) {
+            // At most the shorter half can be hidden, noise on software GL can exceed it
+            double hidden_ms = serial_ms - threaded_ms;
+            double shorter_ms = std::min(cpu_ms, submit_ms);
+            result->metrics.push_back({"speedup", threaded_ms > 0.0 ? serial_ms / threaded_ms : 0.0});
+            result->metrics.push_back({"hidden ms/frame", hidden_ms});
+            result->metrics.push_back({"overlap%", shorter_ms > 0.0 ? std::min(std::max(100.0 * hidden_ms / shorter_ms, 0.0), 100.0) : 0.0});
+        }
+        finish(result);
+    }
+
+    target.destroy();
+    context.destroy();
+}
+
+// Both skinning back ends end to end: joint matrices as uniforms for the
+// vertex shader, or CPU skinning streamed to the GPU every frame
+void bench_gpu_skinning() {
+    if (!selected({"skinning/gpu", "skinning/cpu_upload"})) return;
+    HeadlessContext context;
+    if (!context.create() || !gladLoadGLLoader(HeadlessContext::loader())) {
+        std::cout << "No headless GL context, skipping skinning benchmarks" << std::endl;
+        return;
+    }
+
+    // Small target and a distant camera, so vertex work dominates over fill
+    RenderTarget target;
+    target.create(320, 180);
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 320.0f / 180.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Shader skinnedShader("skinned", "multiple_lights", "skinned");
+    Shader staticShader("multiple_lights");
+    for (Shader* shader : {&skinnedShader, &staticShader}) {
+        shader->setMat4("projection", projection);
+        shader->setMat4("view", view);
+    }
+    JobSystem jobs;
+
+    for (int rows : {256, 2048}) {
+        SkinnedModel model = skinned_tentacle(64, rows, 256);
+        model.mesh.upload();
+        size_t vertex_count = model.mesh.positions.size();
+        int instances = std::max(1, (int)(1000000 / vertex_count));
+        BenchParams params = {{"verts", std::to_string(vertex_count)}, {"instances", std::to_string(instances)}};
+        JointPoses pose;
+        std::vector<glm::mat4> skin(model.skeleton.joint_count());
+        VertexStream stream;
+        stream.create(model.mesh, instances);
+        auto model_matrix = [](int i) { return glm::translate(glm::mat4(1.0f), glm::vec3((i % 16 - 8) * 1.0f, 0.0f, (i / 16) * -1.0f)); };
+
+        // Every instance animates at its own time, as separate characters would
+        BenchResult* result = bench("skinning/gpu", params, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < instances; i++) {
+                model.clip.sample(i * 0.05f, pose);
+                model.skeleton.skin_matrices(pose, skin.data());
+                glm::mat4 transform = model_matrix(i);
+                skinnedShader.setMat4("model", transform);
+                skinnedShader.setMat4Array("joints", skin.data(), (int)skin.size());
+                model.mesh.draw();
+            }
+            glFinish();
+        });
+        add_throughput(result, "Mverts/s", (double)instances * vertex_count);
+        finish(result);
+
+        // CPU skinning straight into the stream buffer, one region per frame
+        result = bench("skinning/cpu_upload", params, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < instances; i++) {
+                model.clip.sample(i * 0.05f, pose);
+                model.skeleton.skin_matrices(pose, skin.data());
+                float* vertices = stream.map(model.mesh);
+                if (!vertices) break;
+                skin_vertices(model.mesh, skin.data(), vertices, &jobs);
+                stream.bind(model.mesh);
+                glm::mat4 transform = model_matrix(i);
+                staticShader.setMat4("model", transform);
+                model.mesh.draw();
+            }
+            stream.end_frame();
+            glFinish();
+        });
+        add_throughput(result, "Mverts/s", (double)instances * vertex_count);
+        finish(result);
+        stream.destroy();
+    }
+
+    target.destroy();
+    context.destroy();
+}
+
+void bench_gpu_morph() {
+    if (!selected({"morph/gpu", "morph/stream"})) return;
+    HeadlessContext context;
+    if (!context.create() || !gladLoadGLLoader(HeadlessContext::loader())) {
+        std::cout << "No headless GL context, skipping morph benchmarks" << std::endl;
+        return;
+    }
+    load_stream_buffer_functions(HeadlessContext::loader());
+
+    // Same setup as bench_gpu_skinning, vertex work dominates over fill
+    RenderTarget target;
+    target.create(320, 180);
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 320.0f / 180.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Shader morphShader("morph", "multiple_lights", "morph");
+    Shader staticShader("multiple_lights");
+    for (Shader* shader : {&morphShader, &staticShader}) {
+        shader->setMat4("projection", projection);
+        shader->setMat4("view", view);
+    }
+    JobSystem jobs;
+
+    RenderMesh base = RenderMesh::uvsphere(256, 256);
+    base.compute_vertex_normals();
+    base.upload();
+    size_t vertex_count = base.positions.size();
+    const int target_count = 64;
+    int instances = std::max(1, (int)(1000000 / vertex_count));
+    auto model_matrix = [](int i) { return glm::translate(glm::mat4(1.0f), glm::vec3((i % 16 - 8) * 2.0f, 0.0f, (i / 16) * -2.0f)); };
+
+    for (MorphPrecision precision : {MorphPrecision::Float32, MorphPrecision::Snorm16}) {
+        MorphTargets targets(precision);
+        add_bench_morph_targets(targets, base, target_count);
+        targets.upload(base);
+        VertexStream stream;
+        stream.create(base, instances);
+        std::vector<float> weights(target_count, 0.0f);
+        // Every instance with its own four active targets
+        auto instance_weights = [&](int i) {
+            std::fill(weights.begin(), weights.end(), 0.0f);
+            for (int k = 0; k < 4; k++) weights[(i * 4 + k) % target_count] = 0.5f;
+        };
+        BenchParams params = {{"verts", std::to_string(vertex_count)}, {"instances", std::to_string(instances)},
+                              {"format", precision == MorphPrecision::Float32 ? "f32" : "s16"}};
+
+        BenchResult* result = bench("morph/gpu", params, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < instances; i++) {
+                instance_weights(i);
+                glm::mat4 transform = model_matrix(i);
+                morphShader.setMat4("model", transform);
+                targets.bind(morphShader, weights.data());
+                base.draw();
+            }
+            glFinish();
+        });
+        add_throughput(result, "Mverts/s", (double)instances * vertex_count);
+        if (result) result->metrics.push_back({"gpu_KB", targets.gpu_bytes() / 1024.0});
+        finish(result);
+
+        // CPU apply straight into the stream buffer, one region per frame
+        result = bench("morph/stream", params, [&] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int i = 0; i < instances; i++) {
+                instance_weights(i);
+                float* vertices = stream.map(base);
+                if (!vertices) break;
+                targets.apply(base, weights.data(), vertices, &jobs);
+                stream.bind(base);
+                glm::mat4 transform = model_matrix(i);
+                staticShader.setMat4("model", transform);
+                base.draw();
+            }
+            stream.end_frame();
+            glFinish();
+        });
+        add_throughput(result, "Mverts/s", (double)instances * vertex_count);
+        finish(result);
+        stream.destroy();
+        targets.release();
+        // Back to the static vertices for the next format's GPU case
+        glBindVertexArray(base.gpu.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, base.gpu.VBO);
+        base.setup_vertex_attributes();
+        glBindVertexArray(0);
+    }
+
+    base.release();
+    target.destroy();
+    context.destroy();
+}
+
+// Per-frame line vertices written and drawn the naive way (glBufferData of a
+// CPU array), through an orphaning StreamBuffer and through a persistent one
+void bench_streaming() {
+    if (!selected({"stream/buffer_data", "stream/orphan", "stream/persistent"})) return;
+    HeadlessContext context;
+    if (!context.create() || !gladLoadGLLoader(HeadlessContext::loader())) {
+        std::cout << "No headless GL context, skipping streaming benchmarks" << std::endl;
+        return;
+    }
+    bool persistent = load_stream_buffer_functions(HeadlessContext::loader());
+
+    RenderTarget target;
+    target.create(320, 180);
+    target.bind();
+
+    Shader shader("debug");
+    glm::mat4 identity(1.0f);
+    shader.setMat4("projection", identity);
+    shader.setMat4("view", identity);
+    shader.setMat4("model", identity);
+
+    const int frames = 20;
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+
+    for (size_t lines : {10000, 100000}) {
+        size_t bytes = lines * 2 * sizeof(glm::vec3);
+        BenchParams params = {{"lines", std::to_string(lines)}, {"frames", std::to_string(frames)}};
+        // Short lines that shift every frame, so uploads rather than rasterization dominate
+        auto write_lines = [&](glm::vec3* out, int frame) {
+            for (size_t i = 0; i < lines; i++) {
+                float x = (float)i / lines * 2.0f - 1.0f;
+                out[i * 2] = glm::vec3(x, -0.5f + frame * 0.01f, 0.0f);
+                out[i * 2 + 1] = glm::vec3(x, -0.49f + frame * 0.01f, 0.0f);
+            }
+        };
+        auto throughput = [&](BenchResult* result) {
+            if (result) result->metrics.push_back({"MB/s", bytes * frames / (1024.0 * 1024.0) / (percentile(result->samples, 50.0) / 1000.0)});
+            finish(result);
+        };
+
+        GLuint vbo = 0;
+        glGenBuffers(1, &vbo);
+        std::vector<glm::vec3> vertices(lines * 2);
+        throughput(bench("stream/buffer_data", params, [&] {
+            for (int frame = 0; frame < frames; frame++) {
+                write_lines(vertices.data(), frame);
+                glBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glBufferData(GL_ARRAY_BUFFER, bytes, vertices.data(), GL_DYNAMIC_DRAW);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+                glDrawArrays(GL_LINES, 0, (GLsizei)(lines * 2));
+            }
+            glFinish();
+        }));
+        glDeleteBuffers(1, &vbo);
+
+        for (bool use_persistent : {false, true}) {
+            if (use_persistent && !persistent) {
+                std::cout << "stream/persistent: no GL 4.4 or ARB_buffer_storage, skipped" << std::endl;
+                continue;
+            }
+            StreamBuffer::allow_persistent = use_persistent;
+            StreamBuffer stream;
+            stream.create(GL_ARRAY_BUFFER, bytes);
+            throughput(bench(use_persistent ? "stream/persistent" : "stream/orphan", params, [&] {
+                for (int frame = 0; frame < frames; frame++) {
+                    StreamAllocation allocation = stream.allocate(bytes);
+                    write_lines((glm::vec3*)allocation.data, frame);
+                    stream.flush();
+                    glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (const void*)allocation.offset);
+                    glDrawArrays(GL_LINES, 0, (GLsizei)(lines * 2));
+                    stream.end_frame();
+                }
+                glFinish();
+            }));
+        }
+        StreamBuffer::allow_persistent = true;
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    target.destroy();
+    context.destroy();
+}
+
+bool write_json(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file) return false;
+
+    auto escape = [](const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    };
+
+    file << std::setprecision(6) << "{\n";
+    file << "  \"config\": {\"warmup\": " << options.warmup << ", \"reps\": " << options.reps
+         << ", \"hardware_threads\": " << std::thread::hardware_concurrency() << "},\n";
+    file << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        file << "    {\"name\": \"" << escape(result.name) << "\", \"params\": {";
+        for (size_t j = 0; j < result.params.size(); j++) {
+            file << (j ? ", " : "") << "\"" << escape(result.params[j].first) << "\": \"" << escape(result.params[j].second) << "\"";
+        }
+        file << "}, \"reps\": " << result.samples.size() << ", \"warmup\": " << result.warmup
+             << ", \"min_ms\": " << percentile(result.samples, 0.0)
+             << ", \"mean_ms\": " << result.mean()
+             << ", \"p50_ms\": " << percentile(result.samples, 50.0)
+             << ", \"p90_ms\": " << percentile(result.samples, 90.0)
+             << ", \"p99_ms\": " << percentile(result.samples, 99.0)
+             << ", \"max_ms\": " << percentile(result.samples, 100.0) << ", \"metrics\": {";
+        for (size_t j = 0; j < result.metrics.size(); j++) {
+            file << (j ? ", " : "") << "\"" << escape(result.metrics[j].first) << "\": " << result.metrics[j].second;
+        }
+        file << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return (bool)file;
+}
+
+// Reads back the files written by write_json(), which keeps one result per line.
+// Returns (key, p50) pairs in file order.
+std::vector<std::pair<std::string, double>> read_json(const std::string& filename) {
+    std::vector<std::pair<std::string, double>> entries;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t name = line.find("{\"name\": \"");
+        size_t reps = line.find(", \"reps\"");
+        size_t p50 = line.find("\"p50_ms\": ");
+        if (name == std::string::npos || reps == std::string::npos || p50 == std::string::npos) continue;
+        std::string key = line.substr(name + 10, reps - name - 10);
+        entries.push_back({key, std::strtod(line.c_str() + p50 + 10, nullptr)});
+    }
+    return entries;
+}
+
+int compare(const std::string& old_file, const std::string& new_file) {
+    auto old_entries = read_json(old_file);
+    auto new_entries = read_json(new_file);
+    if (old_entries.empty() || new_entries.empty()) {
+        std::cerr << "No results in " << (old_entries.empty() ? old_file : new_file) << std::endl;
+        return 1;
+    }
+
+    for (const auto& entry : new_entries) {
+        auto old = std::find_if(old_entries.begin(), old_entries.end(), [&](const auto& e) { return e.first == entry.first; });
+        std::string label = entry.first;
+        for (const char* strip : {"\"params\": ", "\"", "{", "}"}) {
+            for (size_t at; (at = label.find(strip)) != std::string::npos;) label.erase(at, std::strlen(strip));
+        }
+        std::cout << std::left << std::setw(64) << label << std::right << std::fixed << std::setprecision(3);
+        if (old == old_entries.end()) {
+            std::cout << "        new " << std::setw(10) << entry.second << " ms" << std::endl;
+            continue;
+        }
+        double change = old->second > 0.0 ? 100.0 * (entry.second - old->second) / old->second : 0.0;
+        std::cout << std::setw(10) << old->second << " -> " << std::setw(10) << entry.second << " ms "
+                  << std::showpos << std::setprecision(1) << std::setw(7) << change << "%" << std::noshowpos
+                  << (change > 5.0 ? "  slower" : change < -5.0 ? "  faster" : "") << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Profiler::instance().enabled = false;      // Zones in the job system would add to every timing
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--compare" && i + 2 < argc) {
+            return compare(argv[i + 1], argv[i + 2]);
+        } else if (arg == "--reps" && has_value) {
+            options.reps = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            options.json = argv[++i];
+        } else if (arg == "--output" && has_value) {
+            options.output_dir = argv[++i];
+        } else if (arg == "--max-obj-tris" && has_value) {
+            options.max_obj_triangles = (size_t)std::atoll(argv[++i]);
+        } else if (arg == "--max-instances" && has_value) {
+            options.max_instances = std::atoi(argv[++i]);
+        } else if (arg == "--max-points" && has_value) {
+            options.max_points = (size_t)std::atoll(argv[++i]);
+        } else if (arg == "--no-gl") {
+            options.gl = false;
+        } else {
+            options.obj_files.push_back(arg);
+        }
+    }
+
+    std::cout << "Benchmarks: " << options.warmup << " warmup, " << options.reps << " reps, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    bench_generators();
+    bench_obj();
+    bench_scenes();
+    bench_job_scaling();
+    bench_textures();
+    bench_points();
+    bench_subdivision();
+    bench_welding();
+    bench_skinning();
+    bench_morph();
+    bench_isosurface();
+    if (selected({"meshlets/cull"})) {
+        bench_meshlet_culling("uvsphere 100x100", RenderMesh::uvsphere(100, 100));
+        bench_meshlet_culling("uvsphere 1000x1000", RenderMesh::uvsphere(1000, 1000));
+        for (const auto& filename : options.obj_files) bench_meshlet_culling(filename, RenderMesh::from_obj(filename));
+    }
+    if (options.gl) {
+        bench_gl();
+        bench_render_thread();
+        bench_streaming();
+        bench_gpu_skinning();
+        bench_gpu_morph();
+    }
+
+    if (!options.json.empty()) {
+        if (!write_json(options.json)) {
+            std::cerr << "Failed to write " << options.json << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << options.json << std::endl;
+    }
+    return 0;
+}
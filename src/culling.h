@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "scene.h"
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance)
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum from_matrix(const glm::mat4& view_projection);
+    bool intersects_sphere(const glm::vec3& center, float radius) const;
+};
+
+Frustum Frustum::from_matrix(const glm::mat4& m) {
+    // Gribb/Hartmann plane extraction from the rows of the clip matrix
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum f;
+    f.planes[0] = row3 + row0;  // Left
+    f.planes[1] = row3 - row0;  // Right
+    f.planes[2] = row3 + row1;  // Bottom
+    f.planes[3] = row3 - row1;  // Top
+    f.planes[4] = row3 + row2;  // Near
+    f.planes[5] = row3 - row2;  // Far
+
+    for (auto& plane : f.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return f;
+}
+
+bool Frustum::intersects_sphere(const glm::vec3& center, float radius) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    }
+    return true;
+}
+
+// Frustum test of every scene entity's world-space bounding sphere. visible[slot]
+// is 1 if the entity has a mesh and may be on screen. Returns the visible count.
+size_t cull_scene(const Scene& scene, const Frustum& frustum, std::vector<uint8_t>& visible, JobSystem* jobs = nullptr) {
+    visible.assign(scene.size(), 0);
+
+    auto cull_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const RenderMesh* mesh = scene.meshes[i];
+            if (!mesh) continue;
+
+            const glm::mat4& m = scene.world[i];
+            glm::vec3 center = glm::vec3(m * glm::vec4(mesh->bounds_center, 1.0f));
+            float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+            visible[i] = frustum.intersects_sphere(center, mesh->bounds_radius * scale) ? 1 : 0;
+        }
+    };
+
+    if (jobs) jobs->parallel_for(0, scene.size(), 256, cull_range);
+    else cull_range(0, scene.size());
+
+    size_t count = 0;
+    for (uint8_t v : visible) count += v;
+    return count;
+}
+
+// Per-meshlet frustum and backface cone test for one mesh instance. Appends the
+// index ranges of visible meshlets to `ranges`, merging runs of consecutive
+// visible meshlets into one range. Returns the number of visible triangles.
+size_t cull_meshlets(const RenderMesh& mesh, const glm::mat4& model, const Frustum& frustum, const glm::vec3& camera_position, MeshletDrawList& ranges) {
+    glm::vec3 axis_scale(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])));
+    float scale = std::max(axis_scale.x, std::max(axis_scale.y, axis_scale.z));
+
+    // Cone angles only survive uniform scale, skip the backface test otherwise
+    float min_scale = std::min(axis_scale.x, std::min(axis_scale.y, axis_scale.z));
+    bool cone_test = min_scale > 0.0f && (scale - min_scale) <= 1e-3f * scale;
+    glm::mat3 rotation(model);
+
+    size_t visible = 0;
+    bool extend = false;    // Previous meshlet was visible, grow its range
+    for (const Meshlet& m : mesh.meshlets) {
+        ranges.triangles += m.triangle_count;
+
+        glm::vec3 center = glm::vec3(model * glm::vec4(m.center, 1.0f));
+        float radius = m.radius * scale;
+        bool keep = frustum.intersects_sphere(center, radius);
+
+        if (keep && cone_test && m.cone_cutoff < 1.0f) {
+            // Every triangle faces away if the camera is behind the cone, with
+            // the bounding sphere as a conservative margin
+            glm::vec3 to_center = center - camera_position;
+            glm::vec3 axis = glm::normalize(rotation * m.cone_axis);
+            keep = glm::dot(to_center, axis) < m.cone_cutoff * glm::length(to_center) + radius;
+        }
+
+        if (!keep) {
+            extend = false;
+            continue;
+        }
+
+        GLsizei count = (GLsizei)m.triangle_count * 3;
+        if (extend) ranges.counts.back() += count;
+        else {
+            ranges.counts.push_back(count);
+            ranges.offsets.push_back((const void*)(m.index_offset * mesh.index_size()));
+        }
+        extend = true;
+        visible += m.triangle_count;
+    }
+
+    ranges.visible_triangles += visible;
+    return visible;
+}
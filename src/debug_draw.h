@@ -0,0 +1,309 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "imgui.h"
+#include "mesh.h"
+#include "shader.h"
+#include "stream_buffer.h"
+#include "render_stats.h"
+
+struct DebugVertex {
+    glm::vec3 position;
+    uint32_t color;                     // RGBA8
+};
+
+// One frame of debug drawing. Lines are flushed in one draw per depth mode;
+// mesh normals and wireframes are drawn from the mesh's own buffers.
+struct DebugDrawList {
+    struct MeshDraw {
+        RenderMesh* mesh;
+        glm::mat4 model;
+        glm::vec3 color;
+        float length;                   // Normals only
+    };
+    struct Text {
+        glm::vec3 position;
+        uint32_t color;
+        size_t offset;                  // Null-terminated string in text_data
+    };
+
+    std::vector<DebugVertex> lines;             // Depth tested, pairs of vertices
+    std::vector<DebugVertex> overlay_lines;     // Drawn on top
+    std::vector<MeshDraw> normals;
+    std::vector<MeshDraw> wireframes;
+    std::vector<Text> texts;
+    std::vector<char> text_data;                // Label characters, reused from frame to frame
+
+    void clear();
+    bool empty() const { return lines.empty() && overlay_lines.empty() && normals.empty() && wireframes.empty() && texts.empty(); }
+};
+
+// Immediate-mode debug drawing: call the shape functions anywhere during the
+// frame, take() the frame's list and hand it to DebugDrawRenderer on the GL
+// thread. Recording is main thread only.
+class DebugDraw {
+public:
+    bool enabled = true;
+
+    static DebugDraw& instance();
+
+    void line(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color, bool depth_test = true);
+    void box(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color, bool depth_test = true);
+    void box(const glm::mat4& transform, const glm::vec3& color, bool depth_test = true);     // The -1..1 cube
+    void sphere(const glm::vec3& center, float radius, const glm::vec3& color, bool depth_test = true, int segments = 24);
+    void axes(const glm::mat4& transform, float size = 1.0f, bool depth_test = true);
+    void frustum(const glm::mat4& view_projection, const glm::vec3& color, bool depth_test = true);
+    void text(const glm::vec3& position, const char* text, const glm::vec3& color = glm::vec3(1.0f));
+    // Drawn from the mesh VBO on the GPU, the mesh must outlive the frame
+    void mesh_normals(RenderMesh* mesh, const glm::mat4& model, float length, const glm::vec3& color);
+    void mesh_wireframe(RenderMesh* mesh, const glm::mat4& model, const glm::vec3& color);
+
+    // Swaps the recorded frame into `list`, whose previous contents are dropped.
+    // Keeping one list per frame in flight reuses their storage.
+    void take(DebugDrawList& list);
+    // Screen-space labels, e.g. into ImGui::GetForegroundDrawList()
+    static void draw_text(const DebugDrawList& list, ImDrawList* draw_list, const glm::mat4& view_projection, const ImVec2& viewport_size);
+
+private:
+    DebugDrawList frame;
+
+    std::vector<DebugVertex>& target(bool depth_test) { return depth_test ? frame.lines : frame.overlay_lines; }
+};
+
+// GL side of DebugDraw. Create after the GL context, use on the GL thread.
+class DebugDrawRenderer {
+public:
+    DebugDrawRenderer();
+    ~DebugDrawRenderer() { release(); }
+    // Deletes the GL objects while the context is still current
+    void release();
+
+    // Once per frame, after the scene
+    void draw(const DebugDrawList& list, const glm::mat4& view, const glm::mat4& projection);
+    const StreamBuffer& stream() const { return vertices; }
+
+private:
+    Shader line_shader;
+    Shader normal_shader;               // Geometry shader, one line per mesh vertex
+    Shader wire_shader;
+    StreamBuffer vertices;
+    GLuint vao = 0;
+};
+
+inline uint32_t debug_color(const glm::vec3& color) {
+    glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return (uint32_t)c.x | ((uint32_t)c.y << 8) | ((uint32_t)c.z << 16) | 0xFF000000u;
+}
+
+void DebugDrawList::clear() {
+    lines.clear();
+    overlay_lines.clear();
+    normals.clear();
+    wireframes.clear();
+    texts.clear();
+    text_data.clear();
+}
+
+DebugDraw& DebugDraw::instance() {
+    static DebugDraw debug_draw;
+    return debug_draw;
+}
+
+void DebugDraw::line(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color, bool depth_test) {
+    if (!enabled) return;
+    uint32_t packed = debug_color(color);
+    std::vector<DebugVertex>& out = target(depth_test);
+    out.push_back({a, packed});
+    out.push_back({b, packed});
+}
+
+void DebugDraw::box(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color, bool depth_test) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 half = (max - min) * 0.5f;
+    glm::mat4 transform(1.0f);
+    transform[0][0] = half.x;
+    transform[1][1] = half.y;
+    transform[2][2] = half.z;
+    transform[3] = glm::vec4(center, 1.0f);
+    box(transform, color, depth_test);
+}
+
+void DebugDraw::box(const glm::mat4& transform, const glm::vec3& color, bool depth_test) {
+    if (!enabled) return;
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+        corners[i] = glm::vec3(transform * corner);
+    }
+    // Edges join corners that differ in one bit
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) line(corners[i], corners[i | bit], color, depth_test);
+        }
+    }
+}
+
+void DebugDraw::sphere(const glm::vec3& center, float radius, const glm::vec3& color, bool depth_test, int segments) {
+    if (!enabled) return;
+    // One circle around each axis
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec3 previous;
+        for (int i = 0; i <= segments; i++) {
+            float angle = 6.2831853f * i / segments;
+            float c = std::cos(angle) * radius, s = std::sin(angle) * radius;
+            glm::vec3 point = center + (axis == 0 ? glm::vec3(0.0f, c, s) : axis == 1 ? glm::vec3(c, 0.0f, s) : glm::vec3(c, s, 0.0f));
+            if (i > 0) line(previous, point, color, depth_test);
+            previous = point;
+        }
+    }
+}
+
+void DebugDraw::axes(const glm::mat4& transform, float size, bool depth_test) {
+    glm::vec3 origin(transform[3]);
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec3 color(0.0f);
+        color[axis] = 1.0f;
+        line(origin, origin + glm::vec3(transform[axis]) * size, color, depth_test);
+    }
+}
+
+void DebugDraw::frustum(const glm::mat4& view_projection, const glm::vec3& color, bool depth_test) {
+    if (!enabled) return;
+    // The NDC cube back through the inverse view-projection
+    glm::mat4 inverse = glm::inverse(view_projection);
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+        corners[i] = glm::vec3(corner) / corner.w;
+    }
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) line(corners[i], corners[i | bit], color, depth_test);
+        }
+    }
+}
+
+void DebugDraw::text(const glm::vec3& position, const char* text, const glm::vec3& color) {
+    if (!enabled) return;
+    frame.texts.push_back({position, debug_color(color), frame.text_data.size()});
+    frame.text_data.insert(frame.text_data.end(), text, text + std::strlen(text) + 1);
+}
+
+void DebugDraw::mesh_normals(RenderMesh* mesh, const glm::mat4& model, float length, const glm::vec3& color) {
+    if (enabled && mesh && mesh->has_vertex_normals) frame.normals.push_back({mesh, model, color, length});
+}
+
+void DebugDraw::mesh_wireframe(RenderMesh* mesh, const glm::mat4& model, const glm::vec3& color) {
+    if (enabled && mesh) frame.wireframes.push_back({mesh, model, color, 0.0f});
+}
+
+void DebugDraw::take(DebugDrawList& list) {
+    list.clear();
+    std::swap(frame, list);
+}
+
+void DebugDraw::draw_text(const DebugDrawList& list, ImDrawList* draw_list, const glm::mat4& view_projection, const ImVec2& viewport_size) {
+    for (const DebugDrawList::Text& text : list.texts) {
+        glm::vec4 clip = view_projection * glm::vec4(text.position, 1.0f);
+        if (clip.w <= 0.0f) continue;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        if (std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f) continue;
+        ImVec2 position((ndc.x * 0.5f + 0.5f) * viewport_size.x, (0.5f - ndc.y * 0.5f) * viewport_size.y);
+        draw_list->AddText(position, text.color, list.text_data.data() + text.offset);
+    }
+}
+
+DebugDrawRenderer::DebugDrawRenderer() : line_shader("debug_lines"), normal_shader("debug_normals"), wire_shader("debug") {
+    vertices.create(GL_ARRAY_BUFFER, 1 << 20);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
+
+void DebugDrawRenderer::release() {
+    vertices.destroy();
+    if (vao) glDeleteVertexArrays(1, &vao);
+    vao = 0;
+}
+
+void DebugDrawRenderer::draw(const DebugDrawList& list, const glm::mat4& view, const glm::mat4& projection) {
+    RenderStats& stats = RenderStats::instance();
+    glm::mat4 view_matrix = view, projection_matrix = projection;
+
+    // Wireframes rasterize the mesh's own triangles as lines, pulled slightly
+    // towards the camera so they win against the shaded surface
+    if (!list.wireframes.empty()) {
+        wire_shader.setMat4("view", view_matrix);
+        wire_shader.setMat4("projection", projection_matrix);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glEnable(GL_POLYGON_OFFSET_LINE);
+        glPolygonOffset(-1.0f, -1.0f);
+        for (const DebugDrawList::MeshDraw& draw : list.wireframes) {
+            glm::mat4 model = draw.model;
+            wire_shader.setMat4("model", model);
+            wire_shader.setVec3("lineColor", draw.color);
+            draw.mesh->draw();
+        }
+        glDisable(GL_POLYGON_OFFSET_LINE);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+
+    if (!list.normals.empty()) {
+        normal_shader.setMat4("view", view_matrix);
+        normal_shader.setMat4("projection", projection_matrix);
+        for (const DebugDrawList::MeshDraw& draw : list.normals) {
+            glm::mat4 model = draw.model;
+            normal_shader.setMat4("model", model);
+            normal_shader.setFloat("normalLength", draw.length);
+            normal_shader.setVec3("lineColor", draw.color);
+            glBindVertexArray(draw.mesh->gpu.VAO);
+            glDrawArrays(GL_POINTS, 0, (GLsizei)draw.mesh->positions.size());
+            stats.vao_bind();
+            stats.draw_lines(draw.mesh->positions.size());
+        }
+        glBindVertexArray(0);
+    }
+
+    size_t count = list.lines.size() + list.overlay_lines.size();
+    if (count > 0) {
+        StreamAllocation allocation = vertices.allocate(count * sizeof(DebugVertex), sizeof(DebugVertex));
+        if (allocation) {
+            DebugVertex* out = (DebugVertex*)allocation.data;
+            std::memcpy(out, list.lines.data(), list.lines.size() * sizeof(DebugVertex));
+            std::memcpy(out + list.lines.size(), list.overlay_lines.data(), list.overlay_lines.size() * sizeof(DebugVertex));
+            vertices.flush();
+
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (const void*)allocation.offset);
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (const void*)(allocation.offset + offsetof(DebugVertex, color)));
+            glm::mat4 view_projection = projection * view;
+            line_shader.setMat4("viewProjection", view_projection);
+
+            if (!list.lines.empty()) {
+                glDrawArrays(GL_LINES, 0, (GLsizei)list.lines.size());
+                stats.draw_lines(list.lines.size() / 2);
+            }
+            if (!list.overlay_lines.empty()) {
+                glDisable(GL_DEPTH_TEST);
+                glDrawArrays(GL_LINES, (GLint)list.lines.size(), (GLsizei)list.overlay_lines.size());
+                glEnable(GL_DEPTH_TEST);
+                stats.draw_lines(list.overlay_lines.size() / 2);
+            }
+            glBindVertexArray(0);
+            stats.vao_bind();
+        }
+    }
+    vertices.end_frame();
+}
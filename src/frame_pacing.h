@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+
+enum class PacingMode {
+    VSync,          // Swap interval 1, the driver blocks in SwapBuffers
+    Capped,         // Sleep, then spin to the target frame time
+    Uncapped
+};
+
+// Fixed-rate simulation clock. advance() turns elapsed real time into a number
+// of fixed steps; alpha() is how far the render time lies between the last two
+// simulated states, for interpolation.
+class FixedTimestep {
+public:
+    double step = 1.0 / 60.0;           // Seconds per update
+    int max_steps = 8;                  // Per frame, drops time after a hitch instead of spiralling
+
+    int advance(double elapsed_seconds);
+    float alpha() const { return (float)(accumulator / step); }
+
+private:
+    double accumulator = 0.0;
+};
+
+// Waits out the rest of the frame in Capped mode. Sleeping overshoots by up to
+// a scheduler tick, so the last `spin_ms` are spent polling the clock.
+class FramePacer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    PacingMode mode = PacingMode::VSync;
+    float target_fps = 120.0f;
+    float spin_ms = 2.0f;
+
+    int swap_interval() const { return mode == PacingMode::VSync ? 1 : 0; }
+    // Call right before polling input so the input is as fresh as possible
+    void wait();
+
+private:
+    clock::time_point deadline;
+    bool has_deadline = false;
+};
+
+// Input-to-present latency: time from GLFW delivering the first input event
+// a frame consumed to the end of that frame's present (SwapBuffers plus glFinish).
+// input() and take_input() run on the main thread, presented() may run on the
+// render thread, the results are guarded for the UI.
+class LatencyMeter {
+public:
+    static constexpr size_t HISTORY = 240;
+
+    bool enabled = false;
+
+    void input();                       // Any input event, keeps the first one until taken
+    int64_t take_input();               // When a frame starts, 0 if there was no input
+    void presented(int64_t input_ns);   // After the present of the frame that took it
+    float last_ms() const { std::lock_guard<std::mutex> lock(mutex); return last; }
+    float avg_ms() const { std::lock_guard<std::mutex> lock(mutex); return summary[0]; }
+    float p99_ms() const { std::lock_guard<std::mutex> lock(mutex); return summary[1]; }
+    size_t history(float* out) const;   // Up to HISTORY samples into `out`, oldest first, returns the count
+
+private:
+    int64_t first_input = 0;
+    mutable std::mutex mutex;
+    float last = 0.0f;
+    float summary[2] = {0.0f, 0.0f};
+    std::vector<float> samples;         // Ring, oldest at `head` once full
+    std::vector<float> sorted;          // Scratch for the percentiles
+    size_t head = 0;
+};
+
+int FixedTimestep::advance(double elapsed_seconds) {
+    accumulator += std::max(elapsed_seconds, 0.0);
+    int steps = (int)(accumulator / step);
+    accumulator -= steps * step;
+    if (steps > max_steps) steps = max_steps;
+    return steps;
+}
+
+void FramePacer::wait() {
+    auto now = clock::now();
+    if (mode != PacingMode::Capped || target_fps <= 0.0f) {
+        has_deadline = false;
+        return;
+    }
+
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / target_fps));
+    // Restart the schedule after a long frame rather than rushing to catch up
+    if (!has_deadline || now > deadline + period) deadline = now;
+    has_deadline = true;
+
+    auto spin = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(spin_ms));
+    if (deadline - now > spin) std::this_thread::sleep_for(deadline - now - spin);
+    while (clock::now() < deadline) std::this_thread::yield();
+    deadline += period;
+}
+
+int64_t latency_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyMeter::input() {
+    if (enabled && first_input == 0) first_input = latency_now_ns();
+}
+
+int64_t LatencyMeter::take_input() {
+    int64_t input_ns = first_input;
+    first_input = 0;
+    return input_ns;
+}
+
+void LatencyMeter::presented(int64_t input_ns) {
+    if (input_ns == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    last = (latency_now_ns() - input_ns) / 1.0e6f;
+
+    if (samples.empty()) {
+        samples.reserve(HISTORY);
+        sorted.reserve(HISTORY);
+    }
+    if (samples.size() < HISTORY) {
+        samples.push_back(last);
+    } else {
+        samples[head] = last;
+        head = (head + 1) % HISTORY;
+    }
+
+    sorted.assign(samples.begin(), samples.end());
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0.0f;
+    for (float ms : sorted) sum += ms;
+    summary[0] = sum / sorted.size();
+    summary[1] = sorted[std::min(sorted.size() - 1, (size_t)(0.99f * (sorted.size() - 1) + 0.5f))];
+}
+
+size_t LatencyMeter::history(float* out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < samples.size(); i++) out[i] = samples[(head + i) % samples.size()];
+    return samples.size();
+}
@@ -0,0 +1,1144 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+// GL command capture and replay. GLTrace::start() swaps glad's function
+// pointers for recording shims, so every call the engine makes through glad is
+// serialized with its data into a binary trace and then forwarded to the driver.
+// GLTracePlayer re-executes a trace against the current context, remapping
+// object names and uniform locations, and times frames, calls and groups.
+//
+// Trace layout: "GLTR", version, width, height (u32 each), then commands of a
+// u8 TraceOp followed by the raw arguments. Pointers to client memory become a
+// u32 size plus the bytes, pointers into bound buffers become u64 offsets.
+//
+// Calls made through other loaders (the ImGui backend) are not captured, and
+// glGet* queries are not recorded apart from glGetUniformLocation.
+
+enum class TraceObject : uint8_t { Buffer, VertexArray, Texture, Program, Shader, Framebuffer, Renderbuffer, Count };
+
+template <TraceObject K> struct TraceName {};
+struct TraceLocation {};
+
+using TraceBuffer = TraceName<TraceObject::Buffer>;
+using TraceVertexArray = TraceName<TraceObject::VertexArray>;
+using TraceTexture = TraceName<TraceObject::Texture>;
+using TraceProgram = TraceName<TraceObject::Program>;
+using TraceShader = TraceName<TraceObject::Shader>;
+using TraceFramebuffer = TraceName<TraceObject::Framebuffer>;
+using TraceRenderbuffer = TraceName<TraceObject::Renderbuffer>;
+
+// Calls whose arguments are all scalars, object names or uniform locations.
+// Shims and replay for these are generated from the argument list.
+#define GL_TRACE_SIMPLE_CALLS(X) \
+    X(Enable, GLenum) \
+    X(Disable, GLenum) \
+    X(Clear, GLbitfield) \
+    X(ClearColor, GLfloat, GLfloat, GLfloat, GLfloat) \
+    X(Viewport, GLint, GLint, GLsizei, GLsizei) \
+    X(Scissor, GLint, GLint, GLsizei, GLsizei) \
+    X(LineWidth, GLfloat) \
+    X(PolygonMode, GLenum, GLenum) \
+    X(PolygonOffset, GLfloat, GLfloat) \
+    X(CullFace, GLenum) \
+    X(FrontFace, GLenum) \
+    X(DepthFunc, GLenum) \
+    X(DepthMask, GLboolean) \
+    X(ColorMask, GLboolean, GLboolean, GLboolean, GLboolean) \
+    X(BlendFunc, GLenum, GLenum) \
+    X(BlendEquation, GLenum) \
+    X(PixelStorei, GLenum, GLint) \
+    X(PrimitiveRestartIndex, GLuint) \
+    X(ActiveTexture, GLenum) \
+    X(BindTexture, GLenum, TraceTexture) \
+    X(TexParameteri, GLenum, GLenum, GLint) \
+    X(TexParameterf, GLenum, GLenum, GLfloat) \
+    X(GenerateMipmap, GLenum) \
+    X(TexBuffer, GLenum, GLenum, TraceBuffer) \
+    X(BindBuffer, GLenum, TraceBuffer) \
+    X(BindBufferBase, GLenum, GLuint, TraceBuffer) \
+    X(CopyBufferSubData, GLenum, GLenum, GLintptr, GLintptr, GLsizeiptr) \
+    X(BindVertexArray, TraceVertexArray) \
+    X(EnableVertexAttribArray, GLuint) \
+    X(DisableVertexAttribArray, GLuint) \
+    X(VertexAttribDivisor, GLuint, GLuint) \
+    X(AttachShader, TraceProgram, TraceShader) \
+    X(CompileShader, TraceShader) \
+    X(LinkProgram, TraceProgram) \
+    X(DeleteShader, TraceShader) \
+    X(DeleteProgram, TraceProgram) \
+    X(UniformBlockBinding, TraceProgram, GLuint, GLuint) \
+    X(Uniform1i, TraceLocation, GLint) \
+    X(Uniform1f, TraceLocation, GLfloat) \
+    X(Uniform2f, TraceLocation, GLfloat, GLfloat) \
+    X(Uniform3f, TraceLocation, GLfloat, GLfloat, GLfloat) \
+    X(Uniform4f, TraceLocation, GLfloat, GLfloat, GLfloat, GLfloat) \
+    X(DrawArrays, GLenum, GLint, GLsizei) \
+    X(DrawArraysInstanced, GLenum, GLint, GLsizei, GLsizei) \
+    X(BindFramebuffer, GLenum, TraceFramebuffer) \
+    X(BindRenderbuffer, GLenum, TraceRenderbuffer) \
+    X(RenderbufferStorage, GLenum, GLenum, GLsizei, GLsizei) \
+    X(FramebufferRenderbuffer, GLenum, GLenum, GLenum, TraceRenderbuffer) \
+    X(FramebufferTexture2D, GLenum, GLenum, GLenum, TraceTexture, GLint)
+
+// Calls with pointers, results or side effects, recorded by hand
+#define GL_TRACE_CUSTOM_CALLS(X) \
+    X(GenBuffers) X(GenVertexArrays) X(GenTextures) X(GenFramebuffers) X(GenRenderbuffers) \
+    X(DeleteBuffers) X(DeleteVertexArrays) X(DeleteTextures) X(DeleteFramebuffers) X(DeleteRenderbuffers) \
+    X(CreateShader) X(CreateProgram) X(ShaderSource) X(UseProgram) X(GetUniformLocation) \
+    X(BufferData) X(BufferSubData) X(MapWrite) X(TexImage2D) X(TexSubImage2D) \
+    X(VertexAttribPointer) X(VertexAttribIPointer) \
+    X(DrawElements) X(DrawElementsInstanced) X(MultiDrawElements) X(MultiDrawArrays) \
+    X(Uniform1fv) X(Uniform3fv) X(Uniform4fv) X(UniformMatrix3fv) X(UniformMatrix4fv) \
+    X(Finish) X(Flush)
+
+enum class TraceOp : uint8_t {
+#define GL_TRACE_OP(name, ...) name,
+    GL_TRACE_SIMPLE_CALLS(GL_TRACE_OP)
+#undef GL_TRACE_OP
+#define GL_TRACE_OP(name) name,
+    GL_TRACE_CUSTOM_CALLS(GL_TRACE_OP)
+#undef GL_TRACE_OP
+    Frame,              // Start of a frame
+    GroupBegin,         // Named range, from PROFILE_GPU_SCOPE
+    GroupEnd,
+    Count
+};
+
+const char* trace_op_name(TraceOp op) {
+    static const char* names[] = {
+#define GL_TRACE_OP(name, ...) "gl" #name,
+        GL_TRACE_SIMPLE_CALLS(GL_TRACE_OP)
+#undef GL_TRACE_OP
+#define GL_TRACE_OP(name) "gl" #name,
+        GL_TRACE_CUSTOM_CALLS(GL_TRACE_OP)
+#undef GL_TRACE_OP
+        "Frame", "GroupBegin", "GroupEnd"
+    };
+    if (op == TraceOp::MapWrite) return "glMapBufferRange+glUnmapBuffer";
+    return (size_t)op < sizeof(names) / sizeof(names[0]) ? names[(size_t)op] : "?";
+}
+
+class GLTracePlayer;
+
+// Recording side. All state is static because the shims are plain function pointers.
+class GLTrace {
+public:
+    static constexpr uint32_t VERSION = 2;
+
+    // Swaps the glad pointers, call after gladLoadGLLoader() and before creating
+    // GL objects. max_frames > 0 stops recording after that many frames.
+    static bool start(const std::string& filename, int width, int height, int max_frames = 0);
+    static void stop();
+    static bool recording() { return active; }
+
+    static void frame();
+    static void group_begin(const char* name);
+    static void group_end();
+
+    // Serialization helpers used by the shims
+    template <typename T> static void put(const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    static void put_op(TraceOp op) { put((uint8_t)op); }
+    static void put_blob(const void* data, size_t size);
+    static void put_string(const char* text) { put_blob(text, std::strlen(text)); }
+    static void flush_if_full() { if (buffer.size() > FLUSH_SIZE) flush(); }
+
+private:
+    static constexpr size_t FLUSH_SIZE = 4 << 20;
+
+    static inline bool active = false;
+    static inline int frames_left = 0;
+    static inline std::ofstream file;
+    static inline std::vector<uint8_t> buffer;
+
+    static void flush();
+    static void install(bool enable);
+};
+
+// Argument traits: how each argument type is written, read back and printed
+template <typename T> struct TraceArg {
+    using type = T;
+    static void write(T value) { GLTrace::put(value); }
+    static T read(GLTracePlayer& player);
+    static void print(std::ostream& out, T value) { out << +value; }
+};
+
+template <TraceObject K> struct TraceArg<TraceName<K>> {
+    using type = GLuint;
+    static void write(GLuint value) { GLTrace::put(value); }
+    static GLuint read(GLTracePlayer& player);
+    static void print(std::ostream& out, GLuint value) { out << "#" << value; }
+};
+
+template <> struct TraceArg<TraceLocation> {
+    using type = GLint;
+    static void write(GLint value) { GLTrace::put(value); }
+    static GLint read(GLTracePlayer& player);
+    static void print(std::ostream& out, GLint value) { out << "@" << value; }
+};
+
+// Shim and replay for a GL_TRACE_SIMPLE_CALLS entry
+template <TraceOp Op, typename... Tags>
+struct TraceSimpleCall {
+    using Function = void (APIENTRYP)(typename TraceArg<Tags>::type...);
+    static inline Function real = nullptr;
+
+    static void APIENTRY shim(typename TraceArg<Tags>::type... args) {
+        GLTrace::put_op(Op);
+        (TraceArg<Tags>::write(args), ...);
+        real(args...);
+        GLTrace::flush_if_full();
+    }
+
+    // Braced initialization evaluates the reads left to right
+    static void replay(GLTracePlayer& player, Function function, std::ostream* dump) {
+        std::tuple<typename TraceArg<Tags>::type...> args{TraceArg<Tags>::read(player)...};
+        if (dump) print(*dump, args, std::index_sequence_for<Tags...>());
+        if (function) std::apply(function, args);
+    }
+
+    template <typename Tuple, size_t... I>
+    static void print(std::ostream& out, const Tuple& args, std::index_sequence<I...>) {
+        ((out << (I ? ", " : ""), TraceArg<Tags>::print(out, std::get<I>(args))), ...);
+    }
+};
+
+#define GL_TRACE_SIMPLE_TYPE(name, ...) TraceSimpleCall<TraceOp::name, __VA_ARGS__>
+
+// Originals of the hand-written shims
+struct GLTraceReal {
+    PFNGLGENBUFFERSPROC GenBuffers;
+    PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+    PFNGLGENTEXTURESPROC GenTextures;
+    PFNGLGENFRAMEBUFFERSPROC GenFramebuffers;
+    PFNGLGENRENDERBUFFERSPROC GenRenderbuffers;
+    PFNGLDELETEBUFFERSPROC DeleteBuffers;
+    PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+    PFNGLDELETETEXTURESPROC DeleteTextures;
+    PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers;
+    PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+    PFNGLCREATESHADERPROC CreateShader;
+    PFNGLCREATEPROGRAMPROC CreateProgram;
+    PFNGLSHADERSOURCEPROC ShaderSource;
+    PFNGLUSEPROGRAMPROC UseProgram;
+    PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+    PFNGLBUFFERDATAPROC BufferData;
+    PFNGLBUFFERSUBDATAPROC BufferSubData;
+    PFNGLMAPBUFFERRANGEPROC MapBufferRange;
+    PFNGLUNMAPBUFFERPROC UnmapBuffer;
+    PFNGLTEXIMAGE2DPROC TexImage2D;
+    PFNGLTEXSUBIMAGE2DPROC TexSubImage2D;
+    PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+    PFNGLVERTEXATTRIBIPOINTERPROC VertexAttribIPointer;
+    PFNGLDRAWELEMENTSPROC DrawElements;
+    PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+    PFNGLMULTIDRAWELEMENTSPROC MultiDrawElements;
+    PFNGLMULTIDRAWARRAYSPROC MultiDrawArrays;
+    PFNGLUNIFORM1FVPROC Uniform1fv;
+    PFNGLUNIFORM3FVPROC Uniform3fv;
+    PFNGLUNIFORM4FVPROC Uniform4fv;
+    PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+    PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+    PFNGLFINISHPROC Finish;
+    PFNGLFLUSHPROC Flush;
+};
+
+inline GLTraceReal gl_trace_real = {};
+
+// Write mappings, copied into the trace when the buffer is unmapped
+struct GLTraceMapping {
+    void* pointer;
+    GLintptr offset;
+    GLsizeiptr length;
+    GLbitfield access;
+};
+inline std::unordered_map<GLenum, GLTraceMapping> gl_trace_mappings;
+
+// Bytes of a glTexImage2D/glTexSubImage2D upload from client memory
+size_t trace_pixel_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+    size_t components = 4;
+    switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: components = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+        default: components = 4; break;
+    }
+    size_t pixel = components;
+    switch (type) {
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: pixel = components * 2; break;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: pixel = components * 4; break;
+        case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_2_10_10_10_REV: pixel = 4; break;
+        case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1: pixel = 2; break;
+        default: break;
+    }
+
+    GLint alignment = 4, row_length = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    size_t row = pixel * (row_length > 0 ? row_length : width);
+    row = (row + alignment - 1) / alignment * alignment;
+    return height > 0 ? row * (height - 1) + pixel * width : 0;
+}
+
+// Client pointer, or an offset when a pixel unpack buffer is bound
+void trace_pixels(const void* pixels, size_t size) {
+    GLint unpack_buffer = 0;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+    uint8_t kind = unpack_buffer ? 2 : pixels ? 1 : 0;
+    GLTrace::put(kind);
+    if (kind == 2) GLTrace::put((uint64_t)(uintptr_t)pixels);
+    if (kind == 1) GLTrace::put_blob(pixels, size);
+}
+
+template <TraceObject K, PFNGLGENBUFFERSPROC GLTraceReal::*Real>
+void APIENTRY trace_gen(GLsizei n, GLuint* names) {
+    (gl_trace_real.*Real)(n, names);
+    GLTrace::put_op(K == TraceObject::Buffer ? TraceOp::GenBuffers : K == TraceObject::VertexArray ? TraceOp::GenVertexArrays :
+                    K == TraceObject::Texture ? TraceOp::GenTextures : K == TraceObject::Framebuffer ? TraceOp::GenFramebuffers : TraceOp::GenRenderbuffers);
+    GLTrace::put(n);
+    for (GLsizei i = 0; i < n; i++) GLTrace::put(names[i]);
+}
+
+template <TraceObject K, PFNGLDELETEBUFFERSPROC GLTraceReal::*Real>
+void APIENTRY trace_delete(GLsizei n, const GLuint* names) {
+    GLTrace::put_op(K == TraceObject::Buffer ? TraceOp::DeleteBuffers : K == TraceObject::VertexArray ? TraceOp::DeleteVertexArrays :
+                    K == TraceObject::Texture ? TraceOp::DeleteTextures : K == TraceObject::Framebuffer ? TraceOp::DeleteFramebuffers : TraceOp::DeleteRenderbuffers);
+    GLTrace::put(n);
+    for (GLsizei i = 0; i < n; i++) GLTrace::put(names[i]);
+    (gl_trace_real.*Real)(n, names);
+}
+
+GLuint APIENTRY trace_CreateShader(GLenum type) {
+    GLuint shader = gl_trace_real.CreateShader(type);
+    GLTrace::put_op(TraceOp::CreateShader);
+    GLTrace::put(type);
+    GLTrace::put(shader);
+    return shader;
+}
+
+GLuint APIENTRY trace_CreateProgram() {
+    GLuint program = gl_trace_real.CreateProgram();
+    GLTrace::put_op(TraceOp::CreateProgram);
+    GLTrace::put(program);
+    return program;
+}
+
+void APIENTRY trace_ShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths) {
+    GLTrace::put_op(TraceOp::ShaderSource);
+    GLTrace::put(shader);
+    GLTrace::put(count);
+    for (GLsizei i = 0; i < count; i++) {
+        size_t length = lengths && lengths[i] >= 0 ? (size_t)lengths[i] : std::strlen(strings[i]);
+        GLTrace::put_blob(strings[i], length);
+    }
+    gl_trace_real.ShaderSource(shader, count, strings, lengths);
+}
+
+void APIENTRY trace_UseProgram(GLuint program) {
+    GLTrace::put_op(TraceOp::UseProgram);
+    GLTrace::put(program);
+    gl_trace_real.UseProgram(program);
+}
+
+GLint APIENTRY trace_GetUniformLocation(GLuint program, const GLchar* name) {
+    GLint location = gl_trace_real.GetUniformLocation(program, name);
+    GLTrace::put_op(TraceOp::GetUniformLocation);
+    GLTrace::put(program);
+    GLTrace::put_string(name);
+    GLTrace::put(location);
+    return location;
+}
+
+void APIENTRY trace_BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    GLTrace::put_op(TraceOp::BufferData);
+    GLTrace::put(target);
+    GLTrace::put((uint64_t)size);
+    GLTrace::put((uint8_t)(data != nullptr));
+    if (data) GLTrace::put_blob(data, (size_t)size);
+    GLTrace::put(usage);
+    gl_trace_real.BufferData(target, size, data, usage);
+    GLTrace::flush_if_full();
+}
+
+void APIENTRY trace_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    GLTrace::put_op(TraceOp::BufferSubData);
+    GLTrace::put(target);
+    GLTrace::put((uint64_t)offset);
+    GLTrace::put_blob(data, (size_t)size);
+    gl_trace_real.BufferSubData(target, offset, size, data);
+    GLTrace::flush_if_full();
+}
+
+void* APIENTRY trace_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    void* pointer = gl_trace_real.MapBufferRange(target, offset, length, access);
+    if (pointer && (access & GL_MAP_WRITE_BIT)) gl_trace_mappings[target] = {pointer, offset, length, access};
+    return pointer;
+}
+
+GLboolean APIENTRY trace_UnmapBuffer(GLenum target) {
+    auto mapping = gl_trace_mappings.find(target);
+    if (mapping != gl_trace_mappings.end()) {
+        GLTrace::put_op(TraceOp::MapWrite);
+        GLTrace::put(target);
+        GLTrace::put((uint64_t)mapping->second.offset);
+        GLTrace::put(mapping->second.access & ~(GLbitfield)GL_MAP_READ_BIT);
+        GLTrace::put_blob(mapping->second.pointer, (size_t)mapping->second.length);
+        gl_trace_mappings.erase(mapping);
+    }
+    GLboolean result = gl_trace_real.UnmapBuffer(target);
+    GLTrace::flush_if_full();
+    return result;
+}
+
+void APIENTRY trace_TexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border,
+                               GLenum format, GLenum type, const void* pixels) {
+    GLTrace::put_op(TraceOp::TexImage2D);
+    GLTrace::put(target);
+    GLTrace::put(level);
+    GLTrace::put(internal_format);
+    GLTrace::put(width);
+    GLTrace::put(height);
+    GLTrace::put(border);
+    GLTrace::put(format);
+    GLTrace::put(type);
+    trace_pixels(pixels, trace_pixel_bytes(width, height, format, type));
+    gl_trace_real.TexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+    GLTrace::flush_if_full();
+}
+
+void APIENTRY trace_TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+                                  GLenum format, GLenum type, const void* pixels) {
+    GLTrace::put_op(TraceOp::TexSubImage2D);
+    GLTrace::put(target);
+    GLTrace::put(level);
+    GLTrace::put(x);
+    GLTrace::put(y);
+    GLTrace::put(width);
+    GLTrace::put(height);
+    GLTrace::put(format);
+    GLTrace::put(type);
+    trace_pixels(pixels, trace_pixel_bytes(width, height, format, type));
+    gl_trace_real.TexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+    GLTrace::flush_if_full();
+}
+
+void APIENTRY trace_VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+    GLTrace::put_op(TraceOp::VertexAttribPointer);
+    GLTrace::put(index);
+    GLTrace::put(size);
+    GLTrace::put(type);
+    GLTrace::put(normalized);
+    GLTrace::put(stride);
+    GLTrace::put((uint64_t)(uintptr_t)pointer);
+    gl_trace_real.VertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void APIENTRY trace_VertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer) {
+    GLTrace::put_op(TraceOp::VertexAttribIPointer);
+    GLTrace::put(index);
+    GLTrace::put(size);
+    GLTrace::put(type);
+    GLTrace::put(stride);
+    GLTrace::put((uint64_t)(uintptr_t)pointer);
+    gl_trace_real.VertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void APIENTRY trace_DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    GLTrace::put_op(TraceOp::DrawElements);
+    GLTrace::put(mode);
+    GLTrace::put(count);
+    GLTrace::put(type);
+    GLTrace::put((uint64_t)(uintptr_t)indices);
+    gl_trace_real.DrawElements(mode, count, type, indices);
+}
+
+void APIENTRY trace_DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances) {
+    GLTrace::put_op(TraceOp::DrawElementsInstanced);
+    GLTrace::put(mode);
+    GLTrace::put(count);
+    GLTrace::put(type);
+    GLTrace::put((uint64_t)(uintptr_t)indices);
+    GLTrace::put(instances);
+    gl_trace_real.DrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+void APIENTRY trace_MultiDrawElements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei draws) {
+    GLTrace::put_op(TraceOp::MultiDrawElements);
+    GLTrace::put(mode);
+    GLTrace::put(type);
+    GLTrace::put(draws);
+    for (GLsizei i = 0; i < draws; i++) {
+        GLTrace::put(counts[i]);
+        GLTrace::put((uint64_t)(uintptr_t)indices[i]);
+    }
+    gl_trace_real.MultiDrawElements(mode, counts, type, indices, draws);
+    GLTrace::flush_if_full();
+}
+
+void APIENTRY trace_MultiDrawArrays(GLenum mode, const GLint* firsts, const GLsizei* counts, GLsizei draws) {
+    GLTrace::put_op(TraceOp::MultiDrawArrays);
+    GLTrace::put(mode);
+    GLTrace::put(draws);
+    for (GLsizei i = 0; i < draws; i++) {
+        GLTrace::put(firsts[i]);
+        GLTrace::put(counts[i]);
+    }
+    gl_trace_real.MultiDrawArrays(mode, firsts, counts, draws);
+    GLTrace::flush_if_full();
+}
+
+template <TraceOp Op, int Floats, PFNGLUNIFORM3FVPROC GLTraceReal::*Real>
+void APIENTRY trace_uniform_vector(GLint location, GLsizei count, const GLfloat* values) {
+    GLTrace::put_op(Op);
+    GLTrace::put(location);
+    GLTrace::put(count);
+    GLTrace::put_blob(values, sizeof(GLfloat) * Floats * count);
+    (gl_trace_real.*Real)(location, count, values);
+}
+
+template <TraceOp Op, int Floats, PFNGLUNIFORMMATRIX4FVPROC GLTraceReal::*Real>
+void APIENTRY trace_uniform_matrix(GLint location, GLsizei count, GLboolean transpose, const GLfloat* values) {
+    GLTrace::put_op(Op);
+    GLTrace::put(location);
+    GLTrace::put(count);
+    GLTrace::put(transpose);
+    GLTrace::put_blob(values, sizeof(GLfloat) * Floats * count);
+    (gl_trace_real.*Real)(location, count, transpose, values);
+}
+
+void APIENTRY trace_Finish() {
+    GLTrace::put_op(TraceOp::Finish);
+    gl_trace_real.Finish();
+}
+
+void APIENTRY trace_Flush() {
+    GLTrace::put_op(TraceOp::Flush);
+    gl_trace_real.Flush();
+}
+
+void GLTrace::put_blob(const void* data, size_t size) {
+    put((uint32_t)size);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void GLTrace::flush() {
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    buffer.clear();
+}
+
+void GLTrace::install(bool enable) {
+#define GL_TRACE_INSTALL(name, ...) \
+    if (enable) { GL_TRACE_SIMPLE_TYPE(name, __VA_ARGS__)::real = glad_gl##name; glad_gl##name = &GL_TRACE_SIMPLE_TYPE(name, __VA_ARGS__)::shim; } \
+    else glad_gl##name = GL_TRACE_SIMPLE_TYPE(name, __VA_ARGS__)::real;
+    GL_TRACE_SIMPLE_CALLS(GL_TRACE_INSTALL)
+#undef GL_TRACE_INSTALL
+
+    // Uniform vector/matrix shims share a signature per family
+    using Vector = PFNGLUNIFORM3FVPROC;
+    using Matrix = PFNGLUNIFORMMATRIX4FVPROC;
+    static_assert(std::is_same<Vector, PFNGLUNIFORM1FVPROC>::value && std::is_same<Matrix, PFNGLUNIFORMMATRIX3FVPROC>::value, "");
+
+#define GL_TRACE_SWAP(name, shim) \
+    if (enable) { gl_trace_real.name = glad_gl##name; glad_gl##name = shim; } \
+    else glad_gl##name = gl_trace_real.name;
+    GL_TRACE_SWAP(GenBuffers, (trace_gen<TraceObject::Buffer, &GLTraceReal::GenBuffers>))
+    GL_TRACE_SWAP(GenVertexArrays, (trace_gen<TraceObject::VertexArray, &GLTraceReal::GenVertexArrays>))
+    GL_TRACE_SWAP(GenTextures, (trace_gen<TraceObject::Texture, &GLTraceReal::GenTextures>))
+    GL_TRACE_SWAP(GenFramebuffers, (trace_gen<TraceObject::Framebuffer, &GLTraceReal::GenFramebuffers>))
+    GL_TRACE_SWAP(GenRenderbuffers, (trace_gen<TraceObject::Renderbuffer, &GLTraceReal::GenRenderbuffers>))
+    GL_TRACE_SWAP(DeleteBuffers, (trace_delete<TraceObject::Buffer, &GLTraceReal::DeleteBuffers>))
+    GL_TRACE_SWAP(DeleteVertexArrays, (trace_delete<TraceObject::VertexArray, &GLTraceReal::DeleteVertexArrays>))
+    GL_TRACE_SWAP(DeleteTextures, (trace_delete<TraceObject::Texture, &GLTraceReal::DeleteTextures>))
+    GL_TRACE_SWAP(DeleteFramebuffers, (trace_delete<TraceObject::Framebuffer, &GLTraceReal::DeleteFramebuffers>))
+    GL_TRACE_SWAP(DeleteRenderbuffers, (trace_delete<TraceObject::Renderbuffer, &GLTraceReal::DeleteRenderbuffers>))
+    GL_TRACE_SWAP(CreateShader, trace_CreateShader)
+    GL_TRACE_SWAP(CreateProgram, trace_CreateProgram)
+    GL_TRACE_SWAP(ShaderSource, trace_ShaderSource)
+    GL_TRACE_SWAP(UseProgram, trace_UseProgram)
+    GL_TRACE_SWAP(GetUniformLocation, trace_GetUniformLocation)
+    GL_TRACE_SWAP(BufferData, trace_BufferData)
+    GL_TRACE_SWAP(BufferSubData, trace_BufferSubData)
+    GL_TRACE_SWAP(MapBufferRange, trace_MapBufferRange)
+    GL_TRACE_SWAP(UnmapBuffer, trace_UnmapBuffer)
+    GL_TRACE_SWAP(TexImage2D, trace_TexImage2D)
+    GL_TRACE_SWAP(TexSubImage2D, trace_TexSubImage2D)
+    GL_TRACE_SWAP(VertexAttribPointer, trace_VertexAttribPointer)
+    GL_TRACE_SWAP(VertexAttribIPointer, trace_VertexAttribIPointer)
+    GL_TRACE_SWAP(DrawElements, trace_DrawElements)
+    GL_TRACE_SWAP(DrawElementsInstanced, trace_DrawElementsInstanced)
+    GL_TRACE_SWAP(MultiDrawElements, trace_MultiDrawElements)
+    GL_TRACE_SWAP(MultiDrawArrays, trace_MultiDrawArrays)
+    GL_TRACE_SWAP(Uniform1fv, (trace_uniform_vector<TraceOp::Uniform1fv, 1, &GLTraceReal::Uniform1fv>))
+    GL_TRACE_SWAP(Uniform3fv, (trace_uniform_vector<TraceOp::Uniform3fv, 3, &GLTraceReal::Uniform3fv>))
+    GL_TRACE_SWAP(Uniform4fv, (trace_uniform_vector<TraceOp::Uniform4fv, 4, &GLTraceReal::Uniform4fv>))
+    GL_TRACE_SWAP(UniformMatrix3fv, (trace_uniform_matrix<TraceOp::UniformMatrix3fv, 9, &GLTraceReal::UniformMatrix3fv>))
+    GL_TRACE_SWAP(UniformMatrix4fv, (trace_uniform_matrix<TraceOp::UniformMatrix4fv, 16, &GLTraceReal::UniformMatrix4fv>))
+    GL_TRACE_SWAP(Finish, trace_Finish)
+    GL_TRACE_SWAP(Flush, trace_Flush)
+#undef GL_TRACE_SWAP
+}
+
+bool GLTrace::start(const std::string& filename, int width, int height, int max_frames) {
+    if (active) return false;
+    file.open(filename, std::ios::binary);
+    if (!file) return false;
+
+    buffer.clear();
+    buffer.insert(buffer.end(), {'G', 'L', 'T', 'R'});
+    put(VERSION);
+    put((uint32_t)width);
+    put((uint32_t)height);
+
+    frames_left = max_frames > 0 ? max_frames + 1 : 0;     // The marker after the last frame stops it
+    install(true);
+    gpu_scope_hook = [](const char* name) { name ? group_begin(name) : group_end(); };
+    active = true;
+    return true;
+}
+
+void GLTrace::stop() {
+    if (!active) return;
+    install(false);
+    gpu_scope_hook = nullptr;
+    active = false;
+    flush();
+    file.close();
+    gl_trace_mappings.clear();
+}
+
+void GLTrace::frame() {
+    if (!active) return;
+    if (frames_left > 0 && --frames_left == 0) {
+        stop();
+        return;
+    }
+    put_op(TraceOp::Frame);
+    flush_if_full();
+}
+
+void GLTrace::group_begin(const char* name) {
+    if (!active) return;
+    put_op(TraceOp::GroupBegin);
+    put_string(name);
+}
+
+void GLTrace::group_end() {
+    if (!active) return;
+    put_op(TraceOp::GroupEnd);
+}
+
+// Replays a trace against the current context, or prints it one command per
+// line. Object names and uniform locations recorded in the trace are mapped to
+// the ones this context hands out; framebuffer 0 maps to `default_framebuffer`.
+class GLTracePlayer {
+public:
+    struct CallStats {
+        uint64_t count = 0;
+        double ms = 0.0;            // CPU time spent in the call
+    };
+
+    struct FrameStats {
+        uint32_t commands = 0;
+        uint32_t draws = 0;
+        double cpu_ms = 0.0;        // Sum of the call times
+        double ms = 0.0;            // Wall time including glFinish at the frame end
+    };
+
+    uint32_t width = 0, height = 0;
+    CallStats calls[(size_t)TraceOp::Count];
+    std::map<std::string, CallStats> groups;    // Nested names joined by '/'
+    std::vector<FrameStats> frames;             // Commands before the first frame marker are setup
+    double setup_ms = 0.0;
+
+    bool load(const std::string& filename);
+    // sync finishes the GPU around every group so group times include GPU work
+    bool replay(GLuint default_framebuffer, bool sync = false);
+    bool dump(std::ostream& out);
+
+    // Used by TraceArg
+    template <typename T> T get() {
+        T value;
+        if (cursor + sizeof(T) > data.size()) {
+            failed = true;
+            std::memset(&value, 0, sizeof(T));
+            return value;
+        }
+        std::memcpy(&value, data.data() + cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+    GLuint map(TraceObject kind, GLuint name) const;
+    GLint location(GLint recorded) const;
+
+private:
+    std::vector<uint8_t> data;
+    size_t cursor = 0;
+    bool failed = false;
+    bool executing = false;
+    GLuint default_framebuffer = 0;
+    std::unordered_map<GLuint, GLuint> names[(size_t)TraceObject::Count];
+    std::map<std::pair<GLuint, GLint>, GLint> locations;    // (recorded program, recorded location)
+    GLuint current_program = 0;                             // Recorded name
+    std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> group_stack;
+
+    const uint8_t* get_blob(uint32_t& size);
+    bool run(bool execute, std::ostream* out, bool sync);
+    void command(TraceOp op, bool execute, std::ostream* out, bool sync);
+};
+
+template <typename T> T TraceArg<T>::read(GLTracePlayer& player) { return player.get<T>(); }
+template <TraceObject K> GLuint TraceArg<TraceName<K>>::read(GLTracePlayer& player) { return player.map(K, player.get<GLuint>()); }
+GLint TraceArg<TraceLocation>::read(GLTracePlayer& player) { return player.location(player.get<GLint>()); }
+
+bool GLTracePlayer::load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (data.size() < 16 || std::memcmp(data.data(), "GLTR", 4) != 0) return false;
+
+    cursor = 4;
+    uint32_t version = get<uint32_t>();
+    width = get<uint32_t>();
+    height = get<uint32_t>();
+    return version == GLTrace::VERSION;
+}
+
+GLuint GLTracePlayer::map(TraceObject kind, GLuint name) const {
+    if (!executing) return name;        // Dumps show the recorded names
+    if (name == 0) return kind == TraceObject::Framebuffer ? default_framebuffer : 0;
+    auto found = names[(size_t)kind].find(name);
+    return found != names[(size_t)kind].end() ? found->second : 0;
+}
+
+GLint GLTracePlayer::location(GLint recorded) const {
+    if (!executing || recorded < 0) return recorded;
+    auto found = locations.find({current_program, recorded});
+    return found != locations.end() ? found->second : -1;
+}
+
+const uint8_t* GLTracePlayer::get_blob(uint32_t& size) {
+    size = get<uint32_t>();
+    if (failed || cursor + size > data.size()) {
+        failed = true;
+        size = 0;
+        return nullptr;
+    }
+    const uint8_t* blob = data.data() + cursor;
+    cursor += size;
+    return blob;
+}
+
+bool GLTracePlayer::replay(GLuint framebuffer, bool sync) {
+    default_framebuffer = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    return run(true, nullptr, sync);
+}
+
+bool GLTracePlayer::dump(std::ostream& out) {
+    return run(false, &out, false);
+}
+
+bool GLTracePlayer::run(bool execute, std::ostream* out, bool sync) {
+    using clock = std::chrono::steady_clock;
+    cursor = 16;
+    failed = false;
+    executing = execute;
+    frames.clear();
+    groups.clear();
+    for (auto& call : calls) call = CallStats();
+    for (auto& table : names) table.clear();
+    locations.clear();
+    group_stack.clear();
+
+    FrameStats frame;
+    bool in_frame = false;
+    auto frame_start = clock::now();
+    auto trace_start = frame_start;
+
+    while (cursor < data.size() && !failed) {
+        TraceOp op = (TraceOp)get<uint8_t>();
+        if (op >= TraceOp::Count) {
+            failed = true;
+            break;
+        }
+
+        if (op == TraceOp::Frame) {
+            if (execute) glFinish();
+            auto now = clock::now();
+            if (in_frame) {
+                frame.ms = std::chrono::duration<double, std::milli>(now - frame_start).count();
+                frames.push_back(frame);
+            } else {
+                setup_ms = std::chrono::duration<double, std::milli>(now - trace_start).count();
+            }
+            if (out) *out << "# frame " << frames.size() << "\n";
+            frame = FrameStats();
+            in_frame = true;
+            frame_start = clock::now();
+            continue;
+        }
+
+        if (out) *out << trace_op_name(op) << "(";
+        auto start = clock::now();
+        command(op, execute, out, sync);
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        if (out) *out << ")\n";
+        if (op == TraceOp::GroupBegin || op == TraceOp::GroupEnd) continue;
+
+        calls[(size_t)op].count++;
+        calls[(size_t)op].ms += ms;
+        frame.commands++;
+        frame.cpu_ms += ms;
+        if (op == TraceOp::DrawArrays || op == TraceOp::DrawArraysInstanced || op == TraceOp::DrawElements ||
+            op == TraceOp::DrawElementsInstanced || op == TraceOp::MultiDrawElements || op == TraceOp::MultiDrawArrays) {
+            frame.draws++;
+        }
+    }
+
+    // The trace ends mid-frame when recording stops
+    if (in_frame && frame.commands > 0) {
+        if (execute) glFinish();
+        frame.ms = std::chrono::duration<double, std::milli>(clock::now() - frame_start).count();
+        frames.push_back(frame);
+    }
+    if (failed) std::cerr << "Trace is truncated or corrupt at byte " << cursor << std::endl;
+    return !failed;
+}
+
+void GLTracePlayer::command(TraceOp op, bool execute, std::ostream* out, bool sync) {
+    // Client data pointers and names that only exist while executing
+    auto blob_text = [&](uint32_t size, const uint8_t* blob) {
+        if (!out) return;
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; i < size; i++) hash = (hash ^ blob[i]) * 16777619u;
+        *out << "<" << size << " bytes " << std::hex << std::setw(8) << std::setfill('0') << hash << std::dec << std::setfill(' ') << ">";
+    };
+    auto sep = [&] { if (out) *out << ", "; };
+
+    switch (op) {
+#define GL_TRACE_REPLAY(name, ...) \
+        case TraceOp::name: GL_TRACE_SIMPLE_TYPE(name, __VA_ARGS__)::replay(*this, execute ? glad_gl##name : nullptr, out); break;
+        GL_TRACE_SIMPLE_CALLS(GL_TRACE_REPLAY)
+#undef GL_TRACE_REPLAY
+
+        case TraceOp::GenBuffers: case TraceOp::GenVertexArrays: case TraceOp::GenTextures:
+        case TraceOp::GenFramebuffers: case TraceOp::GenRenderbuffers: {
+            TraceObject kind = op == TraceOp::GenBuffers ? TraceObject::Buffer : op == TraceOp::GenVertexArrays ? TraceObject::VertexArray :
+                               op == TraceOp::GenTextures ? TraceObject::Texture : op == TraceOp::GenFramebuffers ? TraceObject::Framebuffer : TraceObject::Renderbuffer;
+            GLsizei n = get<GLsizei>();
+            for (GLsizei i = 0; i < n && !failed; i++) {
+                GLuint recorded = get<GLuint>(), name = 0;
+                if (execute) {
+                    switch (kind) {
+                        case TraceObject::Buffer: glGenBuffers(1, &name); break;
+                        case TraceObject::VertexArray: glGenVertexArrays(1, &name); break;
+                        case TraceObject::Texture: glGenTextures(1, &name); break;
+                        case TraceObject::Framebuffer: glGenFramebuffers(1, &name); break;
+                        default: glGenRenderbuffers(1, &name); break;
+                    }
+                }
+                names[(size_t)kind][recorded] = name;
+                if (out) *out << (i ? ", #" : "#") << recorded;
+            }
+            break;
+        }
+        case TraceOp::DeleteBuffers: case TraceOp::DeleteVertexArrays: case TraceOp::DeleteTextures:
+        case TraceOp::DeleteFramebuffers: case TraceOp::DeleteRenderbuffers: {
+            TraceObject kind = op == TraceOp::DeleteBuffers ? TraceObject::Buffer : op == TraceOp::DeleteVertexArrays ? TraceObject::VertexArray :
+                               op == TraceOp::DeleteTextures ? TraceObject::Texture : op == TraceOp::DeleteFramebuffers ? TraceObject::Framebuffer : TraceObject::Renderbuffer;
+            GLsizei n = get<GLsizei>();
+            for (GLsizei i = 0; i < n && !failed; i++) {
+                GLuint recorded = get<GLuint>();
+                GLuint name = map(kind, recorded);
+                if (execute && name) {
+                    switch (kind) {
+                        case TraceObject::Buffer: glDeleteBuffers(1, &name); break;
+                        case TraceObject::VertexArray: glDeleteVertexArrays(1, &name); break;
+                        case TraceObject::Texture: glDeleteTextures(1, &name); break;
+                        case TraceObject::Framebuffer: glDeleteFramebuffers(1, &name); break;
+                        default: glDeleteRenderbuffers(1, &name); break;
+                    }
+                }
+                names[(size_t)kind].erase(recorded);
+                if (out) *out << (i ? ", #" : "#") << recorded;
+            }
+            break;
+        }
+        case TraceOp::CreateShader: {
+            GLenum type = get<GLenum>();
+            GLuint recorded = get<GLuint>();
+            names[(size_t)TraceObject::Shader][recorded] = execute ? glCreateShader(type) : 0;
+            if (out) *out << type << " -> #" << recorded;
+            break;
+        }
+        case TraceOp::CreateProgram: {
+            GLuint recorded = get<GLuint>();
+            names[(size_t)TraceObject::Program][recorded] = execute ? glCreateProgram() : 0;
+            if (out) *out << "-> #" << recorded;
+            break;
+        }
+        case TraceOp::ShaderSource: {
+            GLuint shader = get<GLuint>();
+            GLsizei count = get<GLsizei>();
+            std::vector<const GLchar*> strings;
+            std::vector<GLint> lengths;
+            if (out) *out << "#" << shader;
+            for (GLsizei i = 0; i < count && !failed; i++) {
+                uint32_t size;
+                const uint8_t* text = get_blob(size);
+                strings.push_back(reinterpret_cast<const GLchar*>(text));
+                lengths.push_back((GLint)size);
+                sep();
+                blob_text(size, text);
+            }
+            if (execute && !failed) glShaderSource(map(TraceObject::Shader, shader), count, strings.data(), lengths.data());
+            break;
+        }
+        case TraceOp::UseProgram: {
+            current_program = get<GLuint>();
+            if (execute) glUseProgram(map(TraceObject::Program, current_program));
+            if (out) *out << "#" << current_program;
+            break;
+        }
+        case TraceOp::GetUniformLocation: {
+            GLuint program = get<GLuint>();
+            uint32_t size;
+            const uint8_t* text = get_blob(size);
+            GLint recorded = get<GLint>();
+            std::string name(reinterpret_cast<const char*>(text), size);
+            if (execute && recorded >= 0) locations[{program, recorded}] = glGetUniformLocation(map(TraceObject::Program, program), name.c_str());
+            if (out) *out << "#" << program << ", \"" << name << "\" -> @" << recorded;
+            break;
+        }
+        case TraceOp::BufferData: {
+            GLenum target = get<GLenum>();
+            uint64_t size = get<uint64_t>();
+            uint8_t has_data = get<uint8_t>();
+            uint32_t blob_size = 0;
+            const uint8_t* blob = has_data ? get_blob(blob_size) : nullptr;
+            GLenum usage = get<GLenum>();
+            if (execute && !failed) glBufferData(target, (GLsizeiptr)size, blob, usage);
+            if (out) {
+                *out << target << ", " << size << ", ";
+                if (blob) blob_text(blob_size, blob);
+                else *out << "null";
+                *out << ", " << usage;
+            }
+            break;
+        }
+        case TraceOp::BufferSubData: {
+            GLenum target = get<GLenum>();
+            uint64_t offset = get<uint64_t>();
+            uint32_t size;
+            const uint8_t* blob = get_blob(size);
+            if (execute && !failed) glBufferSubData(target, (GLintptr)offset, size, blob);
+            if (out) {
+                *out << target << ", " << offset << ", ";
+                blob_text(size, blob);
+            }
+            break;
+        }
+        case TraceOp::MapWrite: {
+            GLenum target = get<GLenum>();
+            uint64_t offset = get<uint64_t>();
+            GLbitfield access = get<GLbitfield>();
+            uint32_t size;
+            const uint8_t* blob = get_blob(size);
+            if (execute && !failed && size > 0) {
+                void* pointer = glMapBufferRange(target, (GLintptr)offset, size, access);
+                if (pointer) {
+                    std::memcpy(pointer, blob, size);
+                    glUnmapBuffer(target);
+                }
+            }
+            if (out) {
+                *out << target << ", " << offset << ", " << access << ", ";
+                blob_text(size, blob);
+            }
+            break;
+        }
+        case TraceOp::TexImage2D: case TraceOp::TexSubImage2D: {
+            bool sub = op == TraceOp::TexSubImage2D;
+            GLenum target = get<GLenum>();
+            GLint level = get<GLint>();
+            GLint internal_format = sub ? 0 : get<GLint>();
+            GLint x = sub ? get<GLint>() : 0;
+            GLint y = sub ? get<GLint>() : 0;
+            GLsizei width = get<GLsizei>();
+            GLsizei height = get<GLsizei>();
+            GLint border = sub ? 0 : get<GLint>();
+            GLenum format = get<GLenum>();
+            GLenum type = get<GLenum>();
+            uint8_t kind = get<uint8_t>();
+            uint32_t size = 0;
+            const void* pixels = nullptr;
+            if (kind == 2) pixels = reinterpret_cast<const void*>((uintptr_t)get<uint64_t>());
+            if (kind == 1) pixels = get_blob(size);
+            if (execute && !failed) {
+                if (sub) glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+                else glTexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+            }
+            if (out) {
+                *out << target << ", " << level << ", ";
+                if (sub) *out << x << ", " << y << ", ";
+                else *out << internal_format << ", ";
+                *out << width << "x" << height << ", " << format << ", " << type << ", ";
+                if (kind == 1) blob_text(size, static_cast<const uint8_t*>(pixels));
+                else if (kind == 2) *out << "offset " << (uintptr_t)pixels;
+                else *out << "null";
+            }
+            break;
+        }
+        case TraceOp::VertexAttribPointer: {
+            GLuint index = get<GLuint>();
+            GLint size = get<GLint>();
+            GLenum type = get<GLenum>();
+            GLboolean normalized = get<GLboolean>();
+            GLsizei stride = get<GLsizei>();
+            uint64_t offset = get<uint64_t>();
+            if (execute) glVertexAttribPointer(index, size, type, normalized, stride, reinterpret_cast<const void*>((uintptr_t)offset));
+            if (out) *out << index << ", " << size << ", " << type << ", " << +normalized << ", " << stride << ", " << offset;
+            break;
+        }
+        case TraceOp::VertexAttribIPointer: {
+            GLuint index = get<GLuint>();
+            GLint size = get<GLint>();
+            GLenum type = get<GLenum>();
+            GLsizei stride = get<GLsizei>();
+            uint64_t offset = get<uint64_t>();
+            if (execute) glVertexAttribIPointer(index, size, type, stride, reinterpret_cast<const void*>((uintptr_t)offset));
+            if (out) *out << index << ", " << size << ", " << type << ", " << stride << ", " << offset;
+            break;
+        }
+        case TraceOp::DrawElements: case TraceOp::DrawElementsInstanced: {
+            GLenum mode = get<GLenum>();
+            GLsizei count = get<GLsizei>();
+            GLenum type = get<GLenum>();
+            uint64_t offset = get<uint64_t>();
+            GLsizei instances = op == TraceOp::DrawElementsInstanced ? get<GLsizei>() : 1;
+            const void* indices = reinterpret_cast<const void*>((uintptr_t)offset);
+            if (execute) {
+                if (op == TraceOp::DrawElements) glDrawElements(mode, count, type, indices);
+                else glDrawElementsInstanced(mode, count, type, indices, instances);
+            }
+            if (out) *out << mode << ", " << count << ", " << type << ", " << offset << (op == TraceOp::DrawElements ? "" : ", ") ;
+            if (out && op != TraceOp::DrawElements) *out << instances;
+            break;
+        }
+        case TraceOp::MultiDrawElements: {
+            GLenum mode = get<GLenum>();
+            GLenum type = get<GLenum>();
+            GLsizei draws = get<GLsizei>();
+            std::vector<GLsizei> counts(std::max(draws, 0));
+            std::vector<const void*> offsets(std::max(draws, 0));
+            uint64_t total = 0;
+            for (GLsizei i = 0; i < draws && !failed; i++) {
+                counts[i] = get<GLsizei>();
+                offsets[i] = reinterpret_cast<const void*>((uintptr_t)get<uint64_t>());
+                total += counts[i];
+            }
+            if (execute && !failed) glMultiDrawElements(mode, counts.data(), type, offsets.data(), draws);
+            if (out) *out << mode << ", " << type << ", " << draws << " ranges, " << total << " indices";
+            break;
+        }
+        case TraceOp::MultiDrawArrays: {
+            GLenum mode = get<GLenum>();
+            GLsizei draws = get<GLsizei>();
+            std::vector<GLint> firsts(std::max(draws, 0));
+            std::vector<GLsizei> counts(std::max(draws, 0));
+            uint64_t total = 0;
+            for (GLsizei i = 0; i < draws && !failed; i++) {
+                firsts[i] = get<GLint>();
+                counts[i] = get<GLsizei>();
+                total += counts[i];
+            }
+            if (execute && !failed) glMultiDrawArrays(mode, firsts.data(), counts.data(), draws);
+            if (out) *out << mode << ", " << draws << " ranges, " << total << " vertices";
+            break;
+        }
+        case TraceOp::Uniform1fv: case TraceOp::Uniform3fv: case TraceOp::Uniform4fv: {
+            GLint location = this->location(get<GLint>());
+            GLsizei count = get<GLsizei>();
+            uint32_t size;
+            const uint8_t* blob = get_blob(size);
+            const GLfloat* values = reinterpret_cast<const GLfloat*>(blob);
+            if (execute && !failed) {
+                if (op == TraceOp::Uniform1fv) glUniform1fv(location, count, values);
+                else if (op == TraceOp::Uniform3fv) glUniform3fv(location, count, values);
+                else glUniform4fv(location, count, values);
+            }
+            if (out) {
+                *out << "@" << location << ", " << count << ", ";
+                blob_text(size, blob);
+            }
+            break;
+        }
+        case TraceOp::UniformMatrix3fv: case TraceOp::UniformMatrix4fv: {
+            GLint location = this->location(get<GLint>());
+            GLsizei count = get<GLsizei>();
+            GLboolean transpose = get<GLboolean>();
+            uint32_t size;
+            const uint8_t* blob = get_blob(size);
+            const GLfloat* values = reinterpret_cast<const GLfloat*>(blob);
+            if (execute && !failed) {
+                if (op == TraceOp::UniformMatrix3fv) glUniformMatrix3fv(location, count, transpose, values);
+                else glUniformMatrix4fv(location, count, transpose, values);
+            }
+            if (out) {
+                *out << "@" << location << ", " << count << ", " << +transpose << ", ";
+                blob_text(size, blob);
+            }
+            break;
+        }
+        case TraceOp::Finish:
+            if (execute) glFinish();
+            break;
+        case TraceOp::Flush:
+            if (execute) glFlush();
+            break;
+        case TraceOp::GroupBegin: {
+            uint32_t size;
+            const uint8_t* text = get_blob(size);
+            std::string name(reinterpret_cast<const char*>(text), size);
+            if (execute && sync) glFinish();
+            std::string path = group_stack.empty() ? name : group_stack.back().first + "/" + name;
+            group_stack.push_back({path, std::chrono::steady_clock::now()});
+            if (out) *out << "\"" << name << "\"";
+            break;
+        }
+        case TraceOp::GroupEnd: {
+            if (execute && sync) glFinish();
+            if (group_stack.empty()) break;
+            CallStats& group = groups[group_stack.back().first];
+            group.count++;
+            group.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - group_stack.back().second).count();
+            group_stack.pop_back();
+            break;
+        }
+        default:
+            failed = true;
+            break;
+    }
+}
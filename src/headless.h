@@ -0,0 +1,399 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifdef HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// Offscreen GL 3.3 core context without a window or display. Uses EGL with the
+// surfaceless platform (Mesa llvmpipe works), falling back to the default
+// display and a 1x1 pbuffer.
+struct HeadlessContext {
+#ifdef HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+#endif
+
+    bool create();
+    void destroy();
+    // Hand the context to another thread: release() here, make_current() there
+    bool make_current();
+    void release();
+    static GLADloadproc loader();
+};
+
+// Framebuffer object with an RGBA8 color and depth renderbuffer
+struct RenderTarget {
+    unsigned int FBO = 0, color = 0, depth = 0;
+    int width = 0, height = 0;
+
+    bool create(int width, int height);
+    void bind() const;
+    void read_pixels(std::vector<unsigned char>& rgba) const;     // Top row first
+    void destroy();
+};
+
+// Camera keyframes sampled by time, linear interpolation between keys
+struct CameraPath {
+    struct Key {
+        float time;
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    std::vector<Key> keys;
+
+    static CameraPath orbit(const glm::vec3& center, float radius, float height, float duration, int steps = 32);
+    bool load(const std::string& filename);     // Lines of "time px py pz tx ty tz", '#' comments
+    void sample(float time, glm::vec3& position, glm::vec3& target) const;
+    glm::mat4 view(float time) const;
+};
+
+// Per-frame timings of a headless run, written as CSV plus a JSON summary
+struct FrameTimings {
+    std::vector<double> cpu_ms;     // Frame start until all commands are submitted
+    std::vector<double> frame_ms;   // Frame start until the GPU has finished (glFinish)
+    std::vector<double> gpu_ms;     // GL_TIME_ELAPSED around the scene pass
+
+    void add(double cpu, double frame, double gpu);
+    bool write(const std::string& directory) const;
+};
+
+bool write_png(const std::string& filename, int width, int height, const std::vector<unsigned char>& rgba);
+double percentile(std::vector<double> values, double p);
+
+bool HeadlessContext::create() {
+#ifdef HAS_EGL
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    bool surfaceless = display != EGL_NO_DISPLAY;
+    if (!surfaceless) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    EGLConfig config = nullptr;
+    if (!surfaceless) {
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_NONE
+        };
+        EGLint count = 0;
+        if (!eglChooseConfig(display, config_attribs, &config, 1, &count) || count == 0) {
+            std::cerr << "No EGL pbuffer config" << std::endl;
+            return false;
+        }
+        const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, surfaceless ? EGL_NO_CONFIG_KHR : config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "Failed to create EGL OpenGL 3.3 core context" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "Headless mode needs EGL, which this build does not have" << std::endl;
+    return false;
+#endif
+}
+
+void HeadlessContext::destroy() {
+#ifdef HAS_EGL
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+    surface = EGL_NO_SURFACE;
+#endif
+}
+
+bool HeadlessContext::make_current() {
+#ifdef HAS_EGL
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+#else
+    return false;
+#endif
+}
+
+void HeadlessContext::release() {
+#ifdef HAS_EGL
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+}
+
+GLADloadproc HeadlessContext::loader() {
+#ifdef HAS_EGL
+    return (GLADloadproc)eglGetProcAddress;
+#else
+    return nullptr;
+#endif
+}
+
+bool RenderTarget::create(int w, int h) {
+    width = w;
+    height = h;
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    glViewport(0, 0, width, height);
+    return complete;
+}
+
+void RenderTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+void RenderTarget::read_pixels(std::vector<unsigned char>& rgba) const {
+    size_t row_bytes = (size_t)width * 4;
+    rgba.resize(row_bytes * height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // GL rows start at the bottom, images at the top
+    std::vector<unsigned char> row(row_bytes);
+    for (int y = 0; y < height / 2; y++) {
+        unsigned char* a = rgba.data() + y * row_bytes;
+        unsigned char* b = rgba.data() + (height - 1 - y) * row_bytes;
+        std::memcpy(row.data(), a, row_bytes);
+        std::memcpy(a, b, row_bytes);
+        std::memcpy(b, row.data(), row_bytes);
+    }
+}
+
+void RenderTarget::destroy() {
+    if (FBO) glDeleteFramebuffers(1, &FBO);
+    if (color) glDeleteRenderbuffers(1, &color);
+    if (depth) glDeleteRenderbuffers(1, &depth);
+    FBO = color = depth = 0;
+}
+
+CameraPath CameraPath::orbit(const glm::vec3& center, float radius, float height, float duration, int steps) {
+    CameraPath path;
+    for (int i = 0; i <= steps; i++) {
+        float angle = glm::two_pi<float>() * i / steps;
+        glm::vec3 position = center + glm::vec3(radius * glm::sin(angle), height, radius * glm::cos(angle));
+        path.keys.push_back({duration * i / steps, position, center});
+    }
+    return path;
+}
+
+bool CameraPath::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) return false;
+
+    keys.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        Key key;
+        if (iss >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z) {
+            keys.push_back(key);
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.time < b.time; });
+    return !keys.empty();
+}
+
+void CameraPath::sample(float time, glm::vec3& position, glm::vec3& target) const {
+    if (keys.empty()) {
+        position = glm::vec3(0.0f, 0.0f, 3.0f);
+        target = glm::vec3(0.0f);
+        return;
+    }
+
+    // Clamp outside the keyed range
+    if (time <= keys.front().time) {
+        position = keys.front().position;
+        target = keys.front().target;
+        return;
+    }
+    if (time >= keys.back().time) {
+        position = keys.back().position;
+        target = keys.back().target;
+        return;
+    }
+
+    size_t i = 1;
+    while (keys[i].time < time) i++;
+    const Key& a = keys[i - 1];
+    const Key& b = keys[i];
+    float t = (time - a.time) / std::max(b.time - a.time, 1e-6f);
+    position = glm::mix(a.position, b.position, t);
+    target = glm::mix(a.target, b.target, t);
+}
+
+glm::mat4 CameraPath::view(float time) const {
+    glm::vec3 position, target;
+    sample(time, position, target);
+    return glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void FrameTimings::add(double cpu, double frame, double gpu) {
+    cpu_ms.push_back(cpu);
+    frame_ms.push_back(frame);
+    gpu_ms.push_back(gpu);
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)std::min<double>((double)values.size() - 1, p / 100.0 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+bool FrameTimings::write(const std::string& directory) const {
+    std::ofstream csv(directory + "/frames.csv");
+    if (!csv) return false;
+    csv << "frame,cpu_ms,frame_ms,gpu_ms\n";
+    for (size_t i = 0; i < cpu_ms.size(); i++) {
+        csv << i << "," << cpu_ms[i] << "," << frame_ms[i] << "," << gpu_ms[i] << "\n";
+    }
+
+    std::ofstream json(directory + "/summary.json");
+    if (!json) return false;
+    auto stats = [&](const char* name, const std::vector<double>& values, bool last) {
+        double sum = 0.0;
+        for (double v : values) sum += v;
+        json << "  \"" << name << "\": {"
+             << "\"min\": " << percentile(values, 0.0)
+             << ", \"avg\": " << (values.empty() ? 0.0 : sum / values.size())
+             << ", \"p50\": " << percentile(values, 50.0)
+             << ", \"p95\": " << percentile(values, 95.0)
+             << ", \"p99\": " << percentile(values, 99.0)
+             << ", \"max\": " << percentile(values, 100.0) << "}" << (last ? "\n" : ",\n");
+    };
+    json << std::fixed << std::setprecision(4) << "{\n";
+    json << "  \"frames\": " << cpu_ms.size() << ",\n";
+    stats("cpu_ms", cpu_ms, false);
+    stats("frame_ms", frame_ms, false);
+    stats("gpu_ms", gpu_ms, true);
+    json << "}\n";
+    return true;
+}
+
+// PNG with uncompressed (stored) deflate blocks. Larger than a real encoder's
+// output but needs no zlib, and the pixels are exact for image diffs.
+bool write_png(const std::string& filename, int width, int height, const std::vector<unsigned char>& rgba) {
+    static uint32_t crc_table[256];
+    static bool crc_ready = false;
+    if (!crc_ready) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc_table[n] = c;
+        }
+        crc_ready = true;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) return false;
+
+    auto put32 = [](std::vector<unsigned char>& out, uint32_t v) {
+        out.push_back(v >> 24);
+        out.push_back(v >> 16);
+        out.push_back(v >> 8);
+        out.push_back(v);
+    };
+    auto chunk = [&](const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> out;
+        put32(out, (uint32_t)data.size());
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 4; i < out.size(); i++) crc = crc_table[(crc ^ out[i]) & 0xFF] ^ (crc >> 8);
+        put32(out, crc ^ 0xFFFFFFFFu);
+        file.write((const char*)out.data(), out.size());
+    };
+
+    // Filter byte 0 (none) in front of every row
+    size_t row_bytes = (size_t)width * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + y * row_bytes, rgba.begin() + (y + 1) * row_bytes);
+    }
+
+    std::vector<unsigned char> z = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (size_t offset = 0; offset < raw.size() || offset == 0;) {
+        size_t size = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        z.push_back(last ? 1 : 0);
+        z.push_back(size & 0xFF);
+        z.push_back(size >> 8);
+        z.push_back(~size & 0xFF);
+        z.push_back((~size >> 8) & 0xFF);
+        z.insert(z.end(), raw.begin() + offset, raw.begin() + offset + size);
+        for (size_t i = offset; i < offset + size; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        offset += size;
+        if (last) break;
+    }
+    put32(z, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    put32(header, width);
+    put32(header, height);
+    header.insert(header.end(), {8, 6, 0, 0, 0});   // 8-bit RGBA, no interlace
+
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write((const char*)signature, 8);
+    chunk("IHDR", header);
+    chunk("IDAT", z);
+    chunk("IEND", {});
+    return (bool)file;
+}
@@ -0,0 +1,657 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+
+// Cells per block side. Blocks are meshed, cached and re-meshed independently;
+// sparse grids store their bricks at the same size.
+constexpr int ISO_BLOCK = 16;
+
+// Triangles of each of the 256 corner configurations of a cell, as cell edges.
+// Corner c sits at (c & 1, c >> 1 & 1, c >> 2 & 1) and is inside when its value
+// is below the iso value. Edges 0-3 run along x, 4-7 along y, 8-11 along z.
+struct MarchingCubesTable {
+    static const uint8_t EDGE_CORNERS[12][2];
+    uint8_t triangle_count[256];
+    int8_t edges[256][15];          // At most five triangles
+};
+
+// Built once from the faces of the cube rather than typed in: every face
+// splits its crossings the same way from both cells that share it, so
+// ambiguous faces never leave cracks
+const MarchingCubesTable& marching_cubes_table();
+
+// Scalar samples on a regular lattice, size() samples per axis from `origin`,
+// `spacing` apart. Writes mark the blocks whose surface they can move, which
+// IsosurfaceMesher re-meshes and then clears.
+class VoxelGrid {
+public:
+    glm::vec3 origin = glm::vec3(0.0f);
+    float spacing = 1.0f;
+
+    virtual ~VoxelGrid() = default;
+
+    glm::ivec3 size() const { return samples; }
+    glm::ivec3 blocks() const { return block_dims; }
+    size_t block_count() const { return (size_t)block_dims.x * block_dims.y * block_dims.z; }
+    glm::vec3 position(const glm::ivec3& sample) const { return origin + glm::vec3(sample) * spacing; }
+
+    virtual float at(int x, int y, int z) const = 0;
+    virtual void set(int x, int y, int z, float value) = 0;
+    // Samples [first, first + count), x fastest; coordinates outside the grid
+    // read the nearest edge sample
+    virtual void read(const glm::ivec3& first, const glm::ivec3& count, float* out) const = 0;
+    // True with the value when the box is known to hold a single value, without reading it
+    virtual bool uniform(const glm::ivec3&, const glm::ivec3&, float&) const { return false; }
+    virtual size_t bytes() const = 0;
+
+    bool changed(size_t block) const { return changed_blocks[block] != 0; }
+    void mark_all_changed() { std::fill(changed_blocks.begin(), changed_blocks.end(), (uint8_t)1); }
+    void clear_changes() { std::fill(changed_blocks.begin(), changed_blocks.end(), (uint8_t)0); }
+
+protected:
+    glm::ivec3 samples = glm::ivec3(0);
+    glm::ivec3 block_dims = glm::ivec3(0);
+    std::vector<uint8_t> changed_blocks;
+
+    void resize(const glm::ivec3& size);
+    // Blocks read samples one past their cells for gradients, so a sample
+    // belongs to the blocks around it as well
+    void touch(int x, int y, int z);
+};
+
+class DenseGrid : public VoxelGrid {
+public:
+    std::vector<float> values;
+
+    DenseGrid() = default;
+    explicit DenseGrid(const glm::ivec3& size, float value = 0.0f) {
+        resize(size);
+        values.assign((size_t)size.x * size.y * size.z, value);
+        mark_all_changed();
+    }
+
+    size_t index(int x, int y, int z) const { return ((size_t)z * samples.y + y) * samples.x + x; }
+    float at(int x, int y, int z) const override { return values[index(x, y, z)]; }
+    void set(int x, int y, int z, float value) override {
+        values[index(x, y, z)] = value;
+        touch(x, y, z);
+    }
+    void read(const glm::ivec3& first, const glm::ivec3& count, float* out) const override;
+    size_t bytes() const override { return values.size() * sizeof(float); }
+
+    // Samples `field` at every lattice position, slices across a job system
+    void fill(const std::function<float(const glm::vec3&)>& field, JobSystem* jobs = nullptr);
+};
+
+// Bricks of ISO_BLOCK^3 samples, allocated only where the values vary. A
+// brick holding a single value is a tile: one float in the directory, which
+// is what far inside and far outside a narrow band cost.
+class SparseGrid : public VoxelGrid {
+public:
+    SparseGrid() = default;
+    explicit SparseGrid(const glm::ivec3& size, float background = 0.0f);
+
+    float at(int x, int y, int z) const override;
+    // Writing into a tile allocates its brick
+    void set(int x, int y, int z, float value) override;
+    void read(const glm::ivec3& first, const glm::ivec3& count, float* out) const override;
+    bool uniform(const glm::ivec3& first, const glm::ivec3& count, float& value) const override;
+    size_t bytes() const override;
+    size_t brick_count() const { return pool.size() / BRICK_SAMPLES; }
+
+    // Samples `field` clamped to [lo, hi], a narrow band for signed distances:
+    // bricks that clamp to one value become tiles
+    void fill(const std::function<float(const glm::vec3&)>& field, float lo, float hi, JobSystem* jobs = nullptr);
+
+private:
+    static constexpr size_t BRICK_SAMPLES = (size_t)ISO_BLOCK * ISO_BLOCK * ISO_BLOCK;
+
+    glm::ivec3 brick_dims = glm::ivec3(0);
+    std::vector<int32_t> directory;     // Brick index into the pool, -1 for a tile
+    std::vector<float> tiles;           // Value of each tile
+    std::vector<float> pool;
+
+    size_t brick_of(int x, int y, int z) const {
+        return ((size_t)(z / ISO_BLOCK) * brick_dims.y + y / ISO_BLOCK) * brick_dims.x + x / ISO_BLOCK;
+    }
+    static size_t offset_in_brick(int x, int y, int z) {
+        return ((size_t)(z % ISO_BLOCK) * ISO_BLOCK + y % ISO_BLOCK) * ISO_BLOCK + x % ISO_BLOCK;
+    }
+    // In-grid run [x0, x1) of row (y, z)
+    void read_row(int x0, int x1, int y, int z, float* out) const;
+};
+
+struct IsosurfaceStats {
+    size_t blocks_meshed = 0;           // Gathered and marched
+    size_t blocks_cleared = 0;          // Lost their surface to the iso value, without marching
+    size_t vertices = 0;
+    size_t triangles = 0;
+    double ms = 0.0;
+};
+
+// Extracts the iso surface of a VoxelGrid into a RenderMesh with marching
+// cubes. Every block keeps its own vertices and triangles; update() marches
+// only the blocks the grid marks changed, or whose value range the iso value
+// moved into or out of, and rewrites the mesh from the first changed block
+// on, marking just that tail dirty for RenderMesh::update(). Triangles face
+// toward larger values, outward for signed distances, with normals from the
+// central-difference gradient. Vertices on edges between blocks are repeated
+// in each block.
+class IsosurfaceMesher {
+public:
+    IsosurfaceStats update(VoxelGrid& grid, float iso, RenderMesh& out, JobSystem* jobs = nullptr);
+    // Drops the cached blocks, the next update() marches everything
+    void reset() { blocks.clear(); target = nullptr; }
+
+private:
+    struct Block {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<uint32_t> indices;      // Local to the block
+        float lo = 0.0f, hi = 0.0f;         // Value range of the block's corners
+        bool meshed = false;
+
+        bool crosses(float iso) const { return lo < iso && iso <= hi; }
+        void clear() { positions.clear(); normals.clear(); indices.clear(); }
+    };
+
+    std::vector<Block> blocks;
+    glm::ivec3 dims = glm::ivec3(0);
+    float current_iso = 0.0f;
+    const RenderMesh* target = nullptr;     // Mesh the blocks were last written into
+    std::vector<uint32_t> pending;
+    std::vector<size_t> vertex_offsets, index_offsets;
+
+    void mesh_block(const VoxelGrid& grid, size_t index, float iso, Block& block) const;
+};
+
+// Smooth union of four spheres with a shallow ripple, a signed distance over
+// [-1, 1]^3 for the demo, benchmarks and tests
+float isosurface_test_field(const glm::vec3& p);
+
+
+
+const uint8_t MarchingCubesTable::EDGE_CORNERS[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7},
+};
+
+static MarchingCubesTable build_marching_cubes_table() {
+    auto corner = [](int c) { return glm::ivec3(c & 1, c >> 1 & 1, c >> 2 & 1); };
+    auto edge_between = [](int a, int b) {
+        for (int e = 0; e < 12; e++) {
+            int c0 = MarchingCubesTable::EDGE_CORNERS[e][0], c1 = MarchingCubesTable::EDGE_CORNERS[e][1];
+            if ((c0 == a && c1 == b) || (c0 == b && c1 == a)) return e;
+        }
+        return -1;
+    };
+    auto on_face = [](int edge, int face) {
+        int axis = face / 2, side = face % 2;
+        return (MarchingCubesTable::EDGE_CORNERS[edge][0] >> axis & 1) == side && (MarchingCubesTable::EDGE_CORNERS[edge][1] >> axis & 1) == side;
+    };
+
+    // Corners of each face, counter-clockwise seen from outside the cube
+    int faces[6][4];
+    for (int f = 0; f < 6; f++) {
+        int axis = f / 2, side = f % 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const glm::ivec2 square[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        for (int k = 0; k < 4; k++) faces[f][k] = side << axis | square[k].x << u | square[k].y << v;
+        glm::vec3 outward(0.0f);
+        outward[axis] = side ? 1.0f : -1.0f;
+        glm::vec3 p0(corner(faces[f][0])), p1(corner(faces[f][1])), p2(corner(faces[f][2]));
+        if (glm::dot(glm::cross(p1 - p0, p2 - p1), outward) < 0.0f) std::swap(faces[f][1], faces[f][3]);
+    }
+
+    MarchingCubesTable table;
+    for (int cube = 0; cube < 256; cube++) {
+        // On every face, a crossing into the inside links to the next crossing
+        // along the face. Each crossed edge enters on one of its two faces, so
+        // the links close into loops around the inside corners.
+        int next[12];
+        std::fill(next, next + 12, -1);
+        for (int f = 0; f < 6; f++) {
+            int crossings[4], enters[4], count = 0;
+            for (int k = 0; k < 4; k++) {
+                int a = faces[f][k], b = faces[f][(k + 1) % 4];
+                bool inside_a = cube >> a & 1, inside_b = cube >> b & 1;
+                if (inside_a == inside_b) continue;
+                crossings[count] = edge_between(a, b);
+                enters[count++] = inside_b;
+            }
+            for (int k = 0; k < count; k++) {
+                if (enters[k]) next[crossings[k]] = crossings[(k + 1) % count];
+            }
+        }
+
+        int triangles = 0;
+        bool visited[12] = {};
+        for (int start = 0; start < 12; start++) {
+            if (next[start] < 0 || visited[start]) continue;
+            int loop[12], length = 0;
+            for (int e = start; !visited[e]; e = next[e]) {
+                visited[e] = true;
+                loop[length++] = e;
+            }
+            // A loop can cross an ambiguous face twice; fan from a vertex that
+            // gives no triangle lying flat in a face, which the cell across
+            // that face would repeat
+            int origin = 0;
+            for (int r = 0; r < length; r++) {
+                bool flat = false;
+                for (int k = 1; k + 1 < length && !flat; k++) {
+                    int a = loop[r], b = loop[(r + k) % length], c = loop[(r + k + 1) % length];
+                    for (int f = 0; f < 6 && !flat; f++) flat = on_face(a, f) && on_face(b, f) && on_face(c, f);
+                }
+                if (!flat) {
+                    origin = r;
+                    break;
+                }
+            }
+            for (int k = 1; k + 1 < length; k++) {
+                table.edges[cube][triangles * 3] = (int8_t)loop[origin];
+                table.edges[cube][triangles * 3 + 1] = (int8_t)loop[(origin + k) % length];
+                table.edges[cube][triangles * 3 + 2] = (int8_t)loop[(origin + k + 1) % length];
+                triangles++;
+            }
+        }
+        table.triangle_count[cube] = (uint8_t)triangles;
+    }
+    return table;
+}
+
+const MarchingCubesTable& marching_cubes_table() {
+    static const MarchingCubesTable table = build_marching_cubes_table();
+    return table;
+}
+
+void VoxelGrid::resize(const glm::ivec3& size) {
+    samples = size;
+    glm::ivec3 cells = glm::max(size - 1, glm::ivec3(1));
+    block_dims = (cells + ISO_BLOCK - 1) / ISO_BLOCK;
+    changed_blocks.assign(block_count(), 0);
+}
+
+void VoxelGrid::touch(int x, int y, int z) {
+    // Block b reads samples [b * ISO_BLOCK - 1, b * ISO_BLOCK + ISO_BLOCK + 1]
+    auto first_block = [](int s) { return std::max(0, (s + ISO_BLOCK - 2) / ISO_BLOCK - 1); };
+    glm::ivec3 lo(first_block(x), first_block(y), first_block(z));
+    glm::ivec3 hi = glm::min(glm::ivec3(x + 1, y + 1, z + 1) / ISO_BLOCK, block_dims - 1);
+    for (int bz = lo.z; bz <= hi.z; bz++) {
+        for (int by = lo.y; by <= hi.y; by++) {
+            for (int bx = lo.x; bx <= hi.x; bx++) changed_blocks[((size_t)bz * block_dims.y + by) * block_dims.x + bx] = 1;
+        }
+    }
+}
+
+void DenseGrid::read(const glm::ivec3& first, const glm::ivec3& count, float* out) const {
+    int x0 = std::max(first.x, 0), x1 = std::min(first.x + count.x, samples.x);
+    for (int z = 0; z < count.z; z++) {
+        int sz = glm::clamp(first.z + z, 0, samples.z - 1);
+        for (int y = 0; y < count.y; y++) {
+            int sy = glm::clamp(first.y + y, 0, samples.y - 1);
+            const float* row = &values[index(0, sy, sz)];
+            float* o = out + ((size_t)z * count.y + y) * count.x;
+            int x = 0;
+            for (; first.x + x < x0; x++) o[x] = row[0];
+            if (x1 > x0) {
+                std::memcpy(o + x, row + x0, (x1 - x0) * sizeof(float));
+                x += x1 - x0;
+            }
+            for (; x < count.x; x++) o[x] = row[samples.x - 1];
+        }
+    }
+}
+
+void DenseGrid::fill(const std::function<float(const glm::vec3&)>& field, JobSystem* jobs) {
+    auto fill_slices = [&](size_t begin, size_t end) {
+        for (int z = (int)begin; z < (int)end; z++) {
+            for (int y = 0; y < samples.y; y++) {
+                for (int x = 0; x < samples.x; x++) values[index(x, y, z)] = field(position(glm::ivec3(x, y, z)));
+            }
+        }
+    };
+    if (jobs) jobs->parallel_for(0, samples.z, 1, fill_slices);
+    else fill_slices(0, samples.z);
+    mark_all_changed();
+}
+
+SparseGrid::SparseGrid(const glm::ivec3& size, float background) {
+    resize(size);
+    brick_dims = (size + ISO_BLOCK - 1) / ISO_BLOCK;
+    size_t count = (size_t)brick_dims.x * brick_dims.y * brick_dims.z;
+    directory.assign(count, -1);
+    tiles.assign(count, background);
+    mark_all_changed();
+}
+
+float SparseGrid::at(int x, int y, int z) const {
+    size_t brick = brick_of(x, y, z);
+    int32_t slot = directory[brick];
+    return slot < 0 ? tiles[brick] : pool[slot * BRICK_SAMPLES + offset_in_brick(x, y, z)];
+}
+
+void SparseGrid::set(int x, int y, int z, float value) {
+    size_t brick = brick_of(x, y, z);
+    if (directory[brick] < 0) {
+        if (tiles[brick] == value) return;
+        directory[brick] = (int32_t)brick_count();
+        pool.resize(pool.size() + BRICK_SAMPLES, tiles[brick]);
+    }
+    pool[directory[brick] * BRICK_SAMPLES + offset_in_brick(x, y, z)] = value;
+    touch(x, y, z);
+}
+
+void SparseGrid::read_row(int x0, int x1, int y, int z, float* out) const {
+    while (x0 < x1) {
+        int end = std::min(x1, (x0 / ISO_BLOCK + 1) * ISO_BLOCK);
+        size_t brick = brick_of(x0, y, z);
+        int32_t slot = directory[brick];
+        if (slot < 0) std::fill(out, out + (end - x0), tiles[brick]);
+        else std::memcpy(out, &pool[slot * BRICK_SAMPLES + offset_in_brick(x0, y, z)], (end - x0) * sizeof(float));
+        out += end - x0;
+        x0 = end;
+    }
+}
+
+void SparseGrid::read(const glm::ivec3& first, const glm::ivec3& count, float* out) const {
+    int x0 = std::max(first.x, 0), x1 = std::min(first.x + count.x, samples.x);
+    for (int z = 0; z < count.z; z++) {
+        int sz = glm::clamp(first.z + z, 0, samples.z - 1);
+        for (int y = 0; y < count.y; y++) {
+            int sy = glm::clamp(first.y + y, 0, samples.y - 1);
+            float* o = out + ((size_t)z * count.y + y) * count.x;
+            int x = 0;
+            if (first.x < x0) {
+                float edge = at(0, sy, sz);
+                for (; first.x + x < x0; x++) o[x] = edge;
+            }
+            if (x1 > x0) {
+                read_row(x0, x1, sy, sz, o + x);
+                x += x1 - x0;
+            }
+            if (x < count.x) {
+                float edge = at(samples.x - 1, sy, sz);
+                for (; x < count.x; x++) o[x] = edge;
+            }
+        }
+    }
+}
+
+bool SparseGrid::uniform(const glm::ivec3& first, const glm::ivec3& count, float& value) const {
+    glm::ivec3 lo = glm::clamp(first, glm::ivec3(0), samples - 1) / ISO_BLOCK;
+    glm::ivec3 hi = glm::clamp(first + count - 1, glm::ivec3(0), samples - 1) / ISO_BLOCK;
+    for (int bz = lo.z; bz <= hi.z; bz++) {
+        for (int by = lo.y; by <= hi.y; by++) {
+            for (int bx = lo.x; bx <= hi.x; bx++) {
+                size_t brick = ((size_t)bz * brick_dims.y + by) * brick_dims.x + bx;
+                if (directory[brick] >= 0) return false;
+                if (bx == lo.x && by == lo.y && bz == lo.z) value = tiles[brick];
+                else if (tiles[brick] != value) return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t SparseGrid::bytes() const {
+    return pool.size() * sizeof(float) + directory.size() * (sizeof(int32_t) + sizeof(float));
+}
+
+void SparseGrid::fill(const std::function<float(const glm::vec3&)>& field, float lo, float hi, JobSystem* jobs) {
+    size_t count = directory.size();
+    auto brick_origin = [&](size_t brick) {
+        return glm::ivec3((int)(brick % brick_dims.x), (int)(brick / brick_dims.x % brick_dims.y), (int)(brick / brick_dims.x / brick_dims.y)) * ISO_BLOCK;
+    };
+    // Samples one brick into `out`, true when every sample clamps to the same value
+    auto sample_brick = [&](size_t brick, float* out) {
+        glm::ivec3 first = brick_origin(brick);
+        glm::ivec3 last = glm::min(first + ISO_BLOCK, samples);
+        bool single = true;
+        for (int z = first.z; z < last.z; z++) {
+            for (int y = first.y; y < last.y; y++) {
+                for (int x = first.x; x < last.x; x++) {
+                    float value = glm::clamp(field(position(glm::ivec3(x, y, z))), lo, hi);
+                    out[offset_in_brick(x, y, z)] = value;
+                    single = single && value == out[0];
+                }
+            }
+        }
+        return single;
+    };
+
+    // Tiles first, then the pool is laid out and the varying bricks sampled again into it
+    auto classify = [&](size_t begin, size_t end) {
+        FrameArena& scratch = FrameArena::thread_scratch();
+        ArenaScope scope(scratch);
+        float* values = scratch.allocate_array<float>(BRICK_SAMPLES);
+        for (size_t brick = begin; brick < end; brick++) {
+            bool single = sample_brick(brick, values);
+            directory[brick] = single ? -1 : 0;
+            tiles[brick] = values[0];
+        }
+    };
+    if (jobs) jobs->parallel_for(0, count, 1, classify);
+    else classify(0, count);
+
+    size_t bricks = 0;
+    for (size_t brick = 0; brick < count; brick++) {
+        if (directory[brick] >= 0) directory[brick] = (int32_t)bricks++;
+    }
+    pool.assign(bricks * BRICK_SAMPLES, 0.0f);
+    auto sample_pool = [&](size_t begin, size_t end) {
+        for (size_t brick = begin; brick < end; brick++) {
+            if (directory[brick] >= 0) sample_brick(brick, &pool[directory[brick] * BRICK_SAMPLES]);
+        }
+    };
+    if (jobs) jobs->parallel_for(0, count, 1, sample_pool);
+    else sample_pool(0, count);
+    mark_all_changed();
+}
+
+void IsosurfaceMesher::mesh_block(const VoxelGrid& grid, size_t index, float iso, Block& block) const {
+    glm::ivec3 b((int)(index % dims.x), (int)(index / dims.x % dims.y), (int)(index / dims.x / dims.y));
+    glm::ivec3 first = b * ISO_BLOCK;
+    glm::ivec3 cells = glm::min(glm::ivec3(ISO_BLOCK), grid.size() - 1 - first);
+    // One sample of padding on each side for the gradients
+    glm::ivec3 padded = cells + 3;
+    block.clear();
+    block.meshed = true;
+
+    float single;
+    if (grid.uniform(first - 1, padded, single)) {
+        block.lo = block.hi = single;
+        return;
+    }
+
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    float* values = scratch.allocate_array<float>((size_t)padded.x * padded.y * padded.z);
+    grid.read(first - 1, padded, values);
+    auto sample = [&](int x, int y, int z) {
+        return values[((size_t)(z + 1) * padded.y + (y + 1)) * padded.x + (x + 1)];
+    };
+
+    block.lo = block.hi = sample(0, 0, 0);
+    for (int z = 0; z <= cells.z; z++) {
+        for (int y = 0; y <= cells.y; y++) {
+            for (int x = 0; x <= cells.x; x++) {
+                float v = sample(x, y, z);
+                block.lo = std::min(block.lo, v);
+                block.hi = std::max(block.hi, v);
+            }
+        }
+    }
+    if (!block.crosses(iso)) return;
+
+    // Edge cache: the vertex on the +x, +y and +z edge of every lattice point,
+    // so the four cells around an edge share it
+    glm::ivec3 points = cells + 1;
+    size_t point_count = (size_t)points.x * points.y * points.z;
+    uint32_t* edge_vertex[3];
+    for (int axis = 0; axis < 3; axis++) edge_vertex[axis] = scratch.allocate_array<uint32_t>(point_count);
+    auto point = [&](int x, int y, int z) { return ((size_t)z * points.y + y) * points.x + x; };
+
+    auto gradient = [&](int x, int y, int z) {
+        return glm::vec3(sample(x + 1, y, z) - sample(x - 1, y, z),
+                         sample(x, y + 1, z) - sample(x, y - 1, z),
+                         sample(x, y, z + 1) - sample(x, y, z - 1));
+    };
+    for (int z = 0; z <= cells.z; z++) {
+        for (int y = 0; y <= cells.y; y++) {
+            for (int x = 0; x <= cells.x; x++) {
+                float v0 = sample(x, y, z);
+                glm::ivec3 p(x, y, z);
+                for (int axis = 0; axis < 3; axis++) {
+                    if (p[axis] == cells[axis]) continue;
+                    glm::ivec3 q = p;
+                    q[axis]++;
+                    float v1 = sample(q.x, q.y, q.z);
+                    if ((v0 < iso) == (v1 < iso)) continue;
+
+                    float t = (iso - v0) / (v1 - v0);
+                    glm::vec3 position(first + p);
+                    position[axis] += t;
+                    glm::vec3 g = glm::mix(gradient(p.x, p.y, p.z), gradient(q.x, q.y, q.z), t);
+                    float length = glm::length(g);
+                    edge_vertex[axis][point(x, y, z)] = (uint32_t)block.positions.size();
+                    block.positions.push_back(grid.origin + position * grid.spacing);
+                    block.normals.push_back(length > 0.0f ? g / length : glm::vec3(0.0f, 1.0f, 0.0f));
+                }
+            }
+        }
+    }
+
+    const MarchingCubesTable& table = marching_cubes_table();
+    for (int z = 0; z < cells.z; z++) {
+        for (int y = 0; y < cells.y; y++) {
+            for (int x = 0; x < cells.x; x++) {
+                int cube = 0;
+                for (int c = 0; c < 8; c++) {
+                    if (sample(x + (c & 1), y + (c >> 1 & 1), z + (c >> 2 & 1)) < iso) cube |= 1 << c;
+                }
+                int count = table.triangle_count[cube] * 3;
+                for (int k = 0; k < count; k++) {
+                    int edge = table.edges[cube][k];
+                    int c = MarchingCubesTable::EDGE_CORNERS[edge][0];
+                    block.indices.push_back(edge_vertex[edge / 4][point(x + (c & 1), y + (c >> 1 & 1), z + (c >> 2 & 1))]);
+                }
+            }
+        }
+    }
+}
+
+IsosurfaceStats IsosurfaceMesher::update(VoxelGrid& grid, float iso, RenderMesh& out, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    IsosurfaceStats stats;
+    size_t count = grid.block_count();
+    if (grid.blocks() != dims || blocks.size() != count) {
+        blocks.clear();
+        blocks.resize(count);
+        dims = grid.blocks();
+        target = nullptr;
+    }
+
+    // Blocks whose range the iso value left only lose their triangles
+    size_t first_changed = count;
+    pending.clear();
+    for (size_t b = 0; b < count; b++) {
+        Block& block = blocks[b];
+        if (!block.meshed || grid.changed(b)) {
+            pending.push_back((uint32_t)b);
+        } else if (iso != current_iso) {
+            if (block.crosses(iso)) {
+                pending.push_back((uint32_t)b);
+            } else if (!block.indices.empty()) {
+                block.clear();
+                stats.blocks_cleared++;
+                first_changed = std::min(first_changed, b);
+            }
+        }
+    }
+    auto mesh_range = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) mesh_block(grid, pending[k], iso, blocks[pending[k]]);
+    };
+    if (jobs) jobs->parallel_for(0, pending.size(), 1, mesh_range);
+    else mesh_range(0, pending.size());
+    grid.clear_changes();
+    current_iso = iso;
+    stats.blocks_meshed = pending.size();
+    if (!pending.empty()) first_changed = std::min(first_changed, (size_t)pending[0]);
+    if (&out != target) first_changed = 0;
+
+    vertex_offsets.resize(count + 1);
+    index_offsets.resize(count + 1);
+    vertex_offsets[0] = index_offsets[0] = 0;
+    for (size_t b = 0; b < count; b++) {
+        vertex_offsets[b + 1] = vertex_offsets[b] + blocks[b].positions.size();
+        index_offsets[b + 1] = index_offsets[b] + blocks[b].indices.size();
+    }
+    stats.vertices = vertex_offsets[count];
+    stats.triangles = index_offsets[count] / 3;
+
+    if (first_changed < count) {
+        // Blocks before the first changed one keep their place in the mesh
+        out.positions.resize(stats.vertices);
+        out.normals.resize(stats.vertices);
+        out.indices.resize(index_offsets[count]);
+        auto write_range = [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; b++) {
+                const Block& block = blocks[b];
+                std::copy(block.positions.begin(), block.positions.end(), out.positions.begin() + vertex_offsets[b]);
+                std::copy(block.normals.begin(), block.normals.end(), out.normals.begin() + vertex_offsets[b]);
+                uint32_t base = (uint32_t)vertex_offsets[b];
+                uint32_t* indices = out.indices.data() + index_offsets[b];
+                for (size_t k = 0; k < block.indices.size(); k++) indices[k] = block.indices[k] + base;
+            }
+        };
+        if (jobs) jobs->parallel_for(first_changed, count, 0, write_range);
+        else write_range(first_changed, count);
+
+        out.tex_coords.clear();
+        out.strip_indices.clear();
+        out.meshlets.clear();
+        out.has_shared_vertices = true;
+        out.has_vertex_normals = true;
+        out.has_tex_coords = false;
+        glm::vec3 extent = glm::vec3(grid.size() - 1) * grid.spacing;
+        out.bounds_center = grid.origin + extent * 0.5f;
+        out.bounds_radius = glm::length(extent) * 0.5f;
+        out.mark_vertices_dirty(vertex_offsets[first_changed], stats.vertices - vertex_offsets[first_changed]);
+        out.mark_indices_dirty(index_offsets[first_changed], index_offsets[count] - index_offsets[first_changed]);
+        target = &out;
+    }
+
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+float isosurface_test_field(const glm::vec3& p) {
+    const glm::vec4 spheres[4] = {
+        {-0.35f, -0.2f, 0.0f, 0.42f},
+        {0.4f, -0.25f, 0.1f, 0.36f},
+        {0.0f, 0.35f, -0.15f, 0.38f},
+        {0.1f, 0.05f, 0.45f, 0.25f},
+    };
+    // Polynomial smooth minimum, blends within `k` of the seams
+    const float k = 0.2f;
+    float d = glm::length(p - glm::vec3(spheres[0])) - spheres[0].w;
+    for (int s = 1; s < 4; s++) {
+        float e = glm::length(p - glm::vec3(spheres[s])) - spheres[s].w;
+        float h = glm::clamp(0.5f + 0.5f * (e - d) / k, 0.0f, 1.0f);
+        d = glm::mix(e, d, h) - k * h * (1.0f - h);
+    }
+    return d + 0.02f * std::sin(p.x * 14.0f) * std::sin(p.y * 14.0f) * std::sin(p.z * 14.0f);
+}
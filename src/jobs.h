@@ -0,0 +1,380 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <string>
+
+#include "profiler.h"
+
+// Counts outstanding top-level jobs. The GL thread can poll is_done() once per
+// frame instead of blocking, worker code can wait() on it and help meanwhile.
+struct JobCounter {
+    std::atomic<int> value{0};
+};
+
+// A unit of work. The callable is stored inline in the payload so creating a
+// job never touches the heap. A job is finished once it and all of its
+// children have run.
+struct alignas(64) Job {
+    void (*function)(Job*);
+    Job* parent;
+    JobCounter* counter;
+    std::atomic<int> unfinished;
+    alignas(16) unsigned char payload[104];
+};
+
+// Chase-Lev work-stealing deque. The owning worker pushes and pops at the
+// bottom, other workers steal from the top.
+class WorkStealingQueue {
+public:
+    static const int64_t CAPACITY = 4096;   // Power of two
+
+    bool push(Job* job) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY) return false;
+
+        jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Job* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t != b) return job;
+
+        // Last job in the queue, race against concurrent steals
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return job;
+    }
+
+    Job* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        Job* job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Job*> jobs[CAPACITY];
+};
+
+// Work-stealing scheduler. The thread that constructs the system is worker 0
+// and only runs jobs while it waits, the remaining workers are background
+// threads. Threads that are not workers (e.g. a loader thread) submit through
+// a locked injection queue.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned thread_count = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Create a job running `f`. Children must be created before their parent is run.
+    template <typename F>
+    Job* create(F&& f, Job* parent = nullptr);
+
+    // Queue a job. The counter, if any, drops back when the job and its children are done.
+    void run(Job* job, JobCounter* counter = nullptr);
+
+    // Run other jobs until the job or counter is done
+    void wait(const Job* job);
+    void wait(const JobCounter& counter);
+    bool is_done(const Job* job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+    bool is_done(const JobCounter& counter) const { return counter.value.load(std::memory_order_acquire) == 0; }
+
+    // Split [begin, end) into chunks of `grain` indices and call fn(chunk_begin, chunk_end)
+    // on the workers. Blocks until done. A grain of 0 picks one based on the thread count.
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F&& fn);
+
+    unsigned thread_count() const { return (unsigned)queues.size(); }
+
+private:
+    static const int JOB_POOL_SIZE = 4096;
+
+    struct JobPool {
+        std::unique_ptr<Job[]> jobs;
+        uint32_t next = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+    std::vector<JobPool> pools;             // One per worker, plus a shared one for other threads
+    std::mutex external_pool_mutex;
+    std::vector<std::thread> threads;
+    std::deque<Job*> injected;
+    std::mutex injected_mutex;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<int> pending{0};
+    std::atomic<bool> running{true};
+
+    Job* allocate();
+    Job* next_free(JobPool& pool);
+    Job* find_job(int index);
+    void execute(Job* job);
+    void finish(Job* job);
+    void worker_main(int index);
+    int current_index() const;
+};
+
+// Scheduler owning the calling thread, and that thread's worker index
+inline thread_local JobSystem* tls_job_system = nullptr;
+inline thread_local int tls_worker_index = -1;
+
+JobSystem::JobSystem(unsigned thread_count) {
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    pools.resize(thread_count + 1);
+    for (auto& pool : pools) pool.jobs.reset(new Job[JOB_POOL_SIZE]());
+
+    for (unsigned i = 0; i < thread_count; i++) {
+        queues.push_back(std::make_unique<WorkStealingQueue>());
+    }
+
+    tls_job_system = this;
+    tls_worker_index = 0;
+
+    for (unsigned i = 1; i < thread_count; i++) {
+        threads.emplace_back(&JobSystem::worker_main, this, (int)i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        running.store(false);
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+
+    if (tls_job_system == this) {
+        tls_job_system = nullptr;
+        tls_worker_index = -1;
+    }
+}
+
+template <typename F>
+Job* JobSystem::create(F&& f, Job* parent) {
+    using Fn = typename std::decay<F>::type;
+    static_assert(sizeof(Fn) <= sizeof(Job::payload), "Job callable captures too much state, capture by reference or pointer");
+    static_assert(alignof(Fn) <= 16, "Job callable is over-aligned");
+
+    Job* job = allocate();
+    job->function = [](Job* self) {
+        Fn* fn = reinterpret_cast<Fn*>(self->payload);
+        (*fn)();
+        fn->~Fn();
+    };
+    job->parent = parent;
+    job->counter = nullptr;
+    new (job->payload) Fn(std::forward<F>(f));
+
+    if (parent) parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+template <typename F>
+void JobSystem::parallel_for(size_t begin, size_t end, size_t grain, F&& fn) {
+    if (end <= begin) return;
+    size_t count = end - begin;
+
+    if (grain == 0) grain = std::max<size_t>(1, count / (thread_count() * 8));
+    // Keep the chunk count well inside the per-thread job pool
+    grain = std::max(grain, (count + 1023) / 1024);
+
+    if (count <= grain || thread_count() == 1) {
+        fn(begin, end);
+        return;
+    }
+
+    auto* body = &fn;
+    Job* root = create([] {});
+    for (size_t lo = begin; lo < end; lo += grain) {
+        size_t hi = std::min(end, lo + grain);
+        run(create([body, lo, hi] { (*body)(lo, hi); }, root));
+    }
+    run(root);
+    wait(root);
+}
+
+Job* JobSystem::allocate() {
+    int index = current_index();
+    while (true) {
+        Job* job;
+        if (index >= 0) {
+            job = next_free(pools[index]);
+        } else {
+            std::lock_guard<std::mutex> lock(external_pool_mutex);
+            job = next_free(pools.back());
+        }
+        if (job) return job;
+
+        // All JOB_POOL_SIZE slots are in flight: run queued work until one
+        // finishes rather than overwrite a live job
+        Job* other = find_job(index);
+        if (other) execute(other);
+        else std::this_thread::yield();
+    }
+}
+
+Job* JobSystem::next_free(JobPool& pool) {
+    // Ring of jobs, skipping slots that are still in flight. The slot is
+    // claimed before returning, so other threads sharing the pool skip it.
+    for (int i = 0; i < JOB_POOL_SIZE; i++) {
+        Job* job = &pool.jobs[pool.next++ & (JOB_POOL_SIZE - 1)];
+        if (job->unfinished.load(std::memory_order_acquire) == 0) {
+            job->unfinished.store(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+int JobSystem::current_index() const {
+    return tls_job_system == this ? tls_worker_index : -1;
+}
+
+void JobSystem::run(Job* job, JobCounter* counter) {
+    if (counter) {
+        job->counter = counter;
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int index = current_index();
+    pending.fetch_add(1, std::memory_order_release);
+
+    if (index >= 0) {
+        if (!queues[index]->push(job)) {
+            // Queue is full, run inline rather than drop work
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        injected.push_back(job);
+    }
+
+    wake.notify_one();
+}
+
+Job* JobSystem::find_job(int index) {
+    Job* job = nullptr;
+
+    if (index >= 0) job = queues[index]->pop();
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        if (!injected.empty()) {
+            job = injected.front();
+            injected.pop_front();
+        }
+    }
+
+    if (!job) {
+        // Steal starting from a random victim
+        thread_local std::minstd_rand rng(std::random_device{}());
+        int n = (int)queues.size();
+        int start = (int)(rng() % n);
+        for (int i = 0; i < n && !job; i++) {
+            int victim = (start + i) % n;
+            if (victim != index) job = queues[victim]->steal();
+        }
+    }
+
+    if (job) pending.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::execute(Job* job) {
+    PROFILE_SCOPE("Job");
+    job->function(job);
+    finish(job);
+}
+
+void JobSystem::finish(Job* job) {
+    // Once unfinished reaches 0 the slot can be handed out again, so read
+    // what the job points to first
+    JobCounter* counter = job->counter;
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    if (counter) counter->value.fetch_sub(1, std::memory_order_release);
+    if (parent) finish(parent);
+}
+
+void JobSystem::wait(const Job* job) {
+    int index = current_index();
+    while (!is_done(job)) {
+        Job* next = find_job(index);
+        if (next) execute(next);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+    int index = current_index();
+    while (!is_done(counter)) {
+        Job* next = find_job(index);
+        if (next) execute(next);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::worker_main(int index) {
+    tls_job_system = this;
+    tls_worker_index = index;
+    Profiler::instance().set_thread_name("Worker " + std::to_string(index));
+
+    while (running.load(std::memory_order_acquire)) {
+        Job* job = find_job(index);
+        if (job) {
+            execute(job);
+            continue;
+        }
+
+        // Nothing to do, sleep until new work is queued. The timeout covers
+        // wakeups that race with the pending check.
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait_for(lock, std::chrono::milliseconds(1), [this] {
+            return !running.load(std::memory_order_relaxed) || pending.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
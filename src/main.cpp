@@ -22,17 +22,45 @@
 #include "camera.h"
 #include "shader.h"
 #include "mesh.h"
+#include "scene.h"
+#include "jobs.h"
+#include "culling.h"
+#include "assets.h"
+#include "headless.h"
+#include "profiler.h"
+#include "profiler_ui.h"
+#include "render_stats.h"
+#include "gl_trace.h"
+#include "frame_pacing.h"
+#include "render_thread.h"
+#include "stream_buffer.h"
+#include "debug_draw.h"
+#include "point_cloud.h"
+#include "skinning.h"
+#include "morph.h"
+#include "isosurface.h"
+#include "memory.h"
 
 // Standard Library
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <cstdio>
+#include <cstring>
 
 // Forward Declarations
 unsigned int LoadShader(std::string vertexPath, std::string fragmentPath);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void UpdateCamera(GLFWwindow *window, float step);
+GLFWwindow* CreateAppWindow();
+void SetupImGui(GLFWwindow* window);
 
 // camera
 unsigned int SCR_WIDTH = 1280;
@@ -47,6 +75,10 @@ bool firstMouse = true;
 static bool enableFlyCam = true;
 static bool drawNormals = false;
 static bool drawWireframe = false;
+static float normalLength = 0.5f;
+static float wireframeWidth = 1.5f;
+static bool drawBounds = false;
+static bool drawLightMarkers = false;
 static bool drawShaded = true;
 
 
@@ -58,14 +90,69 @@ static ImGuizmo::MODE mCurrentGizmoMode(ImGuizmo::WORLD);
 static bool useSnap(false);
 static float snap[3] = { 1.f, 1.f, 1.f };
 
+// scene
+Scene scene;
+static Entity selectedEntity = NULL_ENTITY;
+static std::vector<uint8_t> visibleEntities;
+static bool meshletCulling = true;
+
+// Per-entity state the render side needs, copied from the scene when the frame is recorded
+struct DrawItem
+{
+    RenderMesh* mesh = nullptr;
+    glm::mat4 model;
+    Material material;
+    bool useRanges = false;     // Draw the meshlets that survived culling
+    MeshletDrawList ranges;
+};
+
+// Deep copy of ImGui's draw data, drawn by the render thread while the main thread builds the next frame
+struct DrawDataDeleter
+{
+    void operator()(ImDrawData* drawData) const
+    {
+        for (ImDrawList* drawList : drawData->CmdLists)
+            IM_DELETE(drawList);
+        IM_DELETE(drawData);
+    }
+};
+using DrawDataCopy = std::unique_ptr<ImDrawData, DrawDataDeleter>;
+DrawDataCopy CopyDrawData(const ImDrawData* drawData);
+void StartRenderThread(RenderThread& renderThread, GLFWwindow* window, int frames, const int64_t* frameInputs);
+
+// headless batch runs (--headless)
+struct HeadlessOptions
+{
+    bool enabled = false;
+    int frames = 300;
+    int warmup = 5;             // Rendered before the timed frames, not recorded
+    int captureEvery = 0;       // 0 captures only the last frame
+    std::string outputDir = "headless_output";
+    std::string cameraPath;     // Keyframe file, orbit when empty
+};
+
+// asset streaming
+static float uploadBudgetMs = 2.0f;
+static int uploadBudgetKB = 8192;
+
+// point cloud (--points): LOD limits, default point size and upload rate
+static PointLod pointLod;
+static float pointRadius = 0.0f;        // World units, set from the cloud's spacing once loaded
+static int pointUploadKB = 16384;
+
 // timing
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
-// Matrix Setup
-// Model Matrix
-glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+// frame pacing: the camera moves in fixed steps, rendering interpolates between the last two
+static FixedTimestep fixedTimestep;
+static FramePacer framePacer;
+static LatencyMeter latencyMeter;
+static int updateHz = 60;
+static bool interpolateUpdates = true;
+static glm::vec3 previousCameraPosition;
 
+// Matrix Setup
 // View Matrix
 glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f),
                     glm::vec3(0.0f, 0.0f, 0.0f),
@@ -83,7 +170,7 @@ void TransformEnd()
    ImGui::PopStyleColor(1);
 }
 
-void EditTransform(float* cameraView, float* cameraProjection, float* matrix)
+bool EditTransform(float* cameraView, float* cameraProjection, float* matrix)
 {
     ImGuiIO& io = ImGui::GetIO();
     float windowWidth = (float)ImGui::GetWindowWidth();
@@ -96,7 +183,7 @@ void EditTransform(float* cameraView, float* cameraProjection, float* matrix)
     {
        ImGuizmo::SetRect(ImGui::GetWindowPos().x, ImGui::GetWindowPos().y, windowWidth, windowHeight);
     }
-    ImGuizmo::Manipulate(cameraView, cameraProjection, mCurrentGizmoOperation, mCurrentGizmoMode, matrix, NULL, useSnap ? &snap[0] : NULL);
+    return ImGuizmo::Manipulate(cameraView, cameraProjection, mCurrentGizmoOperation, mCurrentGizmoMode, matrix, NULL, useSnap ? &snap[0] : NULL);
 }
 
 std::string vec3_to_string(const glm::vec3& vec) {
@@ -104,13 +191,1097 @@ std::string vec3_to_string(const glm::vec3& vec) {
 }
 
 
-int main()
+int main(int argc, char** argv)
+{
+    // Worker threads for mesh processing, scene update and culling. The main
+    // thread is worker 0 and joins in whenever it waits on a job.
+    Profiler::instance().set_thread_name("Main");
+    JobSystem jobSystem;
+
+    // Command line: --headless [--frames N] [--warmup N] [--size WxH] [--output DIR] [--camera-path FILE]
+    // [--capture-every N] [--stats-csv FILE] [--gl-trace FILE] [--gl-trace-frames N]
+    // [--pacing vsync|capped|uncapped] [--fps N] [--update-hz N] [--latency] [--render-thread [2|3]]
+    // [--points FILE] [--point-budget N] [--weld EPSILON] [--skinning cpu|gpu]
+    // [--morph cpu|gpu] [--isosurface dense|sparse], anything else is an OBJ file to load
+    HeadlessOptions headless;
+    std::string statsCsv;
+    std::string glTraceFile;
+    int glTraceFrames = 0;
+    int renderThreadFrames = 0;     // Command lists in flight, 0 renders on the main thread
+    std::string pointsFile;
+    std::vector<std::string> objFiles;
+    float weldEpsilon = -1.0f;      // Negative keeps OBJ vertices as they are
+    std::string skinningMode;       // Animated tentacle skinned on the CPU or in the vertex shader, none when empty
+    std::string morphMode;          // Blob with blend shapes weighted on the CPU or in the vertex shader, none when empty
+    std::string isosurfaceMode;     // Marching cubes over a dense or sparse grid, none when empty
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            headless.enabled = true;
+        else if (arg == "--frames" && hasValue)
+            headless.frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            headless.warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--capture-every" && hasValue)
+            headless.captureEvery = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--output" && hasValue)
+            headless.outputDir = argv[++i];
+        else if (arg == "--camera-path" && hasValue)
+            headless.cameraPath = argv[++i];
+        else if (arg == "--stats-csv" && hasValue)
+            statsCsv = argv[++i];
+        else if (arg == "--gl-trace" && hasValue)
+            glTraceFile = argv[++i];
+        else if (arg == "--gl-trace-frames" && hasValue)
+            glTraceFrames = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--pacing" && hasValue)
+        {
+            std::string mode = argv[++i];
+            framePacer.mode = mode == "capped" ? PacingMode::Capped : mode == "uncapped" ? PacingMode::Uncapped : PacingMode::VSync;
+        }
+        else if (arg == "--fps" && hasValue)
+        {
+            framePacer.target_fps = std::max(1.0f, (float)std::atof(argv[++i]));
+            framePacer.mode = PacingMode::Capped;
+        }
+        else if (arg == "--update-hz" && hasValue)
+            updateHz = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--latency")
+            latencyMeter.enabled = true;
+        else if (arg == "--render-thread")
+        {
+            renderThreadFrames = 2;
+            if (hasValue && (std::string(argv[i + 1]) == "2" || std::string(argv[i + 1]) == "3"))
+                renderThreadFrames = std::atoi(argv[++i]);
+        }
+        else if (arg == "--points" && hasValue)
+            pointsFile = argv[++i];
+        else if (arg == "--point-budget" && hasValue)
+            pointLod.budget = (size_t)std::max(1000ll, std::atoll(argv[++i]));
+        else if (arg == "--weld" && hasValue)
+            weldEpsilon = (float)std::atof(argv[++i]);
+        else if (arg == "--skinning" && hasValue)
+            skinningMode = argv[++i];
+        else if (arg == "--morph" && hasValue)
+            morphMode = argv[++i];
+        else if (arg == "--isosurface" && hasValue)
+            isosurfaceMode = argv[++i];
+        else if (arg == "--size" && hasValue)
+            std::sscanf(argv[++i], "%ux%u", &SCR_WIDTH, &SCR_HEIGHT);
+        else
+            objFiles.push_back(arg);
+    }
+
+    // Window with GLFW, or an offscreen context and framebuffer for batch runs
+    GLFWwindow *window = nullptr;
+    HeadlessContext headlessContext;
+    RenderTarget renderTarget;
+    if (headless.enabled)
+    {
+        if (!headlessContext.create())
+            return -1;
+    }
+    else
+    {
+        window = CreateAppWindow();
+        if (!window)
+            return -1;
+    }
+
+    // Initialize GLAD
+    if (!gladLoadGLLoader(headless.enabled ? HeadlessContext::loader() : (GLADloadproc)glfwGetProcAddress))
+    {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    bool persistentStreaming = load_stream_buffer_functions(headless.enabled ? HeadlessContext::loader() : (GLADloadproc)glfwGetProcAddress);
+
+    // Record GL calls from here on, before any GL object exists, for the replay tool.
+    // Stream buffers orphan instead of mapping persistently so their writes are recorded.
+    if (!glTraceFile.empty())
+    {
+        StreamBuffer::allow_persistent = false;
+        if (!GLTrace::start(glTraceFile, SCR_WIDTH, SCR_HEIGHT, glTraceFrames))
+            std::cerr << "Failed to open " << glTraceFile << std::endl;
+    }
+
+    // Initialize ImGui
+    if (window)
+    {
+        SetupImGui(window);
+        glfwSwapInterval(framePacer.swap_interval());
+    }
+    previousCameraPosition = camera.Position;
+
+    // Configure OpenGL
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    
+    // Get actual framebuffer size for proper viewport setup
+    if (window)
+    {
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+    }
+    else
+    {
+        if (!renderTarget.create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+        projection = glm::perspective(glm::radians(60.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    }
+    glEnable(GL_DEPTH_TEST);
+
+
+       // positions of the point lights
+    glm::vec3 pointLightPositions[] = {
+        glm::vec3( 0.7f,  0.2f,  2.0f),
+        glm::vec3( 2.3f, -3.3f, -4.0f),
+        glm::vec3(-4.0f,  2.0f, -12.0f),
+        glm::vec3( 0.0f,  0.0f, -3.0f)
+    };
+
+    // Load Shaders
+    Shader lightingShader("multiple_lights");
+    Shader wireLightingShader("multiple_lights", "wireframe_overlay");     // Barycentrics per triangle from a geometry shader
+    Shader skinnedShader("skinned", "multiple_lights", "skinned");          // Joint matrices blended in the vertex shader
+    Shader morphShader("morph", "multiple_lights", "morph");                // Morph target deltas from texture buffers
+    DebugDrawRenderer debugRenderer;
+    DebugDraw& debugDraw = DebugDraw::instance();
+
+    // Same lighting for the plain and the single-pass wireframe variant
+    for (Shader* shader : {&lightingShader, &wireLightingShader, &skinnedShader, &morphShader})
+    {
+        shader->use();
+        shader->setMat4("view", view);
+        shader->setMat4("projection", projection);
+
+        // dir light
+        shader->setVec3("dirLight.ambient", 1.0f, 0.0f, 0.0f);
+        shader->setVec3("diffuse", 0.5f, 0.5f, 0.5f);
+        shader->setVec3("specular", 1.0f, 1.0f, 1.0f);
+        shader->setFloat("shininess", 32.0f);
+
+        shader->setVec3("pointLights[0].position", pointLightPositions[0]);
+        shader->setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
+        shader->setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
+        shader->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
+        shader->setFloat("pointLights[0].constant", 1.0f);
+        shader->setFloat("pointLights[0].linear", 0.09f);
+        shader->setFloat("pointLights[0].quadratic", 0.032f);
+        // point light 2
+        shader->setVec3("pointLights[1].position", pointLightPositions[1]);
+        shader->setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
+        shader->setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
+        shader->setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
+        shader->setFloat("pointLights[1].constant", 1.0f);
+        shader->setFloat("pointLights[1].linear", 0.09f);
+        shader->setFloat("pointLights[1].quadratic", 0.032f);
+        // point light 3
+        shader->setVec3("pointLights[2].position", pointLightPositions[2]);
+        shader->setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
+        shader->setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
+        shader->setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
+        shader->setFloat("pointLights[2].constant", 1.0f);
+        shader->setFloat("pointLights[2].linear", 0.09f);
+        shader->setFloat("pointLights[2].quadratic", 0.032f);
+        // point light 4
+        shader->setVec3("pointLights[3].position", pointLightPositions[3]);
+        shader->setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
+        shader->setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
+        shader->setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
+        shader->setFloat("pointLights[3].constant", 1.0f);
+        shader->setFloat("pointLights[3].linear", 0.09f);
+        shader->setFloat("pointLights[3].quadratic", 0.032f);
+        shader->setInt("material.diffuseMap", 0);
+        shader->setInt("material.specularMap", 1);
+    }
+    wireLightingShader.setBool("enableWireframe", true);
+
+    // Load Meshes in the background, entities get their mesh once it is uploaded
+    AssetManager assets(jobSystem);
+    std::vector<std::pair<Entity, MeshHandle>> pendingMeshes;
+    std::vector<MeshHandle> loadedMeshes;      // Keeps meshes referenced by the scene alive
+
+    // Material maps, a white texture stands in until they are uploaded (and for untextured materials)
+    Texture whiteTexture = solid_texture(255, 255, 255);
+    TextureHandle checkerDiffuse = assets.load_texture("assets/textures/checker_diffuse.png");
+    TextureHandle checkerSpecular = assets.load_texture("assets/textures/checker_specular.png");
+    bool texturesAssigned = false;
+
+    // Build Scene
+    int sphereMaterial = scene.add_material({glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.5f, 0.5f, 0.5f), 128.0f});
+    int cylinderMaterial = scene.add_material({glm::vec3(0.4f, 0.6f, 1.0f), glm::vec3(0.5f, 0.5f, 0.5f), 32.0f});
+    Entity sphereEntity = scene.create("sphere", NULL_ENTITY, nullptr, sphereMaterial);
+    Entity cylinderEntity = scene.create("cylinder", sphereEntity, nullptr, cylinderMaterial);
+    scene.set_translation(cylinderEntity, glm::vec3(2.0f, 0.0f, 0.0f));
+    selectedEntity = sphereEntity;
+
+    pendingMeshes.push_back({sphereEntity, assets.build_mesh("uvsphere", [] { return RenderMesh::uvsphere(5, 6); })});
+    pendingMeshes.push_back({cylinderEntity, assets.build_mesh("cylinder", [] { return RenderMesh::cylinder(10); })});
+
+    // Optional OBJ files from the command line
+    for (size_t i = 0; i < objFiles.size(); i++)
+    {
+        Entity objEntity = scene.create(objFiles[i], NULL_ENTITY, nullptr, sphereMaterial);
+        scene.set_translation(objEntity, glm::vec3(-2.0f * (i + 1), 0.0f, 0.0f));
+        pendingMeshes.push_back({objEntity, assets.load_mesh(objFiles[i], true, weldEpsilon)});
+    }
+
+    // Skinned tentacle from --skinning. The CPU path skins every frame, streams the
+    // vertices through a VertexStream and draws it like any other mesh, the GPU path
+    // draws the bind pose with the skinned shader and is not part of the static draw list.
+    SkinnedModel tentacle;
+    VertexStream tentacleStream;
+    Entity tentacleEntity = NULL_ENTITY;
+    bool cpuSkinning = skinningMode == "cpu";
+    bool gpuSkinning = skinningMode == "gpu";
+    JointPoses tentaclePose;
+    std::vector<glm::mat4> skinMatrices[RenderThread::MAX_FRAMES];
+    std::vector<float> skinnedVertices[RenderThread::MAX_FRAMES];
+    if (cpuSkinning || gpuSkinning)
+    {
+        tentacle = skinned_tentacle(16, 64, 32, 2.0f, &jobSystem);
+        tentacle.mesh.upload();
+        if (cpuSkinning)
+            tentacleStream.create(tentacle.mesh);
+        tentacleEntity = scene.create("tentacle", NULL_ENTITY, cpuSkinning ? &tentacle.mesh : nullptr, cylinderMaterial);
+        scene.set_translation(tentacleEntity, glm::vec3(0.0f, -1.0f, 2.0f));
+    }
+    else if (!skinningMode.empty())
+        std::cerr << "Unknown skinning mode " << skinningMode << ", expected cpu or gpu" << std::endl;
+
+    // Blob with blend shapes from --morph. The CPU path blends the active targets on
+    // the job system and streams the vertices through a VertexStream, the mesh's
+    // VBO stays the rest pose. The GPU path adds the deltas in the morph shader.
+    MorphTargets blobTargets;
+    RenderMesh blob;
+    VertexStream blobStream;
+    Entity blobEntity = NULL_ENTITY;
+    bool cpuMorph = morphMode == "cpu";
+    bool gpuMorph = morphMode == "gpu";
+    std::vector<float> morphWeights[RenderThread::MAX_FRAMES];
+    std::vector<float> morphedVertices[RenderThread::MAX_FRAMES];
+    if (cpuMorph || gpuMorph)
+    {
+        blob = morph_test_blob(48, blobTargets, &jobSystem);
+        blob.upload();
+        if (cpuMorph)
+            blobStream.create(blob);
+        else
+            blobTargets.upload(blob);
+        blobEntity = scene.create("blob", NULL_ENTITY, cpuMorph ? &blob : nullptr, cylinderMaterial);
+        scene.set_translation(blobEntity, glm::vec3(-1.5f, 1.5f, 1.0f));
+        scene.set_scale(blobEntity, glm::vec3(0.6f));
+    }
+    else if (!morphMode.empty())
+        std::cerr << "Unknown morph mode " << morphMode << ", expected cpu or gpu" << std::endl;
+
+    // Isosurface of the test field from --isosurface, in a dense grid or a narrow-band
+    // sparse one. Moving the iso value or the probe re-meshes only the blocks it
+    // reaches, and only the mesh from the first of them on is uploaded again.
+    DenseGrid isoDenseGrid;
+    SparseGrid isoSparseGrid;
+    VoxelGrid* isoGrid = nullptr;
+    IsosurfaceMesher isoMesher;
+    IsosurfaceStats isoStats;
+    RenderMesh isoMesh;
+    Entity isoEntity = NULL_ENTITY;
+    const float isoBand = 0.1f;         // Sparse grids clamp the field to +-isoBand
+    float isoValue = 0.0f;
+    float meshedIsoValue = 0.0f;
+    bool isoProbe = false;              // A ball carved out of the surface, circling
+    bool isoProbeStamped = false;
+    glm::ivec3 isoProbeCenter(0);
+    const int isoProbeRadius = 5;       // In samples
+    if (isosurfaceMode == "dense" || isosurfaceMode == "sparse")
+    {
+        glm::ivec3 isoSamples(96);
+        if (isosurfaceMode == "dense")
+        {
+            isoDenseGrid = DenseGrid(isoSamples);
+            isoGrid = &isoDenseGrid;
+        }
+        else
+        {
+            isoSparseGrid = SparseGrid(isoSamples, isoBand);
+            isoGrid = &isoSparseGrid;
+        }
+        isoGrid->origin = glm::vec3(-1.0f);
+        isoGrid->spacing = 2.0f / (isoSamples.x - 1);
+        if (isoGrid == &isoDenseGrid)
+            isoDenseGrid.fill(isosurface_test_field, &jobSystem);
+        else
+            isoSparseGrid.fill(isosurface_test_field, -isoBand, isoBand, &jobSystem);
+        isoStats = isoMesher.update(*isoGrid, isoValue, isoMesh, &jobSystem);
+        isoMesh.upload();
+        isoEntity = scene.create("isosurface", NULL_ENTITY, &isoMesh, cylinderMaterial);
+        scene.set_translation(isoEntity, glm::vec3(1.5f, 1.5f, 1.0f));
+        scene.set_scale(isoEntity, glm::vec3(0.8f));
+    }
+    else if (!isosurfaceMode.empty())
+        std::cerr << "Unknown isosurface mode " << isosurfaceMode << ", expected dense or sparse" << std::endl;
+    // Writes the probe ball into the grid around `center`, or the field back when `carve` is false
+    auto stampIsoProbe = [&](const glm::ivec3& center, bool carve)
+    {
+        glm::ivec3 lo = glm::max(center - (isoProbeRadius + 1), glm::ivec3(0));
+        glm::ivec3 hi = glm::min(center + (isoProbeRadius + 1), isoGrid->size() - 1);
+        for (int z = lo.z; z <= hi.z; z++)
+            for (int y = lo.y; y <= hi.y; y++)
+                for (int x = lo.x; x <= hi.x; x++)
+                {
+                    glm::ivec3 sample(x, y, z);
+                    float value = isosurface_test_field(isoGrid->position(sample));
+                    if (carve)
+                        value = std::max(value, (isoProbeRadius - glm::length(glm::vec3(sample - center))) * isoGrid->spacing);
+                    if (isoGrid == &isoSparseGrid)
+                        value = glm::clamp(value, -isoBand, isoBand);
+                    isoGrid->set(x, y, z, value);
+                }
+    };
+
+    // Point cloud from --points, read and sorted into its octree on a background
+    // thread. The points stream to the GPU coarse levels first.
+    PointCloud pointCloud;
+    PointCloudRenderer pointRenderer;
+    PointSelection pointSelections[RenderThread::MAX_FRAMES];
+    std::future<bool> pointCloudLoad;
+    bool pointCloudReady = false;
+    if (!pointsFile.empty())
+        pointCloudLoad = std::async(std::launch::async, [&] { return pointCloud.load(pointsFile, &jobSystem); });
+
+    // Headless runs are reproducible: every asset is resident before the first
+    // frame, time advances by a fixed step and the camera follows a scripted path
+    CameraPath cameraPath;
+    FrameTimings frameTimings;
+    unsigned int timerQuery = 0;
+    int frameIndex = -headless.warmup;
+    const float headlessStep = 1.0f / 60.0f;
+    if (headless.enabled)
+    {
+        if (headless.cameraPath.empty() || !cameraPath.load(headless.cameraPath))
+        {
+            if (!headless.cameraPath.empty())
+                std::cerr << "Failed to load camera path " << headless.cameraPath << ", orbiting instead" << std::endl;
+            cameraPath = CameraPath::orbit(glm::vec3(0.0f), 6.0f, 2.0f, headless.frames * headlessStep);
+        }
+
+        auto anyPending = [&] {
+            for (const auto& pending : pendingMeshes)
+                if (pending.second.pending()) return true;
+            return checkerDiffuse.pending() || checkerSpecular.pending();
+        };
+        while (anyPending())
+        {
+            assets.update(1000.0f, (size_t)1 << 30);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (pointCloudLoad.valid() && pointCloudLoad.get())
+        {
+            pointRenderer.upload(pointCloud, SIZE_MAX);
+            pointCloudReady = true;
+            pointRadius = pointCloud.leaf_spacing * 0.5f;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(headless.outputDir, ec);
+        glGenQueries(1, &timerQuery);
+        renderTarget.bind();
+        if (statsCsv.empty()) statsCsv = headless.outputDir + "/frame_stats.csv";
+    }
+
+    // Per-frame draw/state counters for soak runs
+    RenderStats& renderStats = RenderStats::instance();
+    if (!statsCsv.empty() && !renderStats.start_csv(statsCsv))
+        std::cerr << "Failed to open " << statsCsv << std::endl;
+
+    // Main loop. GL work is recorded into a command list that runs on this thread,
+    // or with --render-thread on a thread that owns the context while the next
+    // frame is being built. Headless runs always render inline.
+    ProfilerWindow profilerWindow;
+    RenderThread renderThread;
+    CommandList inlineCommands;
+    std::vector<DrawItem> drawLists[RenderThread::MAX_FRAMES];
+    DebugDrawList debugLists[RenderThread::MAX_FRAMES];
+    int64_t frameInputs[RenderThread::MAX_FRAMES] = {};     // First input each frame consumed, for the latency meter
+    FrameArena frameArena;                                  // Main thread temporaries, reset every frame
+    if (window && renderThreadFrames > 0)
+        StartRenderThread(renderThread, window, renderThreadFrames, frameInputs);
+    while (headless.enabled ? frameIndex < headless.frames : !glfwWindowShouldClose(window))
+    {
+        bool threaded = renderThread.running();
+        int frameSlot = threaded ? renderThread.acquire() : 0;
+        CommandList& commands = threaded ? renderThread.commands(frameSlot) : inlineCommands;
+        if (!threaded)
+        {
+            Profiler::instance().begin_frame();
+            renderStats.end_frame();    // Close the previous frame's counters
+            GLTrace::frame();
+        }
+        frameInputs[frameSlot] = latencyMeter.take_input();
+        frameArena.reset();
+        PROFILE_SCOPE("Frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        float currentFrame = headless.enabled ? std::max(frameIndex, 0) * headlessStep : (float)glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;  
+
+        // input: window controls once per frame, camera movement at the fixed update rate
+        if (window)
+        {
+            processInput(window);
+            PROFILE_SCOPE("Fixed Update");
+            fixedTimestep.step = 1.0 / updateHz;
+            int steps = fixedTimestep.advance(deltaTime);
+            for (int step = 0; step < steps; step++)
+            {
+                previousCameraPosition = camera.Position;
+                UpdateCamera(window, (float)fixedTimestep.step);
+            }
+        }
+
+        // Upload finished assets within the frame budget and hand them to their entities
+        float budgetMs = uploadBudgetMs;
+        size_t budgetBytes = (size_t)uploadBudgetKB * 1024;
+        commands.push([&assets, budgetMs, budgetBytes] { assets.update(budgetMs, budgetBytes); });
+        for (size_t i = 0; i < pendingMeshes.size();)
+        {
+            if (pendingMeshes[i].second.pending())
+            {
+                i++;
+                continue;
+            }
+            scene.meshes[scene.slot(pendingMeshes[i].first)] = pendingMeshes[i].second.get();
+            loadedMeshes.push_back(pendingMeshes[i].second);
+            pendingMeshes.erase(pendingMeshes.begin() + i);
+        }
+        if (!texturesAssigned && !checkerDiffuse.pending() && !checkerSpecular.pending())
+        {
+            Material& material = scene.material_table[sphereMaterial];
+            if (checkerDiffuse.ready()) material.diffuse_map = checkerDiffuse.get()->ID;
+            if (checkerSpecular.ready()) material.specular_map = checkerSpecular.get()->ID;
+            texturesAssigned = true;
+        }
+        if (pointCloudLoad.valid() && pointCloudLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            pointCloudReady = pointCloudLoad.get();
+            if (pointCloudReady)
+            {
+                pointRadius = pointCloud.leaf_spacing * 0.5f;
+                std::cout << "Loaded " << pointsFile << ": " << pointCloud.points.size() << " points, " << pointCloud.nodes.size()
+                          << " nodes (read " << pointCloud.load_ms << " ms, octree " << pointCloud.build_ms << " ms)" << std::endl;
+            }
+        }
+
+        // camera/view transformation
+        if (headless.enabled)
+        {
+            glm::vec3 target;
+            cameraPath.sample(currentFrame, camera.Position, target);
+        }
+        Camera renderCamera = camera;
+        if (window && interpolateUpdates)
+            renderCamera.Position = glm::mix(previousCameraPosition, camera.Position, fixedTimestep.alpha());
+        glm::mat4 view = headless.enabled ? cameraPath.view(currentFrame) : renderCamera.GetViewMatrix();
+
+        // Clear the screen and set up the directional light
+        glm::vec3 viewPos = renderCamera.Position;
+        glm::mat4 frameProjection = projection;
+        unsigned int viewportWidth = SCR_WIDTH, viewportHeight = SCR_HEIGHT;
+        bool timeGpu = headless.enabled;
+        // Shaded + wireframe is one pass through the geometry shader variant
+        bool wireOverlay = drawShaded && drawWireframe;
+        Shader* sceneShader = wireOverlay ? &wireLightingShader : &lightingShader;
+        float wireWidth = wireframeWidth;
+        Shader* skinnedSceneShader = gpuSkinning ? &skinnedShader : nullptr;
+        Shader* morphSceneShader = gpuMorph ? &morphShader : nullptr;
+        commands.push([=]() mutable {
+            if (timeGpu)
+                glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+            glViewport(0, 0, viewportWidth, viewportHeight);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            for (Shader* shader : {skinnedSceneShader, morphSceneShader, sceneShader})
+            {
+                if (!shader)
+                    continue;
+                shader->use();
+                shader->setMat4("projection", frameProjection);
+                shader->setMat4("view", view);
+                shader->setVec3("viewPos", viewPos.x, viewPos.y, viewPos.z);
+                shader->setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
+                shader->setVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
+                shader->setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
+                shader->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+            }
+            if (wireOverlay)
+                sceneShader->setFloat("wireframeWidth", wireWidth);
+        });
+
+        // Animate the tentacle: sample the clip, evaluate the skeleton, then skin on
+        // the job system into this frame's staging copy, which the GL thread copies
+        // into the stream, or hand the joints to the shader
+        if (cpuSkinning || gpuSkinning)
+        {
+            PROFILE_SCOPE("Skinning");
+            std::vector<glm::mat4>& skin = skinMatrices[frameSlot];
+            skin.resize(tentacle.skeleton.joint_count());
+            tentacle.clip.sample(currentFrame, tentaclePose);
+            tentacle.skeleton.skin_matrices(tentaclePose, skin.data());
+            if (cpuSkinning)
+            {
+                std::vector<float>& vertices = skinnedVertices[frameSlot];
+                vertices.resize(tentacle.mesh.positions.size() * tentacle.mesh.vertex_stride() / sizeof(float));
+                skin_vertices(tentacle.mesh, skin.data(), vertices.data(), &jobSystem);
+                commands.push([&vertices, &tentacleStream, &tentacle] {
+                    float* mapped = tentacleStream.map(tentacle.mesh);
+                    if (!mapped)
+                        return;
+                    std::memcpy(mapped, vertices.data(), vertices.size() * sizeof(float));
+                    tentacleStream.bind(tentacle.mesh);
+                });
+            }
+        }
+
+        // Weight the blob's bulge, dent and squash, then blend on the CPU into this
+        // frame's staging copy, which the GL thread copies into the stream
+        if (cpuMorph || gpuMorph)
+        {
+            PROFILE_SCOPE("Morph");
+            std::vector<float>& weights = morphWeights[frameSlot];
+            weights.assign(blobTargets.target_count(), 0.0f);
+            weights[0] = 0.5f + 0.5f * std::sin(currentFrame * 1.3f);
+            weights[1] = 0.5f + 0.5f * std::sin(currentFrame * 2.1f + 1.0f);
+            weights[2] = 0.4f * std::sin(currentFrame * 0.7f);
+            if (cpuMorph)
+            {
+                std::vector<float>& vertices = morphedVertices[frameSlot];
+                vertices.resize(blob.positions.size() * blob.vertex_stride() / sizeof(float));
+                blobTargets.apply(blob, weights.data(), vertices.data(), &jobSystem);
+                commands.push([&vertices, &blobStream, &blob] {
+                    float* mapped = blobStream.map(blob);
+                    if (!mapped)
+                        return;
+                    std::memcpy(mapped, vertices.data(), vertices.size() * sizeof(float));
+                    blobStream.bind(blob);
+                });
+            }
+        }
+
+        // Move the probe, then re-mesh what it or the iso value changed. The render
+        // thread draws from the mesh's arrays, so it has to be idle first.
+        if (isoGrid)
+        {
+            if (isoProbeStamped)
+                stampIsoProbe(isoProbeCenter, false);
+            isoProbeStamped = isoProbe;
+            if (isoProbe)
+            {
+                glm::vec3 center = glm::vec3(0.45f * std::cos(currentFrame), 0.0f, 0.45f * std::sin(currentFrame));
+                isoProbeCenter = glm::ivec3((center - isoGrid->origin) / isoGrid->spacing + 0.5f);
+                stampIsoProbe(isoProbeCenter, true);
+            }
+            bool changed = isoValue != meshedIsoValue;
+            for (size_t b = 0; b < isoGrid->block_count() && !changed; b++)
+                changed = isoGrid->changed(b);
+            if (changed)
+            {
+                PROFILE_SCOPE("Isosurface");
+                if (threaded)
+                    renderThread.wait_idle();
+                isoStats = isoMesher.update(*isoGrid, isoValue, isoMesh, &jobSystem);
+                meshedIsoValue = isoValue;
+                commands.push([&isoMesh] { isoMesh.update(); });
+            }
+        }
+
+        // Update world matrices of moved nodes and cull against the view frustum
+        {
+            PROFILE_SCOPE("Scene Update");
+            scene.update(jobSystem);
+        }
+        Frustum frustum = Frustum::from_matrix(projection * view);
+        size_t visibleCount;
+        {
+            PROFILE_SCOPE("Cull Scene");
+            visibleCount = cull_scene(scene, frustum, visibleEntities, &jobSystem);
+        }
+        // Draw list: meshlet culling happens here, the render side only draws
+        size_t meshletTriangles = 0, meshletVisibleTriangles = 0;
+        std::vector<DrawItem>& drawItems = drawLists[frameSlot];
+        size_t drawCount = 0;
+        {
+            PROFILE_SCOPE("Build Draw List");
+            for (size_t i = 0; i < scene.size(); i++)
+            {
+                RenderMesh* renderMesh = scene.meshes[i];
+                if (!renderMesh || !visibleEntities[i]) continue;
+
+                if (drawCount == drawItems.size())
+                    drawItems.emplace_back();
+                DrawItem& item = drawItems[drawCount++];
+                item.mesh = renderMesh;
+                item.model = scene.world[i];
+                item.material = scene.materials[i] >= 0 ? scene.material_table[scene.materials[i]] : Material();
+                item.ranges.clear();
+
+                // Drop off-screen and backfacing meshlets, draw the remaining index ranges
+                item.useRanges = drawShaded && meshletCulling && !renderMesh->meshlets.empty();
+                if (item.useRanges)
+                {
+                    cull_meshlets(*renderMesh, item.model, frustum, renderCamera.Position, item.ranges);
+                    meshletTriangles += item.ranges.triangles;
+                    meshletVisibleTriangles += item.ranges.visible_triangles;
+                }
+
+                if (!drawShaded)
+                    debugDraw.mesh_wireframe(renderMesh, item.model, drawWireframe ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f));
+                if (drawNormals)
+                    debugDraw.mesh_normals(renderMesh, item.model, normalLength, glm::vec3(1.0f, 0.0f, 0.0f));
+                if (drawBounds)
+                {
+                    const glm::mat4& m = item.model;
+                    float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+                    debugDraw.sphere(glm::vec3(m * glm::vec4(renderMesh->bounds_center, 1.0f)), renderMesh->bounds_radius * scale, glm::vec3(1.0f, 1.0f, 0.0f));
+                }
+            }
+        }
+        if (drawLightMarkers)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                debugDraw.box(pointLightPositions[i] - glm::vec3(0.1f), pointLightPositions[i] + glm::vec3(0.1f), glm::vec3(1.0f));
+                char label[32];
+                std::snprintf(label, sizeof(label), "Point Light %d", i);
+                debugDraw.text(pointLightPositions[i], label);
+            }
+            debugDraw.axes(glm::mat4(1.0f), 1.0f, false);
+        }
+
+        unsigned int whiteMap = whiteTexture.ID;
+        bool shaded = drawShaded;
+        commands.push([&drawItems, drawCount, sceneShader, whiteMap, shaded]() mutable {
+            if (!shaded)
+                return;
+            PROFILE_SCOPE("Draw Scene");
+            PROFILE_GPU_SCOPE("Scene");
+            for (size_t i = 0; i < drawCount; i++)
+            {
+                DrawItem& item = drawItems[i];
+                RenderMesh* renderMesh = item.mesh;
+                const Material& material = item.material;
+                sceneShader->setMat4("model", item.model);
+                sceneShader->setVec3("material.diffuse", material.diffuse);
+                sceneShader->setVec3("material.specular", material.specular);
+                sceneShader->setFloat("material.shininess", material.shininess);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, material.diffuse_map ? material.diffuse_map : whiteMap);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, material.specular_map ? material.specular_map : whiteMap);
+
+                if (item.useRanges)
+                    renderMesh->draw(item.ranges);
+                else
+                    renderMesh->draw();
+            }
+        });
+
+        if (gpuSkinning && shaded)
+        {
+            size_t tentacleSlot = scene.slot(tentacleEntity);
+            glm::mat4 tentacleModel = scene.world[tentacleSlot];
+            Material material = scene.material_table[scene.materials[tentacleSlot]];
+            commands.push([&skinnedShader, &tentacle, &skin = skinMatrices[frameSlot], tentacleModel, material, whiteMap]() mutable {
+                PROFILE_SCOPE("Draw Skinned");
+                PROFILE_GPU_SCOPE("Skinned");
+                skinnedShader.setMat4("model", tentacleModel);
+                skinnedShader.setMat4Array("joints", skin.data(), (int)skin.size());
+                skinnedShader.setVec3("material.diffuse", material.diffuse);
+                skinnedShader.setVec3("material.specular", material.specular);
+                skinnedShader.setFloat("material.shininess", material.shininess);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, whiteMap);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, whiteMap);
+                tentacle.mesh.draw();
+            });
+        }
+
+        if (cpuSkinning)
+            commands.push([&tentacleStream] { tentacleStream.end_frame(); });
+        if (cpuMorph)
+            commands.push([&blobStream] { blobStream.end_frame(); });
+        if (gpuMorph && shaded)
+        {
+            size_t blobSlot = scene.slot(blobEntity);
+            glm::mat4 blobModel = scene.world[blobSlot];
+            Material material = scene.material_table[scene.materials[blobSlot]];
+            commands.push([&morphShader, &blob, &blobTargets, &weights = morphWeights[frameSlot], blobModel, material, whiteMap]() mutable {
+                PROFILE_SCOPE("Draw Morphed");
+                PROFILE_GPU_SCOPE("Morphed");
+                morphShader.setMat4("model", blobModel);
+                morphShader.setVec3("material.diffuse", material.diffuse);
+                morphShader.setVec3("material.specular", material.specular);
+                morphShader.setFloat("material.shininess", material.shininess);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, whiteMap);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, whiteMap);
+                blobTargets.bind(morphShader, weights.data());
+                blob.draw();
+            });
+        }
+
+        // Point cloud: upload the next slice, then draw the nodes picked under the point budget
+        PointSelection& pointSelection = pointSelections[frameSlot];
+        if (pointCloudReady)
+        {
+            PROFILE_SCOPE("Select Points");
+            float projectionScale = viewportHeight * frameProjection[1][1] * 0.5f;
+            pointCloud.select(frustum, renderCamera.Position, projectionScale, pointRenderer.resident(), pointLod, pointSelection);
+            size_t pointUploadBytes = (size_t)pointUploadKB * 1024;
+            float radius = pointRadius;
+            commands.push([&pointRenderer, &pointCloud, &pointSelection, view, frameProjection, viewportHeight, pointUploadBytes, radius] {
+                PROFILE_SCOPE("Draw Points");
+                PROFILE_GPU_SCOPE("Points");
+                pointRenderer.upload(pointCloud, pointUploadBytes);
+                pointRenderer.draw(pointSelection, view, frameProjection, (float)viewportHeight, radius);
+            });
+        }
+
+        // Debug lines, wireframes and normals recorded this frame
+        DebugDrawList& debugList = debugLists[frameSlot];
+        debugDraw.take(debugList);
+        commands.push([&debugRenderer, &debugList, view, frameProjection] {
+            PROFILE_SCOPE("Debug Draw");
+            PROFILE_GPU_SCOPE("Debug");
+            debugRenderer.draw(debugList, view, frameProjection);
+        });
+
+        // Headless: time the frame, save requested images, no UI
+        if (headless.enabled)
+        {
+            {
+                PROFILE_GPU_SCOPE("Frame");
+                commands.execute();
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            glFinish();
+            double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            GLuint64 gpuNs = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &gpuNs);
+            if (frameIndex >= 0)
+                frameTimings.add(cpuMs, frameMs, gpuNs / 1.0e6);
+
+            bool finalFrame = frameIndex == headless.frames - 1;
+            bool capture = finalFrame || (headless.captureEvery > 0 && frameIndex >= 0 && frameIndex % headless.captureEvery == 0);
+            if (capture)
+            {
+                std::vector<unsigned char> pixels;
+                renderTarget.read_pixels(pixels);
+                char name[32];
+                std::snprintf(name, sizeof(name), "/frame_%05d.png", frameIndex);
+                if (!write_png(headless.outputDir + name, renderTarget.width, renderTarget.height, pixels))
+                    std::cerr << "Failed to write " << headless.outputDir + name << std::endl;
+            }
+            frameIndex++;
+            continue;
+        }
+
+        // Start ImGui frame
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+        ImGuizmo::BeginFrame();
+
+        // Create dockspace
+        ImGuiViewport* viewport = ImGui::GetMainViewport();
+        ImGui::SetNextWindowPos(viewport->WorkPos);
+        ImGui::SetNextWindowSize(viewport->WorkSize);
+        ImGui::SetNextWindowViewport(viewport->ID);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
+        ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoTitleBar | 
+                                         ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | 
+                                         ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoBringToFrontOnFocus | 
+                                         ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoBackground;
+        
+        ImGui::Begin("DockSpace", nullptr, window_flags);
+        ImGui::PopStyleVar(3);
+        
+        ImGuiID dockspace_id = ImGui::GetID("MyDockSpace");
+        ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), ImGuiDockNodeFlags_PassthruCentralNode);
+        ImGui::End();
+
+        // Create ImGui window
+        ImGui::Begin("Settings");
+        ImGui::Checkbox("Draw Shaded", &drawShaded);
+        ImGui::Checkbox("Draw Normals", &drawNormals);
+        ImGui::Checkbox("Draw Wireframe", &drawWireframe);
+        if (drawNormals)
+            ImGui::SliderFloat("Normal Length", &normalLength, 0.01f, 2.0f);
+        if (drawWireframe && drawShaded)
+            ImGui::SliderFloat("Wireframe Width", &wireframeWidth, 0.5f, 4.0f);
+        ImGui::Checkbox("Draw Bounds", &drawBounds);
+        ImGui::Checkbox("Draw Light Markers", &drawLightMarkers);
+        ImGui::Text("Visible: %d / %d entities", (int)visibleCount, (int)scene.size());
+        ImGui::Text("Worker threads: %u", jobSystem.thread_count());
+        ImGui::Checkbox("Meshlet Culling", &meshletCulling);
+        if (meshletCulling && meshletTriangles > 0)
+            ImGui::Text("Meshlets culled %.1f%% of %d triangles", 100.0f * (1.0f - (float)meshletVisibleTriangles / meshletTriangles), (int)meshletTriangles);
+
+        const AssetStats& assetStats = assets.stats();
+        ImGui::Text("Assets loading: %d, uploading: %d", (int)assetStats.loading, (int)assetStats.uploading);
+        ImGui::Text("Upload: %.2f MB/frame (%.2f ms)", assetStats.frame_bytes / (1024.0f * 1024.0f), assetStats.frame_ms);
+        ImGui::SliderFloat("Upload Budget (ms)", &uploadBudgetMs, 0.1f, 16.0f);
+        ImGui::SliderInt("Upload Budget (KB)", &uploadBudgetKB, 64, 65536);
+        ImGui::Checkbox("Profiler", &profilerWindow.open);
+
+        if (pointCloudReady && ImGui::CollapsingHeader("Point Cloud", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            size_t resident = pointRenderer.resident();
+            ImGui::Text("%zu points, %zu nodes, %.1f%% on the GPU", pointCloud.points.size(), pointCloud.nodes.size(),
+                        100.0f * resident / std::max<size_t>(pointCloud.points.size(), 1));
+            ImGui::Text("Drawn: %zu points in %zu nodes, %zu draws%s", pointSelection.points, pointSelection.nodes,
+                        pointSelection.firsts.size(), pointSelection.budget_limited ? " (budget)" : "");
+            int budget = (int)std::min<size_t>(pointLod.budget, 50000000);
+            if (ImGui::SliderInt("Point Budget", &budget, 100000, 50000000, "%d", ImGuiSliderFlags_Logarithmic))
+                pointLod.budget = (size_t)budget;
+            ImGui::SliderFloat("Max Error (px)", &pointLod.max_error, 0.5f, 16.0f);
+            ImGui::SliderFloat("Point Radius", &pointRadius, pointCloud.leaf_spacing * 0.05f, pointCloud.leaf_spacing * 10.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
+            if (resident < pointCloud.points.size())
+                ImGui::SliderInt("Point Upload (KB)", &pointUploadKB, 256, 262144);
+        }
+
+        if (isoGrid && ImGui::CollapsingHeader("Isosurface", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Text("%s grid %dx%dx%d, %.2f MB", isoGrid == &isoDenseGrid ? "Dense" : "Sparse", isoGrid->size().x, isoGrid->size().y,
+                        isoGrid->size().z, isoGrid->bytes() / (1024.0f * 1024.0f));
+            ImGui::Text("%zu triangles, last update %zu of %zu blocks (%.2f ms)", isoStats.triangles, isoStats.blocks_meshed + isoStats.blocks_cleared,
+                        isoGrid->block_count(), isoStats.ms);
+            ImGui::SliderFloat("Iso Value", &isoValue, -isoBand * 0.9f, isoBand * 0.9f);
+            ImGui::Checkbox("Probe", &isoProbe);
+        }
+
+        if (ImGui::CollapsingHeader("Frame Pacing"))
+        {
+            const char* pacingModes[] = {"VSync", "Capped", "Uncapped"};
+            int pacingMode = (int)framePacer.mode;
+            if (ImGui::Combo("Pacing", &pacingMode, pacingModes, 3))
+            {
+                framePacer.mode = (PacingMode)pacingMode;
+                // The swap interval belongs to the context, which the render thread holds
+                int swapInterval = framePacer.swap_interval();
+                if (threaded)
+                    commands.push([swapInterval] { glfwSwapInterval(swapInterval); });
+                else
+                    glfwSwapInterval(swapInterval);
+            }
+            if (framePacer.mode == PacingMode::Capped)
+            {
+                ImGui::SliderFloat("Target FPS", &framePacer.target_fps, 10.0f, 480.0f, "%.0f");
+                ImGui::SliderFloat("Spin (ms)", &framePacer.spin_ms, 0.0f, 4.0f);
+            }
+            ImGui::SliderInt("Update Rate (Hz)", &updateHz, 10, 240);
+            ImGui::Checkbox("Interpolate", &interpolateUpdates);
+            ImGui::Checkbox("Measure Latency", &latencyMeter.enabled);
+            if (latencyMeter.enabled)
+            {
+                ImGui::Text("Input to present: %.2f ms last, %.2f ms avg, %.2f ms p99", latencyMeter.last_ms(), latencyMeter.avg_ms(), latencyMeter.p99_ms());
+                float* latencies = frameArena.allocate_array<float>(LatencyMeter::HISTORY);
+                size_t latencyCount = latencyMeter.history(latencies);
+                if (latencyCount > 0)
+                    ImGui::PlotLines("##Latency", latencies, (int)latencyCount, 0, nullptr, 0.0f, latencyMeter.p99_ms() * 1.5f, ImVec2(0.0f, 40.0f));
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Frame Stats", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            // Copied under the lock, end_frame() runs on the render thread when there is one
+            std::unique_lock<std::mutex> statsLock(renderStats.mutex);
+            FrameStats stats = renderStats.last;
+            const std::vector<float>& history = renderStats.frame_times();
+            ArenaVector<float> frameTimes(history.begin(), history.end(), ArenaAllocator<float>(frameArena));
+            float minMs = renderStats.min_ms(), avgMs = renderStats.avg_ms(), p99Ms = renderStats.p99_ms();
+            statsLock.unlock();
+
+            ImGui::Text("Frame: %.2f ms min, %.2f ms avg, %.2f ms p99", minMs, avgMs, p99Ms);
+            if (!frameTimes.empty())
+                ImGui::PlotLines("##FrameTimes", frameTimes.data(), (int)frameTimes.size(), 0, nullptr, 0.0f, p99Ms * 1.5f, ImVec2(0.0f, 60.0f));
+            if (threaded)
+                ImGui::Text("Render thread (%d lists): execute %.2f ms, idle %.2f ms, main waited %.2f ms", renderThread.frames_in_flight(),
+                            renderThread.execute_ms.load(), renderThread.idle_ms.load(), renderThread.wait_ms);
+            ImGui::Text("Draw calls: %u", stats.draw_calls);
+            ImGui::Text("Triangles: %llu, lines: %llu, points: %llu", (unsigned long long)stats.triangles, (unsigned long long)stats.lines,
+                        (unsigned long long)stats.points);
+            ImGui::Text("Program binds: %u, VAO binds: %u", stats.program_binds, stats.vao_binds);
+            ImGui::Text("Uniform uploads: %u", stats.uniform_uploads);
+            ImGui::Text("Buffer uploads: %.1f KB", stats.buffer_bytes / 1024.0f);
+            ImGui::Text("Index fetch: %.1f KB", stats.index_bytes / 1024.0f);
+            ImGui::Text("Heap allocations: %llu (%.1f KB), frame arena peak %.1f KB", (unsigned long long)stats.allocations,
+                        stats.allocated_bytes / 1024.0f, frameArena.peak() / 1024.0f);
+            ImGui::Text("Streaming: %s", persistentStreaming && StreamBuffer::allow_persistent ? "persistent mapped" : "orphaning");
+            if (renderStats.logging())
+            {
+                if (ImGui::Button("Stop CSV Log"))
+                    renderStats.stop_csv();
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", renderStats.csv_path().c_str());
+            }
+            else if (ImGui::Button("Start CSV Log"))
+            {
+                renderStats.start_csv(statsCsv.empty() ? "frame_stats.csv" : statsCsv);
+            }
+        }
+        
+        if (ImGui::Checkbox("Capture Cursor (Fly Cam)", &enableFlyCam))
+        {
+            if (enableFlyCam)
+            {
+                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            }
+            else
+            {
+                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+            }
+        }
+
+        ImGui::End();
+
+        // Scene hierarchy and gizmo for the selected entity
+        ImGui::Begin("Scene");
+        for (size_t i = 0; i < scene.size(); i++)
+        {
+            ImGui::PushID((int)scene.entities[i]);
+            char label[128];
+            std::snprintf(label, sizeof(label), "%*s%s", scene.depths[i] * 2, "", scene.names[i].c_str());
+            if (ImGui::Selectable(label, scene.entities[i] == selectedEntity))
+                selectedEntity = scene.entities[i];
+            ImGui::PopID();
+        }
+        ImGui::Separator();
+        if (ImGui::RadioButton("Translate", mCurrentGizmoOperation == ImGuizmo::TRANSLATE))
+            mCurrentGizmoOperation = ImGuizmo::TRANSLATE;
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Rotate", mCurrentGizmoOperation == ImGuizmo::ROTATE))
+            mCurrentGizmoOperation = ImGuizmo::ROTATE;
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Scale", mCurrentGizmoOperation == ImGuizmo::SCALE))
+            mCurrentGizmoOperation = ImGuizmo::SCALE;
+
+        if (selectedEntity != NULL_ENTITY)
+        {
+            glm::mat4 world = scene.world_matrix(selectedEntity);
+            if (EditTransform(glm::value_ptr(view), glm::value_ptr(projection), glm::value_ptr(world)))
+                scene.set_world_matrix(selectedEntity, world);
+        }
+
+        // Render ImGui
+        ImGui::End();
+        profilerWindow.draw();
+        DebugDraw::draw_text(debugList, ImGui::GetForegroundDrawList(), projection * view, ImGui::GetIO().DisplaySize);
+        ImGui::Render();
+        if (threaded)
+        {
+            commands.push([drawData = CopyDrawData(ImGui::GetDrawData())] {
+                PROFILE_SCOPE("ImGui Render");
+                PROFILE_GPU_SCOPE("ImGui");
+                ImGui_ImplOpenGL3_RenderDrawData(drawData.get());
+            });
+        }
+        else
+        {
+            commands.push([] {
+                PROFILE_SCOPE("ImGui Render");
+                PROFILE_GPU_SCOPE("ImGui");
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            });
+            PROFILE_GPU_SCOPE("Frame");
+            commands.execute();
+        }
+
+        // Update and Render additional Platform Windows
+        if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+        {
+            GLFWwindow* backup_current_context = glfwGetCurrentContext();
+            ImGui::UpdatePlatformWindows();
+            ImGui::RenderPlatformWindowsDefault();
+            glfwMakeContextCurrent(backup_current_context);
+        }
+
+        // Swap buffers (the render thread presents its own frames), wait out the
+        // frame when capped, then poll so input is as fresh as possible
+        if (threaded)
+        {
+            renderThread.submit();
+        }
+        else
+        {
+            PROFILE_SCOPE("Swap");
+            glfwSwapBuffers(window);
+            if (frameInputs[frameSlot])
+            {
+                glFinish();     // The swap has been processed once this returns
+                latencyMeter.presented(frameInputs[frameSlot]);
+            }
+        }
+        framePacer.wait();
+        glfwPollEvents();
+    }
+
+    // Cleanup
+    if (renderThread.running())
+    {
+        renderThread.stop();
+        glfwMakeContextCurrent(window);
+    }
+
+    // Locals that own GL objects outlive the context, release them while it is current
+    for (const MeshHandle& mesh : loadedMeshes)
+        mesh.asset->value.release();
+    for (const auto& pending : pendingMeshes)
+        pending.second.asset->value.release();
+    tentacleStream.destroy();
+    tentacle.mesh.release();
+    blobStream.destroy();
+    blobTargets.release();
+    blob.release();
+    isoMesh.release();
+    pointRenderer.release();
+    debugRenderer.release();
+    assets.release();
+    renderStats.end_frame();
+    renderStats.stop_csv();
+    GLTrace::stop();
+    if (headless.enabled)
+    {
+        if (!frameTimings.write(headless.outputDir))
+            std::cerr << "Failed to write timings to " << headless.outputDir << std::endl;
+        if (!Profiler::instance().export_chrome_trace(headless.outputDir + "/trace.json"))
+            std::cerr << "Failed to write " << headless.outputDir << "/trace.json" << std::endl;
+        std::cout << "Rendered " << headless.frames << " frames, p50 " << percentile(frameTimings.frame_ms, 50.0)
+                  << " ms, p99 " << percentile(frameTimings.frame_ms, 99.0) << " ms, results in " << headless.outputDir << std::endl;
+        glDeleteQueries(1, &timerQuery);
+        renderTarget.destroy();
+        headlessContext.destroy();
+        return 0;
+    }
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
+
+GLFWwindow* CreateAppWindow()
 {
     // Initialize GLFW
     if (!glfwInit())
     {
         std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
+        return nullptr;
     }
 
     // Set window hints *before* creating the window
@@ -122,30 +1293,29 @@ int main()
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For Mac compatibility
 #endif
 
-    GLFWwindow *window = glfwCreateWindow(1280, 720, "OpenGL Starter", nullptr, nullptr);
+    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Starter", nullptr, nullptr);
     if (!window)
     {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
-        return -1;
+        return nullptr;
     }
 
     // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwMakeContextCurrent(window);
     
     // Hide the cursor and capture it
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        return -1;
-    }
+    return window;
+}
 
-    // Initialize ImGui
+void SetupImGui(GLFWwindow* window)
+{
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO &io = ImGui::GetIO();
@@ -251,215 +1421,6 @@ int main()
     
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
-
-    // Configure OpenGL
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    
-    // Get actual framebuffer size for proper viewport setup
-    int framebufferWidth, framebufferHeight;
-    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
-    glViewport(0, 0, framebufferWidth, framebufferHeight);
-    glEnable(GL_DEPTH_TEST);
-
-
-       // positions of the point lights
-    glm::vec3 pointLightPositions[] = {
-        glm::vec3( 0.7f,  0.2f,  2.0f),
-        glm::vec3( 2.3f, -3.3f, -4.0f),
-        glm::vec3(-4.0f,  2.0f, -12.0f),
-        glm::vec3( 0.0f,  0.0f, -3.0f)
-    };
-
-    // Load Shaders
-    Shader lightingShader("multiple_lights");
-    Shader debugShader("debug");
-
-    debugShader.use();
-    debugShader.setMat4("projection", projection);
-    debugShader.setMat4("view", view);
-    debugShader.setMat4("model", model);
-    debugShader.setVec3("lineColor", glm::vec3(1.0f, 0.0f, 0.0f));
-
-    lightingShader.use();
-    lightingShader.setMat4("model", model);
-    lightingShader.setMat4("view", view);
-    lightingShader.setMat4("projection", projection);
-
-    // dir light
-    lightingShader.setVec3("dirLight.ambient", 1.0f, 0.0f, 0.0f);
-    lightingShader.setVec3("diffuse", 0.5f, 0.5f, 0.5f);
-    lightingShader.setVec3("specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("shininess", 32.0f);
-
-    lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-    lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[0].constant", 1.0f);
-    lightingShader.setFloat("pointLights[0].linear", 0.09f);
-    lightingShader.setFloat("pointLights[0].quadratic", 0.032f);
-    // point light 2
-    lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-    lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[1].constant", 1.0f);
-    lightingShader.setFloat("pointLights[1].linear", 0.09f);
-    lightingShader.setFloat("pointLights[1].quadratic", 0.032f);
-    // point light 3
-    lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-    lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[2].constant", 1.0f);
-    lightingShader.setFloat("pointLights[2].linear", 0.09f);
-    lightingShader.setFloat("pointLights[2].quadratic", 0.032f);
-    // point light 4
-    lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-    lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader.setFloat("pointLights[3].constant", 1.0f);
-    lightingShader.setFloat("pointLights[3].linear", 0.09f);
-    lightingShader.setFloat("pointLights[3].quadratic", 0.032f);
-
-    // Load Mesh
-    RenderMesh mesh = RenderMesh::uvsphere(5, 6);
-    RenderMesh cylinder = RenderMesh::cylinder(10);
-    
-    cylinder.upload();
-    mesh.upload();
-
-    // Main loop
-    while (!glfwWindowShouldClose(window))
-    {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;  
-
-        // input
-        processInput(window);
-
-        // camera/view transformation
-        glm::mat4 view = camera.GetViewMatrix();
-
-        // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // directional light
-        lightingShader.use();
-        lightingShader.setMat4("view", view);
-        lightingShader.setVec3("viewPos", camera.Position.x, camera.Position.y, camera.Position.z);
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
-        lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        lightingShader.setVec3("material.ambient", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("material.diffuse", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-        lightingShader.setFloat("material.shininess", 128.0f);
-
-        // Render Mesh - shaded or wireframe
-        if (drawShaded)
-        {
-            mesh.draw();
-            // cylinder.draw();
-        }
-        else
-        {
-            debugShader.use();
-            debugShader.setMat4("view", view);
-            debugShader.setVec3("lineColor", glm::vec3(1.0f, 1.0f, 1.0f));
-            mesh.draw_wireframe(1.0f);
-            // cylinder.draw_wireframe(1.0f);
-        }
-
-        // Render Normal Visualization
-        if(drawNormals)
-        {
-            debugShader.use();
-            debugShader.setMat4("view", view);
-            debugShader.setVec3("lineColor", glm::vec3(1.0f, 0.0f, 0.0f));
-            mesh.draw_normals(1.0f, 0.5f);
-            // cylinder.draw_normals(1.0f, 0.5f);
-        }
-
-        // Render Wireframe
-        if (drawWireframe)
-        {
-            debugShader.use();
-            debugShader.setMat4("view", view);
-            debugShader.setVec3("lineColor", glm::vec3(0.0f, 1.0f, 0.0f));
-            mesh.draw_wireframe(1.0f);
-            // cylinder.draw_wireframe(1.0f);
-        }
-
-        // Start ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // Create dockspace
-        ImGuiViewport* viewport = ImGui::GetMainViewport();
-        ImGui::SetNextWindowPos(viewport->WorkPos);
-        ImGui::SetNextWindowSize(viewport->WorkSize);
-        ImGui::SetNextWindowViewport(viewport->ID);
-        ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
-        ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
-        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
-        ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoTitleBar | 
-                                         ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | 
-                                         ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoBringToFrontOnFocus | 
-                                         ImGuiWindowFlags_NoNavFocus | ImGuiWindowFlags_NoBackground;
-        
-        ImGui::Begin("DockSpace", nullptr, window_flags);
-        ImGui::PopStyleVar(3);
-        
-        ImGuiID dockspace_id = ImGui::GetID("MyDockSpace");
-        ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), ImGuiDockNodeFlags_PassthruCentralNode);
-        ImGui::End();
-
-        // Create ImGui window
-        ImGui::Begin("Settings");
-        ImGui::Checkbox("Draw Shaded", &drawShaded);
-        ImGui::Checkbox("Draw Normals", &drawNormals);
-        ImGui::Checkbox("Draw Wireframe", &drawWireframe);
-        
-        if (ImGui::Checkbox("Capture Cursor (Fly Cam)", &enableFlyCam))
-        {
-            if (enableFlyCam)
-            {
-                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-            }
-            else
-            {
-                glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-            }
-        }
-
-        // Render ImGui
-        ImGui::End();
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        // Update and Render additional Platform Windows
-        if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
-        {
-            GLFWwindow* backup_current_context = glfwGetCurrentContext();
-            ImGui::UpdatePlatformWindows();
-            ImGui::RenderPlatformWindowsDefault();
-            glfwMakeContextCurrent(backup_current_context);
-        }
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    // Cleanup
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    return 0;
 }
 
 void processInput(GLFWwindow *window)
@@ -484,26 +1445,31 @@ void processInput(GLFWwindow *window)
     }
     if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+}
+
+// Fly camera movement, called once per fixed update step
+void UpdateCamera(GLFWwindow *window, float step)
+{
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        camera.ProcessKeyboard(FORWARD, step);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        camera.ProcessKeyboard(BACKWARD, step);
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        camera.ProcessKeyboard(LEFT, step);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        camera.ProcessKeyboard(RIGHT, step);
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        camera.ProcessKeyboard(UP, deltaTime);
+        camera.ProcessKeyboard(UP, step);
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        camera.ProcessKeyboard(DOWN, deltaTime);
+        camera.ProcessKeyboard(DOWN, step);
 }
 
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
+    // The viewport is set when the next frame is recorded, the GL context may be on the render thread
     SCR_WIDTH = width;
     SCR_HEIGHT = height;
-    glViewport(0, 0, width, height);
     
     // Update projection matrix with new aspect ratio
     projection = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 100.0f);
@@ -597,6 +1563,7 @@ unsigned int LoadShader(std::string vertexPath, std::string fragmentPath)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+    latencyMeter.input();
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
 
@@ -615,4 +1582,57 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 
     if (enableFlyCam)
         camera.ProcessMouseMovement(xoffset, yoffset);
-}
\ No newline at end of file
+}
+
+// glfw: key and mouse button events only timestamp input for the latency meter,
+// ImGui chains to these and the camera polls key state
+// -------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_RELEASE)
+        latencyMeter.input();
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (action == GLFW_PRESS)
+        latencyMeter.input();
+}
+
+DrawDataCopy CopyDrawData(const ImDrawData* drawData)
+{
+    DrawDataCopy copy(IM_NEW(ImDrawData)(*drawData));
+    for (ImDrawList*& drawList : copy->CmdLists)
+        drawList = drawList->CloneOutput();
+    return copy;
+}
+
+// Hands the window's GL context to a render thread that executes and presents recorded frames
+void StartRenderThread(RenderThread& renderThread, GLFWwindow* window, int frames, const int64_t* frameInputs)
+{
+    // Platform windows render on the main thread and would need the context there
+    ImGui::GetIO().ConfigFlags &= ~ImGuiConfigFlags_ViewportsEnable;
+    // ImGui_ImplOpenGL3_NewFrame() creates these on first use, which needs the context
+    ImGui_ImplOpenGL3_CreateDeviceObjects();
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+
+    RenderThread::Callbacks callbacks;
+    callbacks.attach = [window] { glfwMakeContextCurrent(window); };
+    callbacks.begin_frame = [] {
+        Profiler::instance().begin_frame();
+        RenderStats::instance().end_frame();
+        GLTrace::frame();
+    };
+    callbacks.present = [window, frameInputs](int slot) {
+        PROFILE_SCOPE("Swap");
+        glfwSwapBuffers(window);
+        if (frameInputs[slot])
+        {
+            glFinish();
+            latencyMeter.presented(frameInputs[slot]);
+        }
+    };
+    callbacks.detach = [] { glfwMakeContextCurrent(nullptr); };
+    renderThread.start(frames, callbacks);
+}
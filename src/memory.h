@@ -0,0 +1,312 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+// Heap allocations through the global operator new, counted process-wide and
+// per thread. Allocations with extended alignment and ImGui's own malloc
+// calls are not counted.
+struct AllocationCounters {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    AllocationCounters operator-(const AllocationCounters& other) const { return {count - other.count, bytes - other.bytes}; }
+};
+
+AllocationCounters allocation_counters();           // Every thread since startup
+AllocationCounters thread_allocation_counters();    // Calling thread since it started
+
+// Linear allocator for short-lived data: per-frame temporaries and scratch
+// buffers of mesh processing. allocate() bumps a pointer, nothing is freed
+// individually. rewind() returns to a mark(), reset() to the start. Blocks are
+// kept, so once the arena has grown to a frame's peak it stops allocating.
+// One thread at a time.
+class FrameArena {
+public:
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    explicit FrameArena(size_t block_size = 64 * 1024) : block_size(block_size) {}
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    ~FrameArena() { release(); }
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // Uninitialized storage, for trivially destructible types only
+    template <typename T>
+    T* allocate_array(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+    Marker mark() const { return {current, offset}; }
+    void rewind(const Marker& marker);
+    // Back to empty. A frame that spilled into several blocks leaves one block of their combined size.
+    void reset();
+    void release();
+
+    size_t used() const { return used_bytes; }
+    size_t peak() const { return peak_bytes; }
+    size_t capacity() const;
+    uint64_t block_allocations() const { return blocks_allocated; }
+
+    // Scratch arena of the calling thread, rewound by ArenaScope
+    static FrameArena& thread_scratch();
+
+private:
+    struct Block {
+        unsigned char* data;
+        size_t size;
+        size_t used_before;             // Bytes in the blocks before this one, for used()
+    };
+
+    size_t block_size;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t used_bytes = 0;
+    size_t peak_bytes = 0;
+    uint64_t blocks_allocated = 0;
+
+    void add_block(size_t size);
+};
+
+// Rewinds an arena to where it was when the scope started
+class ArenaScope {
+public:
+    explicit ArenaScope(FrameArena& arena) : arena(arena), marker(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    FrameArena& arena;
+    FrameArena::Marker marker;
+};
+
+// Standard allocator on a FrameArena. deallocate() is a no-op: growing a
+// container leaves its old storage in the arena until the next rewind/reset,
+// so reserve() up front where the size is known.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    FrameArena* arena;
+
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocate_array<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Fixed-size blocks from a free list, carved out of larger chunks. For objects
+// that are created and destroyed all the time with a bounded live count
+// (draw data lists, per-request state); freed blocks are reused, chunks are
+// only returned when the pool is destroyed. One thread at a time.
+class BlockPool {
+public:
+    explicit BlockPool(size_t block_size, size_t blocks_per_chunk = 64);
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+    ~BlockPool();
+
+    void* allocate();
+    void free(void* block);
+
+    size_t block_size() const { return size; }
+    size_t live() const { return live_blocks; }
+    uint64_t chunk_allocations() const { return chunks.size(); }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    size_t size;
+    size_t per_chunk;
+    std::vector<unsigned char*> chunks;
+    FreeBlock* free_list = nullptr;
+    size_t live_blocks = 0;
+};
+
+// Standard allocator drawing single objects from a BlockPool, e.g. for the
+// nodes of a std::list or std::map. Array requests go to the heap.
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+    BlockPool* pool;
+
+    explicit PoolAllocator(BlockPool& pool) : pool(&pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t count) {
+        if (count == 1 && sizeof(T) <= pool->block_size() && alignof(T) <= alignof(std::max_align_t)) return static_cast<T*>(pool->allocate());
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+    void deallocate(T* ptr, size_t count) {
+        if (count == 1 && sizeof(T) <= pool->block_size() && alignof(T) <= alignof(std::max_align_t)) pool->free(ptr);
+        else ::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+};
+
+// Counters behind the replaced operator new
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocation_bytes{0};
+thread_local AllocationCounters thread_allocations;
+
+AllocationCounters allocation_counters() {
+    return {allocation_count.load(std::memory_order_relaxed), allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+AllocationCounters thread_allocation_counters() {
+    return thread_allocations;
+}
+
+void* counted_allocate(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    thread_allocations.count++;
+    thread_allocations.bytes += size;
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size) { return counted_allocate(size); }
+void* operator new[](size_t size) { return counted_allocate(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+void FrameArena::add_block(size_t size) {
+    Block block;
+    block.data = static_cast<unsigned char*>(::operator new(size));
+    block.size = size;
+    block.used_before = 0;
+    blocks.push_back(block);
+    blocks_allocated++;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    if (size == 0) size = 1;
+    while (true) {
+        if (current < blocks.size()) {
+            Block& block = blocks[current];
+            uintptr_t base = (uintptr_t)block.data;
+            size_t aligned = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if (aligned + size <= block.size) {
+                offset = aligned + size;
+                used_bytes = block.used_before + offset;
+                peak_bytes = std::max(peak_bytes, used_bytes);
+                return block.data + aligned;
+            }
+        }
+
+        // Next kept block if it fits, otherwise a new one in its place
+        size_t used_before = current < blocks.size() ? blocks[current].used_before + offset : 0;
+        size_t next = current < blocks.size() ? current + 1 : 0;
+        if (next >= blocks.size() || blocks[next].size < size + alignment) {
+            size_t grow = std::max(block_size, size + alignment);
+            if (!blocks.empty()) grow = std::max(grow, blocks.back().size * 2);
+            if (next < blocks.size()) {
+                ::operator delete(blocks[next].data);
+                blocks[next].data = static_cast<unsigned char*>(::operator new(grow));
+                blocks[next].size = grow;
+                blocks_allocated++;
+            } else {
+                add_block(grow);
+            }
+        }
+        current = next;
+        offset = 0;
+        blocks[current].used_before = used_before;
+    }
+}
+
+void FrameArena::rewind(const Marker& marker) {
+    current = marker.block;
+    offset = marker.offset;
+    used_bytes = current < blocks.size() ? blocks[current].used_before + offset : 0;
+}
+
+void FrameArena::reset() {
+    if (blocks.size() > 1) {
+        size_t total = capacity();
+        release();
+        add_block(total);
+    }
+    current = 0;
+    offset = 0;
+    used_bytes = 0;
+}
+
+void FrameArena::release() {
+    for (Block& block : blocks) ::operator delete(block.data);
+    blocks.clear();
+    current = 0;
+    offset = 0;
+    used_bytes = 0;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const Block& block : blocks) total += block.size;
+    return total;
+}
+
+FrameArena& FrameArena::thread_scratch() {
+    thread_local FrameArena scratch(256 * 1024);
+    return scratch;
+}
+
+BlockPool::BlockPool(size_t block_size, size_t blocks_per_chunk)
+    : size((std::max(block_size, sizeof(FreeBlock)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+      per_chunk(std::max<size_t>(blocks_per_chunk, 1)) {}
+
+BlockPool::~BlockPool() {
+    for (unsigned char* chunk : chunks) ::operator delete(chunk);
+}
+
+void* BlockPool::allocate() {
+    if (!free_list) {
+        unsigned char* chunk = static_cast<unsigned char*>(::operator new(size * per_chunk));
+        chunks.push_back(chunk);
+        for (size_t i = per_chunk; i-- > 0;) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * size);
+            block->next = free_list;
+            free_list = block;
+        }
+    }
+    FreeBlock* block = free_list;
+    free_list = block->next;
+    live_blocks++;
+    return block;
+}
+
+void BlockPool::free(void* ptr) {
+    if (!ptr) return;
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_list;
+    free_list = block;
+    live_blocks--;
+}
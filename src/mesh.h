@@ -2,6 +2,17 @@
 
 #include <vector>
 #include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <functional>
+#include <chrono>
 
 #include <glad/glad.h>
 
@@ -9,12 +20,104 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "jobs.h"
+#include "render_stats.h"
+#include "memory.h"
+
+// Index buffers use the narrowest type that addresses every vertex: 8 bits up
+// to 256 vertices, 16 up to 65536, 32 beyond. Build with -DMESH_NARROW_INDICES=0
+// to always use 32 bits.
+#ifndef MESH_NARROW_INDICES
+#define MESH_NARROW_INDICES 1
+#endif
+
 // Forward declaration
 struct ProcMesh;
 
-struct DebugMeshLines {
-    unsigned int VAO, VBO;
-    unsigned int line_count;
+// Cluster of up to 64 vertices / 124 triangles. Its triangles are contiguous in
+// the index buffer starting at index_offset.
+struct Meshlet {
+    unsigned int index_offset;
+    unsigned int triangle_count;
+    unsigned int vertex_count;
+    glm::vec3 center;                   // Bounding sphere, model space
+    float radius;
+    glm::vec3 cone_axis;                // Average facing direction of the triangles
+    float cone_cutoff;                  // Sine of the cone half-angle, 1 if the cone is too wide to cull
+};
+
+// Index ranges to draw this frame, one per run of consecutive visible meshlets
+struct MeshletDrawList {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    size_t triangles = 0;               // Triangles of all tested meshlets
+    size_t visible_triangles = 0;
+
+    void clear() {
+        counts.clear();
+        offsets.clear();
+        triangles = visible_triangles = 0;
+    }
+};
+
+// Up to four joints per vertex for skinning, weights in 1/255 summing to 255
+// and sorted largest first. See skinning.h.
+struct SkinInfluence {
+    uint8_t joints[4];
+    uint8_t weights[4];
+};
+
+// Result of RenderMesh::weld()
+struct WeldStats {
+    size_t vertices_before = 0;
+    size_t vertices_after = 0;
+    size_t triangles_before = 0;
+    size_t triangles_after = 0;         // Without the triangles that collapsed
+    double ms = 0.0;
+};
+
+// Element ranges edited since the last upload, sorted and disjoint. Touching
+// or overlapping ranges merge; past MAX_RANGES the two closest merge, so a
+// widely scattered edit costs a bounded number of uploads.
+struct DirtyRanges {
+    struct Range {
+        size_t begin, end;
+    };
+    static constexpr size_t MAX_RANGES = 64;
+    std::vector<Range> ranges;
+
+    void add(size_t begin, size_t end);
+    void clear() { ranges.clear(); }
+    bool empty() const { return ranges.empty(); }
+};
+
+// GL objects of an uploaded RenderMesh and what they hold. Owns the objects:
+// they are deleted with the mesh and handed over by moves, while copies start
+// without any and upload their own. Destroy uploaded meshes on the GL thread.
+struct MeshBuffers {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint skin_VBO = 0;
+    size_t vertex_capacity = 0;         // Bytes allocated per buffer
+    size_t index_capacity = 0;
+    size_t skin_capacity = 0;
+    size_t vertex_count = 0;            // Vertices and gpu_indices() elements uploaded
+    size_t index_count = 0;
+    size_t triangle_count = 0;          // Triangles those elements draw
+    int vertex_stride = 0;              // Layout the attributes were set up for
+    DirtyRanges dirty_vertices;
+    DirtyRanges dirty_indices;          // In gpu_indices() elements
+
+    MeshBuffers() = default;
+    MeshBuffers(const MeshBuffers&) {}
+    MeshBuffers(MeshBuffers&& other) noexcept { take(other); }
+    MeshBuffers& operator=(const MeshBuffers& other);
+    MeshBuffers& operator=(MeshBuffers&& other) noexcept;
+    ~MeshBuffers() { release(); }
+
+    void release();
+
+private:
+    void take(MeshBuffers& other);
 };
 
 struct RenderMesh {
@@ -23,41 +126,113 @@ struct RenderMesh {
     std::vector<glm::vec3> normals;     // Normals
     std::vector<glm::vec2> tex_coords; // Texture coordinates
     std::vector<unsigned int> indices; // Index buffer for drawing
-    unsigned int VAO, VBO, EBO;         // OpenGL handles
+    MeshBuffers gpu;                    // OpenGL objects, owned
+    GLenum index_type = GL_UNSIGNED_INT;    // Of the uploaded index buffer, from index_type_for()
+
+    // Optional triangle strips over the same vertices, separated by STRIP_RESTART.
+    // Uploaded and drawn instead of `indices` while the mesh has no meshlets;
+    // `indices` stays the triangle list the processing methods work on.
+    static constexpr unsigned int STRIP_RESTART = 0xFFFFFFFFu;
+    std::vector<unsigned int> strip_indices;
     bool has_shared_vertices = false;
     bool has_tex_coords = false;
     bool has_vertex_normals = false;
-    
-    // Debug Visualization
-    DebugMeshLines debug_normals = {0, 0, 0};
-    DebugMeshLines debug_wireframe = {0, 0, 0};
+
+    // Bounding sphere in model space, see compute_bounds()
+    glm::vec3 bounds_center = glm::vec3(0.0f);
+    float bounds_radius = 0.0f;
+
+    // Clusters for per-meshlet culling, see build_meshlets()
+    std::vector<Meshlet> meshlets;
+
+    // Optional joint influences per vertex, uploaded to their own buffer as
+    // attributes 3 (joint indices) and 4 (weights) for the skinning shader
+    std::vector<SkinInfluence> skin;
 
     // Constructor
     void add_vertex(float x, float y, float z);
     void add_vertex(float x, float y, float z, float nx, float ny, float nz);
     void add_vertex(float x, float y, float z, float nx, float ny, float nz, float u, float v);
     void add_face(unsigned int i0, unsigned int i1, unsigned int i2);
+    // Exact sizes up front so the add_* calls never reallocate
+    void reserve(size_t vertex_count, size_t triangle_count, bool with_normals, bool with_tex_coords);
 
-    // Mesh generation methods
+    // Mesh generation methods. All of them produce normals and texture
+    // coordinates, size the arrays exactly up front and fill rows in parallel
+    // when given a job system. Unit sized around the origin.
     static RenderMesh cube();
-    static RenderMesh uvsphere(int rings, int sectors);
+    // uvsphere() and cylinder() also emit strip_indices with `strips`
+    static RenderMesh uvsphere(int rings, int sectors, JobSystem* jobs = nullptr, bool strips = false);
     static RenderMesh plane();
-    static RenderMesh cylinder(int sectors);
+    static RenderMesh cylinder(int sectors, JobSystem* jobs = nullptr, bool strips = false);
+    static RenderMesh icosphere(int subdivisions, JobSystem* jobs = nullptr);     // 20 * 4^subdivisions triangles
+    static RenderMesh torus(int rings, int sides, float minor_radius = 0.125f, JobSystem* jobs = nullptr);
+    static RenderMesh cone(int sectors, JobSystem* jobs = nullptr);
+    static RenderMesh capsule(int rings, int sectors, float length = 1.0f, JobSystem* jobs = nullptr);
+    // Subdivided plane in xz, optionally displaced by height(x, z)
+    static RenderMesh grid(int columns, int rows, const std::function<float(float, float)>& height = nullptr, JobSystem* jobs = nullptr);
+    static RenderMesh rounded_box(int segments, float radius, JobSystem* jobs = nullptr);
+
+    // Generator building blocks: resize() sets the exact array sizes, fill_grid()
+    // writes a (rows + 1) x (columns + 1) vertex grid from vertex(row, column,
+    // position, normal, uv) plus its triangles, facing d(column) x d(row). A pole
+    // row has all its vertices at one point and gets one triangle per cell.
+    void resize(size_t vertex_count, size_t triangle_count, bool with_normals, bool with_tex_coords);
+    void set_face(size_t triangle, unsigned int i0, unsigned int i1, unsigned int i2);
+    template <typename F>
+    void fill_grid(size_t first_vertex, size_t first_triangle, int rows, int columns, bool pole_first, bool pole_last, JobSystem* jobs, F&& vertex);
+    static size_t grid_triangles(int rows, int columns, bool pole_first, bool pole_last);
 
     // GPU methods
-    void upload();
+    void upload();                      // Everything, reusing the mesh's buffers
     void upload_elements();
+    // After editing the arrays of an uploaded mesh, mark what changed (the
+    // processing methods below mark what they rewrite) and update() re-packs and
+    // uploads only those ranges. A buffer is reallocated, with headroom, only when
+    // the mesh outgrows it; growth within capacity uploads the new tail. Returns
+    // the bytes uploaded, and uploads everything if the mesh was never uploaded.
+    size_t update();
+    void mark_vertices_dirty(size_t first, size_t count);
+    void mark_indices_dirty(size_t first, size_t count);   // Elements of gpu_indices()
+    void mark_all_dirty();
+    bool dirty() const { return !gpu.dirty_vertices.empty() || !gpu.dirty_indices.empty(); }
+    void release() { gpu.release(); }
+    void setup_vertex_attributes(size_t first_byte = 0);   // Attribute layout for the bound VAO/VBO, vertices from first_byte on
+    void setup_skin_attributes();       // Attributes 3 and 4 from the bound skin buffer
+    int vertex_stride() const;          // Bytes per interleaved vertex
     void draw();
-    void draw_normals(float line_width = 1.0f, float length = 0.1f);
-    void draw_wireframe(float line_width = 1.0f);
+    void draw(const MeshletDrawList& ranges);
     std::vector<float> get_vertex_data(); // Interleaved vertex data
+    void write_vertex_data(float* out) const;   // Same into vertex_stride() * positions.size() bytes
+    void write_vertex_data(float* out, size_t first, size_t count) const;
+    bool uses_strips() const { return !strip_indices.empty() && meshlets.empty(); }
+    const std::vector<unsigned int>& gpu_indices() const { return uses_strips() ? strip_indices : indices; }
+    // Narrowest type for the vertex count, one value less when the maximum is the strip restart index
+    static GLenum index_type_for(size_t vertex_count, bool restart = false);
+    void choose_index_type() { index_type = index_type_for(positions.size(), uses_strips()); }
+    size_t index_size() const { return index_type == GL_UNSIGNED_BYTE ? 1 : index_type == GL_UNSIGNED_SHORT ? 2 : 4; }
+    GLuint restart_index() const { return index_type == GL_UNSIGNED_BYTE ? 0xFFu : index_type == GL_UNSIGNED_SHORT ? 0xFFFFu : 0xFFFFFFFFu; }
+    size_t index_bytes() const { return gpu_indices().size() * index_size(); }
+    void write_index_data(void* out) const;     // gpu_indices() as index_type, index_bytes() bytes
+    void write_index_data(void* out, size_t first, size_t count) const;
 
     // Mesh processing methods
-    void compute_vertex_normals();
+    void compute_vertex_normals(JobSystem* jobs = nullptr);
+    void compute_bounds();
+    void build_meshlets(size_t max_vertices = 64, size_t max_triangles = 124);
+    // Reverses the winding of every triangle, in the list and in the strips
     void flip_faces();
-    void create_debug_normals(float length);
-    void create_debug_wireframe();
-    ProcMesh to_procmesh();
+    // Merges vertices within epsilon of a kept vertex whose normals are within
+    // normal_degrees and texture coordinates within uv_epsilon, remaps the indices
+    // and drops triangles that collapse. Positions are bucketed in a hashed grid of
+    // 4 * epsilon cells, grouped with a radix sort, and each vertex also searches
+    // the neighbor cells it is within epsilon of. Clears meshlets and strips, so run it
+    // before those. Leaves the mesh unchanged when an attribute array that is present,
+    // or flagged, is not one entry per position.
+    WeldStats weld(float epsilon, JobSystem* jobs = nullptr, float normal_degrees = 1.0f, float uv_epsilon = 1e-4f);
+    // Half-edge mesh of the triangles. Vertices at identical positions are merged,
+    // so seams and hard edges do not split the surface; degenerate triangles are dropped.
+    ProcMesh to_procmesh() const;
 
     // Mesh IO
     void to_obj(std::string filename);
@@ -87,8 +262,16 @@ struct ProcMesh {
     std::vector<HalfEdge> half_edges;
     std::vector<Face> faces;
 
-    // Method to compute adjacency or other mesh processing
+    // Faces and half-edges for triangles over vertex_count vertices (positions are
+    // kept when the count is unchanged), then compute_adjacency()
+    void set_triangles(size_t vertex_count, const std::vector<unsigned int>& indices);
+    // Twin links, and an outgoing half-edge per vertex. Boundary half-edges have no
+    // twin (-1); boundary vertices get their outgoing boundary half-edge so a walk
+    // around them covers every face. Isolated vertices get -1.
     void compute_adjacency();
+
+    int next(int edge) const { return half_edges[edge].next_index; }
+    int end_vertex(int edge) const { return half_edges[next(edge)].vertex_index; }
 };
 
 void RenderMesh::add_face(unsigned int i0, unsigned int i1, unsigned int i2) {
@@ -116,209 +299,894 @@ void RenderMesh::add_vertex(float x, float y, float z) {
     positions.push_back(glm::vec3(x, y, z));
 }
 
+void RenderMesh::reserve(size_t vertex_count, size_t triangle_count, bool with_normals, bool with_tex_coords) {
+    positions.reserve(vertex_count);
+    if (with_normals) normals.reserve(vertex_count);
+    if (with_tex_coords) tex_coords.reserve(vertex_count);
+    indices.reserve(triangle_count * 3);
+}
+
 void RenderMesh::flip_faces() {
     for (size_t i = 0; i < indices.size(); i += 3) {
         std::swap(indices[i], indices[i + 2]);
     }
+    if (!uses_strips()) mark_indices_dirty(0, indices.size());
+    if (strip_indices.empty()) return;
+
+    // Reversing a strip flips its triangles when it has an odd number of
+    // indices; an even one starts again with a degenerate triangle so that
+    // the winding parity shifts as well
+    size_t even_strips = 0, length = 0;
+    for (size_t i = 0; i <= strip_indices.size(); i++) {
+        if (i < strip_indices.size() && strip_indices[i] != STRIP_RESTART) {
+            length++;
+            continue;
+        }
+        if (length > 0 && length % 2 == 0) even_strips++;
+        length = 0;
+    }
+    std::vector<unsigned int> flipped;
+    flipped.reserve(strip_indices.size() + even_strips);
+    size_t start = 0;
+    for (size_t i = 0; i <= strip_indices.size(); i++) {
+        if (i < strip_indices.size() && strip_indices[i] != STRIP_RESTART) continue;
+        if ((i - start) % 2 == 0 && i > start) flipped.push_back(strip_indices[i - 1]);
+        for (size_t k = i; k > start; k--) flipped.push_back(strip_indices[k - 1]);
+        if (i < strip_indices.size()) flipped.push_back(STRIP_RESTART);
+        start = i + 1;
+    }
+    strip_indices.swap(flipped);
+    if (uses_strips()) mark_indices_dirty(0, strip_indices.size());
 }
 
 std::vector<float> RenderMesh::get_vertex_data() {
-    std::vector<float> data;
-    for (size_t i = 0; i < positions.size(); i++) {
+    std::vector<float> data(positions.size() * (vertex_stride() / sizeof(float)));
+    write_vertex_data(data.data());
+    return data;
+}
+
+void RenderMesh::write_vertex_data(float* out) const {
+    write_vertex_data(out, 0, positions.size());
+}
 
-        data.push_back(positions[i].x);
-        data.push_back(positions[i].y);
-        data.push_back(positions[i].z);
+void RenderMesh::write_vertex_data(float* out, size_t first, size_t count) const {
+    for (size_t i = first; i < first + count; i++) {
+        *out++ = positions[i].x;
+        *out++ = positions[i].y;
+        *out++ = positions[i].z;
 
         if (has_vertex_normals) {
-            data.push_back(normals[i].x);
-            data.push_back(normals[i].y);
-            data.push_back(normals[i].z);
+            *out++ = normals[i].x;
+            *out++ = normals[i].y;
+            *out++ = normals[i].z;
         }
 
         if (has_tex_coords) {
-            data.push_back(tex_coords[i].x);
-            data.push_back(tex_coords[i].y);
+            *out++ = tex_coords[i].x;
+            *out++ = tex_coords[i].y;
         }
     }
-    return data;
 }
 
-void RenderMesh::create_debug_wireframe() {
-    std::cout << "Creating debug wireframe" << std::endl;
-    std::vector<float> lines;
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        // Triangle vertices
-        glm::vec3 v0 = positions[indices[i]];
-        glm::vec3 v1 = positions[indices[i + 1]];
-        glm::vec3 v2 = positions[indices[i + 2]];
+GLenum RenderMesh::index_type_for(size_t vertex_count, bool restart) {
+#if MESH_NARROW_INDICES
+    size_t reserved = restart ? 1 : 0;
+    if (vertex_count + reserved <= 0x100) return GL_UNSIGNED_BYTE;
+    if (vertex_count + reserved <= 0x10000) return GL_UNSIGNED_SHORT;
+#endif
+    return GL_UNSIGNED_INT;
+}
 
-        // Add lines for each edge
-        lines.push_back(v0.x);
-        lines.push_back(v0.y);
-        lines.push_back(v0.z);
+// Truncation maps STRIP_RESTART onto the restart index of the narrow types
+void RenderMesh::write_index_data(void* out) const {
+    write_index_data(out, 0, gpu_indices().size());
+}
 
-        lines.push_back(v1.x);
-        lines.push_back(v1.y);
-        lines.push_back(v1.z);
+void RenderMesh::write_index_data(void* out, size_t first, size_t count) const {
+    const unsigned int* source = gpu_indices().data() + first;
+    if (index_type == GL_UNSIGNED_BYTE) {
+        uint8_t* narrow = static_cast<uint8_t*>(out);
+        for (size_t i = 0; i < count; i++) narrow[i] = (uint8_t)source[i];
+    } else if (index_type == GL_UNSIGNED_SHORT) {
+        uint16_t* narrow = static_cast<uint16_t*>(out);
+        for (size_t i = 0; i < count; i++) narrow[i] = (uint16_t)source[i];
+    } else {
+        std::memcpy(out, source, count * sizeof(unsigned int));
+    }
+}
+
+void RenderMesh::compute_vertex_normals(JobSystem* jobs) {
+    has_vertex_normals = true;
+    normals.assign(positions.size(), glm::vec3(0.0f));
+    mark_vertices_dirty(0, positions.size());
+
+    // Temporaries live in the thread's scratch arena
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+
+    size_t face_count = indices.size() / 3;
+    ArenaVector<glm::vec3> face_normals(face_count, ArenaAllocator<glm::vec3>(scratch));
+
+    // Face normals are independent, one job per chunk of triangles
+    auto compute_faces = [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            glm::vec3 v0 = positions[indices[f * 3]];
+            glm::vec3 v1 = positions[indices[f * 3 + 1]];
+            glm::vec3 v2 = positions[indices[f * 3 + 2]];
+            face_normals[f] = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+        }
+    };
 
-        lines.push_back(v1.x);
-        lines.push_back(v1.y);
-        lines.push_back(v1.z);
+    if (!jobs) {
+        compute_faces(0, face_count);
+        for (size_t i = 0; i < indices.size(); i++) {
+            normals[indices[i]] += face_normals[i / 3];
+        }
+        for (size_t i = 0; i < normals.size(); i++) {
+            normals[i] = glm::normalize(normals[i]);
+        }
+        return;
+    }
 
-        lines.push_back(v2.x);
-        lines.push_back(v2.y);
-        lines.push_back(v2.z);
+    jobs->parallel_for(0, face_count, 0, compute_faces);
 
-        lines.push_back(v2.x);
-        lines.push_back(v2.y);
-        lines.push_back(v2.z);
+    // Vertex -> face adjacency (CSR) so each vertex gathers its faces without
+    // racing on a shared accumulator
+    ArenaAllocator<unsigned int> uints(scratch);
+    ArenaVector<unsigned int> offsets(positions.size() + 1, 0, uints);
+    for (size_t i = 0; i < indices.size(); i++) offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < positions.size(); v++) offsets[v + 1] += offsets[v];
 
-        lines.push_back(v0.x);
-        lines.push_back(v0.y);
-        lines.push_back(v0.z);
-    }
+    ArenaVector<unsigned int> vertex_faces(indices.size(), uints);
+    ArenaVector<unsigned int> cursor(offsets.begin(), offsets.end() - 1, uints);
+    for (size_t i = 0; i < indices.size(); i++) vertex_faces[cursor[indices[i]]++] = (unsigned int)(i / 3);
 
-    glGenVertexArrays(1, &debug_wireframe.VAO);
-    glGenBuffers(1, &debug_wireframe.VBO);
+    jobs->parallel_for(0, positions.size(), 0, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            glm::vec3 n(0.0f);
+            for (unsigned int k = offsets[v]; k < offsets[v + 1]; k++) n += face_normals[vertex_faces[k]];
+            normals[v] = glm::normalize(n);
+        }
+    });
+}
 
-    glBindVertexArray(debug_wireframe.VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, debug_wireframe.VBO);
-    glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(float), lines.data(), GL_STATIC_DRAW);
+// Stable LSD radix sort of (key, value) pairs, 8 bits per pass. Chunks of the
+// input are histogrammed and scattered in parallel; passes whose digit is the
+// same for every key are skipped. The scratch arrays hold `count` pairs each.
+void radix_sort_pairs(uint32_t* keys, uint32_t* values, uint32_t* scratch_keys, uint32_t* scratch_values, size_t count, JobSystem* jobs) {
+    size_t chunks = jobs ? std::max<size_t>(1, std::min<size_t>(jobs->thread_count() * 4, count / 4096)) : 1;
+    size_t chunk_size = (count + chunks - 1) / std::max<size_t>(chunks, 1);
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    size_t* offsets = scratch.allocate_array<size_t>(chunks * 256);
+
+    uint32_t* source_keys = keys;
+    uint32_t* source_values = values;
+    uint32_t* target_keys = scratch_keys;
+    uint32_t* target_values = scratch_values;
+    for (int shift = 0; shift < 32; shift += 8) {
+        auto histogram = [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                size_t* counts = offsets + c * 256;
+                std::fill(counts, counts + 256, 0);
+                for (size_t i = c * chunk_size; i < std::min(count, (c + 1) * chunk_size); i++) counts[(source_keys[i] >> shift) & 0xFF]++;
+            }
+        };
+        if (jobs) jobs->parallel_for(0, chunks, 1, histogram);
+        else histogram(0, chunks);
+
+        // Digit-major prefix sum: every chunk writes after the earlier chunks' keys of the same digit
+        size_t total = 0;
+        bool single_digit = false;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t digit_total = 0;
+            for (size_t c = 0; c < chunks; c++) {
+                size_t n = offsets[c * 256 + digit];
+                offsets[c * 256 + digit] = total;
+                total += n;
+                digit_total += n;
+            }
+            if (digit_total == count) single_digit = true;
+        }
+        if (single_digit) continue;
+
+        auto scatter = [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                size_t* cursor = offsets + c * 256;
+                for (size_t i = c * chunk_size; i < std::min(count, (c + 1) * chunk_size); i++) {
+                    size_t at = cursor[(source_keys[i] >> shift) & 0xFF]++;
+                    target_keys[at] = source_keys[i];
+                    target_values[at] = source_values[i];
+                }
+            }
+        };
+        if (jobs) jobs->parallel_for(0, chunks, 1, scatter);
+        else scatter(0, chunks);
+        std::swap(source_keys, target_keys);
+        std::swap(source_values, target_values);
+    }
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-
-    debug_wireframe.line_count = lines.size() / 3; // 3 floats per line (2 vertices * 3 coords)
-    
-}
-
-void RenderMesh::create_debug_normals(float length) {
-    if (!has_vertex_normals) return;
-    
-    std::cout << "Creating debug normals" << std::endl;
-
-    std::vector<float> lines;
-    // For each vertex, create a line from position to position + normal * length
-    for (size_t i = 0; i < positions.size(); i++) {
-        // Start point of line
-        lines.push_back(positions[i].x);
-        lines.push_back(positions[i].y);
-        lines.push_back(positions[i].z);
-        
-        // End point of line
-        glm::vec3 end = positions[i] + normals[i] * length;
-        lines.push_back(end.x);
-        lines.push_back(end.y);
-        lines.push_back(end.z);
-    }
-    
-    glGenVertexArrays(1, &debug_normals.VAO);
-    glGenBuffers(1, &debug_normals.VBO);
-    
-    glBindVertexArray(debug_normals.VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, debug_normals.VBO);
-    glBufferData(GL_ARRAY_BUFFER, lines.size() * sizeof(float), lines.data(), GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-    
-    debug_normals.line_count = lines.size() / 6; // 6 floats per line (2 vertices * 3 coords)
+    if (source_keys != keys) {
+        std::memcpy(keys, source_keys, count * sizeof(uint32_t));
+        std::memcpy(values, source_values, count * sizeof(uint32_t));
+    }
 }
 
-void RenderMesh::compute_vertex_normals() {
-    has_vertex_normals = true;
-    
-    // Compute vertex normals
-    for (size_t i = 0; i < positions.size(); i++) {
-        normals.push_back(glm::vec3(0.0f));
+WeldStats RenderMesh::weld(float epsilon, JobSystem* jobs, float normal_degrees, float uv_epsilon) {
+    auto start = std::chrono::steady_clock::now();
+    WeldStats stats;
+    size_t count = positions.size();
+    stats.vertices_before = stats.vertices_after = count;
+    stats.triangles_before = stats.triangles_after = indices.size() / 3;
+    if (count == 0) return stats;
+    // Every attribute array is compacted with the same remap as the positions
+    bool weld_normals = !normals.empty(), weld_tex_coords = !tex_coords.empty(), weld_skin = !skin.empty();
+    if ((weld_normals || has_vertex_normals) && normals.size() != count) return stats;
+    if ((weld_tex_coords || has_tex_coords) && tex_coords.size() != count) return stats;
+    if (weld_skin && skin.size() != count) return stats;
+
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    uint32_t* keys = scratch.allocate_array<uint32_t>(count);
+    uint32_t* order = scratch.allocate_array<uint32_t>(count);
+    uint32_t* representative = scratch.allocate_array<uint32_t>(count);    // Lowest match, then the new index
+
+    // Hash of the 4 * epsilon cell, or of the exact position when epsilon is 0.
+    // Collisions only add candidates, every pair is still compared.
+    auto cell_hash = [](int64_t x, int64_t y, int64_t z) {
+        uint64_t h = (uint64_t)x * 73856093ull ^ (uint64_t)y * 19349663ull ^ (uint64_t)z * 83492791ull;
+        return (uint32_t)(h ^ (h >> 32));
+    };
+    bool exact = epsilon <= 0.0f;
+    double cell_size = 4.0 * epsilon;
+    auto cell = [&](float value) -> int64_t {
+        if (exact) {
+            uint32_t bits;
+            float normalized = value + 0.0f;    // -0 and +0 share a cell
+            std::memcpy(&bits, &normalized, sizeof(bits));
+            return bits;
+        }
+        return (int64_t)std::floor(value / cell_size);
+    };
+    // Neighbor cell the value's matches can spill into, 0 when they all stay in its own
+    auto side = [&](float value, int64_t c) -> int64_t {
+        if (exact) return 0;
+        double offset = value - c * cell_size;
+        return offset < epsilon ? -1 : offset > cell_size - epsilon ? 1 : 0;
+    };
+
+    auto hash_vertices = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::vec3& p = positions[i];
+            keys[i] = cell_hash(cell(p.x), cell(p.y), cell(p.z));
+            order[i] = (uint32_t)i;
+        }
+    };
+    if (jobs) jobs->parallel_for(0, count, 0, hash_vertices);
+    else hash_vertices(0, count);
+    {
+        ArenaScope sort_scope(scratch);
+        uint32_t* scratch_keys = scratch.allocate_array<uint32_t>(count);
+        uint32_t* scratch_values = scratch.allocate_array<uint32_t>(count);
+        radix_sort_pairs(keys, order, scratch_keys, scratch_values, count, jobs);
     }
 
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        glm::vec3 v0 = positions[indices[i]];
-        glm::vec3 v1 = positions[indices[i + 1]];
-        glm::vec3 v2 = positions[indices[i + 2]];
+    // Start of every sorted entry's run, and a compact open-addressing table from
+    // key to run for the neighbor cells
+    uint32_t* own_run = scratch.allocate_array<uint32_t>(count);
+    size_t runs = 0;
+    for (size_t k = 0; k < count; k++) {
+        bool first = k == 0 || keys[k] != keys[k - 1];
+        runs += first;
+        own_run[k] = first ? (uint32_t)k : own_run[k - 1];
+    }
+    size_t table_size = 16;
+    while (table_size < runs * 2) table_size *= 2;
+    uint32_t* run_start = scratch.allocate_array<uint32_t>(table_size);
+    uint32_t* run_key = scratch.allocate_array<uint32_t>(table_size);
+    const uint32_t EMPTY = 0xFFFFFFFFu;
+    std::fill(run_start, run_start + table_size, EMPTY);
+    auto slot = [&](uint32_t key) {
+        size_t at = (key * 2654435761u) & (table_size - 1);
+        while (run_start[at] != EMPTY && run_key[at] != key) at = (at + 1) & (table_size - 1);
+        return at;
+    };
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0 && keys[i] == keys[i - 1]) continue;
+        size_t at = slot(keys[i]);
+        run_key[at] = keys[i];
+        run_start[at] = (uint32_t)i;
+    }
 
-        glm::vec3 normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    // Positions in sorted order, so scanning a cell reads contiguous memory
+    glm::vec3* sorted_positions = scratch.allocate_array<glm::vec3>(count);
+    auto gather = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) sorted_positions[k] = positions[order[k]];
+    };
+    if (jobs) jobs->parallel_for(0, count, 0, gather);
+    else gather(0, count);
+
+    bool compare_normals = has_vertex_normals;
+    bool compare_tex_coords = has_tex_coords;
+    float epsilon_squared = epsilon * epsilon;
+    float uv_squared = uv_epsilon * uv_epsilon;
+    float normal_cos = std::cos(glm::radians(normal_degrees));
+    auto close = [&](const glm::vec3& a, const glm::vec3& b) {
+        glm::vec3 d = a - b;
+        return glm::dot(d, d) <= epsilon_squared;
+    };
+    auto attributes_match = [&](size_t a, size_t b) {
+        if (compare_normals && glm::dot(normals[a], normals[b]) < normal_cos * glm::length(normals[a]) * glm::length(normals[b])) return false;
+        if (compare_tex_coords) {
+            glm::vec2 t = tex_coords[a] - tex_coords[b];
+            if (glm::dot(t, t) > uv_squared) return false;
+        }
+        return true;
+    };
 
-        normals[indices[i]] += normal;
-        normals[indices[i + 1]] += normal;
-        normals[indices[i + 2]] += normal;
+    // Lowest-numbered vertex below the one at sorted position `sorted` that matches
+    // it and passes `accept`
+    auto lowest_match = [&](size_t sorted, auto&& accept) {
+        uint32_t i = order[sorted];
+        const glm::vec3& p = sorted_positions[sorted];
+        int64_t x = cell(p.x), y = cell(p.y), z = cell(p.z);
+        int64_t sx = side(p.x, x), sy = side(p.y, y), sz = side(p.z, z);
+        uint32_t best = i;
+        for (int corner = 0; corner < 8; corner++) {
+            if (((corner & 1) && !sx) || ((corner & 2) && !sy) || ((corner & 4) && !sz)) continue;
+            size_t first = own_run[sorted];
+            uint32_t key = keys[sorted];
+            if (corner) {
+                key = cell_hash(x + (corner & 1) * sx, y + ((corner >> 1) & 1) * sy, z + ((corner >> 2) & 1) * sz);
+                size_t at = slot(key);
+                if (run_start[at] == EMPTY) continue;
+                first = run_start[at];
+            }
+            for (size_t k = first; k < count && keys[k] == key; k++) {
+                uint32_t j = order[k];
+                if (j < best && close(p, sorted_positions[k]) && accept(j) && attributes_match(i, j)) best = j;
+            }
+        }
+        return best;
+    };
+    // In sorted order, so the vertex's own cell is the run around it
+    uint32_t* sorted_index = scratch.allocate_array<uint32_t>(count);
+    auto find_matches = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            representative[order[k]] = lowest_match(k, [](uint32_t) { return true; });
+            sorted_index[order[k]] = (uint32_t)k;
+        }
+    };
+    if (jobs) jobs->parallel_for(0, count, 0, find_matches);
+    else find_matches(0, count);
+
+    // Greedy in index order: every vertex joins the lowest kept vertex it matches,
+    // so groups stay within epsilon of their kept vertex. A lowest match that was
+    // itself merged away needs a second, serial search among the kept ones.
+    uint8_t* is_kept = scratch.allocate_array<uint8_t>(count);
+    uint32_t* new_index = scratch.allocate_array<uint32_t>(count);
+    uint32_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t root = representative[i];
+        if (root != i && !is_kept[root]) root = lowest_match(sorted_index[i], [&](uint32_t j) { return is_kept[j] != 0; });
+        is_kept[i] = root == i;
+        new_index[i] = root == i ? kept++ : new_index[root];
+    }
+    representative = new_index;
+    stats.vertices_after = kept;
+
+    if (kept < count) {
+        std::vector<glm::vec3> welded_positions(kept);
+        std::vector<glm::vec3> welded_normals(weld_normals ? kept : 0);
+        std::vector<glm::vec2> welded_tex_coords(weld_tex_coords ? kept : 0);
+        std::vector<SkinInfluence> welded_skin(weld_skin ? kept : 0);
+        // First vertex of each group in index order keeps its attributes
+        uint32_t next = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (representative[i] != next) continue;
+            welded_positions[next] = positions[i];
+            if (weld_normals) welded_normals[next] = normals[i];
+            if (weld_tex_coords) welded_tex_coords[next] = tex_coords[i];
+            if (weld_skin) welded_skin[next] = skin[i];
+            next++;
+        }
+        positions.swap(welded_positions);
+        if (weld_normals) normals.swap(welded_normals);
+        if (weld_tex_coords) tex_coords.swap(welded_tex_coords);
+        if (weld_skin) skin.swap(welded_skin);
     }
 
-    for (size_t i = 0; i < normals.size(); i++) {
-        normals[i] = glm::normalize(normals[i]);
+    // Remap, then squeeze out the triangles that lost a corner
+    auto remap = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) indices[i] = representative[indices[i]];
+    };
+    if (jobs) jobs->parallel_for(0, indices.size(), 0, remap);
+    else remap(0, indices.size());
+    size_t written = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || c == a) continue;
+        indices[written++] = a;
+        indices[written++] = b;
+        indices[written++] = c;
     }
+    indices.resize(written);
+    stats.triangles_after = written / 3;
+
+    meshlets.clear();
+    strip_indices.clear();
+    mark_all_dirty();
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
 }
 
-void RenderMesh::draw() {
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void RenderMesh::compute_bounds() {
+    if (positions.empty()) return;
+
+    glm::vec3 lo = positions[0];
+    glm::vec3 hi = positions[0];
+    for (const auto& p : positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+
+    bounds_center = (lo + hi) * 0.5f;
+    bounds_radius = 0.0f;
+    for (const auto& p : positions) {
+        bounds_radius = std::max(bounds_radius, glm::length(p - bounds_center));
+    }
 }
 
-void RenderMesh::draw_normals(float line_width, float length) {
-    // if (!has_vertex_normals) return;
+void RenderMesh::build_meshlets(size_t max_vertices, size_t max_triangles) {
+    size_t triangle_count = indices.size() / 3;
+    meshlets.clear();
+    if (triangle_count == 0) return;
+
+    // Temporaries live in the thread's scratch arena, only the new index buffer is kept
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    ArenaAllocator<unsigned int> uints(scratch);
+
+    // Vertex -> triangle adjacency (CSR)
+    ArenaVector<unsigned int> offsets(positions.size() + 1, 0, uints);
+    for (size_t i = 0; i < indices.size(); i++) offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < positions.size(); v++) offsets[v + 1] += offsets[v];
+
+    ArenaVector<unsigned int> vertex_triangles(indices.size(), uints);
+    ArenaVector<unsigned int> cursor(offsets.begin(), offsets.end() - 1, uints);
+    for (size_t i = 0; i < indices.size(); i++) vertex_triangles[cursor[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    ArenaVector<uint8_t> emitted(triangle_count, 0, ArenaAllocator<uint8_t>(scratch));
+    ArenaVector<unsigned int> vertex_meshlet(positions.size(), 0xFFFFFFFF, uints);   // Last meshlet that used the vertex
+    ArenaVector<unsigned int> meshlet_vertices(uints);
+    ArenaVector<unsigned int> meshlet_triangles(uints);
+    ArenaVector<glm::vec3> face_normals{ArenaAllocator<glm::vec3>(scratch)};
+    ArenaVector<unsigned int> adjacency_cursor(offsets.begin(), offsets.end() - 1, uints);    // First possibly unemitted triangle
+    meshlet_vertices.reserve(max_vertices);
+    meshlet_triangles.reserve(max_triangles);
+    face_normals.reserve(max_triangles);
+    meshlets.reserve(triangle_count / std::min(max_vertices, max_triangles) + 1);     // Clusters usually close on vertices first
+    size_t scan = 0;
+
+    auto new_vertices = [&](unsigned int t) {
+        unsigned int id = (unsigned int)meshlets.size();
+        return (vertex_meshlet[indices[t * 3]] != id) + (vertex_meshlet[indices[t * 3 + 1]] != id) + (vertex_meshlet[indices[t * 3 + 2]] != id);
+    };
+
+    // Finalize the current cluster: bounds, normal cone and its triangles in the index buffer
+    auto flush = [&] {
+        Meshlet m;
+        m.index_offset = (unsigned int)reordered.size();
+        m.triangle_count = (unsigned int)meshlet_triangles.size();
+        m.vertex_count = (unsigned int)meshlet_vertices.size();
+
+        glm::vec3 lo = positions[meshlet_vertices[0]], hi = lo;
+        for (unsigned int v : meshlet_vertices) {
+            lo = glm::min(lo, positions[v]);
+            hi = glm::max(hi, positions[v]);
+        }
+        m.center = (lo + hi) * 0.5f;
+        m.radius = 0.0f;
+        for (unsigned int v : meshlet_vertices) m.radius = std::max(m.radius, glm::length(positions[v] - m.center));
+
+        face_normals.clear();
+        glm::vec3 axis(0.0f);
+        for (unsigned int t : meshlet_triangles) {
+            glm::vec3 v0 = positions[indices[t * 3]];
+            glm::vec3 n = glm::cross(positions[indices[t * 3 + 1]] - v0, positions[indices[t * 3 + 2]] - v0);
+            float length = glm::length(n);
+            if (length > 0.0f) {
+                face_normals.push_back(n / length);
+                axis += n / length;
+            }
+            reordered.push_back(indices[t * 3]);
+            reordered.push_back(indices[t * 3 + 1]);
+            reordered.push_back(indices[t * 3 + 2]);
+        }
+
+        // Normals within acos(min_dot) of the axis. Past 90 degrees some triangle
+        // always faces the camera, so the cone is disabled.
+        float axis_length = glm::length(axis);
+        m.cone_axis = axis_length > 0.0f ? axis / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+        float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+        for (const auto& n : face_normals) min_dot = std::min(min_dot, glm::dot(n, m.cone_axis));
+        m.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+
+        meshlets.push_back(m);
+        meshlet_vertices.clear();
+        meshlet_triangles.clear();
+    };
 
-    // Query max line width
-    float max_line_width;
-    glGetFloatv(GL_ALIASED_LINE_WIDTH_RANGE, &max_line_width);
+    // Candidates are the unemitted triangles touching the cluster. Each step takes
+    // the one adding the fewest new vertices, ties broken by distance to the
+    // cluster centroid to keep clusters round, which tightens bounds and cones.
+    ArenaVector<unsigned int> candidates(uints);
+    glm::vec3 centroid_sum(0.0f);
+
+    while (true) {
+        int best = -1;
+        int best_cost = 4;
+        float best_distance = 0.0f;
+        glm::vec3 centroid = meshlet_vertices.empty() ? glm::vec3(0.0f) : centroid_sum / (float)meshlet_vertices.size();
+
+        size_t live = 0;
+        for (unsigned int t : candidates) {
+            if (emitted[t]) continue;
+            candidates[live++] = t;
+
+            int cost = new_vertices(t);
+            glm::vec3 p = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.0f;
+            float distance = glm::dot(p - centroid, p - centroid);
+            if (cost < best_cost || (cost == best_cost && distance < best_distance)) {
+                best = (int)t;
+                best_cost = cost;
+                best_distance = distance;
+            }
+        }
+        candidates.resize(live);
+
+        // Nothing adjacent left, continue with the next triangle in the original order
+        if (best < 0) {
+            while (scan < triangle_count && emitted[scan]) scan++;
+            if (scan == triangle_count) break;
+            best = (int)scan;
+            best_cost = new_vertices(best);
+        }
 
+        // Full, close the cluster and seed the next one with the candidate
+        if (meshlet_vertices.size() + best_cost > max_vertices || meshlet_triangles.size() + 1 > max_triangles) {
+            flush();
+            candidates.clear();
+            centroid_sum = glm::vec3(0.0f);
+        }
 
-    if (debug_normals.VAO == 0) {
-        std::cout << "Max supported line width: " << max_line_width << std::endl;
-        create_debug_normals(length);
+        unsigned int id = (unsigned int)meshlets.size();
+        for (int c = 0; c < 3; c++) {
+            unsigned int v = indices[best * 3 + c];
+            if (vertex_meshlet[v] == id) continue;
+            vertex_meshlet[v] = id;
+            meshlet_vertices.push_back(v);
+            centroid_sum += positions[v];
+
+            // A cluster never takes more than max_triangles, so high-valence
+            // vertices (poles, cap centers) only contribute that many candidates
+            unsigned int& k = adjacency_cursor[v];
+            while (k < offsets[v + 1] && emitted[vertex_triangles[k]]) k++;
+            size_t pushed = 0;
+            for (unsigned int j = k; j < offsets[v + 1] && pushed < max_triangles; j++) {
+                if (emitted[vertex_triangles[j]]) continue;
+                candidates.push_back(vertex_triangles[j]);
+                pushed++;
+            }
+        }
+        meshlet_triangles.push_back((unsigned int)best);
+        emitted[best] = 1;
     }
+    if (!meshlet_triangles.empty()) flush();
 
-    float clamped_width = std::min(line_width, max_line_width);
-    
-    glLineWidth(clamped_width);
-    glBindVertexArray(debug_normals.VAO);
-    glDrawArrays(GL_LINES, 0, debug_normals.line_count * 2);
-    glLineWidth(1.0f);
+    indices.swap(reordered);
+    mark_indices_dirty(0, indices.size());
 }
 
-void RenderMesh::draw_wireframe(float line_width)
-{
-    if (debug_wireframe.VAO == 0) {
-        create_debug_wireframe();
+void RenderMesh::draw() {
+    // Only what the element buffer holds: indices appended since the last
+    // update() are not on the GPU yet
+    GLsizei count = (GLsizei)gpu.index_count;
+    glBindVertexArray(gpu.VAO);
+    if (uses_strips()) {
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(restart_index());
+        glDrawElements(GL_TRIANGLE_STRIP, count, index_type, 0);
+        glDisable(GL_PRIMITIVE_RESTART);
+    } else {
+        glDrawElements(GL_TRIANGLES, count, index_type, 0);
     }
+    glBindVertexArray(0);
+
+    RenderStats& stats = RenderStats::instance();
+    stats.vao_bind();
+    stats.draw_triangles(gpu.triangle_count);
+    stats.index_fetch(gpu.index_count * index_size());
+}
 
-    float max_line_width;
-    glGetFloatv(GL_ALIASED_LINE_WIDTH_RANGE, &max_line_width);
-    float clamped_width = std::min(line_width, max_line_width);
+void RenderMesh::draw(const MeshletDrawList& ranges) {
+    if (ranges.counts.empty()) return;
+    glBindVertexArray(gpu.VAO);
+    glMultiDrawElements(GL_TRIANGLES, ranges.counts.data(), index_type, ranges.offsets.data(), (GLsizei)ranges.counts.size());
+    glBindVertexArray(0);
 
-    glLineWidth(clamped_width);
-    glBindVertexArray(debug_wireframe.VAO);
-    glDrawArrays(GL_LINES, 0, debug_wireframe.line_count * 2);
-    glLineWidth(1.0f);
+    RenderStats& stats = RenderStats::instance();
+    stats.vao_bind();
+    stats.draw_triangles(ranges.visible_triangles);
+    stats.index_fetch(ranges.visible_triangles * 3 * index_size());
 }
 
 void RenderMesh::upload_elements() {
-    // Generate buffers
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    // Generate buffers, or reuse the ones from an earlier upload
+    if (!gpu.VAO) glGenVertexArrays(1, &gpu.VAO);
+    if (!gpu.VBO) glGenBuffers(1, &gpu.VBO);
+    if (!gpu.EBO) glGenBuffers(1, &gpu.EBO);
 
     // Bind VAO
-    glBindVertexArray(VAO);
+    glBindVertexArray(gpu.VAO);
 
     // Upload vertex data
     auto verts = get_vertex_data();
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
     glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
 
-    // Upload index data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    // Upload index data, narrowed in scratch memory when the vertices fit 8 or 16 bits
+    choose_index_type();
+    size_t index_buffer_bytes = index_bytes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.EBO);
+    if (index_type == GL_UNSIGNED_INT) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_bytes, gpu_indices().data(), GL_STATIC_DRAW);
+    } else {
+        FrameArena& scratch = FrameArena::thread_scratch();
+        ArenaScope scope(scratch);
+        void* narrow = scratch.allocate(index_buffer_bytes);
+        write_index_data(narrow);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_bytes, narrow, GL_STATIC_DRAW);
+    }
+
+    setup_vertex_attributes();
+
+    // Joint influences, integer indices and normalized weights from one buffer
+    size_t skin_bytes = skin.size() == positions.size() ? skin.size() * sizeof(SkinInfluence) : 0;
+    if (skin_bytes > 0) {
+        if (!gpu.skin_VBO) glGenBuffers(1, &gpu.skin_VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.skin_VBO);
+        glBufferData(GL_ARRAY_BUFFER, skin_bytes, skin.data(), GL_STATIC_DRAW);
+        setup_skin_attributes();
+    } else if (gpu.skin_VBO) {
+        glDisableVertexAttribArray(3);
+        glDisableVertexAttribArray(4);
+        glDeleteBuffers(1, &gpu.skin_VBO);
+        gpu.skin_VBO = 0;
+    }
+
+    // Unbind VAO
+    glBindVertexArray(0);
+
+    gpu.vertex_capacity = verts.size() * sizeof(float);
+    gpu.index_capacity = index_buffer_bytes;
+    gpu.skin_capacity = skin_bytes;
+    gpu.vertex_count = positions.size();
+    gpu.index_count = gpu_indices().size();
+    gpu.triangle_count = indices.size() / 3;
+    gpu.vertex_stride = vertex_stride();
+    gpu.dirty_vertices.clear();
+    gpu.dirty_indices.clear();
+    RenderStats::instance().buffer_upload(verts.size() * sizeof(float) + index_buffer_bytes + skin_bytes);
+}
+
+size_t RenderMesh::update() {
+    if (!gpu.VAO) {
+        upload();
+        return gpu.vertex_capacity + gpu.index_capacity + gpu.skin_capacity;
+    }
+
+    // A buffer that has to grow gets half its new size again as headroom
+    auto grow = [](size_t needed) { return needed + needed / 2; };
+    size_t vertex_count = positions.size();
+    size_t stride = vertex_stride();
+    size_t bytes = 0;
+    glBindVertexArray(gpu.VAO);
+
+    // Vertices: a new layout or more than fit rewrites all of them
+    bool all_vertices = (int)stride != gpu.vertex_stride;
+    if (vertex_count * stride > gpu.vertex_capacity) {
+        gpu.vertex_capacity = grow(vertex_count * stride);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+        glBufferData(GL_ARRAY_BUFFER, gpu.vertex_capacity, nullptr, GL_STATIC_DRAW);
+        all_vertices = true;
+    }
+    if (all_vertices) {
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+        setup_vertex_attributes();
+        gpu.vertex_stride = (int)stride;
+    }
+
+    bool with_skin = !skin.empty() && skin.size() == vertex_count;
+    bool all_skin = false;
+    if (with_skin && vertex_count * sizeof(SkinInfluence) > gpu.skin_capacity) {
+        if (!gpu.skin_VBO) glGenBuffers(1, &gpu.skin_VBO);
+        gpu.skin_capacity = grow(vertex_count * sizeof(SkinInfluence));
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.skin_VBO);
+        glBufferData(GL_ARRAY_BUFFER, gpu.skin_capacity, nullptr, GL_STATIC_DRAW);
+        setup_skin_attributes();
+        all_skin = true;
+    } else if (!with_skin && gpu.skin_VBO) {
+        glDisableVertexAttribArray(3);
+        glDisableVertexAttribArray(4);
+        glDeleteBuffers(1, &gpu.skin_VBO);
+        gpu.skin_VBO = 0;
+        gpu.skin_capacity = 0;
+    }
+
+    if (all_vertices) gpu.dirty_vertices.ranges.assign(1, {0, vertex_count});
+    else if (vertex_count > gpu.vertex_count) gpu.dirty_vertices.add(gpu.vertex_count, vertex_count);
+    for (const DirtyRanges::Range& range : gpu.dirty_vertices.ranges) {
+        size_t end = std::min(range.end, vertex_count);
+        if (range.begin >= end) continue;
+        size_t count = end - range.begin;
+        FrameArena& scratch = FrameArena::thread_scratch();
+        ArenaScope scope(scratch);
+        float* packed = scratch.allocate_array<float>(count * stride / sizeof(float));
+        write_vertex_data(packed, range.begin, count);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, range.begin * stride, count * stride, packed);
+        bytes += count * stride;
+        if (with_skin && !all_skin) {
+            glBindBuffer(GL_ARRAY_BUFFER, gpu.skin_VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, range.begin * sizeof(SkinInfluence), count * sizeof(SkinInfluence), &skin[range.begin]);
+            bytes += count * sizeof(SkinInfluence);
+        }
+    }
+    if (all_skin) {
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.skin_VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(SkinInfluence), skin.data());
+        bytes += vertex_count * sizeof(SkinInfluence);
+    }
+
+    // Indices: a narrower or wider type, or more than fit, rewrites all of them
+    size_t index_count = gpu_indices().size();
+    GLenum type = index_type_for(vertex_count, uses_strips());
+    bool all_indices = type != index_type;
+    index_type = type;
+    if (index_bytes() > gpu.index_capacity) {
+        gpu.index_capacity = grow(index_bytes());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, gpu.index_capacity, nullptr, GL_STATIC_DRAW);
+        all_indices = true;
+    }
+    if (all_indices) gpu.dirty_indices.ranges.assign(1, {0, index_count});
+    else if (index_count > gpu.index_count) gpu.dirty_indices.add(gpu.index_count, index_count);
+    for (const DirtyRanges::Range& range : gpu.dirty_indices.ranges) {
+        size_t end = std::min(range.end, index_count);
+        if (range.begin >= end) continue;
+        size_t count = end - range.begin;
+        FrameArena& scratch = FrameArena::thread_scratch();
+        ArenaScope scope(scratch);
+        void* packed = scratch.allocate(count * index_size());
+        write_index_data(packed, range.begin, count);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.begin * index_size(), count * index_size(), packed);
+        bytes += count * index_size();
+    }
+    glBindVertexArray(0);
+
+    gpu.vertex_count = vertex_count;
+    gpu.index_count = index_count;
+    gpu.triangle_count = indices.size() / 3;
+    gpu.dirty_vertices.clear();
+    gpu.dirty_indices.clear();
+    RenderStats& stats = RenderStats::instance();
+    stats.vao_bind();
+    stats.buffer_upload(bytes);
+    return bytes;
+}
+
+void RenderMesh::mark_vertices_dirty(size_t first, size_t count) {
+    if (gpu.VAO) gpu.dirty_vertices.add(first, first + count);
+}
+
+void RenderMesh::mark_indices_dirty(size_t first, size_t count) {
+    if (gpu.VAO) gpu.dirty_indices.add(first, first + count);
+}
+
+void RenderMesh::mark_all_dirty() {
+    mark_vertices_dirty(0, positions.size());
+    mark_indices_dirty(0, gpu_indices().size());
+}
+
+void RenderMesh::setup_skin_attributes() {
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof(SkinInfluence), (void*)offsetof(SkinInfluence, joints));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinInfluence), (void*)offsetof(SkinInfluence, weights));
+    glEnableVertexAttribArray(4);
+}
+
+void DirtyRanges::add(size_t begin, size_t end) {
+    if (begin >= end) return;
+    // Absorb every range that overlaps or touches [begin, end)
+    auto first = std::lower_bound(ranges.begin(), ranges.end(), begin, [](const Range& range, size_t value) { return range.end < value; });
+    auto last = first;
+    while (last != ranges.end() && last->begin <= end) {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+        ++last;
+    }
+    ranges.insert(ranges.erase(first, last), {begin, end});
+
+    if (ranges.size() > MAX_RANGES) {
+        size_t closest = 1;
+        for (size_t i = 2; i < ranges.size(); i++) {
+            if (ranges[i].begin - ranges[i - 1].end < ranges[closest].begin - ranges[closest - 1].end) closest = i;
+        }
+        ranges[closest - 1].end = ranges[closest].end;
+        ranges.erase(ranges.begin() + closest);
+    }
+}
+
+MeshBuffers& MeshBuffers::operator=(const MeshBuffers& other) {
+    if (this != &other) release();
+    return *this;
+}
+
+MeshBuffers& MeshBuffers::operator=(MeshBuffers&& other) noexcept {
+    if (this != &other) {
+        release();
+        take(other);
+    }
+    return *this;
+}
+
+void MeshBuffers::release() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    GLuint buffers[] = {VBO, EBO, skin_VBO};
+    for (GLuint buffer : buffers) {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+    VAO = VBO = EBO = skin_VBO = 0;
+    vertex_capacity = index_capacity = skin_capacity = 0;
+    vertex_count = index_count = triangle_count = 0;
+    vertex_stride = 0;
+    dirty_vertices.clear();
+    dirty_indices.clear();
+}
 
+void MeshBuffers::take(MeshBuffers& other) {
+    VAO = other.VAO;
+    VBO = other.VBO;
+    EBO = other.EBO;
+    skin_VBO = other.skin_VBO;
+    vertex_capacity = other.vertex_capacity;
+    index_capacity = other.index_capacity;
+    skin_capacity = other.skin_capacity;
+    vertex_count = other.vertex_count;
+    index_count = other.index_count;
+    triangle_count = other.triangle_count;
+    vertex_stride = other.vertex_stride;
+    dirty_vertices = std::move(other.dirty_vertices);
+    dirty_indices = std::move(other.dirty_indices);
+    other.VAO = other.VBO = other.EBO = other.skin_VBO = 0;
+    other.release();
+}
+
+int RenderMesh::vertex_stride() const {
     // Calculate stride - base position (3) + optional normals (3) + optional tex coords (2)
     int stride = 3; // Position always present
     if (has_vertex_normals) stride += 3;
     if (has_tex_coords) stride += 2;
-    stride *= sizeof(float);
+    return stride * sizeof(float);
+}
 
-    size_t offset = 0;
+void RenderMesh::setup_vertex_attributes(size_t first_byte) {
+    int stride = vertex_stride();
+    size_t offset = first_byte;
 
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
@@ -337,9 +1205,6 @@ void RenderMesh::upload_elements() {
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offset);
         glEnableVertexAttribArray(2);
     }
-
-    // Unbind VAO
-    glBindVertexArray(0);
 }
 
 void RenderMesh::upload() {
@@ -350,15 +1215,15 @@ void RenderMesh::to_obj(std::string filename) {
     std::ofstream file(filename);
 
     for (const auto& position : positions) {
-        file << "v " << position.x << " " << position.y << " " << position.z << std::endl;
+        file << "v " << position.x << " " << position.y << " " << position.z << "\n";
     }
 
     for (const auto& normal : normals) {
-        file << "vn " << normal.x << " " << normal.y << " " << normal.z << std::endl;
+        file << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
     }
 
     for (const auto& tex_coord : tex_coords) {
-        file << "vt " << tex_coord.x << " " << tex_coord.y << std::endl;
+        file << "vt " << tex_coord.x << " " << tex_coord.y << "\n";
     }
 
     for (size_t i = 0; i < indices.size(); i += 3) {
@@ -373,7 +1238,7 @@ void RenderMesh::to_obj(std::string filename) {
             }
             file << " ";
         }
-        file << std::endl;
+        file << "\n";
     }
 
     std::cout << "Wrote " << filename << std::endl;
@@ -382,219 +1247,704 @@ void RenderMesh::to_obj(std::string filename) {
 
 RenderMesh RenderMesh::from_obj(std::string filename) {
     RenderMesh mesh;
+    mesh.has_shared_vertices = true;
 
-    std::ifstream file(filename);
+    // Read the whole file and parse in place, istringstream per line is far too
+    // slow for multi-million triangle files
+    std::ifstream file(filename, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* c = text.c_str();
+    const char* text_end = c + text.size();
+
+    // The mesh has one index per vertex, so vt/vn referenced by a face are
+    // copied onto the position they're used with
+    std::vector<glm::vec3> file_normals;
+    std::vector<glm::vec2> file_tex_coords;
+    std::vector<int> corners;
+
+    auto skip_spaces = [&] { while (*c == ' ' || *c == '\t') c++; };
+    auto next_line = [&] {
+        while (c < text_end && *c != '\n') c++;
+        if (c < text_end) c++;
+    };
+    auto read_float = [&] {
+        char* after;
+        float value = std::strtof(c, &after);
+        c = after;
+        return value;
+    };
+    // 1-based, negative indices count back from the end
+    auto resolve = [](long index, size_t count) { return index < 0 ? (long)count + index : index - 1; };
+
+    while (c < text_end) {
+        skip_spaces();
+        if (c[0] == 'v' && c[1] == ' ') {
+            c += 2;
+            float x = read_float(), y = read_float(), z = read_float();
+            mesh.add_vertex(x, y, z);
+        } else if (c[0] == 'v' && c[1] == 'n' && c[2] == ' ') {
+            c += 3;
+            float x = read_float(), y = read_float(), z = read_float();
+            file_normals.push_back(glm::vec3(x, y, z));
+        } else if (c[0] == 'v' && c[1] == 't' && c[2] == ' ') {
+            c += 3;
+            float u = read_float(), v = read_float();
+            file_tex_coords.push_back(glm::vec2(u, v));
+        } else if (c[0] == 'f' && c[1] == ' ') {
+            c += 2;
+            corners.clear();
+
+            // Corners are v, v/vt, v//vn or v/vt/vn
+            while (true) {
+                skip_spaces();
+                if (*c == '\r' || *c == '\n' || c >= text_end) break;
+                char* after;
+                long v = std::strtol(c, &after, 10);
+                if (after == c) break;
+                c = after;
+                long vt = 0, vn = 0;
+                if (*c == '/') {
+                    c++;
+                    if (*c != '/') {
+                        vt = std::strtol(c, &after, 10);
+                        c = after;
+                    }
+                    if (*c == '/') {
+                        c++;
+                        vn = std::strtol(c, &after, 10);
+                        c = after;
+                    }
+                }
+
+                long position = resolve(v, mesh.positions.size());
+                if (position < 0 || position >= (long)mesh.positions.size()) continue;
+                if (vt != 0) {
+                    long index = resolve(vt, file_tex_coords.size());
+                    if (index >= 0 && index < (long)file_tex_coords.size()) {
+                        if (mesh.tex_coords.size() < mesh.positions.size()) mesh.tex_coords.resize(mesh.positions.size());
+                        mesh.has_tex_coords = true;
+                        mesh.tex_coords[position] = file_tex_coords[index];
+                    }
+                }
+                if (vn != 0) {
+                    long index = resolve(vn, file_normals.size());
+                    if (index >= 0 && index < (long)file_normals.size()) {
+                        if (mesh.normals.size() < mesh.positions.size()) mesh.normals.resize(mesh.positions.size());
+                        mesh.has_vertex_normals = true;
+                        mesh.normals[position] = file_normals[index];
+                    }
+                }
+                corners.push_back((int)position);
+            }
+
+            // Polygons are triangulated as a fan
+            for (size_t i = 2; i < corners.size(); i++) {
+                mesh.add_face(corners[0], corners[i - 1], corners[i]);
+            }
+        }
+        next_line();
+    }
 
-    std::string line;
+    // Vertices declared after the first face with normals or uvs still need slots
+    if (mesh.has_vertex_normals) mesh.normals.resize(mesh.positions.size());
+    if (mesh.has_tex_coords) mesh.tex_coords.resize(mesh.positions.size());
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
+    return mesh;
+}
 
-        if (type == "v") {
-            float x, y, z;
-            iss >> x >> y >> z;
-            mesh.add_vertex(x, y, z);
-        } else if (type == "vn") {
-            float nx, ny, nz;
-            iss >> nx >> ny >> nz;
-            mesh.normals.push_back(glm::vec3(nx, ny, nz));
-        } else if (type == "vt") {
-            float u, v;
-            iss >> u >> v;
-            mesh.tex_coords.push_back(glm::vec2(u, v));
-        } else if (type == "f") {
-            unsigned int i0, i1, i2;
-            char slash;
-            iss >> i0 >> slash >> slash >> i1 >> slash >> i2;
-            mesh.add_face(i0 - 1, i1 - 1, i2 - 1);
+ProcMesh RenderMesh::to_procmesh() const {
+    ProcMesh mesh;
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+
+    // Sort the vertices by position so identical ones are adjacent, then number the distinct ones
+    size_t count = positions.size();
+    unsigned int* order = scratch.allocate_array<unsigned int>(count);
+    unsigned int* remap = scratch.allocate_array<unsigned int>(count);
+    for (size_t i = 0; i < count; i++) order[i] = (unsigned int)i;
+    auto less = [&](unsigned int a, unsigned int b) {
+        const glm::vec3& p = positions[a];
+        const glm::vec3& q = positions[b];
+        if (p.x != q.x) return p.x < q.x;
+        if (p.y != q.y) return p.y < q.y;
+        return p.z < q.z;
+    };
+    std::sort(order, order + count, less);
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || less(order[i - 1], order[i])) {
+            mesh.vertices.push_back({positions[order[i]], -1});
         }
+        remap[order[i]] = (unsigned int)mesh.vertices.size() - 1;
     }
 
+    std::vector<unsigned int> welded;
+    welded.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+        welded.push_back(a);
+        welded.push_back(b);
+        welded.push_back(c);
+    }
+    mesh.set_triangles(mesh.vertices.size(), welded);
     return mesh;
+}
 
+void ProcMesh::set_triangles(size_t vertex_count, const std::vector<unsigned int>& indices) {
+    if (vertices.size() != vertex_count) vertices.assign(vertex_count, {glm::vec3(0.0f), -1});
+    size_t face_count = indices.size() / 3;
+    faces.resize(face_count);
+    half_edges.resize(face_count * 3);
+    for (size_t f = 0; f < face_count; f++) {
+        int first = (int)f * 3;
+        faces[f].edge_index = first;
+        for (int k = 0; k < 3; k++) {
+            HalfEdge& edge = half_edges[first + k];
+            edge.vertex_index = (int)indices[first + k];
+            edge.twin_index = -1;
+            edge.next_index = first + (k + 1) % 3;
+            edge.face_index = (int)f;
+        }
+    }
+    compute_adjacency();
 }
 
-RenderMesh RenderMesh::plane() {
-    RenderMesh mesh;
-    mesh.has_shared_vertices = true;
+void ProcMesh::compute_adjacency() {
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+
+    // Half-edges sorted by (start, end) so each finds its twin (end, start) by binary search
+    struct Key {
+        uint64_t edge;
+        int index;
+        bool operator<(const Key& other) const { return edge < other.edge; }
+    };
+    size_t count = half_edges.size();
+    Key* keys = scratch.allocate_array<Key>(count);
+    for (size_t h = 0; h < count; h++) {
+        keys[h] = {((uint64_t)(uint32_t)half_edges[h].vertex_index << 32) | (uint32_t)end_vertex((int)h), (int)h};
+    }
+    std::sort(keys, keys + count);
+
+    for (Vertex& vertex : vertices) vertex.edge_index = -1;
+    for (size_t h = 0; h < count; h++) {
+        HalfEdge& edge = half_edges[h];
+        uint64_t reverse = ((uint64_t)(uint32_t)end_vertex((int)h) << 32) | (uint32_t)edge.vertex_index;
+        const Key* found = std::lower_bound(keys, keys + count, Key{reverse, 0});
+        edge.twin_index = found != keys + count && found->edge == reverse ? found->index : -1;
+    }
+    for (size_t h = 0; h < count; h++) {
+        int& outgoing = vertices[half_edges[h].vertex_index].edge_index;
+        if (outgoing < 0 || half_edges[h].twin_index < 0) outgoing = (int)h;
+    }
+}
 
-    // Make a place facing up with two triangles and use no shared vertices and use indices
-    mesh.add_vertex(-0.5f, 0.0f, -0.5f);
-    mesh.add_vertex(0.5f, 0.0f, -0.5f);
-    mesh.add_vertex(0.5f, 0.0f, 0.5f);
-    mesh.add_vertex(-0.5f, 0.0f, 0.5f);
+void RenderMesh::resize(size_t vertex_count, size_t triangle_count, bool with_normals, bool with_tex_coords) {
+    has_vertex_normals = with_normals;
+    has_tex_coords = with_tex_coords;
+    positions.resize(vertex_count);
+    normals.resize(with_normals ? vertex_count : 0);
+    tex_coords.resize(with_tex_coords ? vertex_count : 0);
+    indices.resize(triangle_count * 3);
+}
 
-    mesh.add_face(0, 2, 1);
-    mesh.add_face(0, 3, 2);
+void RenderMesh::set_face(size_t triangle, unsigned int i0, unsigned int i1, unsigned int i2) {
+    indices[triangle * 3] = i0;
+    indices[triangle * 3 + 1] = i1;
+    indices[triangle * 3 + 2] = i2;
+}
 
-    return mesh;
+// Rows of the grid are independent, so both passes split them over the job system
+template <typename F>
+void RenderMesh::fill_grid(size_t first_vertex, size_t first_triangle, int rows, int columns, bool pole_first, bool pole_last,
+                           JobSystem* jobs, F&& vertex) {
+    size_t stride = (size_t)columns + 1;
+    auto fill_vertices = [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            for (int column = 0; column <= columns; column++) {
+                size_t i = first_vertex + row * stride + column;
+                vertex((int)row, column, positions[i], normals[i], tex_coords[i]);
+            }
+        }
+    };
+
+    // Cells in a pole row lose the triangle whose two pole corners coincide
+    auto fill_faces = [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            size_t t = first_triangle + row * 2 * columns - (pole_first && row > 0 ? columns : 0);
+            bool skip_first = pole_first && row == 0;
+            bool skip_last = pole_last && row == (size_t)rows - 1;
+            for (int column = 0; column < columns; column++) {
+                unsigned int a = (unsigned int)(first_vertex + row * stride + column);
+                unsigned int b = a + 1;
+                unsigned int c = a + (unsigned int)stride + 1;
+                unsigned int d = a + (unsigned int)stride;
+                if (!skip_first) set_face(t++, a, b, c);
+                if (!skip_last) set_face(t++, a, c, d);
+            }
+        }
+    };
+
+    if (jobs) {
+        jobs->parallel_for(0, (size_t)rows + 1, 0, fill_vertices);
+        jobs->parallel_for(0, (size_t)rows, 0, fill_faces);
+    } else {
+        fill_vertices(0, (size_t)rows + 1);
+        fill_faces(0, (size_t)rows);
+    }
+}
+
+size_t RenderMesh::grid_triangles(int rows, int columns, bool pole_first, bool pole_last) {
+    return 2 * (size_t)rows * columns - (pole_first ? columns : 0) - (pole_last ? columns : 0);
+}
+
+RenderMesh RenderMesh::plane() {
+    return grid(1, 1);
 }
 
 RenderMesh RenderMesh::cube() {
+    return rounded_box(0, 0.0f);
+}
+
+RenderMesh RenderMesh::grid(int columns, int rows, const std::function<float(float, float)>& height, JobSystem* jobs) {
+    RenderMesh mesh;
+    mesh.has_shared_vertices = true;
+    mesh.resize(((size_t)rows + 1) * (columns + 1), grid_triangles(rows, columns, false, false), true, true);
+
+    // Heights are sampled once per grid point plus a border ring, normals come
+    // from central differences over one cell
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    float dx = 1.0f / columns, dz = 1.0f / rows;
+    size_t stride = (size_t)columns + 3;
+    float* heights = nullptr;
+    if (height) {
+        heights = scratch.allocate_array<float>(stride * (rows + 3));
+        auto sample_rows = [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                for (size_t column = 0; column < stride; column++)
+                    heights[row * stride + column] = height(-0.5f + ((int)column - 1) * dx, 0.5f - ((int)row - 1) * dz);
+            }
+        };
+        if (jobs) jobs->parallel_for(0, (size_t)rows + 3, 0, sample_rows);
+        else sample_rows(0, (size_t)rows + 3);
+    }
+    auto sampled = [&](int row, int column) { return heights[(row + 1) * stride + column + 1]; };
+
+    // Rows run towards -z so the quads face +y
+    mesh.fill_grid(0, 0, rows, columns, false, false, jobs, [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+        position = glm::vec3(-0.5f + column * dx, heights ? sampled(row, column) : 0.0f, 0.5f - row * dz);
+        normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        if (heights) {
+            float slope_x = (sampled(row, column + 1) - sampled(row, column - 1)) / (2.0f * dx);
+            float slope_z = (sampled(row - 1, column) - sampled(row + 1, column)) / (2.0f * dz);
+            normal = glm::normalize(glm::vec3(-slope_x, 1.0f, -slope_z));
+        }
+        uv = glm::vec2((float)column / columns, (float)row / rows);
+    });
+    return mesh;
+}
+
+RenderMesh RenderMesh::rounded_box(int segments, float radius, JobSystem* jobs) {
     RenderMesh mesh;
     mesh.has_shared_vertices = true;
 
-    // Front
-    mesh.add_vertex(-0.5f, -0.5f,  0.5f);  // 0
-    mesh.add_vertex( 0.5f, -0.5f,  0.5f);  // 1
-    mesh.add_vertex( 0.5f,  0.5f,  0.5f);  // 2
-    mesh.add_vertex(-0.5f,  0.5f,  0.5f);  // 3
-    
-    // Back
-    mesh.add_vertex(-0.5f, -0.5f, -0.5f);  // 4
-    mesh.add_vertex( 0.5f, -0.5f, -0.5f);  // 5 
-    mesh.add_vertex( 0.5f,  0.5f, -0.5f);  // 6
-    mesh.add_vertex(-0.5f,  0.5f, -0.5f);  // 7
-
-    // Front
-    mesh.add_face(0, 1, 2);
-    mesh.add_face(0, 2, 3);
-    
-    // Back
-    mesh.add_face(5, 4, 7);
-    mesh.add_face(5, 7, 6);
-    
-    // Top
-    mesh.add_face(3, 2, 6);
-    mesh.add_face(3, 6, 7);
-    
-    // Bottom
-    mesh.add_face(4, 5, 1);
-    mesh.add_face(4, 1, 0);
-    
-    // Right
-    mesh.add_face(1, 5, 6);
-    mesh.add_face(1, 6, 2);
-    
-    // Left
-    mesh.add_face(4, 0, 3);
-    mesh.add_face(4, 3, 7);
+    // Each face is a grid with `segments` cells across each rounded border and
+    // one across the flat middle. Grid points are pushed out from the inner box
+    // onto the rounded shell; neighbouring faces meet with the same positions
+    // and normals, so the seams don't show.
+    if (segments <= 0) radius = 0.0f;
+    radius = glm::clamp(radius, 0.0f, 0.5f);
+    int cells = segments > 0 ? 2 * segments + 1 : 1;
+    size_t face_vertices = ((size_t)cells + 1) * (cells + 1);
+    size_t face_triangles = grid_triangles(cells, cells, false, false);
+    mesh.resize(6 * face_vertices, 6 * face_triangles, true, true);
+
+    auto coordinate = [&](int k) {
+        if (segments <= 0) return k == 0 ? -0.5f : 0.5f;
+        if (k <= segments) return -0.5f + radius * k / segments;
+        return 0.5f - radius * (cells - k) / segments;
+    };
+
+    // Face normal and its two in-plane axes, column x row pointing outwards
+    static const glm::vec3 faces[6][3] = {
+        {glm::vec3(1, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)},
+        {glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 0)},
+        {glm::vec3(0, 1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, -1)},
+        {glm::vec3(0, -1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1)},
+        {glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0)},
+        {glm::vec3(0, 0, -1), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0)},
+    };
 
+    float inner = 0.5f - radius;
+    for (int f = 0; f < 6; f++) {
+        const glm::vec3& n = faces[f][0];
+        const glm::vec3& u = faces[f][1];
+        const glm::vec3& v = faces[f][2];
+        mesh.fill_grid(f * face_vertices, f * face_triangles, cells, cells, false, false, jobs,
+                       [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+            glm::vec3 p = n * 0.5f + u * coordinate(column) + v * coordinate(row);
+            glm::vec3 core = glm::clamp(p, -inner, inner);
+            glm::vec3 offset = p - core;
+            float length = glm::length(offset);
+            normal = length > 1e-6f ? offset / length : n;
+            position = core + normal * radius;
+            uv = glm::vec2(coordinate(column) + 0.5f, coordinate(row) + 0.5f);
+        });
+    }
     return mesh;
 }
 
-RenderMesh RenderMesh::uvsphere(int rings, int sectors) {
+RenderMesh RenderMesh::uvsphere(int rings, int sectors, JobSystem* jobs, bool strips) {
     RenderMesh mesh;
     mesh.has_shared_vertices = true;
 
+    // Two poles plus rings - 1 rows with a duplicated seam vertex; a fan at each
+    // pole, two triangles per quad between
+    size_t row_vertices = (size_t)sectors + 1;
+    size_t vertex_count = 2 + (size_t)(rings - 1) * row_vertices;
+    size_t band_triangles = 2 * (size_t)sectors;
+    mesh.resize(vertex_count, 2 * (size_t)sectors + (size_t)std::max(rings - 2, 0) * band_triangles, true, true);
+
     float R = 1.0f;
     float pi = glm::pi<float>();
 
-    // Add north pole vertex
-    mesh.add_vertex(0, R, 0, 0, 1, 0, 0.5f, 0.0f);
+    // North and south pole
+    mesh.positions[0] = glm::vec3(0, R, 0);
+    mesh.normals[0] = glm::vec3(0, 1, 0);
+    mesh.tex_coords[0] = glm::vec2(0.5f, 0.0f);
+    mesh.positions[vertex_count - 1] = glm::vec3(0, -R, 0);
+    mesh.normals[vertex_count - 1] = glm::vec3(0, -1, 0);
+    mesh.tex_coords[vertex_count - 1] = glm::vec2(0.5f, 1.0f);
+
+    auto fill_rings = [&](size_t begin, size_t end) {
+        for (size_t ring = begin; ring < end; ring++) {
+            int i = (int)ring + 1;
+            float theta = i * pi / rings;
+            float sinTheta = glm::sin(theta);
+            float cosTheta = glm::cos(theta);
+
+            for (int j = 0; j <= sectors; j++) {
+                float phi = j * 2 * pi / sectors;
+                float sinPhi = glm::sin(phi);
+                float cosPhi = glm::cos(phi);
+
+                float x = cosPhi * sinTheta;
+                float y = cosTheta;
+                float z = sinPhi * sinTheta;
+
+                size_t v = 1 + ring * row_vertices + j;
+                mesh.positions[v] = glm::vec3(x * R, y * R, z * R);
+                mesh.normals[v] = glm::vec3(x, y, z);
+                mesh.tex_coords[v] = glm::vec2((float)j / sectors, (float)i / rings);
+            }
+        }
+    };
 
-    // Generate vertices for rings (excluding poles)
-    for (int i = 1; i < rings; i++) {
-        float theta = i * pi / rings;
-        float sinTheta = glm::sin(theta);
-        float cosTheta = glm::cos(theta);
+    // Pole fans first, then the bands between rings
+    unsigned int southPoleIndex = (unsigned int)vertex_count - 1;
+    unsigned int lastRingStart = southPoleIndex - (unsigned int)row_vertices;
+    for (int j = 0; j < sectors; j++) {
+        mesh.set_face(j, 0, j + 2, j + 1);
+    }
+    size_t southFirst = sectors + (size_t)std::max(rings - 2, 0) * band_triangles;
+    for (int j = 0; j < sectors; j++) {
+        mesh.set_face(southFirst + j, southPoleIndex, lastRingStart + j, lastRingStart + j + 1);
+    }
 
-        for (int j = 0; j <= sectors; j++) {
-            float phi = j * 2 * pi / sectors;
-            float sinPhi = glm::sin(phi);
-            float cosPhi = glm::cos(phi);
+    auto fill_bands = [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            unsigned int rowStart = 1 + (unsigned int)(band * row_vertices);
+            size_t t = sectors + band * band_triangles;
+            for (int j = 0; j < sectors; j++) {
+                unsigned int p0 = rowStart + j;
+                unsigned int p1 = p0 + sectors + 1;
 
-            float x = cosPhi * sinTheta;
-            float y = cosTheta;
-            float z = sinPhi * sinTheta;
+                mesh.set_face(t++, p0, p0 + 1, p1);
+                mesh.set_face(t++, p1, p0 + 1, p1 + 1);
+            }
+        }
+    };
 
-            mesh.add_vertex(x * R, y * R, z * R, x, y, z, (float)j / sectors, (float)i / rings);
+    size_t bands = (size_t)std::max(rings - 2, 0);
+
+    // One strip per band; the pole fans have no strip form and become single triangles
+    size_t fan_strip = 4 * (size_t)sectors;
+    size_t band_strip = 2 * row_vertices + 1;
+    if (strips) mesh.strip_indices.resize(2 * fan_strip + bands * band_strip);
+    auto emit_triangle = [&](size_t at, unsigned int i0, unsigned int i1, unsigned int i2) {
+        mesh.strip_indices[at] = i0;
+        mesh.strip_indices[at + 1] = i1;
+        mesh.strip_indices[at + 2] = i2;
+        mesh.strip_indices[at + 3] = STRIP_RESTART;
+    };
+    if (strips) {
+        size_t southStrip = fan_strip + bands * band_strip;
+        for (int j = 0; j < sectors; j++) {
+            emit_triangle(4 * j, 0, j + 2, j + 1);
+            emit_triangle(southStrip + 4 * j, southPoleIndex, lastRingStart + j, lastRingStart + j + 1);
         }
     }
+    auto fill_band_strips = [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            unsigned int rowStart = 1 + (unsigned int)(band * row_vertices);
+            size_t at = fan_strip + band * band_strip;
+            for (size_t j = 0; j < row_vertices; j++) {
+                mesh.strip_indices[at++] = rowStart + (unsigned int)(j + row_vertices);
+                mesh.strip_indices[at++] = rowStart + (unsigned int)j;
+            }
+            mesh.strip_indices[at] = STRIP_RESTART;
+        }
+    };
 
-    // Add south pole vertex
-    mesh.add_vertex(0, -R, 0, 0, -1, 0, 0.5f, 1.0f);
-
-    // Create triangles for north pole (reversed winding)
-    int northPoleIndex = 0;
-    for (int j = 0; j < sectors; j++) {
-        mesh.add_face(northPoleIndex, j + 2, j + 1);
+    if (jobs) {
+        jobs->parallel_for(0, (size_t)rings - 1, 0, fill_rings);
+        jobs->parallel_for(0, bands, 0, fill_bands);
+        if (strips) jobs->parallel_for(0, bands, 0, fill_band_strips);
+    } else {
+        fill_rings(0, (size_t)rings - 1);
+        fill_bands(0, bands);
+        if (strips) fill_band_strips(0, bands);
     }
+    return mesh;
+}
 
-    // Create triangles for rings (reversed winding)
-    for (int i = 1; i < rings - 1; i++) {
-        int rowStart = 1 + (i - 1) * (sectors + 1);
-        for (int j = 0; j < sectors; j++) {
-            int p0 = rowStart + j;
-            int p1 = p0 + sectors + 1;
+RenderMesh RenderMesh::icosphere(int subdivisions, JobSystem* jobs) {
+    RenderMesh mesh;
+    mesh.has_shared_vertices = true;
 
-            mesh.add_face(p0, p0 + 1, p1);
-            mesh.add_face(p1, p0 + 1, p1 + 1);
-        }
-    }
+    // Every icosahedron face becomes a triangular patch with 2^subdivisions
+    // segments per edge, projected onto the unit sphere. Patches don't share
+    // their border vertices, so each one fills its own slice in parallel and
+    // wraps its texture coordinates around the seam on its own.
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    static const int faces[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1},
+    };
+    const glm::vec3 corners[12] = {
+        glm::vec3(-1, t, 0), glm::vec3(1, t, 0), glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+        glm::vec3(0, -1, t), glm::vec3(0, 1, t), glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+        glm::vec3(t, 0, -1), glm::vec3(t, 0, 1), glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1),
+    };
 
-    // Create triangles for south pole (reversed winding)
-    int southPoleIndex = mesh.positions.size() - 1;
-    int lastRingStart = southPoleIndex - (sectors + 1);
-    for (int j = 0; j < sectors; j++) {
-        mesh.add_face(southPoleIndex, lastRingStart + j, lastRingStart + j + 1);
-    }
+    int n = 1 << std::max(subdivisions, 0);
+    size_t patch_vertices = ((size_t)n + 1) * (n + 2) / 2;
+    size_t patch_triangles = (size_t)n * n;
+    mesh.resize(20 * patch_vertices, 20 * patch_triangles, true, true);
+
+    float pi = glm::pi<float>();
+    auto longitude = [&](const glm::vec3& p) { return std::atan2(p.z, p.x) / (2.0f * pi) + 0.5f; };
+
+    auto fill_patches = [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; f++) {
+            glm::vec3 a = corners[faces[f][0]], b = corners[faces[f][1]], c = corners[faces[f][2]];
+            float center_u = longitude(glm::normalize(a + b + c));
+            size_t first = f * patch_vertices;
+
+            // Row `i` (towards c) holds n + 1 - i vertices (towards b)
+            size_t v = first;
+            for (int i = 0; i <= n; i++) {
+                for (int j = 0; j <= n - i; j++, v++) {
+                    glm::vec3 p = glm::normalize(a + (b - a) * ((float)j / n) + (c - a) * ((float)i / n));
+                    float u = p.x * p.x + p.z * p.z > 1e-12f ? longitude(p) : center_u;
+                    if (u - center_u > 0.5f) u -= 1.0f;
+                    if (center_u - u > 0.5f) u += 1.0f;
+                    mesh.positions[v] = p;
+                    mesh.normals[v] = p;
+                    mesh.tex_coords[v] = glm::vec2(u, std::acos(glm::clamp(p.y, -1.0f, 1.0f)) / pi);
+                }
+            }
 
+            auto index = [&](int i, int j) { return (unsigned int)(first + (size_t)i * (n + 1) - (size_t)i * (i - 1) / 2 + j); };
+            size_t triangle = f * patch_triangles;
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n - i; j++) {
+                    mesh.set_face(triangle++, index(i, j), index(i, j + 1), index(i + 1, j));
+                    if (j < n - i - 1) mesh.set_face(triangle++, index(i, j + 1), index(i + 1, j + 1), index(i + 1, j));
+                }
+            }
+        }
+    };
+
+    if (jobs) jobs->parallel_for(0, 20, 1, fill_patches);
+    else fill_patches(0, 20);
     return mesh;
 }
 
-RenderMesh RenderMesh::cylinder(int sectors) {
+RenderMesh RenderMesh::torus(int rings, int sides, float minor_radius, JobSystem* jobs) {
     RenderMesh mesh;
     mesh.has_shared_vertices = true;
+    mesh.resize(((size_t)sides + 1) * (rings + 1), grid_triangles(sides, rings, false, false), true, true);
 
-    float H = 1.0f;  // Height of 1.0
-    float R = 0.5f;  // Radius of 0.5 for diameter of 1.0
+    // Tube around a ring in the xz plane, outer diameter 1
     float pi = glm::pi<float>();
+    float R = 0.5f - minor_radius;
+    mesh.fill_grid(0, 0, sides, rings, false, false, jobs, [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+        float phi = column * 2 * pi / rings;
+        float psi = row * 2 * pi / sides;
+        glm::vec3 radial(glm::cos(phi), 0.0f, glm::sin(phi));
+        normal = radial * glm::cos(psi) - glm::vec3(0.0f, glm::sin(psi), 0.0f);
+        position = radial * R + normal * minor_radius;
+        uv = glm::vec2((float)column / rings, (float)row / sides);
+    });
+    return mesh;
+}
 
-    // Add center vertices for caps
-    mesh.add_vertex(0, H/2, 0, 0, 1, 0, 0.5f, 0.5f);    // Top center
-    mesh.add_vertex(0, -H/2, 0, 0, -1, 0, 0.5f, 0.5f);  // Bottom center
-
-    // Generate vertices for caps
-    for (int i = 0; i <= sectors; i++) {
-        float theta = i * 2 * pi / sectors;
-        float x = R * glm::cos(theta);
-        float z = R * glm::sin(theta);
-        float u = glm::cos(theta) * 0.5f + 0.5f;
-        float v = glm::sin(theta) * 0.5f + 0.5f;
+RenderMesh RenderMesh::cone(int sectors, JobSystem* jobs) {
+    RenderMesh mesh;
+    mesh.has_shared_vertices = true;
 
-        // Top cap vertices
-        mesh.add_vertex(x, H/2, z, 0, 1, 0, u, v);
-        // Bottom cap vertices
-        mesh.add_vertex(x, -H/2, z, 0, -1, 0, u, v);
-    }
+    // Side as a one-row grid from the apex down, plus a fan for the base.
+    // Height 1, base diameter 1 like cylinder().
+    size_t row_vertices = (size_t)sectors + 1;
+    size_t side_triangles = grid_triangles(1, sectors, true, false);
+    mesh.resize(3 * row_vertices + 1, side_triangles + sectors, true, true);
 
-    // Generate vertices for sides
+    float H = 1.0f;
+    float R = 0.5f;
+    float pi = glm::pi<float>();
+    mesh.fill_grid(0, 0, 1, sectors, true, false, jobs, [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+        // The apex vertex of a column only belongs to the triangle to its right, it takes that triangle's mid normal
+        float phi = (column + (row == 0 ? 0.5f : 0.0f)) * 2 * pi / sectors;
+        float cosPhi = glm::cos(phi), sinPhi = glm::sin(phi);
+        position = row == 0 ? glm::vec3(0, H / 2, 0) : glm::vec3(R * cosPhi, -H / 2, R * sinPhi);
+        normal = glm::normalize(glm::vec3(H * cosPhi, R, H * sinPhi));
+        uv = glm::vec2((column + (row == 0 ? 0.5f : 0.0f)) / sectors, (float)row);
+    });
+
+    size_t center = 2 * row_vertices;
+    mesh.positions[center] = glm::vec3(0, -H / 2, 0);
+    mesh.normals[center] = glm::vec3(0, -1, 0);
+    mesh.tex_coords[center] = glm::vec2(0.5f, 0.5f);
     for (int i = 0; i <= sectors; i++) {
         float theta = i * 2 * pi / sectors;
-        float x = R * glm::cos(theta);
-        float z = R * glm::sin(theta);
-        float nx = glm::cos(theta);
-        float nz = glm::sin(theta);
-
-        mesh.add_vertex(x, H/2, z, nx, 0, nz, (float)i/sectors, 0.0f);
-        mesh.add_vertex(x, -H/2, z, nx, 0, nz, (float)i/sectors, 1.0f);
+        size_t v = center + 1 + i;
+        mesh.positions[v] = glm::vec3(R * glm::cos(theta), -H / 2, R * glm::sin(theta));
+        mesh.normals[v] = glm::vec3(0, -1, 0);
+        mesh.tex_coords[v] = glm::vec2(glm::cos(theta) * 0.5f + 0.5f, glm::sin(theta) * 0.5f + 0.5f);
     }
-
-    // Create top circle (reversed winding)
-    int topCenter = 0;
     for (int i = 0; i < sectors; i++) {
-        int current = 2 + i * 2;
-        int next = 2 + (i + 1) * 2;
-        mesh.add_face(topCenter, next, current);
+        mesh.set_face(side_triangles + i, (unsigned int)center, (unsigned int)(center + 1 + i), (unsigned int)(center + 2 + i));
     }
+    return mesh;
+}
 
-    // Create bottom circle (reversed winding)
-    int bottomCenter = 1;
-    for (int i = 0; i < sectors; i++) {
-        int current = 3 + i * 2;
-        int next = 3 + (i + 1) * 2;
-        mesh.add_face(bottomCenter, current, next);
-    }
+RenderMesh RenderMesh::capsule(int rings, int sectors, float length, JobSystem* jobs) {
+    RenderMesh mesh;
+    mesh.has_shared_vertices = true;
 
-    // Create sides (reversed winding)
-    int sideStart = 2 * (sectors + 1) + 2;
-    for (int i = 0; i < sectors; i++) {
-        mesh.add_face(sideStart + i * 2, sideStart + i * 2 + 3, sideStart + i * 2 + 1);
-        mesh.add_face(sideStart + i * 2, sideStart + i * 2 + 2, sideStart + i * 2 + 3);
-    }
+    // Latitude rows from pole to pole: `rings` bands per hemisphere and one for
+    // the cylinder between. Radius 0.5, so with length 1 the middle matches cylinder().
+    rings = std::max(rings, 1);
+    int rows = 2 * rings + 1;
+    mesh.resize(((size_t)rows + 1) * (sectors + 1), grid_triangles(rows, sectors, true, true), true, true);
+
+    float R = 0.5f;
+    float pi = glm::pi<float>();
+    float arc = pi / 2 * R;                 // Quarter circle, v runs along the profile
+    float profile = 2 * arc + length;
+    mesh.fill_grid(0, 0, rows, sectors, true, true, jobs, [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+        bool top = row <= rings;
+        float along = top ? (float)row / rings : (float)(row - rings - 1) / rings;
+        float theta = (top ? 0.0f : pi / 2) + along * pi / 2;
+        float phi = column * 2 * pi / sectors;
+        normal = glm::vec3(glm::cos(phi) * glm::sin(theta), glm::cos(theta), glm::sin(phi) * glm::sin(theta));
+        position = glm::vec3(0.0f, top ? length / 2 : -length / 2, 0.0f) + normal * R;
+        float distance = top ? along * arc : arc + length + along * arc;
+        uv = glm::vec2((float)column / sectors, distance / profile);
+    });
+    return mesh;
+}
+
+RenderMesh RenderMesh::cylinder(int sectors, JobSystem* jobs, bool strips) {
+    RenderMesh mesh;
+    mesh.has_shared_vertices = true;
+
+    // Two cap centers, then a top/bottom pair of cap vertices and a pair of
+    // side vertices per column; two fans and a quad strip
+    size_t column_count = (size_t)sectors + 1;
+    mesh.resize(2 + 4 * column_count, 4 * (size_t)sectors, true, true);
+
+    float H = 1.0f;  // Height of 1.0
+    float R = 0.5f;  // Radius of 0.5 for diameter of 1.0
+    float pi = glm::pi<float>();
 
+    // Center vertices for caps
+    mesh.positions[0] = glm::vec3(0, H/2, 0);
+    mesh.normals[0] = glm::vec3(0, 1, 0);
+    mesh.tex_coords[0] = glm::vec2(0.5f, 0.5f);
+    mesh.positions[1] = glm::vec3(0, -H/2, 0);
+    mesh.normals[1] = glm::vec3(0, -1, 0);
+    mesh.tex_coords[1] = glm::vec2(0.5f, 0.5f);
+
+    size_t sideStart = 2 * column_count + 2;
+    auto fill_columns = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float theta = i * 2 * pi / sectors;
+            float x = R * glm::cos(theta);
+            float z = R * glm::sin(theta);
+            float u = glm::cos(theta) * 0.5f + 0.5f;
+            float v = glm::sin(theta) * 0.5f + 0.5f;
+
+            // Top and bottom cap vertices
+            size_t cap = 2 + i * 2;
+            mesh.positions[cap] = glm::vec3(x, H/2, z);
+            mesh.normals[cap] = glm::vec3(0, 1, 0);
+            mesh.tex_coords[cap] = glm::vec2(u, v);
+            mesh.positions[cap + 1] = glm::vec3(x, -H/2, z);
+            mesh.normals[cap + 1] = glm::vec3(0, -1, 0);
+            mesh.tex_coords[cap + 1] = glm::vec2(u, v);
+
+            // Side vertices
+            size_t side = sideStart + i * 2;
+            glm::vec3 normal(glm::cos(theta), 0, glm::sin(theta));
+            mesh.positions[side] = glm::vec3(x, H/2, z);
+            mesh.normals[side] = normal;
+            mesh.tex_coords[side] = glm::vec2((float)i/sectors, 0.0f);
+            mesh.positions[side + 1] = glm::vec3(x, -H/2, z);
+            mesh.normals[side + 1] = normal;
+            mesh.tex_coords[side + 1] = glm::vec2((float)i/sectors, 1.0f);
+
+            if (i == (size_t)sectors) continue;
+
+            // Top fan, bottom fan and the side quad of this column
+            unsigned int current = (unsigned int)cap;
+            unsigned int next = current + 2;
+            mesh.set_face(i, 0, next, current);
+            mesh.set_face(sectors + i, 1, current + 1, next + 1);
+            unsigned int s = (unsigned int)side;
+            mesh.set_face(2 * sectors + i * 2, s, s + 3, s + 1);
+            mesh.set_face(2 * sectors + i * 2 + 1, s, s + 2, s + 3);
+        }
+    };
+
+    if (jobs) jobs->parallel_for(0, column_count, 0, fill_columns);
+    else fill_columns(0, column_count);
+
+    if (strips) {
+        // Each cap zigzags across its ring without the center vertex (sectors - 2
+        // triangles), then one strip around the side
+        size_t S = (size_t)sectors;
+        mesh.strip_indices.resize(2 * (S + 1) + 2 * column_count + 1);
+        size_t at = 0;
+        for (size_t k = 0; k < S; k++) {
+            size_t column = k % 2 ? S - (k + 1) / 2 : k / 2;
+            mesh.strip_indices[at++] = (unsigned int)(2 + 2 * column);
+        }
+        mesh.strip_indices[at++] = STRIP_RESTART;
+        for (size_t k = 0; k < S; k++) {
+            size_t column = k % 2 ? (k + 1) / 2 : (S - k / 2) % S;
+            mesh.strip_indices[at++] = (unsigned int)(3 + 2 * column);
+        }
+        mesh.strip_indices[at++] = STRIP_RESTART;
+        for (size_t i = 0; i < column_count; i++) {
+            mesh.strip_indices[at++] = (unsigned int)(sideStart + 2 * i + 1);
+            mesh.strip_indices[at++] = (unsigned int)(sideStart + 2 * i);
+        }
+        mesh.strip_indices[at] = STRIP_RESTART;
+    }
     return mesh;
-}
\ No newline at end of file
+}
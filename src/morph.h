@@ -0,0 +1,354 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+#include "jobs.h"
+#include "memory.h"
+#include "render_stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MORPH_USE_SSE2 1
+#endif
+
+// Targets the vertex shader back end weights, MAX_TARGETS in assets/shaders/morph.vs
+constexpr int MORPH_MAX_TARGETS = 64;
+
+enum class MorphPrecision {
+    Float32,        // 24 bytes of deltas per moved vertex
+    Snorm16,        // 12 bytes, scaled per target
+};
+
+// One blend shape: position and normal deltas of the vertices it moves, sorted
+// by vertex. Six values per vertex, position xyz then normal xyz, as floats or
+// as int16 times position_scale / normal_scale.
+struct MorphTarget {
+    std::string name;
+    std::vector<uint32_t> vertices;
+    std::vector<float> deltas;          // Float32, padded by one value for 4-wide loads
+    std::vector<int16_t> quantized;     // Snorm16, padded by two
+    float position_scale = 1.0f;
+    float normal_scale = 1.0f;
+
+    size_t size() const { return vertices.size(); }
+    size_t bytes() const;
+};
+
+// Blend shapes of one mesh. The CPU back end adds the weighted deltas of the
+// targets with a non-zero weight to the base vertices; the GPU back end keeps
+// every delta in texture buffers, listed per vertex, for morph.vs.
+class MorphTargets {
+public:
+    explicit MorphTargets(MorphPrecision precision = MorphPrecision::Float32) : precision(precision) {}
+    MorphTargets(const MorphTargets&) = delete;
+    MorphTargets& operator=(const MorphTargets&) = delete;
+    ~MorphTargets() { release(); }
+
+    // Deltas between `base` and the same mesh moved to `positions` and `normals`
+    // (may be null); vertices that move less than `threshold` are left out
+    int add_target(const std::string& name, const RenderMesh& base, const glm::vec3* positions, const glm::vec3* normals, float threshold = 1e-5f);
+    // Already sparse, `vertices` sorted
+    int add_target(const std::string& name, size_t count, const uint32_t* vertices, const glm::vec3* position_deltas, const glm::vec3* normal_deltas);
+
+    int target_count() const { return (int)targets.size(); }
+    const MorphTarget& target(int index) const { return targets[index]; }
+    MorphPrecision format() const { return precision; }
+    size_t bytes() const;
+    // A full position and normal copy per target, what sparse storage replaces
+    static size_t dense_bytes(size_t vertex_count) { return vertex_count * 2 * sizeof(glm::vec3); }
+
+    // Base vertices plus the weighted deltas, normals renormalized, in the
+    // interleaved layout of write_vertex_data(). Splits the vertices into
+    // ranges across a job system; each range finds its slice of every active
+    // target by binary search and accumulates it in scratch memory.
+    void apply(const RenderMesh& base, const float* weights, float* out, JobSystem* jobs = nullptr) const;
+
+    // GPU back end: upload() builds the per-vertex delta lists, bind() sets the
+    // weights of the first MORPH_MAX_TARGETS targets and binds the texture
+    // buffers to units first_unit and up (units 0 and 1 hold material maps)
+    void upload(const RenderMesh& base);
+    void bind(const Shader& shader, const float* weights, int first_unit = 2) const;
+    void release();
+    size_t gpu_bytes() const { return uploaded_bytes; }
+
+private:
+    MorphPrecision precision;
+    std::vector<MorphTarget> targets;
+    GLuint offsets_buffer = 0, offsets_texture = 0;
+    GLuint deltas_buffer = 0, deltas_texture = 0;
+    size_t uploaded_bytes = 0;
+};
+
+// Test mesh: a UV sphere with three targets, a bulge on top, a dent in front
+// and a squash that moves every vertex
+RenderMesh morph_test_blob(int resolution, MorphTargets& targets, JobSystem* jobs = nullptr);
+
+size_t MorphTarget::bytes() const {
+    size_t value_bytes = quantized.empty() ? sizeof(float) : sizeof(int16_t);
+    return vertices.size() * (sizeof(uint32_t) + 6 * value_bytes);
+}
+
+int MorphTargets::add_target(const std::string& name, const RenderMesh& base, const glm::vec3* positions, const glm::vec3* normals, float threshold) {
+    bool with_normals = normals && base.has_vertex_normals;
+    std::vector<uint32_t> moved;
+    std::vector<glm::vec3> position_deltas, normal_deltas;
+    for (size_t v = 0; v < base.positions.size(); v++) {
+        glm::vec3 dp = positions[v] - base.positions[v];
+        glm::vec3 dn = with_normals ? normals[v] - base.normals[v] : glm::vec3(0.0f);
+        glm::vec3 size = glm::max(glm::abs(dp), glm::abs(dn));
+        if (std::max(size.x, std::max(size.y, size.z)) <= threshold) continue;
+        moved.push_back((uint32_t)v);
+        position_deltas.push_back(dp);
+        normal_deltas.push_back(dn);
+    }
+    return add_target(name, moved.size(), moved.data(), position_deltas.data(), normal_deltas.data());
+}
+
+int MorphTargets::add_target(const std::string& name, size_t count, const uint32_t* vertices, const glm::vec3* position_deltas, const glm::vec3* normal_deltas) {
+    MorphTarget target;
+    target.name = name;
+    target.vertices.assign(vertices, vertices + count);
+    auto value = [&](size_t k, int c) {
+        return c < 3 ? position_deltas[k][c] : normal_deltas ? normal_deltas[k][c - 3] : 0.0f;
+    };
+
+    if (precision == MorphPrecision::Float32) {
+        target.deltas.resize(count * 6 + 1, 0.0f);
+        for (size_t k = 0; k < count; k++) {
+            for (int c = 0; c < 6; c++) target.deltas[k * 6 + c] = value(k, c);
+        }
+    } else {
+        // Scales from the largest component, so each target uses the full int16 range
+        float max_position = 0.0f, max_normal = 0.0f;
+        for (size_t k = 0; k < count; k++) {
+            for (int c = 0; c < 3; c++) max_position = std::max(max_position, std::fabs(value(k, c)));
+            for (int c = 3; c < 6; c++) max_normal = std::max(max_normal, std::fabs(value(k, c)));
+        }
+        target.position_scale = max_position > 0.0f ? max_position / 32767.0f : 1.0f;
+        target.normal_scale = max_normal > 0.0f ? max_normal / 32767.0f : 1.0f;
+        target.quantized.resize(count * 6 + 2, 0);
+        for (size_t k = 0; k < count; k++) {
+            for (int c = 0; c < 6; c++) {
+                float scale = c < 3 ? target.position_scale : target.normal_scale;
+                target.quantized[k * 6 + c] = (int16_t)std::lround(value(k, c) / scale);
+            }
+        }
+    }
+    targets.push_back(std::move(target));
+    return (int)targets.size() - 1;
+}
+
+size_t MorphTargets::bytes() const {
+    size_t total = 0;
+    for (const MorphTarget& target : targets) total += target.bytes();
+    return total;
+}
+
+void MorphTargets::apply(const RenderMesh& base, const float* weights, float* out, JobSystem* jobs) const {
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    int* active = scratch.allocate_array<int>(std::max(targets.size(), (size_t)1));
+    int active_count = 0;
+    for (size_t t = 0; t < targets.size(); t++) {
+        if (weights[t] != 0.0f && !targets[t].vertices.empty()) active[active_count++] = (int)t;
+    }
+
+    size_t stride = base.vertex_stride() / sizeof(float);
+    bool with_normals = base.has_vertex_normals;
+    size_t uv_offset = with_normals ? 6 : 3;
+    bool quantized = precision == MorphPrecision::Snorm16;
+    auto apply_range = [&](size_t begin, size_t end) {
+        FrameArena& range_scratch = FrameArena::thread_scratch();
+        ArenaScope range_scope(range_scratch);
+        glm::vec4* position = range_scratch.allocate_array<glm::vec4>(end - begin);
+        glm::vec4* normal = range_scratch.allocate_array<glm::vec4>(end - begin);
+        for (size_t v = begin; v < end; v++) {
+            position[v - begin] = glm::vec4(base.positions[v], 0.0f);
+            normal[v - begin] = with_normals ? glm::vec4(base.normals[v], 0.0f) : glm::vec4(0.0f);
+        }
+
+        for (int a = 0; a < active_count; a++) {
+            const MorphTarget& target = targets[active[a]];
+            size_t first = std::lower_bound(target.vertices.begin(), target.vertices.end(), (uint32_t)begin) - target.vertices.begin();
+            size_t last = std::lower_bound(target.vertices.begin() + first, target.vertices.end(), (uint32_t)end) - target.vertices.begin();
+            float w = weights[active[a]];
+            float wp = quantized ? w * target.position_scale : w;
+            float wn = quantized ? w * target.normal_scale : w;
+#if MORPH_USE_SSE2
+            // Zero in the last lane drops the value loaded past each triple
+            __m128 position_weight = _mm_set_ps(0.0f, wp, wp, wp);
+            __m128 normal_weight = _mm_set_ps(0.0f, wn, wn, wn);
+            for (size_t k = first; k < last; k++) {
+                float* p = glm::value_ptr(position[target.vertices[k] - begin]);
+                float* n = glm::value_ptr(normal[target.vertices[k] - begin]);
+                __m128 dp, dn;
+                if (quantized) {
+                    // Sign-extend int16 lanes: px py pz nx, then nx ny nz (next)
+                    __m128i raw = _mm_loadu_si128((const __m128i*)&target.quantized[k * 6]);
+                    __m128i shifted = _mm_srli_si128(raw, 6);
+                    dp = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+                    dn = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(shifted, shifted), 16));
+                } else {
+                    dp = _mm_loadu_ps(&target.deltas[k * 6]);
+                    dn = _mm_loadu_ps(&target.deltas[k * 6 + 3]);
+                }
+                _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(dp, position_weight)));
+                _mm_storeu_ps(n, _mm_add_ps(_mm_loadu_ps(n), _mm_mul_ps(dn, normal_weight)));
+            }
+#else
+            for (size_t k = first; k < last; k++) {
+                glm::vec4& p = position[target.vertices[k] - begin];
+                glm::vec4& n = normal[target.vertices[k] - begin];
+                for (int c = 0; c < 3; c++) {
+                    p[c] += wp * (quantized ? (float)target.quantized[k * 6 + c] : target.deltas[k * 6 + c]);
+                    n[c] += wn * (quantized ? (float)target.quantized[k * 6 + 3 + c] : target.deltas[k * 6 + 3 + c]);
+                }
+            }
+#endif
+        }
+
+        for (size_t v = begin; v < end; v++) {
+            float* o = out + v * stride;
+            const glm::vec4& p = position[v - begin];
+            o[0] = p.x; o[1] = p.y; o[2] = p.z;
+            if (with_normals) {
+                glm::vec3 n(normal[v - begin]);
+                float length2 = glm::dot(n, n);
+                if (length2 > 0.0f) n /= std::sqrt(length2);
+                o[3] = n.x; o[4] = n.y; o[5] = n.z;
+            }
+            if (base.has_tex_coords) {
+                o[uv_offset] = base.tex_coords[v].x;
+                o[uv_offset + 1] = base.tex_coords[v].y;
+            }
+        }
+    };
+    if (jobs) jobs->parallel_for(0, base.positions.size(), 0, apply_range);
+    else apply_range(0, base.positions.size());
+}
+
+void MorphTargets::upload(const RenderMesh& base) {
+    release();
+    size_t vertex_count = base.positions.size();
+    int count = std::min((int)targets.size(), MORPH_MAX_TARGETS);
+    bool quantized = precision == MorphPrecision::Snorm16;
+
+    // Vertex-major lists: per vertex the first entry, two texels per entry with
+    // the position delta and target index, then the normal delta
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (int t = 0; t < count; t++) {
+        for (uint32_t v : targets[t].vertices) offsets[v + 1]++;
+    }
+    for (size_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+    size_t entries = offsets[vertex_count];
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    std::vector<float> float_texels(quantized ? 0 : std::max(entries, (size_t)1) * 8, 0.0f);
+    std::vector<int16_t> int_texels(quantized ? std::max(entries, (size_t)1) * 8 : 0, 0);
+    for (int t = 0; t < count; t++) {
+        const MorphTarget& target = targets[t];
+        for (size_t k = 0; k < target.size(); k++) {
+            size_t slot = cursor[target.vertices[k]]++ * 8;
+            for (int c = 0; c < 3; c++) {
+                if (quantized) {
+                    int_texels[slot + c] = target.quantized[k * 6 + c];
+                    int_texels[slot + 4 + c] = target.quantized[k * 6 + 3 + c];
+                } else {
+                    float_texels[slot + c] = target.deltas[k * 6 + c];
+                    float_texels[slot + 4 + c] = target.deltas[k * 6 + 3 + c];
+                }
+            }
+            if (quantized) int_texels[slot + 3] = (int16_t)t;
+            else float_texels[slot + 3] = (float)t;
+        }
+    }
+
+    size_t offset_bytes = offsets.size() * sizeof(uint32_t);
+    size_t delta_bytes = quantized ? int_texels.size() * sizeof(int16_t) : float_texels.size() * sizeof(float);
+    glGenBuffers(1, &offsets_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, offsets_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, offset_bytes, offsets.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &deltas_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, deltas_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, delta_bytes, quantized ? (const void*)int_texels.data() : (const void*)float_texels.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &offsets_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, offsets_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, offsets_buffer);
+    glGenTextures(1, &deltas_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, deltas_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, quantized ? GL_RGBA16I : GL_RGBA32F, deltas_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    uploaded_bytes = offset_bytes + delta_bytes;
+    RenderStats::instance().buffer_upload(uploaded_bytes);
+}
+
+void MorphTargets::bind(const Shader& shader, const float* weights, int first_unit) const {
+    // x weights position deltas, y normal deltas, with the int16 scales folded in
+    int count = std::min((int)targets.size(), MORPH_MAX_TARGETS);
+    bool quantized = precision == MorphPrecision::Snorm16;
+    glm::vec4 packed[MORPH_MAX_TARGETS];
+    for (int t = 0; t < count; t++) {
+        packed[t] = glm::vec4(weights[t] * (quantized ? targets[t].position_scale : 1.0f),
+                              weights[t] * (quantized ? targets[t].normal_scale : 1.0f), 0.0f, 0.0f);
+    }
+    if (count > 0) shader.setVec4Array("morphWeights", packed, count);
+    shader.setBool("morphQuantized", quantized);
+    shader.setInt("morphOffsets", first_unit);
+    shader.setInt("morphDeltas", first_unit + 1);
+    shader.setInt("morphDeltasQuantized", first_unit + 2);
+
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, offsets_texture);
+    glActiveTexture(GL_TEXTURE0 + first_unit + (quantized ? 2 : 1));
+    glBindTexture(GL_TEXTURE_BUFFER, deltas_texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void MorphTargets::release() {
+    if (offsets_texture) glDeleteTextures(1, &offsets_texture);
+    if (deltas_texture) glDeleteTextures(1, &deltas_texture);
+    if (offsets_buffer) glDeleteBuffers(1, &offsets_buffer);
+    if (deltas_buffer) glDeleteBuffers(1, &deltas_buffer);
+    offsets_texture = deltas_texture = offsets_buffer = deltas_buffer = 0;
+    uploaded_bytes = 0;
+}
+
+RenderMesh morph_test_blob(int resolution, MorphTargets& targets, JobSystem* jobs) {
+    // Normals of the base and of every shape come from the same face averaging,
+    // so vertices a shape leaves alone get no normal delta
+    RenderMesh base = RenderMesh::uvsphere(resolution, resolution, jobs);
+    base.compute_vertex_normals(jobs);
+
+    auto add_shape = [&](const char* name, auto&& move) {
+        RenderMesh shape = base;
+        for (size_t v = 0; v < shape.positions.size(); v++) shape.positions[v] = move(base.positions[v], base.normals[v]);
+        shape.compute_vertex_normals(jobs);
+        targets.add_target(name, base, shape.positions.data(), shape.normals.data());
+    };
+    add_shape("bulge", [](const glm::vec3& p, const glm::vec3& n) {
+        return p.y > 0.2f ? p + n * (p.y - 0.2f) * 0.6f : p;
+    });
+    add_shape("dent", [](const glm::vec3& p, const glm::vec3& n) {
+        float d = glm::length(glm::vec2(p.x, p.y));
+        return p.z > 0.0f && d < 0.25f ? p - n * (0.25f - d) * 0.5f : p;
+    });
+    add_shape("squash", [](const glm::vec3& p, const glm::vec3&) {
+        return glm::vec3(p.x * 1.25f, p.y * 0.7f, p.z * 1.25f);
+    });
+    // Covers every combination of weights up to one
+    base.bounds_center = glm::vec3(0.0f);
+    base.bounds_radius = 2.0f;
+    return base;
+}
@@ -0,0 +1,644 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "culling.h"
+#include "shader.h"
+#include "texture.h"
+#include "render_stats.h"
+#include "memory.h"
+
+// One point as stored and uploaded (20 bytes). Color is RGBA8, radius is in
+// world units; 0 draws the point with the renderer's default radius.
+struct CloudPoint {
+    glm::vec3 position;
+    uint32_t color;
+    float radius;
+};
+
+// Reads a PLY file (ascii or binary_little_endian vertex element with x/y/z,
+// optional red/green/blue and radius) or a .bin file of packed CloudPoint
+// records. The file is memory mapped; binary data converts on `jobs` if given.
+bool read_points(const std::string& filename, std::vector<CloudPoint>& points, JobSystem* jobs = nullptr);
+// Binary little-endian PLY with x/y/z, red/green/blue and radius
+bool write_points_ply(const std::string& filename, const std::vector<CloudPoint>& points);
+
+// Octree node. Every node owns a subsample of its points, at most one per
+// cell of a GRID^3 grid, and its children hold the rest: drawing a node adds
+// detail to what its ancestors already drew.
+struct PointNode {
+    glm::vec3 min = glm::vec3(0.0f);
+    float size = 0.0f;                  // Edge of the cube
+    float spacing = 0.0f;               // Distance between the node's own points, size / GRID
+    uint32_t first = 0;                 // Own points in PointCloud::points
+    uint32_t count = 0;
+    int32_t children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    uint8_t level = 0;
+
+    glm::vec3 center() const { return min + glm::vec3(size * 0.5f); }
+    float radius() const { return size * 0.8660254f; }
+};
+
+// Level of detail limits for PointCloud::select()
+struct PointLod {
+    size_t budget = 3000000;            // Points drawn per frame
+    float max_error = 2.0f;             // Stop refining once a node's point spacing is below this many pixels
+};
+
+// Point ranges to draw this frame, contiguous nodes merged
+struct PointSelection {
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+    size_t points = 0;
+    size_t nodes = 0;
+    bool budget_limited = false;        // Stopped at the budget with nodes left to refine
+
+    void clear();
+};
+
+// Point cloud sorted into an LOD octree. Points are laid out breadth first,
+// so the coarse levels come first in the vertex buffer and a partially
+// uploaded buffer already holds a complete low-detail cloud.
+class PointCloud {
+public:
+    static constexpr int GRID = 32;                 // Subsample cells per node axis
+    static constexpr uint32_t LEAF_POINTS = 8192;   // Nodes with fewer points keep all of them
+    static constexpr int MAX_DEPTH = 20;            // Guards against stacks of duplicate points
+
+    std::vector<CloudPoint> points;                 // Node order, breadth first
+    std::vector<PointNode> nodes;                   // nodes[0] is the root
+    float leaf_spacing = 0.0f;                      // Typical distance between neighbouring points at full detail
+    float load_ms = 0.0f;
+    float build_ms = 0.0f;
+
+    bool load(const std::string& filename, JobSystem* jobs = nullptr);
+    void build(std::vector<CloudPoint> input);
+
+    // Nodes inside the frustum, most visible point spacing first, until every node
+    // is below lod.max_error pixels or the budget is reached. `resident` is how many
+    // leading points are on the GPU; nodes beyond it are skipped. `projection_scale`
+    // converts world size at distance 1 to pixels (viewport height * projection[1][1] / 2).
+    void select(const Frustum& frustum, const glm::vec3& camera, float projection_scale, size_t resident,
+                const PointLod& lod, PointSelection& selection) const;
+
+private:
+    struct Range {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    void build_node(int index, uint32_t begin, uint32_t end, const std::vector<CloudPoint>& input, std::vector<uint32_t>& order,
+                    std::vector<uint32_t>& scratch, std::vector<uint64_t>& occupied, std::vector<Range>& own);
+};
+
+// GPU side of a PointCloud: one vertex buffer streamed in over several frames
+// through upload(), drawn as sphere impostors (point.vs/point.fs) with one
+// glMultiDrawArrays. GL thread only, except resident().
+class PointCloudRenderer {
+public:
+    PointCloudRenderer();
+    ~PointCloudRenderer() { release(); }
+    // Deletes the GL objects while the context is still current
+    void release();
+
+    // Uploads up to `budget_bytes` of the points not yet on the GPU
+    void upload(const PointCloud& cloud, size_t budget_bytes);
+    // Points uploaded so far, read by the main thread for select()
+    size_t resident() const { return uploaded.load(std::memory_order_acquire); }
+    void draw(const PointSelection& selection, const glm::mat4& view, const glm::mat4& projection, float viewport_height, float default_radius);
+
+private:
+    Shader shader;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    size_t capacity = 0;                // Points the buffer was allocated for
+    std::atomic<size_t> uploaded{0};
+};
+
+// PLY scalar property types
+enum class PlyType : uint8_t { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;
+    size_t offset = 0;                  // Bytes into the binary record
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    size_t stride = 0;
+    bool has_list = false;
+    std::vector<PlyProperty> properties;
+};
+
+bool ply_type(const std::string& name, PlyType& type, size_t& size) {
+    static const struct { const char* name; PlyType type; size_t size; } types[] = {
+        {"char", PlyType::Int8, 1}, {"int8", PlyType::Int8, 1}, {"uchar", PlyType::UInt8, 1}, {"uint8", PlyType::UInt8, 1},
+        {"short", PlyType::Int16, 2}, {"int16", PlyType::Int16, 2}, {"ushort", PlyType::UInt16, 2}, {"uint16", PlyType::UInt16, 2},
+        {"int", PlyType::Int32, 4}, {"int32", PlyType::Int32, 4}, {"uint", PlyType::UInt32, 4}, {"uint32", PlyType::UInt32, 4},
+        {"float", PlyType::Float32, 4}, {"float32", PlyType::Float32, 4}, {"double", PlyType::Float64, 8}, {"float64", PlyType::Float64, 8},
+    };
+    for (const auto& entry : types) {
+        if (name == entry.name) {
+            type = entry.type;
+            size = entry.size;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Little-endian value, the mapping has no alignment guarantees
+double ply_value(const unsigned char* data, PlyType type) {
+    switch (type) {
+        case PlyType::Int8: return (double)(int8_t)data[0];
+        case PlyType::UInt8: return (double)data[0];
+        case PlyType::Int16: { int16_t v; std::memcpy(&v, data, 2); return v; }
+        case PlyType::UInt16: { uint16_t v; std::memcpy(&v, data, 2); return v; }
+        case PlyType::Int32: { int32_t v; std::memcpy(&v, data, 4); return v; }
+        case PlyType::UInt32: { uint32_t v; std::memcpy(&v, data, 4); return v; }
+        case PlyType::Float32: { float v; std::memcpy(&v, data, 4); return v; }
+        case PlyType::Float64: { double v; std::memcpy(&v, data, 8); return v; }
+    }
+    return 0.0;
+}
+
+// Vertex property slots read into a CloudPoint: x, y, z, red, green, blue, radius
+struct PlyVertexLayout {
+    int slots[7] = {-1, -1, -1, -1, -1, -1, -1};
+
+    explicit PlyVertexLayout(const PlyElement& vertex) {
+        static const char* names[7][3] = {
+            {"x", "x", "x"}, {"y", "y", "y"}, {"z", "z", "z"},
+            {"red", "r", "diffuse_red"}, {"green", "g", "diffuse_green"}, {"blue", "b", "diffuse_blue"},
+            {"radius", "radius", "radius"},
+        };
+        for (int slot = 0; slot < 7; slot++) {
+            for (size_t i = 0; i < vertex.properties.size(); i++) {
+                const std::string& name = vertex.properties[i].name;
+                if (name == names[slot][0] || name == names[slot][1] || name == names[slot][2]) slots[slot] = (int)i;
+            }
+        }
+    }
+
+    bool has_position() const { return slots[0] >= 0 && slots[1] >= 0 && slots[2] >= 0; }
+    bool has_color() const { return slots[3] >= 0 && slots[4] >= 0 && slots[5] >= 0; }
+};
+
+uint32_t point_color(double r, double g, double b, bool normalized) {
+    double scale = normalized ? 255.0 : 1.0;
+    auto channel = [scale](double v) { return (uint32_t)std::min(std::max(v * scale + (scale > 1.0 ? 0.5 : 0.0), 0.0), 255.0); };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | 0xFF000000u;
+}
+
+CloudPoint ply_point(const PlyVertexLayout& layout, const std::vector<PlyProperty>& properties, const double* values) {
+    CloudPoint point;
+    point.position = glm::vec3((float)values[layout.slots[0]], (float)values[layout.slots[1]], (float)values[layout.slots[2]]);
+    point.color = 0xFFFFFFFFu;
+    if (layout.has_color()) {
+        // Float colors are 0..1, integer colors 0..255
+        bool normalized = properties[layout.slots[3]].type == PlyType::Float32 || properties[layout.slots[3]].type == PlyType::Float64;
+        point.color = point_color(values[layout.slots[3]], values[layout.slots[4]], values[layout.slots[5]], normalized);
+    }
+    point.radius = layout.slots[6] >= 0 ? (float)values[layout.slots[6]] : 0.0f;
+    return point;
+}
+
+bool read_ply_points(const MappedFile& file, const std::string& filename, std::vector<CloudPoint>& points, JobSystem* jobs) {
+    const char* text = (const char*)file.data;
+    const char* marker = "end_header";
+    const char* end = std::search(text, text + std::min(file.size, (size_t)65536), marker, marker + std::strlen(marker));
+    if (end == text + std::min(file.size, (size_t)65536)) {
+        std::cerr << filename << ": no PLY header" << std::endl;
+        return false;
+    }
+    const char* body = end + std::strlen(marker);
+    while (body < text + file.size && *body != '\n') body++;
+    body++;
+
+    // Header: format, then elements with their properties
+    std::istringstream header(std::string(text, end));
+    std::string line, format;
+    std::vector<PlyElement> elements;
+    while (std::getline(header, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            tokens >> format;
+        } else if (keyword == "element") {
+            elements.emplace_back();
+            tokens >> elements.back().name >> elements.back().count;
+        } else if (keyword == "property" && !elements.empty()) {
+            PlyElement& element = elements.back();
+            std::string type_name;
+            tokens >> type_name;
+            if (type_name == "list") {
+                element.has_list = true;
+                continue;
+            }
+            PlyProperty property;
+            size_t size;
+            tokens >> property.name;
+            if (!ply_type(type_name, property.type, size)) {
+                std::cerr << filename << ": unknown PLY type " << type_name << std::endl;
+                return false;
+            }
+            property.offset = element.stride;
+            element.stride += size;
+            element.properties.push_back(property);
+        }
+    }
+    bool ascii = format == "ascii";
+    if (!ascii && format != "binary_little_endian") {
+        std::cerr << filename << ": unsupported PLY format " << format << std::endl;
+        return false;
+    }
+
+    // Elements before the vertices are skipped, they must be fixed size
+    size_t skip_bytes = 0, skip_lines = 0;
+    const PlyElement* vertex = nullptr;
+    for (const PlyElement& element : elements) {
+        if (element.name == "vertex") {
+            vertex = &element;
+            break;
+        }
+        if (element.has_list && !ascii) {
+            std::cerr << filename << ": variable-size element before the vertices" << std::endl;
+            return false;
+        }
+        skip_bytes += element.count * element.stride;
+        skip_lines += element.count;
+    }
+    PlyVertexLayout layout(vertex ? *vertex : PlyElement());
+    if (!vertex || vertex->has_list || !layout.has_position()) {
+        std::cerr << filename << ": no vertex element with x, y, z" << std::endl;
+        return false;
+    }
+
+    const char* file_end = text + file.size;
+    points.resize(vertex->count);
+    if (ascii) {
+        const char* cursor = body;
+        for (size_t i = 0; i < skip_lines && cursor < file_end; i++) {
+            while (cursor < file_end && *cursor != '\n') cursor++;
+            cursor++;
+        }
+        // Tokens are copied out for strtod, the mapping is not null terminated
+        std::vector<double> values(vertex->properties.size());
+        char token[64];
+        for (size_t i = 0; i < vertex->count; i++) {
+            for (double& value : values) {
+                while (cursor < file_end && std::isspace((unsigned char)*cursor)) cursor++;
+                const char* number = cursor;
+                while (cursor < file_end && !std::isspace((unsigned char)*cursor)) cursor++;
+                if (number == cursor) {
+                    std::cerr << filename << ": truncated at vertex " << i << std::endl;
+                    points.resize(i);
+                    return false;
+                }
+                size_t length = std::min((size_t)(cursor - number), sizeof(token) - 1);
+                std::memcpy(token, number, length);
+                token[length] = '\0';
+                value = std::strtod(token, nullptr);
+            }
+            points[i] = ply_point(layout, vertex->properties, values.data());
+        }
+        return true;
+    }
+
+    const unsigned char* records = (const unsigned char*)body + skip_bytes;
+    if (records + vertex->count * vertex->stride > (const unsigned char*)file_end) {
+        std::cerr << filename << ": truncated vertex data" << std::endl;
+        points.clear();
+        return false;
+    }
+    auto convert = [&](size_t begin, size_t end) {
+        std::vector<double> values(vertex->properties.size());
+        for (size_t i = begin; i < end; i++) {
+            const unsigned char* record = records + i * vertex->stride;
+            for (size_t p = 0; p < values.size(); p++) values[p] = ply_value(record + vertex->properties[p].offset, vertex->properties[p].type);
+            points[i] = ply_point(layout, vertex->properties, values.data());
+        }
+    };
+    if (jobs) jobs->parallel_for(0, vertex->count, 65536, convert);
+    else convert(0, vertex->count);
+    return true;
+}
+
+bool read_points(const std::string& filename, std::vector<CloudPoint>& points, JobSystem* jobs) {
+    MappedFile file;
+    if (!file.open(filename) || !file.data) {
+        std::cerr << "Failed to open " << filename << std::endl;
+        return false;
+    }
+    if (file.size >= 3 && std::memcmp(file.data, "ply", 3) == 0) return read_ply_points(file, filename, points, jobs);
+
+    // Raw CloudPoint records
+    if (file.size % sizeof(CloudPoint) != 0) {
+        std::cerr << filename << ": not a PLY file or a multiple of " << sizeof(CloudPoint) << "-byte points" << std::endl;
+        return false;
+    }
+    points.resize(file.size / sizeof(CloudPoint));
+    auto copy = [&](size_t begin, size_t end) {
+        std::memcpy(points.data() + begin, file.data + begin * sizeof(CloudPoint), (end - begin) * sizeof(CloudPoint));
+    };
+    if (jobs) jobs->parallel_for(0, points.size(), 262144, copy);
+    else copy(0, points.size());
+    return true;
+}
+
+bool write_points_ply(const std::string& filename, const std::vector<CloudPoint>& points) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) return false;
+    file << "ply\nformat binary_little_endian 1.0\nelement vertex " << points.size() << "\n"
+         << "property float x\nproperty float y\nproperty float z\n"
+         << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+         << "property float radius\nend_header\n";
+    std::vector<unsigned char> record(19);
+    for (const CloudPoint& point : points) {
+        std::memcpy(record.data(), &point.position, 12);
+        record[12] = (unsigned char)(point.color & 0xFF);
+        record[13] = (unsigned char)((point.color >> 8) & 0xFF);
+        record[14] = (unsigned char)((point.color >> 16) & 0xFF);
+        std::memcpy(record.data() + 15, &point.radius, 4);
+        file.write((const char*)record.data(), record.size());
+    }
+    return (bool)file;
+}
+
+void PointSelection::clear() {
+    firsts.clear();
+    counts.clear();
+    points = 0;
+    nodes = 0;
+    budget_limited = false;
+}
+
+bool PointCloud::load(const std::string& filename, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<CloudPoint> input;
+    if (!read_points(filename, input, jobs)) return false;
+    if (input.empty() || input.size() > UINT32_MAX) {
+        std::cerr << filename << ": " << input.size() << " points" << std::endl;
+        return false;
+    }
+    auto read = std::chrono::steady_clock::now();
+    load_ms = std::chrono::duration<float, std::milli>(read - start).count();
+
+    build(std::move(input));
+    build_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - read).count();
+    return true;
+}
+
+void PointCloud::build(std::vector<CloudPoint> input) {
+    PROFILE_SCOPE("Build Point Octree");
+    points.clear();
+    nodes.clear();
+    leaf_spacing = 0.0f;
+    if (input.empty()) return;
+
+    // Root cube around the bounding box, padded so the maximum lands inside the last cell
+    glm::vec3 lo = input[0].position, hi = input[0].position;
+    for (const CloudPoint& point : input) {
+        lo = glm::min(lo, point.position);
+        hi = glm::max(hi, point.position);
+    }
+    glm::vec3 extent = hi - lo;
+    PointNode root;
+    root.size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+    root.min = lo;
+    root.spacing = root.size / GRID;
+    nodes.push_back(root);
+
+    std::vector<uint32_t> order(input.size());
+    for (uint32_t i = 0; i < (uint32_t)order.size(); i++) order[i] = i;
+    std::vector<uint32_t> scratch(input.size());
+    std::vector<uint64_t> occupied(GRID * GRID * GRID / 64);
+    std::vector<Range> own;
+    own.push_back({0, 0});
+    build_node(0, 0, (uint32_t)input.size(), input, order, scratch, occupied, own);
+
+    // Breadth-first layout, coarse levels first
+    points.resize(input.size());
+    std::vector<int> queue = {0};
+    uint32_t next = 0;
+    double spacing_sum = 0.0;
+    size_t leaf_points = 0;
+    for (size_t q = 0; q < queue.size(); q++) {
+        PointNode& node = nodes[queue[q]];
+        const Range& range = own[queue[q]];
+        node.first = next;
+        node.count = range.end - range.begin;
+        for (uint32_t i = range.begin; i < range.end; i++) points[next++] = input[order[i]];
+
+        bool leaf = true;
+        for (int child : node.children) {
+            if (child < 0) continue;
+            queue.push_back(child);
+            leaf = false;
+        }
+        // Surface sampling assumption: a leaf's points cover its cube like a plane
+        if (leaf) {
+            spacing_sum += node.size / std::sqrt((double)std::max(node.count, 1u)) * node.count;
+            leaf_points += node.count;
+        }
+    }
+    leaf_spacing = leaf_points > 0 ? (float)(spacing_sum / leaf_points) : root.spacing;
+}
+
+void PointCloud::build_node(int index, uint32_t begin, uint32_t end, const std::vector<CloudPoint>& input, std::vector<uint32_t>& order,
+                            std::vector<uint32_t>& scratch, std::vector<uint64_t>& occupied, std::vector<Range>& own) {
+    PointNode node = nodes[index];      // Copy, nodes grows below
+    if (end - begin <= LEAF_POINTS || node.level >= MAX_DEPTH) {
+        own[index] = {begin, end};
+        return;
+    }
+
+    // The first point in each grid cell stays in this node, moved to the front of the range
+    std::fill(occupied.begin(), occupied.end(), 0);
+    float cells_per_unit = GRID / node.size;
+    uint32_t sampled = begin;
+    for (uint32_t i = begin; i < end; i++) {
+        glm::vec3 cell = (input[order[i]].position - node.min) * cells_per_unit;
+        auto axis = [](float v) { return (uint32_t)std::min(std::max((int)v, 0), GRID - 1); };
+        uint32_t id = (axis(cell.z) * GRID + axis(cell.y)) * GRID + axis(cell.x);
+        uint64_t bit = 1ull << (id & 63);
+        if (occupied[id >> 6] & bit) continue;
+        occupied[id >> 6] |= bit;
+        std::swap(order[i], order[sampled++]);
+    }
+    own[index] = {begin, sampled};
+
+    // The rest goes to the children by octant, counting sort through the scratch buffer
+    glm::vec3 half = node.min + glm::vec3(node.size * 0.5f);
+    auto octant = [&](uint32_t point) {
+        const glm::vec3& p = input[point].position;
+        return (p.x >= half.x ? 1 : 0) | (p.y >= half.y ? 2 : 0) | (p.z >= half.z ? 4 : 0);
+    };
+    uint32_t counts[8] = {};
+    for (uint32_t i = sampled; i < end; i++) counts[octant(order[i])]++;
+    uint32_t offsets[8];
+    uint32_t offset = sampled;
+    for (int o = 0; o < 8; o++) {
+        offsets[o] = offset;
+        offset += counts[o];
+    }
+    uint32_t write[8];
+    std::copy(offsets, offsets + 8, write);
+    for (uint32_t i = sampled; i < end; i++) scratch[write[octant(order[i])]++] = order[i];
+    std::copy(scratch.begin() + sampled, scratch.begin() + end, order.begin() + sampled);
+
+    for (int o = 0; o < 8; o++) {
+        if (counts[o] == 0) continue;
+        PointNode child;
+        child.size = node.size * 0.5f;
+        child.min = node.min + glm::vec3(o & 1 ? child.size : 0.0f, o & 2 ? child.size : 0.0f, o & 4 ? child.size : 0.0f);
+        child.spacing = child.size / GRID;
+        child.level = (uint8_t)(node.level + 1);
+        int child_index = (int)nodes.size();
+        nodes[index].children[o] = child_index;
+        nodes.push_back(child);
+        own.push_back({0, 0});
+        build_node(child_index, offsets[o], offsets[o] + counts[o], input, order, scratch, occupied, own);
+    }
+}
+
+void PointCloud::select(const Frustum& frustum, const glm::vec3& camera, float projection_scale, size_t resident,
+                        const PointLod& lod, PointSelection& selection) const {
+    selection.clear();
+    if (nodes.empty()) return;
+
+    // Projected spacing in pixels, nodes around the camera refine first
+    auto error = [&](const PointNode& node) {
+        float distance = std::max(glm::length(node.center() - camera) - node.radius(), 1e-3f);
+        return node.spacing * projection_scale / distance;
+    };
+    auto wanted = [&](const PointNode& node) {
+        return node.first + node.count <= resident && frustum.intersects_sphere(node.center(), node.radius());
+    };
+
+    // Per-frame temporaries in the thread's scratch arena, each node enters them at most once
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    typedef std::pair<float, int> Entry;
+    ArenaVector<std::pair<uint32_t, uint32_t>> ranges{ArenaAllocator<std::pair<uint32_t, uint32_t>>(scratch)};
+    ArenaVector<Entry> entries{ArenaAllocator<Entry>(scratch)};
+    ranges.reserve(nodes.size());
+    entries.reserve(nodes.size());
+    std::priority_queue<Entry, ArenaVector<Entry>> queue(std::less<Entry>(), std::move(entries));
+    if (wanted(nodes[0])) queue.push({error(nodes[0]), 0});
+    while (!queue.empty()) {
+        auto [node_error, index] = queue.top();
+        queue.pop();
+        const PointNode& node = nodes[index];
+        if (selection.points + node.count > lod.budget) {
+            selection.budget_limited = true;
+            break;
+        }
+        ranges.push_back({node.first, node.count});
+        selection.points += node.count;
+        selection.nodes++;
+        if (node_error <= lod.max_error) continue;
+
+        for (int child : node.children) {
+            if (child >= 0 && wanted(nodes[child])) queue.push({error(nodes[child]), child});
+        }
+    }
+
+    // Siblings are adjacent in the breadth-first layout, merge them into one draw
+    std::sort(ranges.begin(), ranges.end());
+    for (const auto& range : ranges) {
+        if (range.second == 0) continue;
+        if (!selection.firsts.empty() && (uint32_t)(selection.firsts.back() + selection.counts.back()) == range.first) {
+            selection.counts.back() += (GLsizei)range.second;
+            continue;
+        }
+        selection.firsts.push_back((GLint)range.first);
+        selection.counts.push_back((GLsizei)range.second);
+    }
+}
+
+PointCloudRenderer::PointCloudRenderer() : shader("point") {
+    glGenVertexArrays(1, &vao);
+}
+
+void PointCloudRenderer::release() {
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (vao) glDeleteVertexArrays(1, &vao);
+    vbo = vao = 0;
+    capacity = 0;
+    uploaded.store(0, std::memory_order_release);
+}
+
+void PointCloudRenderer::upload(const PointCloud& cloud, size_t budget_bytes) {
+    if (capacity != cloud.points.size()) {
+        // New cloud: allocate the whole buffer, fill it front to back
+        if (!vbo) glGenBuffers(1, &vbo);
+        glBindVertexArray(vao);
+        RenderStats::instance().vao_bind();
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, cloud.points.size() * sizeof(CloudPoint), nullptr, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CloudPoint), (void*)offsetof(CloudPoint, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CloudPoint), (void*)offsetof(CloudPoint, color));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(CloudPoint), (void*)offsetof(CloudPoint, radius));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+        capacity = cloud.points.size();
+        uploaded.store(0, std::memory_order_release);
+    }
+
+    size_t done = uploaded.load(std::memory_order_relaxed);
+    size_t count = std::min(capacity - done, std::max(budget_bytes / sizeof(CloudPoint), (size_t)1));
+    if (count == 0) return;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, done * sizeof(CloudPoint), count * sizeof(CloudPoint), cloud.points.data() + done);
+    RenderStats::instance().buffer_upload(count * sizeof(CloudPoint));
+    uploaded.store(done + count, std::memory_order_release);
+}
+
+void PointCloudRenderer::draw(const PointSelection& selection, const glm::mat4& view, const glm::mat4& projection, float viewport_height, float default_radius) {
+    if (selection.firsts.empty()) return;
+
+    glm::mat4 model(1.0f), view_matrix = view, projection_matrix = projection;
+    shader.use();
+    shader.setMat4("model", model);
+    shader.setMat4("view", view_matrix);
+    shader.setMat4("projection", projection_matrix);
+    shader.setFloat("viewport_height", viewport_height);
+    shader.setFloat("default_radius", default_radius);
+    // Impostor normals are in view space, so is the light
+    glm::vec3 light = glm::mat3(view) * glm::normalize(glm::vec3(-0.2f, -1.0f, -0.3f));
+    shader.setVec3("light_direction", light);
+    shader.setVec3("light_color", glm::vec3(1.0f));
+    shader.setFloat("specular_strength", 0.3f);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(vao);
+    RenderStats::instance().vao_bind();
+    glMultiDrawArrays(GL_POINTS, selection.firsts.data(), selection.counts.data(), (GLsizei)selection.firsts.size());
+    RenderStats::instance().draw_points(selection.points);
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+}
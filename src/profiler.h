@@ -0,0 +1,339 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+// Compile the profiler out entirely with -DPROFILER_ENABLED=0. When compiled in
+// but switched off at runtime a scope costs one relaxed atomic load.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// A finished CPU or GPU zone. Times are steady_clock nanoseconds, GPU zones are
+// mapped onto the same timeline.
+struct ProfileZone {
+    const char* name;               // Must outlive the profiler, use string literals
+    int64_t start_ns;
+    int64_t end_ns;
+    uint32_t frame;
+    uint16_t depth;
+    uint16_t thread;                // Index into Profiler::threads(), GPU_THREAD for GPU zones
+};
+
+// Per-thread ring of finished zones. Only the owning thread writes, readers
+// copy out and drop anything the writer may have lapped in the meantime.
+struct ThreadProfile {
+    static constexpr size_t CAPACITY = 1 << 16;    // Power of two
+
+    std::unique_ptr<ProfileZone[]> zones{new ProfileZone[CAPACITY]};
+    std::atomic<uint64_t> count{0};
+    uint16_t depth = 0;
+    uint16_t id = 0;
+    std::string name;
+};
+
+class Profiler {
+public:
+    static constexpr uint16_t GPU_THREAD = 0xFFFF;
+    static constexpr int GPU_LATENCY = 4;           // Frames between issuing queries and reading them
+    static constexpr size_t FRAME_HISTORY = 256;
+    static constexpr size_t GPU_CAPACITY = 1 << 14;
+
+    static Profiler& instance();
+
+    std::atomic<bool> enabled{true};
+
+    // Call once per frame on the GL thread, e.g. right after the buffer swap
+    void begin_frame();
+    uint32_t frame() const { return current_frame.load(std::memory_order_relaxed); }
+    static int64_t now_ns();
+
+    // Thread registration, called lazily by the first zone on a thread
+    ThreadProfile* thread_profile();
+    void set_thread_name(const std::string& name);
+    std::vector<std::string> thread_names() const;
+
+    // GPU zones, GL thread only. Timestamps instead of GL_TIME_ELAPSED so zones nest.
+    int gpu_begin(const char* name);
+    void gpu_end(int zone);
+
+    // Zones overlapping [begin_ns, end_ns), CPU zones of all threads then GPU zones
+    void collect(int64_t begin_ns, int64_t end_ns, std::vector<ProfileZone>& out) const;
+    // Start time of a recent frame, false if it's no longer in the history
+    bool frame_range(uint32_t frame, int64_t& begin_ns, int64_t& end_ns) const;
+    bool export_chrome_trace(const std::string& filename) const;
+
+    size_t gpu_frames_dropped() const { return gpu_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct GpuPending {
+        const char* name;
+        uint16_t depth;
+        int begin_query;
+        int end_query;
+    };
+
+    struct GpuFrame {
+        std::vector<GLuint> queries;
+        std::vector<GpuPending> zones;
+        int used = 0;
+        uint32_t frame = 0;
+        int64_t cpu_reference = 0;      // CPU and GPU clocks sampled together at frame start
+        int64_t gpu_reference = 0;
+    };
+
+    mutable std::mutex threads_mutex;       // Also guards gpu_zones and gpu_count, resolved on the GL thread
+    std::vector<std::unique_ptr<ThreadProfile>> thread_list;
+
+    std::atomic<uint32_t> current_frame{0};
+    int64_t frame_starts[FRAME_HISTORY] = {};
+
+    GpuFrame gpu_frames[GPU_LATENCY];
+    std::vector<ProfileZone> gpu_zones;     // Ring of resolved GPU zones
+    uint64_t gpu_count = 0;
+    uint16_t gpu_depth = 0;
+    std::atomic<size_t> gpu_dropped{0};
+    bool gpu_available = false;
+
+    int gpu_query();
+    void resolve_gpu_frame(GpuFrame& frame);
+};
+
+inline thread_local ThreadProfile* tls_thread_profile = nullptr;
+
+// RAII CPU zone
+struct ProfileScope {
+    ThreadProfile* thread = nullptr;
+    const char* name;
+    int64_t start;
+    uint16_t depth;
+
+    explicit ProfileScope(const char* zone_name) {
+        Profiler& profiler = Profiler::instance();
+        if (!profiler.enabled.load(std::memory_order_relaxed)) return;
+        thread = profiler.thread_profile();
+        name = zone_name;
+        depth = thread->depth++;
+        start = Profiler::now_ns();
+    }
+
+    ~ProfileScope() {
+        if (!thread) return;
+        int64_t end = Profiler::now_ns();
+        uint64_t index = thread->count.load(std::memory_order_relaxed);
+        thread->zones[index & (ThreadProfile::CAPACITY - 1)] = {name, start, end, Profiler::instance().frame(), depth, thread->id};
+        thread->count.store(index + 1, std::memory_order_release);
+        thread->depth--;
+    }
+};
+
+// Called with the zone name on entry and nullptr on exit of every GPU scope,
+// even while the profiler is disabled. GLTrace uses it to mark call groups.
+inline void (*gpu_scope_hook)(const char* name) = nullptr;
+
+// RAII GPU zone, GL thread only
+struct GpuProfileScope {
+    int zone = -1;
+
+    explicit GpuProfileScope(const char* name) {
+        Profiler& profiler = Profiler::instance();
+        if (gpu_scope_hook) gpu_scope_hook(name);
+        if (profiler.enabled.load(std::memory_order_relaxed)) zone = profiler.gpu_begin(name);
+    }
+    ~GpuProfileScope() {
+        if (zone >= 0) Profiler::instance().gpu_end(zone);
+        if (gpu_scope_hook) gpu_scope_hook(nullptr);
+    }
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#endif
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadProfile* Profiler::thread_profile() {
+    if (tls_thread_profile) return tls_thread_profile;
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    thread_list.push_back(std::make_unique<ThreadProfile>());
+    ThreadProfile* thread = thread_list.back().get();
+    thread->id = (uint16_t)(thread_list.size() - 1);
+    thread->name = "Thread " + std::to_string(thread->id);
+    tls_thread_profile = thread;
+    return thread;
+}
+
+void Profiler::set_thread_name(const std::string& name) {
+    ThreadProfile* thread = thread_profile();
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    thread->name = name;
+}
+
+std::vector<std::string> Profiler::thread_names() const {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    std::vector<std::string> names;
+    for (const auto& thread : thread_list) names.push_back(thread->name);
+    return names;
+}
+
+void Profiler::begin_frame() {
+    uint32_t frame = current_frame.load(std::memory_order_relaxed) + 1;
+    int64_t now = now_ns();
+    frame_starts[frame % FRAME_HISTORY] = now;
+    current_frame.store(frame, std::memory_order_relaxed);
+
+    // Timer queries need a GL context, the profiler also runs in CPU-only tools
+    gpu_available = glQueryCounter != nullptr && glGetInteger64v != nullptr;
+    if (!gpu_available) return;
+    if (gpu_zones.empty()) {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        gpu_zones.resize(GPU_CAPACITY);
+    }
+
+    // The slot about to be reused was issued GPU_LATENCY frames ago
+    GpuFrame& slot = gpu_frames[frame % GPU_LATENCY];
+    if (!slot.zones.empty()) resolve_gpu_frame(slot);
+
+    slot.zones.clear();
+    slot.used = 0;
+    slot.frame = frame;
+    gpu_depth = 0;
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    slot.cpu_reference = now_ns();
+    slot.gpu_reference = gpu_now;
+}
+
+int Profiler::gpu_query() {
+    GpuFrame& slot = gpu_frames[frame() % GPU_LATENCY];
+    if (slot.used == (int)slot.queries.size()) {
+        slot.queries.push_back(0);
+        glGenQueries(1, &slot.queries.back());
+    }
+    glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP);
+    return slot.used++;
+}
+
+int Profiler::gpu_begin(const char* name) {
+    if (!gpu_available) return -1;
+    GpuFrame& slot = gpu_frames[frame() % GPU_LATENCY];
+    slot.zones.push_back({name, gpu_depth++, gpu_query(), -1});
+    return (int)slot.zones.size() - 1;
+}
+
+void Profiler::gpu_end(int zone) {
+    GpuFrame& slot = gpu_frames[frame() % GPU_LATENCY];
+    if (zone >= (int)slot.zones.size()) return;     // begin_frame() ran inside the scope
+    slot.zones[zone].end_query = gpu_query();
+    gpu_depth--;
+}
+
+void Profiler::resolve_gpu_frame(GpuFrame& slot) {
+    // Never wait on the GPU. If the last query of the frame isn't ready the
+    // frame's zones are dropped rather than stalling the pipeline.
+    GLuint available = 0;
+    glGetQueryObjectuiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        gpu_dropped++;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    for (const GpuPending& pending : slot.zones) {
+        if (pending.end_query < 0) continue;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(slot.queries[pending.begin_query], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(slot.queries[pending.end_query], GL_QUERY_RESULT, &end);
+
+        ProfileZone zone;
+        zone.name = pending.name;
+        zone.start_ns = slot.cpu_reference + ((int64_t)begin - slot.gpu_reference);
+        zone.end_ns = slot.cpu_reference + ((int64_t)end - slot.gpu_reference);
+        zone.frame = slot.frame;
+        zone.depth = pending.depth;
+        zone.thread = GPU_THREAD;
+        gpu_zones[gpu_count++ & (GPU_CAPACITY - 1)] = zone;
+    }
+}
+
+void Profiler::collect(int64_t begin_ns, int64_t end_ns, std::vector<ProfileZone>& out) const {
+    out.clear();
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    for (const auto& thread : thread_list) {
+        uint64_t count = thread->count.load(std::memory_order_acquire);
+        uint64_t first = count > ThreadProfile::CAPACITY ? count - ThreadProfile::CAPACITY : 0;
+        size_t mark = out.size();
+        for (uint64_t i = first; i < count; i++) {
+            const ProfileZone& zone = thread->zones[i & (ThreadProfile::CAPACITY - 1)];
+            if (zone.end_ns > begin_ns && zone.start_ns < end_ns) out.push_back(zone);
+        }
+
+        // Entries the writer overwrote while we were copying are unreliable
+        uint64_t after = thread->count.load(std::memory_order_acquire);
+        if (after - first > ThreadProfile::CAPACITY) out.resize(mark);
+    }
+
+    // The GL thread resolves GPU zones under the same lock
+    uint64_t first = gpu_count > GPU_CAPACITY ? gpu_count - GPU_CAPACITY : 0;
+    for (uint64_t i = first; i < gpu_count; i++) {
+        const ProfileZone& zone = gpu_zones[i & (GPU_CAPACITY - 1)];
+        if (zone.end_ns > begin_ns && zone.start_ns < end_ns) out.push_back(zone);
+    }
+}
+
+bool Profiler::frame_range(uint32_t frame, int64_t& begin_ns, int64_t& end_ns) const {
+    uint32_t current = this->frame();
+    if (frame == 0 || frame >= current || current - frame >= FRAME_HISTORY - 1) return false;
+    begin_ns = frame_starts[frame % FRAME_HISTORY];
+    end_ns = frame_starts[(frame + 1) % FRAME_HISTORY];
+    return true;
+}
+
+bool Profiler::export_chrome_trace(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file) return false;
+
+    std::vector<ProfileZone> zones;
+    collect(INT64_MIN, INT64_MAX, zones);
+    int64_t origin = INT64_MAX;
+    for (const auto& zone : zones) origin = std::min(origin, zone.start_ns);
+
+    // Complete ("X") events in microseconds, one track per thread plus one for the GPU
+    file << "{\"traceEvents\":[\n";
+    std::vector<std::string> names = thread_names();
+    for (size_t i = 0; i < names.size(); i++) {
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":\"" << names[i] << "\"}},\n";
+    }
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+
+    for (const auto& zone : zones) {
+        file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << zone.thread
+             << ",\"ts\":" << (zone.start_ns - origin) / 1000.0 << ",\"dur\":" << (zone.end_ns - zone.start_ns) / 1000.0
+             << ",\"args\":{\"frame\":" << zone.frame << "}}";
+    }
+    file << "\n]}\n";
+    return (bool)file;
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <imgui.h>
+
+#include "profiler.h"
+#include "memory.h"
+
+#include <cstring>
+#include <map>
+
+// ImGui front end for the profiler: a per-thread timeline of recent frames, a
+// flame graph aggregated over many frames and Chrome trace export.
+class ProfilerWindow {
+public:
+    bool open = true;
+
+    void draw();
+
+private:
+    struct FlameNode {
+        const char* name = nullptr;
+        int64_t total_ns = 0;
+        int calls = 0;
+        std::vector<int> children = {};
+    };
+
+    bool paused = false;
+    int timeline_frames = 1;
+    int flame_frames = 60;
+    int flame_thread = 0;
+    uint32_t shown_frame = 0;
+    int64_t view_begin = 0, view_end = 0;
+    std::vector<ProfileZone> zones;
+    std::vector<ProfileZone> flame_zones;
+    std::vector<FlameNode> flame;
+    std::string status;
+    BlockPool lane_nodes{64};               // Nodes of the per-frame lane map
+
+    void draw_timeline();
+    void draw_flame_graph();
+    void build_flame_graph();
+    float draw_flame_node(ImDrawList* draw_list, int node, ImVec2 origin, float x, float width, int depth, float row_height);
+};
+
+// Stable color per zone name
+inline ImU32 profile_zone_color(const char* name, float alpha = 1.0f) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = name; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    int r = 80 + (hash & 0x7F), g = 80 + ((hash >> 8) & 0x7F), b = 80 + ((hash >> 16) & 0x7F);
+    return IM_COL32(r, g, b, (int)(alpha * 255));
+}
+
+void ProfilerWindow::draw() {
+    if (!open) return;
+    Profiler& profiler = Profiler::instance();
+
+    ImGui::Begin("Profiler", &open);
+    bool enabled = profiler.enabled.load();
+    if (ImGui::Checkbox("Enabled", &enabled)) profiler.enabled.store(enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome Trace")) {
+        status = profiler.export_chrome_trace("profile_trace.json") ? "Wrote profile_trace.json" : "Failed to write profile_trace.json";
+    }
+    if (!status.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", status.c_str());
+    }
+    ImGui::SliderInt("Timeline Frames", &timeline_frames, 1, 16);
+    ImGui::SliderInt("Flame Graph Frames", &flame_frames, 1, 240);
+
+    // Show frames whose GPU queries have already been read back
+    if (!paused) {
+        uint32_t last = profiler.frame() > Profiler::GPU_LATENCY + 1 ? profiler.frame() - Profiler::GPU_LATENCY - 1 : 0;
+        int64_t begin, end, unused;
+        uint32_t first = last > (uint32_t)timeline_frames ? last - timeline_frames + 1 : 1;
+        if (profiler.frame_range(first, begin, unused) && profiler.frame_range(last, unused, end)) {
+            shown_frame = last;
+            view_begin = begin;
+            view_end = end;
+            profiler.collect(view_begin, view_end, zones);
+        }
+
+        uint32_t flame_first = last > (uint32_t)flame_frames ? last - flame_frames + 1 : 1;
+        if (profiler.frame_range(flame_first, begin, unused) && profiler.frame_range(last, unused, end)) {
+            profiler.collect(begin, end, flame_zones);
+            build_flame_graph();
+        }
+    }
+
+    if (zones.empty()) {
+        ImGui::TextDisabled("No zones recorded yet");
+    } else {
+        ImGui::Text("Frame %u: %.2f ms", shown_frame, (view_end - view_begin) / 1.0e6);
+        draw_timeline();
+        ImGui::Separator();
+        draw_flame_graph();
+    }
+    ImGui::End();
+}
+
+void ProfilerWindow::draw_timeline() {
+    std::vector<std::string> names = Profiler::instance().thread_names();
+
+    // One lane per thread with zones in view, GPU last, rows stacked by depth
+    std::map<uint16_t, int, std::less<uint16_t>, PoolAllocator<std::pair<const uint16_t, int>>> lane_depths{
+        PoolAllocator<std::pair<const uint16_t, int>>(lane_nodes)};
+    for (const auto& zone : zones) {
+        int& depth = lane_depths[zone.thread];
+        depth = std::max(depth, (int)zone.depth + 1);
+    }
+
+    const float row_height = ImGui::GetTextLineHeight() + 4.0f;
+    const float label_width = 90.0f;
+    float height = 0.0f;
+    for (const auto& lane : lane_depths) height += (lane.second + 0.5f) * row_height;
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x - label_width, 50.0f);
+    double scale = width / (double)std::max<int64_t>(view_end - view_begin, 1);
+    ImVec2 mouse = ImGui::GetMousePos();
+    const ProfileZone* hovered = nullptr;
+
+    float y = origin.y;
+    for (const auto& lane : lane_depths) {
+        const char* lane_name = lane.first == Profiler::GPU_THREAD ? "GPU" : lane.first < names.size() ? names[lane.first].c_str() : "?";
+        draw_list->AddText(ImVec2(origin.x, y + 2.0f), IM_COL32(200, 200, 200, 255), lane_name);
+
+        float x0 = origin.x + label_width;
+        draw_list->PushClipRect(ImVec2(x0, y), ImVec2(x0 + width, y + lane.second * row_height), true);
+        for (const auto& zone : zones) {
+            if (zone.thread != lane.first) continue;
+            float left = x0 + (float)((zone.start_ns - view_begin) * scale);
+            float right = std::max(x0 + (float)((zone.end_ns - view_begin) * scale), left + 1.0f);
+            float top = y + zone.depth * row_height;
+            ImVec2 a(left, top), b(right, top + row_height - 1.0f);
+            draw_list->AddRectFilled(a, b, profile_zone_color(zone.name));
+            if (right - left > ImGui::CalcTextSize(zone.name).x + 4.0f)
+                draw_list->AddText(ImVec2(left + 2.0f, top + 2.0f), IM_COL32(0, 0, 0, 255), zone.name);
+            if (mouse.x >= a.x && mouse.x < b.x && mouse.y >= a.y && mouse.y < b.y) hovered = &zone;
+        }
+        draw_list->PopClipRect();
+        y += (lane.second + 0.5f) * row_height;
+    }
+
+    ImGui::Dummy(ImVec2(label_width + width, height));
+    if (hovered && ImGui::IsItemHovered())
+        ImGui::SetTooltip("%s\n%.3f ms (frame %u)", hovered->name, (hovered->end_ns - hovered->start_ns) / 1.0e6, hovered->frame);
+}
+
+void ProfilerWindow::build_flame_graph() {
+    flame.clear();
+    flame.push_back({"All"});
+
+    std::vector<ProfileZone> thread_zones;
+    for (const auto& zone : flame_zones)
+        if (zone.thread == (uint16_t)flame_thread) thread_zones.push_back(zone);
+    std::sort(thread_zones.begin(), thread_zones.end(), [](const ProfileZone& a, const ProfileZone& b) {
+        return a.start_ns != b.start_ns ? a.start_ns < b.start_ns : a.depth < b.depth;
+    });
+
+    // Merge zones with the same call path, parents are whatever encloses a zone
+    std::vector<std::pair<int64_t, int>> stack;     // (end time, node)
+    for (const auto& zone : thread_zones) {
+        while (!stack.empty() && stack.back().first <= zone.start_ns) stack.pop_back();
+        int parent = stack.empty() ? 0 : stack.back().second;
+
+        int node = -1;
+        for (int child : flame[parent].children) {
+            if (flame[child].name == zone.name || std::strcmp(flame[child].name, zone.name) == 0) {
+                node = child;
+                break;
+            }
+        }
+        if (node < 0) {
+            node = (int)flame.size();
+            flame.push_back({zone.name});
+            flame[parent].children.push_back(node);
+        }
+        flame[node].total_ns += zone.end_ns - zone.start_ns;
+        flame[node].calls++;
+        if (parent == 0) flame[0].total_ns += zone.end_ns - zone.start_ns;
+        stack.push_back({zone.end_ns, node});
+    }
+}
+
+float ProfilerWindow::draw_flame_node(ImDrawList* draw_list, int node, ImVec2 origin, float x, float width, int depth, float row_height) {
+    const FlameNode& flame_node = flame[node];
+    float top = origin.y + depth * row_height;
+    ImVec2 a(origin.x + x, top), b(origin.x + x + std::max(width, 1.0f), top + row_height - 1.0f);
+    draw_list->AddRectFilled(a, b, profile_zone_color(flame_node.name));
+    if (width > ImGui::CalcTextSize(flame_node.name).x + 4.0f)
+        draw_list->AddText(ImVec2(a.x + 2.0f, top + 2.0f), IM_COL32(0, 0, 0, 255), flame_node.name);
+
+    ImVec2 mouse = ImGui::GetMousePos();
+    if (mouse.x >= a.x && mouse.x < b.x && mouse.y >= a.y && mouse.y < b.y) {
+        ImGui::SetTooltip("%s\n%.3f ms/frame, %.1f calls/frame", flame_node.name,
+                          flame_node.total_ns / 1.0e6 / flame_frames, (float)flame_node.calls / flame_frames);
+    }
+
+    // Children left to right, widths proportional to their share of the parent
+    float max_depth = (float)depth;
+    float child_x = x;
+    for (int child : flame_node.children) {
+        float child_width = flame_node.total_ns > 0 ? width * (float)flame[child].total_ns / flame_node.total_ns : 0.0f;
+        max_depth = std::max(max_depth, draw_flame_node(draw_list, child, origin, child_x, child_width, depth + 1, row_height));
+        child_x += child_width;
+    }
+    return max_depth;
+}
+
+void ProfilerWindow::draw_flame_graph() {
+    std::vector<std::string> names = Profiler::instance().thread_names();
+    if (names.empty()) return;
+    flame_thread = std::min(flame_thread, (int)names.size() - 1);
+    if (ImGui::BeginCombo("Flame Graph Thread", names[flame_thread].c_str())) {
+        for (int i = 0; i < (int)names.size(); i++) {
+            if (ImGui::Selectable(names[i].c_str(), i == flame_thread)) {
+                flame_thread = i;
+                build_flame_graph();
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (flame.size() < 2) return;
+
+    const float row_height = ImGui::GetTextLineHeight() + 4.0f;
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 50.0f);
+    float max_depth = draw_flame_node(draw_list, 0, origin, 0.0f, width, 0, row_height);
+    ImGui::Dummy(ImVec2(width, (max_depth + 1.0f) * row_height));
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+
+#include "memory.h"
+
+// GL work issued through RenderMesh, Shader and the asset uploads in one frame
+struct FrameStats {
+    uint32_t draw_calls = 0;
+    uint64_t triangles = 0;
+    uint64_t lines = 0;
+    uint64_t points = 0;
+    uint32_t program_binds = 0;     // glUseProgram calls, including redundant ones
+    uint32_t vao_binds = 0;         // Binds of a real VAO, unbinding to 0 is not counted
+    uint32_t uniform_uploads = 0;
+    uint64_t buffer_bytes = 0;      // glBufferData/glBufferSubData payloads
+    uint64_t index_bytes = 0;       // Index buffer bytes read by indexed draws
+    uint64_t allocations = 0;       // Heap allocations on any thread, see memory.h
+    uint64_t allocated_bytes = 0;
+};
+
+// Per-frame counters plus a rolling frame time history. The counting helpers
+// are plain increments so they stay in release builds.
+class RenderStats {
+public:
+    static constexpr size_t HISTORY = 600;      // Frames kept for min/avg/p99 and the plot
+
+    FrameStats frame;               // Frame being recorded
+    FrameStats last;                // Last finished frame
+
+    // end_frame() runs on the render thread when there is one, hold this while
+    // reading `last` or the history from another thread
+    std::mutex mutex;
+
+    static RenderStats& instance();
+
+    void draw_triangles(uint64_t count) { frame.draw_calls++; frame.triangles += count; }
+    void draw_lines(uint64_t count) { frame.draw_calls++; frame.lines += count; }
+    void draw_points(uint64_t count) { frame.draw_calls++; frame.points += count; }
+    void program_bind() { frame.program_binds++; }
+    void vao_bind() { frame.vao_binds++; }
+    void uniform_upload() { frame.uniform_uploads++; }
+    void buffer_upload(uint64_t bytes) { frame.buffer_bytes += bytes; }
+    void index_fetch(uint64_t bytes) { frame.index_bytes += bytes; }
+
+    // Closes the frame: frame time since the previous call goes into the history
+    // and the CSV log, the counters move to `last` and reset
+    void end_frame();
+
+    // Frame times oldest first, for plotting
+    const std::vector<float>& frame_times() const { return history_ordered; }
+    float min_ms() const { return summary[0]; }
+    float avg_ms() const { return summary[1]; }
+    float p99_ms() const { return summary[2]; }
+
+    // One row per frame until stopped, for soak runs
+    bool start_csv(const std::string& filename);
+    void stop_csv();
+    bool logging() { std::lock_guard<std::mutex> lock(mutex); return csv.is_open(); }
+    const std::string& csv_path() const { return csv_filename; }
+
+private:
+    std::vector<float> history;                 // Ring of frame times in ms
+    std::vector<float> history_ordered;
+    std::vector<float> sorted;                  // Scratch for the percentiles, kept to avoid a per-frame allocation
+    AllocationCounters previous_allocations;
+    size_t history_head = 0;
+    float summary[3] = {0.0f, 0.0f, 0.0f};
+    uint64_t frame_index = 0;
+    std::chrono::steady_clock::time_point previous;
+    bool has_previous = false;
+
+    std::ofstream csv;
+    std::string csv_filename;
+};
+
+RenderStats& RenderStats::instance() {
+    static RenderStats stats;
+    return stats;
+}
+
+void RenderStats::end_frame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    float frame_ms = has_previous ? std::chrono::duration<float, std::milli>(now - previous).count() : 0.0f;
+    previous = now;
+
+    if (has_previous) {
+        if (history.capacity() < HISTORY) {
+            history.reserve(HISTORY);
+            history_ordered.reserve(HISTORY);
+            sorted.reserve(HISTORY);
+        }
+        if (history.size() < HISTORY) {
+            history.push_back(frame_ms);
+        } else {
+            history[history_head] = frame_ms;
+            history_head = (history_head + 1) % HISTORY;
+        }
+
+        history_ordered.assign(history.begin() + history_head, history.end());
+        history_ordered.insert(history_ordered.end(), history.begin(), history.begin() + history_head);
+
+        sorted.assign(history.begin(), history.end());
+        std::sort(sorted.begin(), sorted.end());
+        float sum = 0.0f;
+        for (float ms : sorted) sum += ms;
+        summary[0] = sorted.front();
+        summary[1] = sum / sorted.size();
+        summary[2] = sorted[std::min(sorted.size() - 1, (size_t)(0.99f * (sorted.size() - 1) + 0.5f))];
+    }
+    has_previous = true;
+
+    AllocationCounters allocations = allocation_counters();
+    frame.allocations = allocations.count - previous_allocations.count;
+    frame.allocated_bytes = allocations.bytes - previous_allocations.bytes;
+    previous_allocations = allocations;
+
+    if (csv.is_open()) {
+        csv << frame_index << "," << frame_ms << "," << frame.draw_calls << "," << frame.triangles << "," << frame.lines << "," << frame.points << ","
+            << frame.program_binds << "," << frame.vao_binds << "," << frame.uniform_uploads << "," << frame.buffer_bytes << "," << frame.index_bytes << ","
+            << frame.allocations << "," << frame.allocated_bytes << "\n";
+    }
+
+    frame_index++;
+    last = frame;
+    frame = FrameStats();
+}
+
+bool RenderStats::start_csv(const std::string& filename) {
+    stop_csv();
+    std::lock_guard<std::mutex> lock(mutex);
+    csv.open(filename);
+    if (!csv) return false;
+    csv_filename = filename;
+    csv << "frame,frame_ms,draw_calls,triangles,lines,points,program_binds,vao_binds,uniform_uploads,buffer_bytes,index_bytes,allocations,allocated_bytes\n";
+    return true;
+}
+
+void RenderStats::stop_csv() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (csv.is_open()) csv.close();
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+
+#include "profiler.h"
+
+// Recorded GL work for one frame. Commands are callables constructed in place
+// in chunked storage, so recording does not allocate once the chunks have
+// grown to the frame's size and recorded objects never move.
+class CommandList {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    CommandList() = default;
+    CommandList(const CommandList&) = delete;
+    CommandList& operator=(const CommandList&) = delete;
+    ~CommandList() { clear(); }
+
+    template <typename F> void push(F&& function);
+    // Runs the commands in recording order, then destroys them
+    void execute();
+    void clear();
+    size_t size() const { return commands.size(); }
+
+private:
+    struct Command {
+        void* object;
+        void (*run)(void*);
+        void (*destroy)(void*);
+    };
+
+    std::vector<Command> commands;
+    std::vector<std::unique_ptr<uint8_t[]>> chunks;
+    std::vector<size_t> chunk_sizes;
+    size_t chunk = 0, offset = 0;
+
+    void* allocate(size_t size, size_t alignment);
+};
+
+// Dedicated thread that owns the GL context and executes command lists.
+// The main thread records frame N+1 while frame N executes; `frames` lists
+// (2 double, 3 triple buffering) bound how far ahead it may get. Handover
+// is two atomic counters; an idle render thread sleeps on a condition
+// variable, the main thread spins with yield when it runs too far ahead.
+class RenderThread {
+public:
+    static constexpr int MAX_FRAMES = 3;
+
+    struct Callbacks {
+        std::function<void()> attach;       // Make the context current, on the render thread
+        std::function<void()> begin_frame;  // Before each frame's commands, e.g. Profiler::begin_frame()
+        std::function<void(int)> present;   // After each frame with its list index, e.g. swap buffers
+        std::function<void()> detach;       // Release the context before the thread exits
+    };
+
+    // Timings of the last executed frame, in ms
+    std::atomic<float> execute_ms{0.0f};
+    std::atomic<float> idle_ms{0.0f};       // Render thread waiting for the main thread
+    float wait_ms = 0.0f;                   // Main thread waiting for a free list, main thread only
+
+    ~RenderThread() { stop(); }
+
+    // The caller must release the context first, attach() takes it over
+    void start(int frames, Callbacks callbacks);
+    // Finishes submitted frames and joins, the context is released afterwards
+    void stop();
+    bool running() const { return thread.joinable(); }
+    int frames_in_flight() const { return frames; }
+
+    // Main thread: wait for a free list, record into commands(slot), submit()
+    int acquire();
+    CommandList& commands(int slot) { return lists[slot]; }
+    void submit();
+    void wait_idle();
+
+private:
+    CommandList lists[MAX_FRAMES];
+    int frames = 2;
+    Callbacks callbacks;
+    std::atomic<uint64_t> submitted{0};     // Written by the main thread
+    std::atomic<uint64_t> completed{0};     // Written by the render thread
+    std::atomic<bool> quit{false};
+    std::mutex wake_mutex;                  // Pairs with `wake` so a submit cannot slip past the idle check
+    std::condition_variable wake;
+    std::thread thread;
+
+    void notify();
+
+    void run();
+};
+
+template <typename F> void CommandList::push(F&& function) {
+    using Callable = typename std::decay<F>::type;
+    void* object = new (allocate(sizeof(Callable), alignof(Callable))) Callable(std::forward<F>(function));
+    commands.push_back({object,
+                        [](void* callable) { (*static_cast<Callable*>(callable))(); },
+                        [](void* callable) { static_cast<Callable*>(callable)->~Callable(); }});
+}
+
+void* CommandList::allocate(size_t size, size_t alignment) {
+    while (true) {
+        if (chunk < chunks.size()) {
+            size_t aligned = (offset + alignment - 1) / alignment * alignment;
+            if (aligned + size <= chunk_sizes[chunk]) {
+                offset = aligned + size;
+                return chunks[chunk].get() + aligned;
+            }
+            // Skip to the next chunk, or append one big enough
+            chunk++;
+            offset = 0;
+            if (chunk < chunks.size()) continue;
+        }
+        size_t chunk_size = std::max(CHUNK_SIZE, size + alignment);
+        chunks.emplace_back(new uint8_t[chunk_size]);
+        chunk_sizes.push_back(chunk_size);
+        chunk = chunks.size() - 1;
+        offset = 0;
+    }
+}
+
+void CommandList::execute() {
+    for (const Command& command : commands) command.run(command.object);
+    clear();
+}
+
+void CommandList::clear() {
+    for (const Command& command : commands) command.destroy(command.object);
+    commands.clear();
+    chunk = 0;
+    offset = 0;
+}
+
+void RenderThread::start(int frame_count, Callbacks thread_callbacks) {
+    if (running()) return;
+    frames = std::min(std::max(frame_count, 2), MAX_FRAMES);
+    callbacks = std::move(thread_callbacks);
+    submitted.store(0);
+    completed.store(0);
+    quit.store(false);
+    thread = std::thread([this] { run(); });
+}
+
+void RenderThread::stop() {
+    if (!running()) return;
+    quit.store(true, std::memory_order_release);
+    notify();
+    thread.join();
+}
+
+int RenderThread::acquire() {
+    PROFILE_SCOPE("Wait Render Thread");
+    auto start = std::chrono::steady_clock::now();
+    uint64_t frame = submitted.load(std::memory_order_relaxed);
+    // The list for `frame` is free once the frame that used it last has completed
+    while (frame - completed.load(std::memory_order_acquire) >= (uint64_t)frames) std::this_thread::yield();
+    wait_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return (int)(frame % frames);
+}
+
+void RenderThread::submit() {
+    submitted.fetch_add(1, std::memory_order_release);
+    notify();
+}
+
+void RenderThread::notify() {
+    { std::lock_guard<std::mutex> lock(wake_mutex); }
+    wake.notify_one();
+}
+
+void RenderThread::wait_idle() {
+    while (completed.load(std::memory_order_acquire) < submitted.load(std::memory_order_relaxed)) std::this_thread::yield();
+}
+
+void RenderThread::run() {
+    Profiler::instance().set_thread_name("Render");
+    if (callbacks.attach) callbacks.attach();
+
+    uint64_t frame = 0;
+    auto idle_start = std::chrono::steady_clock::now();
+    while (true) {
+        if (frame == submitted.load(std::memory_order_acquire)) {
+            // Leave only once everything submitted before stop() has run
+            if (quit.load(std::memory_order_acquire) && frame == submitted.load(std::memory_order_acquire)) break;
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake.wait(lock, [&] {
+                return frame != submitted.load(std::memory_order_acquire) || quit.load(std::memory_order_acquire);
+            });
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        idle_ms.store(std::chrono::duration<float, std::milli>(start - idle_start).count(), std::memory_order_relaxed);
+        if (callbacks.begin_frame) callbacks.begin_frame();
+        {
+            PROFILE_SCOPE("Execute Frame");
+            PROFILE_GPU_SCOPE("Frame");
+            lists[frame % frames].execute();
+        }
+        if (callbacks.present) callbacks.present((int)(frame % frames));
+        idle_start = std::chrono::steady_clock::now();
+        execute_ms.store(std::chrono::duration<float, std::milli>(idle_start - start).count(), std::memory_order_relaxed);
+
+        completed.store(++frame, std::memory_order_release);
+    }
+
+    if (callbacks.detach) callbacks.detach();
+}
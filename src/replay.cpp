@@ -0,0 +1,307 @@
+// OpenGL Stuff
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// My Stuff
+#include "gl_trace.h"
+#include "headless.h"
+
+// Standard Library
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+// Replays a trace recorded with `main --gl-trace FILE` and reports per-frame,
+// per-function and per-group timings. --json writes one entry per line so two
+// runs or two builds can be diffed, --compare prints what changed per frame and
+// per function. --dump prints the trace as text, one command per line with
+// buffers shown as size and hash, for diff(1).
+//
+// replay TRACE [--sync] [--repeat N] [--json FILE] [--png FILE] [--dump]
+// replay --compare OLD.json NEW.json
+struct ReplayOptions {
+    std::string trace;
+    bool sync = false;          // glFinish around groups so they include GPU time
+    int repeat = 1;
+    std::string json;
+    std::string png;            // Last frame of the last repetition
+    bool dump = false;
+};
+
+// Offscreen context, EGL when available and a hidden GLFW window otherwise
+struct ReplayContext {
+    HeadlessContext headless;
+    GLFWwindow* window = nullptr;
+
+    bool create() {
+#ifdef HAS_EGL
+        if (headless.create() && gladLoadGLLoader(HeadlessContext::loader())) return true;
+#endif
+        if (!glfwInit()) return false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        window = glfwCreateWindow(64, 64, "replay", nullptr, nullptr);
+        if (!window) return false;
+        glfwMakeContextCurrent(window);
+        return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    }
+
+    void destroy() {
+        if (window) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        headless.destroy();
+    }
+};
+
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Per-line JSON: frames, functions and groups, the last repetition's numbers
+bool write_json(const std::string& filename, const ReplayOptions& options, const GLTracePlayer& player,
+                const std::vector<double>& repeat_ms) {
+    std::ofstream file(filename);
+    if (!file) return false;
+
+    const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    file << std::setprecision(6) << "{\n";
+    file << "  \"config\": {\"trace\": \"" << json_escape(options.trace) << "\", \"renderer\": \"" << json_escape(renderer ? renderer : "?")
+         << "\", \"sync\": " << (options.sync ? "true" : "false") << ", \"repeat\": " << options.repeat
+         << ", \"width\": " << player.width << ", \"height\": " << player.height << "},\n";
+
+    file << "  \"runs\": [";
+    for (size_t i = 0; i < repeat_ms.size(); i++) file << (i ? ", " : "") << repeat_ms[i];
+    file << "],\n";
+    file << "  \"setup_ms\": " << player.setup_ms << ",\n";
+
+    file << "  \"frames\": [\n";
+    for (size_t i = 0; i < player.frames.size(); i++) {
+        const auto& frame = player.frames[i];
+        file << "    {\"frame\": " << i << ", \"commands\": " << frame.commands << ", \"draws\": " << frame.draws
+             << ", \"cpu_ms\": " << frame.cpu_ms << ", \"ms\": " << frame.ms << "}" << (i + 1 < player.frames.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n";
+
+    std::vector<size_t> ops;
+    for (size_t op = 0; op < (size_t)TraceOp::Count; op++)
+        if (player.calls[op].count > 0) ops.push_back(op);
+    file << "  \"functions\": [\n";
+    for (size_t i = 0; i < ops.size(); i++) {
+        const auto& call = player.calls[ops[i]];
+        file << "    {\"function\": \"" << trace_op_name((TraceOp)ops[i]) << "\", \"count\": " << call.count
+             << ", \"ms\": " << call.ms << "}" << (i + 1 < ops.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n";
+
+    file << "  \"groups\": [\n";
+    size_t index = 0;
+    for (const auto& group : player.groups) {
+        file << "    {\"group\": \"" << json_escape(group.first) << "\", \"count\": " << group.second.count
+             << ", \"ms\": " << group.second.ms << "}" << (++index < player.groups.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return (bool)file;
+}
+
+// Reads the entries of one section written by write_json(), keyed by their
+// label ("frame 3", "glDrawElements", "Scene") with their numeric fields
+using JsonEntries = std::map<std::string, std::map<std::string, double>>;
+
+bool read_json(const std::string& filename, JsonEntries& frames, JsonEntries& functions, JsonEntries& groups) {
+    std::ifstream file(filename);
+    if (!file) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        JsonEntries* section = nullptr;
+        std::string label;
+        size_t at;
+        if ((at = line.find("{\"frame\": ")) != std::string::npos) {
+            section = &frames;
+            char text[32];
+            std::snprintf(text, sizeof(text), "frame %05d", std::atoi(line.c_str() + at + 10));     // Sorts numerically
+            label = text;
+        } else if ((at = line.find("{\"function\": \"")) != std::string::npos) {
+            section = &functions;
+            label = line.substr(at + 14, line.find('"', at + 14) - at - 14);
+        } else if ((at = line.find("{\"group\": \"")) != std::string::npos) {
+            section = &groups;
+            label = line.substr(at + 11, line.find("\", ", at + 11) - at - 11);
+        }
+        if (!section) continue;
+
+        auto& fields = (*section)[label];
+        for (const char* key : {"commands", "draws", "cpu_ms", "ms", "count"}) {
+            std::string pattern = std::string("\"") + key + "\": ";
+            size_t field = line.find(pattern);
+            if (field != std::string::npos) fields[key] = std::strtod(line.c_str() + field + pattern.size(), nullptr);
+        }
+    }
+    return !frames.empty() || !functions.empty();
+}
+
+int compare(const std::string& old_file, const std::string& new_file) {
+    JsonEntries old_frames, old_functions, old_groups, new_frames, new_functions, new_groups;
+    if (!read_json(old_file, old_frames, old_functions, old_groups)) {
+        std::cerr << "No results in " << old_file << std::endl;
+        return 1;
+    }
+    if (!read_json(new_file, new_frames, new_functions, new_groups)) {
+        std::cerr << "No results in " << new_file << std::endl;
+        return 1;
+    }
+
+    auto change = [](double before, double after) { return before > 0.0 ? 100.0 * (after - before) / before : 0.0; };
+    auto report = [&](const char* title, const JsonEntries& before, const JsonEntries& after, const char* value) {
+        std::cout << title << std::endl;
+        for (const auto& entry : after) {
+            auto old = before.find(entry.first);
+            double now = entry.second.count(value) ? entry.second.at(value) : 0.0;
+            std::cout << "  " << std::left << std::setw(40) << entry.first << std::right << std::fixed << std::setprecision(3);
+            if (old == before.end()) {
+                std::cout << "        new " << std::setw(10) << now << " ms" << std::endl;
+                continue;
+            }
+            double then = old->second.count(value) ? old->second.at(value) : 0.0;
+            double percent = change(then, now);
+            std::cout << std::setw(10) << then << " -> " << std::setw(10) << now << " ms " << std::showpos << std::setprecision(1)
+                      << std::setw(7) << percent << "%" << std::noshowpos << (percent > 5.0 ? "  slower" : percent < -5.0 ? "  faster" : "");
+
+            // Command and call count changes point at what the new build does differently
+            for (const char* key : {"commands", "draws", "count"}) {
+                if (!entry.second.count(key) || !old->second.count(key)) continue;
+                long difference = std::lround(entry.second.at(key) - old->second.at(key));
+                if (difference != 0) std::cout << "  " << key << " " << std::showpos << difference << std::noshowpos;
+            }
+            std::cout << std::endl;
+        }
+        for (const auto& entry : before)
+            if (!after.count(entry.first)) std::cout << "  " << std::left << std::setw(40) << entry.first << std::right << "    removed" << std::endl;
+    };
+
+    report("Frames", old_frames, new_frames, "ms");
+    report("Functions", old_functions, new_functions, "ms");
+    if (!new_groups.empty() || !old_groups.empty()) report("Groups", old_groups, new_groups, "ms");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--compare" && i + 2 < argc) {
+            return compare(argv[i + 1], argv[i + 2]);
+        } else if (arg == "--sync") {
+            options.sync = true;
+        } else if (arg == "--repeat" && has_value) {
+            options.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--json" && has_value) {
+            options.json = argv[++i];
+        } else if (arg == "--png" && has_value) {
+            options.png = argv[++i];
+        } else if (arg == "--dump") {
+            options.dump = true;
+        } else {
+            options.trace = arg;
+        }
+    }
+    if (options.trace.empty()) {
+        std::cerr << "Usage: replay TRACE [--sync] [--repeat N] [--json FILE] [--png FILE] [--dump]\n"
+                     "       replay --compare OLD.json NEW.json" << std::endl;
+        return 1;
+    }
+
+    GLTracePlayer player;
+    if (!player.load(options.trace)) {
+        std::cerr << "Failed to load trace " << options.trace << std::endl;
+        return 1;
+    }
+    if (options.dump) return player.dump(std::cout) ? 0 : 1;
+
+    ReplayContext context;
+    if (!context.create()) {
+        std::cerr << "Failed to create a GL context" << std::endl;
+        return 1;
+    }
+
+    // Framebuffer 0 of the recording becomes this target
+    RenderTarget target;
+    target.create(player.width, player.height);
+
+    std::vector<double> repeat_ms;
+    for (int run = 0; run < options.repeat; run++) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = player.replay(target.FBO, options.sync);
+        glFinish();
+        repeat_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (!ok) break;
+    }
+
+    // Summary: slowest functions first, then groups
+    std::vector<double> frame_ms;
+    uint64_t commands = 0;
+    for (const auto& frame : player.frames) {
+        frame_ms.push_back(frame.ms);
+        commands += frame.commands;
+    }
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Replayed " << player.frames.size() << " frames, " << commands << " commands, setup " << player.setup_ms << " ms, frame p50 "
+              << percentile(frame_ms, 50.0) << " ms, p99 " << percentile(frame_ms, 99.0) << " ms" << std::endl;
+
+    std::vector<size_t> ops;
+    for (size_t op = 0; op < (size_t)TraceOp::Count; op++)
+        if (player.calls[op].count > 0) ops.push_back(op);
+    std::sort(ops.begin(), ops.end(), [&](size_t a, size_t b) { return player.calls[a].ms > player.calls[b].ms; });
+    for (size_t op : ops) {
+        std::cout << "  " << std::left << std::setw(32) << trace_op_name((TraceOp)op) << std::right << std::setw(10)
+                  << player.calls[op].count << " calls " << std::setw(10) << player.calls[op].ms << " ms" << std::endl;
+    }
+    for (const auto& group : player.groups) {
+        std::cout << "  group " << std::left << std::setw(26) << group.first << std::right << std::setw(10) << group.second.count
+                  << " runs  " << std::setw(10) << group.second.ms << " ms" << (options.sync ? "" : " (CPU submit)") << std::endl;
+    }
+
+    int result = 0;
+    if (!options.json.empty()) {
+        if (write_json(options.json, options, player, repeat_ms)) {
+            std::cout << "Wrote " << options.json << std::endl;
+        } else {
+            std::cerr << "Failed to write " << options.json << std::endl;
+            result = 1;
+        }
+    }
+    if (!options.png.empty()) {
+        // Headless recordings render into their own framebuffer, read whatever the trace left bound
+        GLint bound = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+        RenderTarget shown = target;
+        shown.FBO = (unsigned int)bound;
+        std::vector<unsigned char> pixels;
+        shown.read_pixels(pixels);
+        if (!write_png(options.png, target.width, target.height, pixels)) {
+            std::cerr << "Failed to write " << options.png << std::endl;
+            result = 1;
+        }
+    }
+
+    target.destroy();
+    context.destroy();
+    return result;
+}
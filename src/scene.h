@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "mesh.h"
+#include "jobs.h"
+
+// Surface parameters fed to the `material` uniform of multiple_lights
+struct Material {
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(0.5f);
+    float shininess = 128.0f;
+    unsigned int diffuse_map = 0;       // GL texture, 0 binds the white default
+    unsigned int specular_map = 0;
+};
+
+// Stable entity id. Slots move around when the hierarchy is re-sorted, ids never do.
+typedef uint32_t Entity;
+const Entity NULL_ENTITY = 0xFFFFFFFF;
+
+// Flat transform hierarchy. All per-node data lives in parallel arrays sorted by
+// depth, so parents always come before their children and each depth level is
+// one contiguous slot range. World matrices are rebuilt with a linear pass per
+// level, touching only nodes whose own transform or an ancestor's changed.
+struct Scene {
+    // Per-slot data (sorted by depth)
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> world;           // World matrices, valid after update()
+    std::vector<int> parents;               // Parent slot, -1 for roots
+    std::vector<int> depths;
+    std::vector<uint8_t> dirty;             // Local transform changed since last update()
+    std::vector<Entity> entities;           // Slot -> entity id
+    std::vector<RenderMesh*> meshes;        // Mesh to draw, nullptr for pure transform nodes
+    std::vector<int> materials;             // Index into material_table, -1 for none
+    std::vector<std::string> names;
+
+    std::vector<Material> material_table;
+    std::vector<int> slot_of;               // Entity id -> slot
+    std::vector<int> level_start;           // Slots of depth d are [level_start[d], level_start[d + 1])
+    bool needs_sort = false;
+    bool any_dirty = false;
+
+    // Hierarchy
+    Entity create(const std::string& name, Entity parent = NULL_ENTITY, RenderMesh* mesh = nullptr, int material = -1);
+    int add_material(const Material& material);
+    size_t size() const { return entities.size(); }
+    int slot(Entity e) const { return slot_of[e]; }
+    int level_count() const { return (int)level_start.size() - 1; }
+
+    // Local transform (TRS relative to the parent)
+    void set_translation(Entity e, const glm::vec3& t);
+    void set_rotation(Entity e, const glm::quat& r);
+    void set_scale(Entity e, const glm::vec3& s);
+    void set_local_matrix(Entity e, const glm::mat4& m);
+    void set_world_matrix(Entity e, const glm::mat4& m);   // Used by gizmo edits
+    void mark_dirty(Entity e);
+    glm::mat4 local_matrix(int slot) const;
+    const glm::mat4& world_matrix(Entity e) const { return world[slot_of[e]]; }
+
+    // Transform update
+    void update();                          // Serial, level by level
+    void update(JobSystem& jobs);           // Levels in order, each level split across workers
+    void begin_update();                    // Re-sorts if needed, call before update_range()
+    void update_range(int begin, int end);  // Slots of a single level, safe to run concurrently
+    void end_update();                      // Clears dirty flags
+
+private:
+    void sort_by_depth();
+};
+
+Entity Scene::create(const std::string& name, Entity parent, RenderMesh* mesh, int material) {
+    Entity e = (Entity)slot_of.size();
+    int parent_slot = parent == NULL_ENTITY ? -1 : slot_of[parent];
+    int depth = parent_slot < 0 ? 0 : depths[parent_slot] + 1;
+
+    // Appending keeps the order valid only if nothing deeper is already stored
+    if (!depths.empty() && depths.back() > depth) needs_sort = true;
+
+    slot_of.push_back((int)entities.size());
+    translations.push_back(glm::vec3(0.0f));
+    rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scales.push_back(glm::vec3(1.0f));
+    world.push_back(glm::mat4(1.0f));
+    parents.push_back(parent_slot);
+    depths.push_back(depth);
+    dirty.push_back(1);
+    entities.push_back(e);
+    meshes.push_back(mesh);
+    materials.push_back(material);
+    names.push_back(name);
+    any_dirty = true;
+
+    if (!needs_sort) {
+        if ((int)level_start.size() < depth + 2) level_start.resize(depth + 2, (int)entities.size() - 1);
+        level_start[depth + 1] = (int)entities.size();
+    }
+
+    return e;
+}
+
+int Scene::add_material(const Material& material) {
+    material_table.push_back(material);
+    return (int)material_table.size() - 1;
+}
+
+void Scene::set_translation(Entity e, const glm::vec3& t) {
+    translations[slot_of[e]] = t;
+    mark_dirty(e);
+}
+
+void Scene::set_rotation(Entity e, const glm::quat& r) {
+    rotations[slot_of[e]] = r;
+    mark_dirty(e);
+}
+
+void Scene::set_scale(Entity e, const glm::vec3& s) {
+    scales[slot_of[e]] = s;
+    mark_dirty(e);
+}
+
+void Scene::set_local_matrix(Entity e, const glm::mat4& m) {
+    int i = slot_of[e];
+
+    // Decompose into TRS, assumes no shear
+    translations[i] = glm::vec3(m[3]);
+    glm::vec3 s(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+    glm::mat3 r(glm::vec3(m[0]) / s.x, glm::vec3(m[1]) / s.y, glm::vec3(m[2]) / s.z);
+    scales[i] = s;
+    rotations[i] = glm::normalize(glm::quat_cast(r));
+    mark_dirty(e);
+}
+
+void Scene::set_world_matrix(Entity e, const glm::mat4& m) {
+    int p = parents[slot_of[e]];
+    set_local_matrix(e, p < 0 ? m : glm::inverse(world[p]) * m);
+}
+
+void Scene::mark_dirty(Entity e) {
+    dirty[slot_of[e]] = 1;
+    any_dirty = true;
+}
+
+glm::mat4 Scene::local_matrix(int slot) const {
+    glm::mat4 m = glm::mat4_cast(rotations[slot]);
+    m[0] *= scales[slot].x;
+    m[1] *= scales[slot].y;
+    m[2] *= scales[slot].z;
+    m[3] = glm::vec4(translations[slot], 1.0f);
+    return m;
+}
+
+void Scene::update() {
+    if (!any_dirty && !needs_sort) return;
+
+    begin_update();
+    for (int level = 0; level < level_count(); level++) {
+        update_range(level_start[level], level_start[level + 1]);
+    }
+    end_update();
+}
+
+void Scene::update(JobSystem& jobs) {
+    if (!any_dirty && !needs_sort) return;
+
+    begin_update();
+    for (int level = 0; level < level_count(); level++) {
+        // Small levels are not worth the scheduling overhead
+        jobs.parallel_for(level_start[level], level_start[level + 1], 1024, [this](size_t begin, size_t end) {
+            update_range((int)begin, (int)end);
+        });
+    }
+    end_update();
+}
+
+void Scene::begin_update() {
+    if (needs_sort) sort_by_depth();
+}
+
+void Scene::update_range(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        int p = parents[i];
+
+        // A moved parent drags its whole subtree along
+        if (p >= 0 && dirty[p]) dirty[i] = 1;
+        if (!dirty[i]) continue;
+
+        world[i] = p < 0 ? local_matrix(i) : world[p] * local_matrix(i);
+    }
+}
+
+void Scene::end_update() {
+    std::fill(dirty.begin(), dirty.end(), 0);
+    any_dirty = false;
+}
+
+void Scene::sort_by_depth() {
+    size_t n = entities.size();
+    int max_depth = 0;
+    for (size_t i = 0; i < n; i++) max_depth = std::max(max_depth, depths[i]);
+
+    // Counting sort by depth, stable so siblings keep their creation order
+    level_start.assign(max_depth + 2, 0);
+    for (size_t i = 0; i < n; i++) level_start[depths[i] + 1]++;
+    for (int d = 0; d <= max_depth; d++) level_start[d + 1] += level_start[d];
+
+    std::vector<int> new_slot(n);
+    std::vector<int> cursor(level_start.begin(), level_start.end() - 1);
+    for (size_t i = 0; i < n; i++) new_slot[i] = cursor[depths[i]]++;
+
+    auto permute = [&](auto& arr) {
+        auto sorted = arr;
+        for (size_t i = 0; i < n; i++) sorted[new_slot[i]] = arr[i];
+        arr.swap(sorted);
+    };
+
+    for (size_t i = 0; i < n; i++) {
+        if (parents[i] >= 0) parents[i] = new_slot[parents[i]];
+    }
+
+    permute(translations);
+    permute(rotations);
+    permute(scales);
+    permute(world);
+    permute(parents);
+    permute(depths);
+    permute(dirty);
+    permute(entities);
+    permute(meshes);
+    permute(materials);
+    permute(names);
+
+    for (size_t i = 0; i < n; i++) slot_of[entities[i]] = (int)i;
+
+    needs_sort = false;
+    any_dirty = true;
+}
@@ -10,14 +10,22 @@
 #include <sstream>
 #include <iostream>
 
+#include "render_stats.h"
+
 class Shader
 {
 public:
     unsigned int ID;
     std::string shaderRoot = "assets/shaders/";
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, with a geometry stage when
+    // a matching .gs file exists
     // ------------------------------------------------------------------------
-    Shader(const char* shaderName)
+    Shader(const char* shaderName) : Shader(shaderName, shaderName, shaderName) {}
+    // same vertex and fragment shader with the geometry stage from geometryName.gs
+    Shader(const char* shaderName, const char* geometryName) : Shader(shaderName, shaderName, geometryName) {}
+    // vertexName.vs with another shader's fragment stage, e.g. skinning in front of
+    // the lighting shader; the geometry stage is optional when geometryName is vertexName
+    Shader(const char* vertexName, const char* fragmentName, const char* geometryName)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
@@ -25,10 +33,23 @@ public:
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
 
-        std::string vertexPath = shaderRoot + std::string(shaderName) + ".vs";
-        std::string fragmentPath = shaderRoot + std::string(shaderName) + ".fs";
+        std::string vertexPath = shaderRoot + std::string(vertexName) + ".vs";
+        std::string fragmentPath = shaderRoot + std::string(fragmentName) + ".fs";
+        std::string geometryPath = shaderRoot + std::string(geometryName) + ".gs";
+        std::string geometryCode;
+        std::ifstream gShaderFile(geometryPath);
+        if (gShaderFile)
+        {
+            std::stringstream gShaderStream;
+            gShaderStream << gShaderFile.rdbuf();
+            geometryCode = gShaderStream.str();
+        }
+        else if (std::string(geometryName) != vertexName)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << geometryPath << std::endl;
+        }
 
-        std::cout << "Loading shader: " << vertexPath << " and " << fragmentPath << std::endl;
+        std::cout << "Loading shader: " << vertexPath << (geometryCode.empty() ? "" : ", " + geometryPath) << " and " << fragmentPath << std::endl;
 
         // ensure ifstream objects can throw exceptions:
         vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
@@ -67,65 +88,105 @@ public:
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
+        // optional geometry shader
+        unsigned int geometry = 0;
+        if (!geometryCode.empty())
+        {
+            const char* gShaderCode = geometryCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            checkCompileErrors(geometry, "GEOMETRY");
+        }
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (geometry)
+            glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+        if (geometry)
+            glDeleteShader(geometry);
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
         glUseProgram(ID); 
+        RenderStats::instance().program_bind();
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char* name, bool value) const
     {        
         glUseProgram(ID); 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
+        count_uniform_upload();
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char* name, int value) const
     { 
         glUseProgram(ID);
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(glGetUniformLocation(ID, name), value);
+        count_uniform_upload();
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char* name, float value) const
     { 
         glUseProgram(ID);
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(glGetUniformLocation(ID, name), value);
+        count_uniform_upload();
     }
-    void setVec3(const std::string &name, float v0, float v1, float v2) const
+    void setVec3(const char* name, float v0, float v1, float v2) const
     {
         glUseProgram(ID);
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2);
+        glUniform3f(glGetUniformLocation(ID, name), v0, v1, v2);
+        count_uniform_upload();
     }
-    void setVec3(const std::string &name, glm::vec3 vec) const
+    void setVec3(const char* name, glm::vec3 vec) const
     {
         glUseProgram(ID);
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), vec.x, vec.y, vec.z);
+        glUniform3f(glGetUniformLocation(ID, name), vec.x, vec.y, vec.z);
+        count_uniform_upload();
     }
-    glm::vec3 getVec3(const std::string &name) const
+    glm::vec3 getVec3(const char* name) const
     {
         glUseProgram(ID);
         glm::vec3 vec;
-        glGetUniformfv(ID, glGetUniformLocation(ID, name.c_str()), glm::value_ptr(vec));
+        glGetUniformfv(ID, glGetUniformLocation(ID, name), glm::value_ptr(vec));
         return vec;
     }
-    void setMat4(const std::string &name, glm::mat4 &matrix) const
+    void setMat4(const char* name, glm::mat4 &matrix) const
     {   
         glUseProgram(ID);
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+        count_uniform_upload();
+    }
+    void setVec4Array(const char* name, const glm::vec4* values, int count) const
+    {
+        glUseProgram(ID);
+        glUniform4fv(glGetUniformLocation(ID, name), count, glm::value_ptr(values[0]));
+        count_uniform_upload();
+    }
+    void setMat4Array(const char* name, const glm::mat4* matrices, int count) const
+    {
+        glUseProgram(ID);
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, glm::value_ptr(matrices[0]));
+        count_uniform_upload();
     }
 
 private:
+    // Every setter rebinds the program, see RenderStats
+    void count_uniform_upload() const
+    {
+        RenderStats::instance().program_bind();
+        RenderStats::instance().uniform_upload();
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
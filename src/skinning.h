@@ -0,0 +1,461 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SKINNING_USE_SSE2 1
+#endif
+
+// Joints the vertex shader back end addresses, MAX_JOINTS in assets/shaders/skinned.vs
+constexpr int SKINNING_MAX_JOINTS = 128;
+
+// Quaternions are glm::vec4 (x, y, z, w)
+glm::vec4 quat_axis_angle(const glm::vec3& axis, float radians);
+glm::vec4 quat_multiply(const glm::vec4& a, const glm::vec4& b);
+
+// Local joint transforms in structure-of-arrays form: translation, rotation and
+// scale per joint, every array padded to a multiple of four (identity) so that
+// blending works on four joints per register.
+struct JointPoses {
+    size_t count = 0;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> rx, ry, rz, rw;
+    std::vector<float> sx, sy, sz;
+
+    void resize(size_t joint_count);
+    void set(size_t joint, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale = glm::vec3(1.0f));
+    glm::vec3 translation(size_t joint) const { return glm::vec3(tx[joint], ty[joint], tz[joint]); }
+    glm::vec4 rotation(size_t joint) const { return glm::vec4(rx[joint], ry[joint], rz[joint], rw[joint]); }
+    glm::vec3 scale(size_t joint) const { return glm::vec3(sx[joint], sy[joint], sz[joint]); }
+    glm::mat4 local_matrix(size_t joint) const;
+};
+
+// out = a blended towards b by t. Translation and scale interpolate linearly,
+// rotations take the shorter arc: nlerp with t corrected by a polynomial fit
+// in |dot(a, b)|, which tracks slerp's constant angular speed without acos/sin.
+void blend_poses(const JointPoses& a, const JointPoses& b, float t, JointPoses& out);
+
+// Joint hierarchy. Parents come before their children, so one pass in joint
+// order turns local poses into model space.
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents;               // -1 for roots
+    std::vector<glm::mat4> inverse_bind;    // Model space to joint space in the bind pose
+    JointPoses rest;
+
+    size_t joint_count() const { return parents.size(); }
+    int add_joint(const std::string& name, int parent, const glm::vec3& translation, const glm::vec4& rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    int find(const std::string& name) const;
+    // Inverse bind matrices for the rest pose as the bind pose
+    void bind_rest_pose();
+
+    void model_matrices(const JointPoses& local, glm::mat4* model) const;
+    // Model space joint transforms times inverse_bind, what both skinning back
+    // ends take: the identity wherever the pose equals the bind pose
+    void skin_matrices(const JointPoses& local, glm::mat4* skin) const;
+};
+
+// Poses of every joint sampled at a fixed rate, blended between the two keys around a time
+struct AnimationClip {
+    std::string name;
+    float sample_rate = 30.0f;
+    std::vector<JointPoses> keys;
+
+    float duration() const { return keys.size() > 1 ? (keys.size() - 1) / sample_rate : 0.0f; }
+    size_t joint_count() const { return keys.empty() ? 0 : keys[0].count; }
+    // Looping wraps the time into the clip, otherwise it clamps to the ends
+    void sample(float time, JointPoses& out, bool loop = true) const;
+};
+
+// The four largest of `count` weights, normalized and quantized to sum to 255
+SkinInfluence make_skin_influence(const int* joints, const float* weights, int count);
+
+// Linear blend skinning on the CPU, split across a job system by vertex ranges.
+// `bind` needs one influence per vertex; normals are transformed by the blended
+// matrix and renormalized, exact for rotations and uniform scale.
+//
+// skin_vertices() writes the interleaved layout of write_vertex_data(), ready
+// for glBufferSubData into the mesh's VBO. skin_mesh() fills the positions and
+// normals of `out`, copying the static attributes and indices the first time.
+void skin_vertices(const RenderMesh& bind, const glm::mat4* skin, float* out, JobSystem* jobs = nullptr);
+void skin_mesh(const RenderMesh& bind, const glm::mat4* skin, RenderMesh& out, JobSystem* jobs = nullptr);
+
+// Test rig: a tapering tube along +y of the given length, one joint per
+// segment of a chain from the base to the tip. Each vertex blends the two
+// joints nearest its height, and the clip waves the chain in two planes.
+struct SkinnedModel {
+    RenderMesh mesh;        // Bind pose with skin influences
+    Skeleton skeleton;
+    AnimationClip clip;
+};
+SkinnedModel skinned_tentacle(int joints, int rows, int sectors, float length = 2.0f, JobSystem* jobs = nullptr);
+
+glm::vec4 quat_axis_angle(const glm::vec3& axis, float radians) {
+    glm::vec3 unit = glm::normalize(axis);
+    float s = std::sin(radians * 0.5f);
+    return glm::vec4(unit * s, std::cos(radians * 0.5f));
+}
+
+glm::vec4 quat_multiply(const glm::vec4& a, const glm::vec4& b) {
+    return glm::vec4(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                     a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                     a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                     a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+void JointPoses::resize(size_t joint_count) {
+    count = joint_count;
+    size_t padded = (joint_count + 3) & ~(size_t)3;
+    if (tx.size() == padded) return;
+    for (std::vector<float>* values : {&tx, &ty, &tz, &rx, &ry, &rz}) values->assign(padded, 0.0f);
+    for (std::vector<float>* values : {&rw, &sx, &sy, &sz}) values->assign(padded, 1.0f);
+}
+
+void JointPoses::set(size_t joint, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale) {
+    tx[joint] = translation.x; ty[joint] = translation.y; tz[joint] = translation.z;
+    rx[joint] = rotation.x; ry[joint] = rotation.y; rz[joint] = rotation.z; rw[joint] = rotation.w;
+    sx[joint] = scale.x; sy[joint] = scale.y; sz[joint] = scale.z;
+}
+
+glm::mat4 JointPoses::local_matrix(size_t joint) const {
+    float x = rx[joint], y = ry[joint], z = rz[joint], w = rw[joint];
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f) * sx[joint];
+    m[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f) * sy[joint];
+    m[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f) * sz[joint];
+    m[3] = glm::vec4(tx[joint], ty[joint], tz[joint], 1.0f);
+    return m;
+}
+
+// Fit from "Approximating slerp" (zeux.io, 2015): maps t so that nlerp's
+// speed along the arc stays close to constant
+static inline float slerp_correction(float t, float d) {
+    float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+    float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+    float k = a * (t - 0.5f) * (t - 0.5f) + b;
+    return t + t * (t - 0.5f) * (t - 1.0f) * k;
+}
+
+void blend_poses(const JointPoses& a, const JointPoses& b, float t, JointPoses& out) {
+    out.resize(a.count);
+    size_t padded = a.tx.size();
+#if SKINNING_USE_SSE2
+    const __m128 vt = _mm_set1_ps(t);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    auto lerp = [&](const std::vector<float>& from, const std::vector<float>& to, std::vector<float>& result, size_t j) {
+        __m128 x = _mm_loadu_ps(&from[j]);
+        _mm_storeu_ps(&result[j], _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&to[j]), x), vt)));
+    };
+    // Same polynomial as slerp_correction(), per lane
+    __m128 u = _mm_sub_ps(vt, half);
+    __m128 tail = _mm_mul_ps(_mm_mul_ps(vt, u), _mm_sub_ps(vt, one));
+    __m128 u2 = _mm_mul_ps(u, u);
+    for (size_t j = 0; j < padded; j += 4) {
+        lerp(a.tx, b.tx, out.tx, j); lerp(a.ty, b.ty, out.ty, j); lerp(a.tz, b.tz, out.tz, j);
+        lerp(a.sx, b.sx, out.sx, j); lerp(a.sy, b.sy, out.sy, j); lerp(a.sz, b.sz, out.sz, j);
+
+        __m128 ax = _mm_loadu_ps(&a.rx[j]), ay = _mm_loadu_ps(&a.ry[j]), az = _mm_loadu_ps(&a.rz[j]), aw = _mm_loadu_ps(&a.rw[j]);
+        __m128 bx = _mm_loadu_ps(&b.rx[j]), by = _mm_loadu_ps(&b.ry[j]), bz = _mm_loadu_ps(&b.rz[j]), bw = _mm_loadu_ps(&b.rw[j]);
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        // Flip b into a's hemisphere by xoring in the sign of the dot product
+        __m128 sign = _mm_and_ps(dot, sign_mask);
+        __m128 d = _mm_andnot_ps(sign_mask, dot);
+        bx = _mm_xor_ps(bx, sign); by = _mm_xor_ps(by, sign); bz = _mm_xor_ps(bz, sign); bw = _mm_xor_ps(bw, sign);
+
+        __m128 pa = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+                    _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+        __m128 pb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+        __m128 k = _mm_add_ps(_mm_mul_ps(pa, u2), pb);
+        __m128 ot = _mm_add_ps(vt, _mm_mul_ps(tail, k));
+
+        __m128 qx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), ot));
+        __m128 qy = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), ot));
+        __m128 qz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), ot));
+        __m128 qw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), ot));
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)), _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+        __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(length2));
+        _mm_storeu_ps(&out.rx[j], _mm_mul_ps(qx, inverse));
+        _mm_storeu_ps(&out.ry[j], _mm_mul_ps(qy, inverse));
+        _mm_storeu_ps(&out.rz[j], _mm_mul_ps(qz, inverse));
+        _mm_storeu_ps(&out.rw[j], _mm_mul_ps(qw, inverse));
+    }
+#else
+    for (size_t j = 0; j < padded; j++) {
+        out.tx[j] = a.tx[j] + (b.tx[j] - a.tx[j]) * t;
+        out.ty[j] = a.ty[j] + (b.ty[j] - a.ty[j]) * t;
+        out.tz[j] = a.tz[j] + (b.tz[j] - a.tz[j]) * t;
+        out.sx[j] = a.sx[j] + (b.sx[j] - a.sx[j]) * t;
+        out.sy[j] = a.sy[j] + (b.sy[j] - a.sy[j]) * t;
+        out.sz[j] = a.sz[j] + (b.sz[j] - a.sz[j]) * t;
+
+        float dot = a.rx[j] * b.rx[j] + a.ry[j] * b.ry[j] + a.rz[j] * b.rz[j] + a.rw[j] * b.rw[j];
+        float flip = dot < 0.0f ? -1.0f : 1.0f;
+        float ot = slerp_correction(t, std::fabs(dot));
+        float qx = a.rx[j] + (flip * b.rx[j] - a.rx[j]) * ot;
+        float qy = a.ry[j] + (flip * b.ry[j] - a.ry[j]) * ot;
+        float qz = a.rz[j] + (flip * b.rz[j] - a.rz[j]) * ot;
+        float qw = a.rw[j] + (flip * b.rw[j] - a.rw[j]) * ot;
+        float inverse = 1.0f / std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+        out.rx[j] = qx * inverse;
+        out.ry[j] = qy * inverse;
+        out.rz[j] = qz * inverse;
+        out.rw[j] = qw * inverse;
+    }
+#endif
+}
+
+int Skeleton::add_joint(const std::string& name, int parent, const glm::vec3& translation, const glm::vec4& rotation) {
+    int joint = (int)parents.size();
+    names.push_back(name);
+    parents.push_back(parent);
+    inverse_bind.push_back(glm::mat4(1.0f));
+
+    // Grow the rest pose, keeping the joints already set
+    JointPoses grown;
+    grown.resize(parents.size());
+    for (size_t j = 0; j < rest.count; j++) grown.set(j, rest.translation(j), rest.rotation(j), rest.scale(j));
+    grown.set(joint, translation, rotation);
+    rest = std::move(grown);
+    return joint;
+}
+
+int Skeleton::find(const std::string& name) const {
+    for (size_t j = 0; j < names.size(); j++) {
+        if (names[j] == name) return (int)j;
+    }
+    return -1;
+}
+
+void Skeleton::bind_rest_pose() {
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    glm::mat4* model = scratch.allocate_array<glm::mat4>(joint_count());
+    model_matrices(rest, model);
+    for (size_t j = 0; j < joint_count(); j++) inverse_bind[j] = glm::inverse(model[j]);
+}
+
+void Skeleton::model_matrices(const JointPoses& local, glm::mat4* model) const {
+    for (size_t j = 0; j < joint_count(); j++) {
+        glm::mat4 matrix = local.local_matrix(j);
+        model[j] = parents[j] < 0 ? matrix : model[parents[j]] * matrix;
+    }
+}
+
+void Skeleton::skin_matrices(const JointPoses& local, glm::mat4* skin) const {
+    model_matrices(local, skin);
+    for (size_t j = 0; j < joint_count(); j++) skin[j] = skin[j] * inverse_bind[j];
+}
+
+void AnimationClip::sample(float time, JointPoses& out, bool loop) const {
+    if (keys.empty()) return;
+    float length = duration();
+    if (length <= 0.0f) {
+        blend_poses(keys[0], keys[0], 0.0f, out);
+        return;
+    }
+    time = loop ? time - std::floor(time / length) * length : std::min(std::max(time, 0.0f), length);
+    float position = time * sample_rate;
+    size_t key = std::min((size_t)position, keys.size() - 2);
+    blend_poses(keys[key], keys[key + 1], position - key, out);
+}
+
+SkinInfluence make_skin_influence(const int* joints, const float* weights, int count) {
+    // Four largest, largest first
+    int order[4] = {-1, -1, -1, -1};
+    for (int i = 0; i < count; i++) {
+        if (!(weights[i] > 0.0f)) continue;
+        int slot = 4;
+        while (slot > 0 && (order[slot - 1] < 0 || weights[order[slot - 1]] < weights[i])) slot--;
+        if (slot == 4) continue;
+        for (int k = 3; k > slot; k--) order[k] = order[k - 1];
+        order[slot] = i;
+    }
+
+    SkinInfluence influence = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+    float total = 0.0f;
+    for (int k = 0; k < 4 && order[k] >= 0; k++) total += weights[order[k]];
+    if (total <= 0.0f) {
+        influence.weights[0] = 255;     // Unweighted vertices follow joint 0
+        return influence;
+    }
+    int sum = 0;
+    for (int k = 0; k < 4 && order[k] >= 0; k++) {
+        influence.joints[k] = (uint8_t)joints[order[k]];
+        influence.weights[k] = (uint8_t)std::lround(weights[order[k]] / total * 255.0f);
+        sum += influence.weights[k];
+    }
+    // Rounding error goes to the largest weight
+    influence.weights[0] = (uint8_t)(influence.weights[0] + 255 - sum);
+    return influence;
+}
+
+// Skins vertices [begin, end): positions to positions + v * stride, normals
+// (when the mesh has them) to normals + v * stride
+static void skin_vertex_range(const RenderMesh& bind, const glm::mat4* skin, size_t begin, size_t end,
+                              float* positions, float* normals, size_t stride) {
+    bool with_normals = normals && bind.has_vertex_normals;
+    for (size_t v = begin; v < end; v++) {
+        const SkinInfluence& influence = bind.skin[v];
+        const glm::vec3& p = bind.positions[v];
+        float* position = positions + v * stride;
+#if SKINNING_USE_SSE2
+        // Blend the columns of up to four matrices, weights are sorted so the first zero ends the list
+        __m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+        for (int k = 0; k < 4 && influence.weights[k] != 0; k++) {
+            __m128 w = _mm_set1_ps(influence.weights[k] * (1.0f / 255.0f));
+            const float* m = glm::value_ptr(skin[influence.joints[k]]);
+            c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(m)));
+            c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+            c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+            c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(m + 12)));
+        }
+        alignas(16) float result[4];
+        __m128 skinned = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))),
+                                    _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+        _mm_store_ps(result, skinned);
+        position[0] = result[0]; position[1] = result[1]; position[2] = result[2];
+        if (with_normals) {
+            const glm::vec3& n = bind.normals[v];
+            __m128 direction = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n.x)), _mm_mul_ps(c1, _mm_set1_ps(n.y))),
+                                          _mm_mul_ps(c2, _mm_set1_ps(n.z)));
+            _mm_store_ps(result, direction);
+            float length2 = result[0] * result[0] + result[1] * result[1] + result[2] * result[2];
+            float inverse = length2 > 0.0f ? 1.0f / std::sqrt(length2) : 0.0f;
+            float* normal = normals + v * stride;
+            normal[0] = result[0] * inverse; normal[1] = result[1] * inverse; normal[2] = result[2] * inverse;
+        }
+#else
+        glm::mat4 m(0.0f);
+        for (int k = 0; k < 4 && influence.weights[k] != 0; k++) m += skin[influence.joints[k]] * (influence.weights[k] * (1.0f / 255.0f));
+        glm::vec4 skinned = m * glm::vec4(p, 1.0f);
+        position[0] = skinned.x; position[1] = skinned.y; position[2] = skinned.z;
+        if (with_normals) {
+            glm::vec3 direction = glm::mat3(m) * bind.normals[v];
+            float length2 = glm::dot(direction, direction);
+            if (length2 > 0.0f) direction /= std::sqrt(length2);
+            float* normal = normals + v * stride;
+            normal[0] = direction.x; normal[1] = direction.y; normal[2] = direction.z;
+        }
+#endif
+    }
+}
+
+void skin_vertices(const RenderMesh& bind, const glm::mat4* skin, float* out, JobSystem* jobs) {
+    size_t stride = bind.vertex_stride() / sizeof(float);
+    float* normals = bind.has_vertex_normals ? out + 3 : nullptr;
+    size_t uv_offset = bind.has_vertex_normals ? 6 : 3;
+    auto skin_range = [&](size_t begin, size_t end) {
+        skin_vertex_range(bind, skin, begin, end, out, normals, stride);
+        if (!bind.has_tex_coords) return;
+        for (size_t v = begin; v < end; v++) {
+            out[v * stride + uv_offset] = bind.tex_coords[v].x;
+            out[v * stride + uv_offset + 1] = bind.tex_coords[v].y;
+        }
+    };
+    if (jobs) jobs->parallel_for(0, bind.positions.size(), 0, skin_range);
+    else skin_range(0, bind.positions.size());
+}
+
+void skin_mesh(const RenderMesh& bind, const glm::mat4* skin, RenderMesh& out, JobSystem* jobs) {
+    if (bind.positions.empty()) return;
+    if (out.positions.size() != bind.positions.size() || out.indices != bind.indices) {
+        out.positions = bind.positions;
+        out.normals = bind.normals;
+        out.tex_coords = bind.tex_coords;
+        out.indices = bind.indices;
+        out.strip_indices = bind.strip_indices;
+        out.has_shared_vertices = bind.has_shared_vertices;
+        out.has_vertex_normals = bind.has_vertex_normals;
+        out.has_tex_coords = bind.has_tex_coords;
+    }
+    float* positions = glm::value_ptr(out.positions[0]);
+    float* normals = out.has_vertex_normals ? glm::value_ptr(out.normals[0]) : nullptr;
+    auto skin_range = [&](size_t begin, size_t end) {
+        skin_vertex_range(bind, skin, begin, end, positions, normals, 3);
+    };
+    if (jobs) jobs->parallel_for(0, bind.positions.size(), 0, skin_range);
+    else skin_range(0, bind.positions.size());
+}
+
+SkinnedModel skinned_tentacle(int joints, int rows, int sectors, float length, JobSystem* jobs) {
+    SkinnedModel model;
+    joints = std::min(std::max(joints, 1), SKINNING_MAX_JOINTS);
+    rows = std::max(rows, 2);
+    float segment = length / joints;
+
+    // Chain from the base up, each joint one segment above its parent
+    for (int j = 0; j < joints; j++) {
+        model.skeleton.add_joint("joint" + std::to_string(j), j - 1, glm::vec3(0.0f, j == 0 ? 0.0f : segment, 0.0f));
+    }
+    model.skeleton.bind_rest_pose();
+
+    // Tube closed by a pole at either end, radius tapering towards the tip
+    RenderMesh& mesh = model.mesh;
+    mesh.has_shared_vertices = true;
+    mesh.resize(((size_t)rows + 1) * (sectors + 1), RenderMesh::grid_triangles(rows, sectors, true, true), true, true);
+    float radius = 0.25f;
+    float taper = 0.7f;
+    float pi = glm::pi<float>();
+    mesh.fill_grid(0, 0, rows, sectors, true, true, jobs, [&](int row, int column, glm::vec3& position, glm::vec3& normal, glm::vec2& uv) {
+        float v = (float)row / rows;
+        float phi = column * 2 * pi / sectors;
+        glm::vec3 radial(glm::cos(phi), 0.0f, -glm::sin(phi));
+        float r = (row == 0 || row == rows) ? 0.0f : radius * (1.0f - taper * v);
+        position = glm::vec3(0.0f, v * length, 0.0f) + radial * r;
+        normal = row == 0 ? glm::vec3(0.0f, -1.0f, 0.0f) : row == rows ? glm::vec3(0.0f, 1.0f, 0.0f)
+               : glm::normalize(radial + glm::vec3(0.0f, taper * radius / length, 0.0f));
+        uv = glm::vec2((float)column / sectors, v);
+    });
+
+    // Two joints per vertex, blending across each joint between the segment middles
+    mesh.skin.resize(mesh.positions.size());
+    auto bind_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float s = std::min(std::max(mesh.positions[i].y / segment - 0.5f, 0.0f), (float)joints - 1.0f);
+            int lower = std::min((int)s, joints - 1);
+            int upper = std::min(lower + 1, joints - 1);
+            int influence_joints[2] = {lower, upper};
+            float influence_weights[2] = {1.0f - (s - lower), s - lower};
+            mesh.skin[i] = make_skin_influence(influence_joints, influence_weights, upper == lower ? 1 : 2);
+        }
+    };
+    if (jobs) jobs->parallel_for(0, mesh.positions.size(), 0, bind_range);
+    else bind_range(0, mesh.positions.size());
+
+    // Bounds hold every pose, no point of the chain gets farther from the base than its length
+    mesh.bounds_center = glm::vec3(0.0f);
+    mesh.bounds_radius = length + radius;
+
+    // Two seconds of a wave travelling up the chain, bending in x and z
+    AnimationClip& clip = model.clip;
+    clip.name = "wave";
+    clip.sample_rate = 30.0f;
+    clip.keys.resize(61);
+    for (size_t k = 0; k < clip.keys.size(); k++) {
+        JointPoses& key = clip.keys[k];
+        key = model.skeleton.rest;
+        float phase = 2.0f * pi * k / (clip.keys.size() - 1);
+        for (int j = 0; j < joints; j++) {
+            float travel = phase - j * 0.6f;
+            float bend = 1.2f / joints;
+            glm::vec4 swing = quat_multiply(quat_axis_angle(glm::vec3(0.0f, 0.0f, 1.0f), bend * std::sin(travel)),
+                                            quat_axis_angle(glm::vec3(1.0f, 0.0f, 0.0f), 0.5f * bend * std::cos(travel)));
+            key.set(j, model.skeleton.rest.translation(j), swing);
+        }
+    }
+    return model;
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "render_stats.h"
+#include "mesh.h"
+
+// glBufferStorage is GL 4.4 / ARB_buffer_storage and not part of the 3.3 core
+// loader, load_stream_buffer_functions() looks it up
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP StreamBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+inline StreamBufferStorageProc gl_buffer_storage = nullptr;
+
+// Call after gladLoadGLLoader(), returns whether persistent mapping is available
+bool load_stream_buffer_functions(GLADloadproc loader);
+
+// Sub-allocation in a StreamBuffer. `data` is write-only mapped memory, valid
+// until the next allocate() or flush(); the GPU reads it at `buffer` + `offset`.
+struct StreamAllocation {
+    void* data = nullptr;
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    explicit operator bool() const { return data != nullptr; }
+};
+
+struct StreamStats {
+    size_t bytes = 0;               // Allocated during the last frame
+    uint32_t allocations = 0;
+    uint32_t overflows = 0;         // Allocations that did not fit, the buffer grows at end_frame()
+    float wait_ms = 0.0f;           // Waiting for the GPU to release the frame's region
+};
+
+// Streaming allocator for data written every frame: debug lines, instance
+// transforms, uniform blocks. Callers write straight into mapped buffer memory.
+//
+// With buffer storage (GL 4.4) the buffer holds REGIONS frame-sized regions,
+// mapped once persistent and coherent. end_frame() fences the region just used
+// and the region is only written again after its fence has signalled. On 3.3 the
+// buffer is orphaned at the start of each frame and allocations are mapped
+// unsynchronized, the driver keeps the old storage alive for frames in flight.
+//
+// GL thread only. Write the allocation, then flush() before drawing from it.
+class StreamBuffer {
+public:
+    static constexpr int REGIONS = 3;
+    static inline bool allow_persistent = true;     // Off while a GL trace records, mapped writes bypass it
+
+    StreamBuffer() = default;
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    ~StreamBuffer() { destroy(); }
+
+    // `frame_size` is the bytes one frame can allocate
+    bool create(GLenum target, size_t frame_size);
+    void destroy();
+    bool persistent() const { return persistent_mapping; }
+    size_t frame_size() const { return region_size; }
+
+    StreamAllocation allocate(size_t size, size_t alignment = 16);
+    // Makes the writes visible to GL, a no-op with coherent persistent mapping
+    void flush();
+    // After the frame's last draw from this buffer
+    void end_frame();
+
+    const StreamStats& stats() const { return last; }
+    static GLint uniform_alignment();
+
+private:
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint buffer = 0;
+    size_t region_size = 0;
+    bool persistent_mapping = false;
+    uint8_t* mapped = nullptr;          // Whole buffer, persistent mode only
+    bool mapped_range = false;          // Orphan mode: an allocation is mapped
+    GLsync fences[REGIONS] = {};
+    int region = 0;
+    size_t offset = 0;
+    bool frame_started = false;
+    size_t grow_to = 0;
+
+    StreamStats current;
+    StreamStats last;
+
+    bool create_storage();
+    void begin_frame();
+};
+
+// Per-frame vertex data of a mesh deformed on the CPU (skinning, morph targets).
+// map() returns room for the mesh's interleaved vertices in a StreamBuffer, in
+// the layout of write_vertex_data(); bind() then points the mesh's VAO at them,
+// so draw() reads this frame's copy while the GPU may still read older ones.
+// GL thread only, end_frame() after the frame's last draw of the mesh.
+class VertexStream {
+public:
+    // Room for `copies` meshes' vertices per frame
+    bool create(const RenderMesh& mesh, int copies = 1);
+    void destroy() { stream.destroy(); }
+    float* map(const RenderMesh& mesh);
+    void bind(RenderMesh& mesh);
+    void end_frame() { stream.end_frame(); }
+    const StreamStats& stats() const { return stream.stats(); }
+
+private:
+    StreamBuffer stream;
+    StreamAllocation allocation;
+};
+
+bool load_stream_buffer_functions(GLADloadproc loader) {
+    gl_buffer_storage = nullptr;
+    bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+    if (!supported) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && !supported; i++) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            supported = extension && std::strcmp(extension, "GL_ARB_buffer_storage") == 0;
+        }
+    }
+    if (supported) gl_buffer_storage = (StreamBufferStorageProc)loader("glBufferStorage");
+    return gl_buffer_storage != nullptr;
+}
+
+bool StreamBuffer::create(GLenum buffer_target, size_t frame_size) {
+    destroy();
+    target = buffer_target;
+    region_size = std::max(frame_size, (size_t)256);
+    return create_storage();
+}
+
+bool StreamBuffer::create_storage() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    persistent_mapping = allow_persistent && gl_buffer_storage;
+    if (persistent_mapping) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_buffer_storage(target, region_size * REGIONS, nullptr, flags);
+        mapped = (uint8_t*)glMapBufferRange(target, 0, region_size * REGIONS, flags);
+        if (!mapped) {
+            // Storage is immutable, start over with a plain buffer
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+            persistent_mapping = false;
+        }
+    }
+    if (!persistent_mapping) glBufferData(target, region_size, nullptr, GL_STREAM_DRAW);
+    region = 0;
+    offset = 0;
+    frame_started = false;
+    return buffer != 0;
+}
+
+void StreamBuffer::destroy() {
+    if (buffer == 0) return;
+    if (mapped || mapped_range) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+    }
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    mapped = nullptr;
+    mapped_range = false;
+}
+
+void StreamBuffer::begin_frame() {
+    frame_started = true;
+    offset = 0;
+    if (persistent_mapping) {
+        // The region was last used REGIONS frames ago, wait until the GPU is done with it
+        GLsync& fence = fences[region];
+        if (fence) {
+            auto start = std::chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            current.wait_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    } else {
+        // Orphan: new storage for this frame, the old one lives until the GPU is done with it
+        glBindBuffer(target, buffer);
+        glBufferData(target, region_size, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    if (buffer == 0) return {};
+    if (!frame_started) begin_frame();
+    flush();
+
+    size_t aligned = (offset + alignment - 1) / alignment * alignment;
+    if (aligned + size > region_size) {
+        current.overflows++;
+        grow_to = std::max(grow_to, (aligned + size) * 2);
+        return {};
+    }
+    offset = aligned + size;
+    current.bytes += size;
+    current.allocations++;
+    RenderStats::instance().buffer_upload(size);
+
+    StreamAllocation allocation;
+    allocation.buffer = buffer;
+    allocation.size = (GLsizeiptr)size;
+    if (persistent_mapping) {
+        allocation.offset = (GLintptr)(region * region_size + aligned);
+        allocation.data = mapped + allocation.offset;
+    } else {
+        // Nothing in flight uses this range of the orphaned storage
+        allocation.offset = (GLintptr)aligned;
+        glBindBuffer(target, buffer);
+        allocation.data = glMapBufferRange(target, allocation.offset, allocation.size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        mapped_range = allocation.data != nullptr;
+    }
+    return allocation;
+}
+
+void StreamBuffer::flush() {
+    if (!mapped_range) return;
+    glBindBuffer(target, buffer);
+    glUnmapBuffer(target);
+    mapped_range = false;
+}
+
+void StreamBuffer::end_frame() {
+    if (buffer == 0) return;
+    flush();
+    if (frame_started && persistent_mapping) fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGIONS;
+    frame_started = false;
+
+    last = current;
+    current = StreamStats();
+
+    // A frame did not fit: wait for the GPU once and reallocate larger
+    if (grow_to > region_size) {
+        for (GLsync& fence : fences) {
+            if (!fence) continue;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+        }
+        size_t size = grow_to;
+        destroy();
+        region_size = size;
+        create_storage();
+    }
+    grow_to = 0;
+}
+
+GLint StreamBuffer::uniform_alignment() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+bool VertexStream::create(const RenderMesh& mesh, int copies) {
+    return stream.create(GL_ARRAY_BUFFER, mesh.positions.size() * mesh.vertex_stride() * std::max(copies, 1));
+}
+
+float* VertexStream::map(const RenderMesh& mesh) {
+    allocation = stream.allocate(mesh.positions.size() * mesh.vertex_stride(), sizeof(float));
+    return (float*)allocation.data;
+}
+
+void VertexStream::bind(RenderMesh& mesh) {
+    if (!allocation) return;
+    stream.flush();
+    glBindVertexArray(mesh.gpu.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+    mesh.setup_vertex_attributes((size_t)allocation.offset);
+    glBindVertexArray(0);
+    RenderStats& stats = RenderStats::instance();
+    stats.vao_bind();
+    allocation = StreamAllocation();
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+
+// Sparse matrix of weights over control vertices in CSR layout: output row r is
+// the sum of weights[k] * control[sources[k]] for k in [offsets[r], offsets[r + 1]).
+// Sources within a row are sorted.
+struct StencilTable {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> sources;
+    std::vector<float> weights;
+
+    size_t rows() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t entries() const { return sources.size(); }
+
+    void identity(size_t count);
+    // Rows are independent, so a job system splits them across workers
+    void apply(const glm::vec3* control, glm::vec3* out, JobSystem* jobs = nullptr) const;
+    // Rows of `local` are over the rows of `base`; the result maps base's control
+    // vertices straight to local's rows
+    static StencilTable compose(const StencilTable& local, const StencilTable& base, JobSystem* jobs = nullptr);
+};
+
+// Loop subdivision of a triangle cage. build() refines the topology once and
+// keeps a stencil table from the cage vertices to the vertices of the final
+// level, so evaluating after the cage moves is one sparse matrix-vector
+// product plus normals. Boundary edges follow the crease rules; each level
+// multiplies the triangle count by four.
+class LoopSubdivision {
+public:
+    void build(const ProcMesh& cage, int levels, JobSystem* jobs = nullptr);
+
+    // Refined positions, triangles and normals for one position per cage vertex.
+    // Reuses the arrays of `out`, so re-evaluating every frame does not allocate.
+    // The stencils carry positions only, texture coordinates and skin of `out` are dropped.
+    void evaluate(const glm::vec3* control, RenderMesh& out, JobSystem* jobs = nullptr) const;
+    void evaluate(const ProcMesh& cage, RenderMesh& out, JobSystem* jobs = nullptr) const;
+
+    int levels() const { return level_count; }
+    size_t control_count() const { return cage_vertices; }
+    size_t vertex_count() const { return table.rows(); }
+    size_t triangle_count() const { return triangles.size() / 3; }
+    const StencilTable& stencils() const { return table; }
+
+private:
+    int level_count = 0;
+    size_t cage_vertices = 0;
+    StencilTable table;
+    std::vector<unsigned int> triangles;
+
+    // One level's rules over the vertices of `mesh`: old vertices first, then one
+    // per edge, numbered through edge_vertex (per half-edge)
+    static StencilTable level_stencils(const ProcMesh& mesh, std::vector<unsigned int>& edge_vertex);
+};
+
+void StencilTable::identity(size_t count) {
+    offsets.resize(count + 1);
+    sources.resize(count);
+    weights.assign(count, 1.0f);
+    for (size_t i = 0; i <= count; i++) offsets[i] = (uint32_t)i;
+    for (size_t i = 0; i < count; i++) sources[i] = (uint32_t)i;
+}
+
+void StencilTable::apply(const glm::vec3* control, glm::vec3* out, JobSystem* jobs) const {
+    auto apply_rows = [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; r++) {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (uint32_t k = offsets[r]; k < offsets[r + 1]; k++) {
+                const glm::vec3& p = control[sources[k]];
+                float w = weights[k];
+                x += w * p.x;
+                y += w * p.y;
+                z += w * p.z;
+            }
+            out[r] = glm::vec3(x, y, z);
+        }
+    };
+    if (jobs) jobs->parallel_for(0, rows(), 0, apply_rows);
+    else apply_rows(0, rows());
+}
+
+StencilTable StencilTable::compose(const StencilTable& local, const StencilTable& base, JobSystem* jobs) {
+    struct Entry {
+        uint32_t source;
+        float weight;
+        bool operator<(const Entry& other) const { return source < other.source; }
+    };
+
+    // Expands row r into scratch memory, sorted with duplicate sources summed
+    auto expand = [&](size_t r, FrameArena& scratch, size_t& count) {
+        size_t total = 0;
+        for (uint32_t k = local.offsets[r]; k < local.offsets[r + 1]; k++) {
+            uint32_t row = local.sources[k];
+            total += base.offsets[row + 1] - base.offsets[row];
+        }
+        Entry* entries = scratch.allocate_array<Entry>(total);
+        size_t n = 0;
+        for (uint32_t k = local.offsets[r]; k < local.offsets[r + 1]; k++) {
+            uint32_t row = local.sources[k];
+            for (uint32_t j = base.offsets[row]; j < base.offsets[row + 1]; j++) {
+                entries[n++] = {base.sources[j], local.weights[k] * base.weights[j]};
+            }
+        }
+        std::sort(entries, entries + n);
+        count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (count > 0 && entries[count - 1].source == entries[i].source) entries[count - 1].weight += entries[i].weight;
+            else entries[count++] = entries[i];
+        }
+        return entries;
+    };
+
+    // Sizes first, then every row writes its own slice
+    StencilTable result;
+    size_t rows = local.rows();
+    result.offsets.assign(rows + 1, 0);
+    auto count_rows = [&](size_t begin, size_t end) {
+        FrameArena& scratch = FrameArena::thread_scratch();
+        for (size_t r = begin; r < end; r++) {
+            ArenaScope scope(scratch);
+            size_t count;
+            expand(r, scratch, count);
+            result.offsets[r + 1] = (uint32_t)count;
+        }
+    };
+    auto fill_rows = [&](size_t begin, size_t end) {
+        FrameArena& scratch = FrameArena::thread_scratch();
+        for (size_t r = begin; r < end; r++) {
+            ArenaScope scope(scratch);
+            size_t count;
+            Entry* entries = expand(r, scratch, count);
+            for (size_t i = 0; i < count; i++) {
+                result.sources[result.offsets[r] + i] = entries[i].source;
+                result.weights[result.offsets[r] + i] = entries[i].weight;
+            }
+        }
+    };
+
+    if (jobs) jobs->parallel_for(0, rows, 0, count_rows);
+    else count_rows(0, rows);
+    for (size_t r = 0; r < rows; r++) result.offsets[r + 1] += result.offsets[r];
+    result.sources.resize(result.offsets[rows]);
+    result.weights.resize(result.offsets[rows]);
+    if (jobs) jobs->parallel_for(0, rows, 0, fill_rows);
+    else fill_rows(0, rows);
+    return result;
+}
+
+StencilTable LoopSubdivision::level_stencils(const ProcMesh& mesh, std::vector<unsigned int>& edge_vertex) {
+    StencilTable local;
+    size_t vertex_count = mesh.vertices.size();
+    local.offsets.push_back(0);
+    auto add = [&](int source, float weight) {
+        local.sources.push_back((uint32_t)source);
+        local.weights.push_back(weight);
+    };
+
+    // Vertex points: Loop's weights over the one-ring, or 3/4 and 1/8 along a boundary
+    std::vector<int> ring;
+    float pi = glm::pi<float>();
+    for (size_t v = 0; v < vertex_count; v++) {
+        int start = mesh.vertices[v].edge_index;
+        ring.clear();
+        bool boundary = false;
+        int edge = start;
+        while (edge >= 0 && ring.size() <= mesh.half_edges.size()) {
+            ring.push_back(mesh.end_vertex(edge));
+            int previous = mesh.next(mesh.next(edge));
+            int twin = mesh.half_edges[previous].twin_index;
+            if (twin < 0) {
+                boundary = true;
+                ring.push_back(mesh.half_edges[previous].vertex_index);
+                break;
+            }
+            edge = twin;
+            if (edge == start) break;
+        }
+
+        if (ring.empty()) {
+            add((int)v, 1.0f);
+        } else if (boundary) {
+            add((int)v, 0.75f);
+            add(ring.front(), 0.125f);
+            add(ring.back(), 0.125f);
+        } else {
+            float n = (float)ring.size();
+            float c = 0.375f + 0.25f * std::cos(2.0f * pi / n);
+            float beta = (0.625f - c * c) / n;
+            add((int)v, 1.0f - n * beta);
+            for (int neighbor : ring) add(neighbor, beta);
+        }
+        local.offsets.push_back((uint32_t)local.sources.size());
+    }
+
+    // Edge points: 3/8 of each end and 1/8 of each opposite vertex, the midpoint on a boundary
+    edge_vertex.assign(mesh.half_edges.size(), 0);
+    unsigned int next_vertex = (unsigned int)vertex_count;
+    for (size_t h = 0; h < mesh.half_edges.size(); h++) {
+        const ProcMesh::HalfEdge& edge = mesh.half_edges[h];
+        if (edge.twin_index >= 0 && edge.twin_index < (int)h) continue;
+        edge_vertex[h] = next_vertex;
+        if (edge.twin_index >= 0) edge_vertex[edge.twin_index] = next_vertex;
+        next_vertex++;
+
+        int opposite = mesh.half_edges[mesh.next(mesh.next((int)h))].vertex_index;
+        if (edge.twin_index < 0) {
+            add(edge.vertex_index, 0.5f);
+            add(mesh.end_vertex((int)h), 0.5f);
+        } else {
+            int twin_opposite = mesh.half_edges[mesh.next(mesh.next(edge.twin_index))].vertex_index;
+            add(edge.vertex_index, 0.375f);
+            add(mesh.end_vertex((int)h), 0.375f);
+            add(opposite, 0.125f);
+            add(twin_opposite, 0.125f);
+        }
+        local.offsets.push_back((uint32_t)local.sources.size());
+    }
+    return local;
+}
+
+void LoopSubdivision::build(const ProcMesh& cage, int levels, JobSystem* jobs) {
+    level_count = std::max(levels, 0);
+    cage_vertices = cage.vertices.size();
+    table.identity(cage_vertices);
+
+    triangles.resize(cage.faces.size() * 3);
+    for (size_t f = 0; f < cage.faces.size(); f++) {
+        int edge = cage.faces[f].edge_index;
+        for (int k = 0; k < 3; k++, edge = cage.next(edge)) triangles[f * 3 + k] = (unsigned int)cage.half_edges[edge].vertex_index;
+    }
+
+    ProcMesh mesh = cage;
+    std::vector<unsigned int> edge_vertex;
+    std::vector<unsigned int> refined;
+    for (int level = 0; level < level_count; level++) {
+        StencilTable local = level_stencils(mesh, edge_vertex);
+        table = StencilTable::compose(local, table, jobs);
+
+        // Each triangle splits into three corner triangles and a middle one
+        refined.resize(mesh.faces.size() * 12);
+        for (size_t f = 0; f < mesh.faces.size(); f++) {
+            int h0 = mesh.faces[f].edge_index;
+            int h1 = mesh.next(h0);
+            int h2 = mesh.next(h1);
+            unsigned int v0 = mesh.half_edges[h0].vertex_index, v1 = mesh.half_edges[h1].vertex_index, v2 = mesh.half_edges[h2].vertex_index;
+            unsigned int e0 = edge_vertex[h0], e1 = edge_vertex[h1], e2 = edge_vertex[h2];
+            unsigned int* out = &refined[f * 12];
+            out[0] = v0; out[1] = e0; out[2] = e2;
+            out[3] = v1; out[4] = e1; out[5] = e0;
+            out[6] = v2; out[7] = e2; out[8] = e1;
+            out[9] = e0; out[10] = e1; out[11] = e2;
+        }
+        mesh.set_triangles(local.rows(), refined);
+        triangles.swap(refined);
+    }
+}
+
+void LoopSubdivision::evaluate(const glm::vec3* control, RenderMesh& out, JobSystem* jobs) const {
+    out.has_shared_vertices = true;
+    out.has_tex_coords = false;
+    out.tex_coords.clear();
+    out.skin.clear();
+    out.positions.resize(table.rows());
+    table.apply(control, out.positions.data(), jobs);
+    out.mark_vertices_dirty(0, out.positions.size());
+    if (out.indices != triangles) {
+        // New topology: strips and meshlets of the old one no longer apply
+        out.indices = triangles;
+        out.strip_indices.clear();
+        out.meshlets.clear();
+        out.mark_indices_dirty(0, out.indices.size());
+    }
+    out.compute_vertex_normals(jobs);
+}
+
+void LoopSubdivision::evaluate(const ProcMesh& cage, RenderMesh& out, JobSystem* jobs) const {
+    FrameArena& scratch = FrameArena::thread_scratch();
+    ArenaScope scope(scratch);
+    glm::vec3* control = scratch.allocate_array<glm::vec3>(cage.vertices.size());
+    for (size_t i = 0; i < cage.vertices.size(); i++) control[i] = cage.vertices[i].position;
+    evaluate(control, out, jobs);
+}
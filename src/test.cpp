@@ -22,6 +22,10 @@
 #include "camera.h"
 #include "shader.h"
 #include "mesh.h"
+#include "subdivision.h"
+#include "skinning.h"
+#include "morph.h"
+#include "isosurface.h"
 
 // Standard Library
 #include <iostream>
@@ -44,6 +48,50 @@ int main() {
     RenderMesh cylinder = RenderMesh::cylinder(8);
     mesh.compute_vertex_normals();
     cylinder.to_obj("cylinder.obj");
+
+    RenderMesh::icosphere(2).to_obj("icosphere.obj");
+    RenderMesh::torus(24, 12).to_obj("torus.obj");
+    RenderMesh::cone(16).to_obj("cone.obj");
+    RenderMesh::capsule(4, 16).to_obj("capsule.obj");
+    RenderMesh::grid(16, 16, [](float x, float z) { return 0.1f * std::sin(8.0f * x) * std::cos(8.0f * z); }).to_obj("heightfield.obj");
+    RenderMesh::rounded_box(3, 0.1f).to_obj("rounded_box.obj");
+
+    ProcMesh cage = RenderMesh::cube().to_procmesh();
+    LoopSubdivision subdivision;
+    subdivision.build(cage, 3);
+    RenderMesh smooth;
+    subdivision.evaluate(cage, smooth);
+    smooth.to_obj("cube_loop3.obj");
+
+    SkinnedModel tentacle = skinned_tentacle(8, 32, 16);
+    JointPoses pose;
+    tentacle.clip.sample(0.5f, pose);
+    std::vector<glm::mat4> skin(tentacle.skeleton.joint_count());
+    tentacle.skeleton.skin_matrices(pose, skin.data());
+    RenderMesh posed;
+    skin_mesh(tentacle.mesh, skin.data(), posed);
+    posed.to_obj("tentacle_posed.obj");
+
+    MorphTargets blobTargets;
+    RenderMesh blob = morph_test_blob(32, blobTargets);
+    float blobWeights[] = {1.0f, 1.0f, 0.5f};
+    std::vector<float> morphed(blob.positions.size() * blob.vertex_stride() / sizeof(float));
+    blobTargets.apply(blob, blobWeights, morphed.data());
+    size_t stride = blob.vertex_stride() / sizeof(float);
+    for (size_t i = 0; i < blob.positions.size(); i++) {
+        blob.positions[i] = glm::vec3(morphed[i * stride], morphed[i * stride + 1], morphed[i * stride + 2]);
+        blob.normals[i] = glm::vec3(morphed[i * stride + 3], morphed[i * stride + 4], morphed[i * stride + 5]);
+    }
+    blob.to_obj("blob_morphed.obj");
+
+    DenseGrid field(glm::ivec3(64));
+    field.origin = glm::vec3(-1.0f);
+    field.spacing = 2.0f / 63.0f;
+    field.fill(isosurface_test_field);
+    IsosurfaceMesher mesher;
+    RenderMesh isosurface;
+    mesher.update(field, 0.0f, isosurface);
+    isosurface.to_obj("isosurface.obj");
     
     return 0;
 }
\ No newline at end of file
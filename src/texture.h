@@ -0,0 +1,525 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_USE_SSE2 1
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// main.cpp includes stb_image.h with STB_IMAGE_IMPLEMENTATION, don't expand it twice
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+
+// Decoded 8-bit image in CPU memory
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<unsigned char> pixels;
+
+    bool load(const std::string& filename, int desired_channels = 0);
+    size_t row_bytes() const { return (size_t)width * channels; }
+};
+
+// GPU texture handle
+struct Texture {
+    unsigned int ID = 0;
+    int width = 0;
+    int height = 0;
+    int levels = 1;
+
+    void bind(int unit) const;
+};
+
+// Read-only memory mapping of a whole file
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& filename);
+    void close();
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+enum class MipFilter { Box, Kaiser };
+
+// RGBA8 texture with its full mip chain, either owned or pointing into a mapped cache file
+struct TextureData {
+    struct Level {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<Level> levels;
+    std::vector<unsigned char> storage;
+    std::shared_ptr<MappedFile> mapping;
+    bool from_cache = false;
+    float load_ms = 0.0f;
+
+    const unsigned char* level_data(int level) const {
+        const unsigned char* base = mapping ? mapping->data : storage.data();
+        return base + levels[level].offset;
+    }
+    size_t total_bytes() const { return levels.empty() ? 0 : levels.back().offset + levels.back().size; }
+};
+
+// Texture pipeline
+void downsample_box(const unsigned char* src, int src_width, int src_height, unsigned char* dst);
+void downsample_kaiser(const unsigned char* src, int src_width, int src_height, unsigned char* dst);
+void generate_mips(TextureData& texture, MipFilter filter);
+std::string texture_cache_path(const std::string& filename);
+bool write_texture_cache(const std::string& cache_path, const std::string& filename, const TextureData& texture, MipFilter filter);
+bool read_texture_cache(const std::string& cache_path, const std::string& filename, MipFilter filter, TextureData& texture);
+bool load_texture_data(const std::string& filename, TextureData& texture, MipFilter filter = MipFilter::Kaiser, bool use_cache = true);
+Texture upload_texture(const TextureData& texture);
+Texture solid_texture(unsigned char r, unsigned char g, unsigned char b);
+
+GLenum texture_format(int channels) {
+    switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+bool Image::load(const std::string& filename, int desired_channels) {
+    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, desired_channels);
+    if (!data) return false;
+    if (desired_channels) channels = desired_channels;
+
+    pixels.assign(data, data + (size_t)width * height * channels);
+    stbi_image_free(data);
+    return true;
+}
+
+void Texture::bind(int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, ID);
+}
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+#ifdef _WIN32
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size = (size_t)file_size.QuadPart;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    data = ptr == MAP_FAILED ? nullptr : (const unsigned char*)ptr;
+#endif
+    if (!data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data) munmap((void*)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// 2x2 average of an RGBA8 image. Odd trailing rows/columns are clamped.
+void downsample_box(const unsigned char* src, int src_width, int src_height, unsigned char* dst) {
+    int width = std::max(1, src_width / 2);
+    int height = std::max(1, src_height / 2);
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row0 = src + (size_t)std::min(2 * y, src_height - 1) * src_width * 4;
+        const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, src_height - 1) * src_width * 4;
+        unsigned char* out = dst + (size_t)y * width * 4;
+        int x = 0;
+
+#ifdef TEXTURE_USE_SSE2
+        // Two output pixels (four source pixels per row) per iteration, summed in 16 bits
+        if (src_width >= 2) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(2);
+            for (; x + 2 <= width && 2 * x + 4 <= src_width; x += 2) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+                __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+                _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            int x0 = std::min(2 * x, src_width - 1) * 4;
+            int x1 = std::min(2 * x + 1, src_width - 1) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+float bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 16; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Half-resolution taps of a Kaiser-windowed sinc, relative to the source pixel 2x - 2
+const int KAISER_TAPS = 6;
+const float* kaiser_weights() {
+    // Function-local static so concurrent mip jobs initialize it exactly once
+    static const std::vector<float> weights = [] {
+        const float alpha = 4.0f;
+        const float half_width = 1.5f;   // In destination pixels
+        std::vector<float> w(KAISER_TAPS);
+        float sum = 0.0f;
+        for (int i = 0; i < KAISER_TAPS; i++) {
+            float t = ((float)i - 2.5f) * 0.5f;
+            float sinc = t == 0.0f ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+            float r = t / half_width;
+            float window = bessel_i0(alpha * std::sqrt(std::max(0.0f, 1.0f - r * r))) / bessel_i0(alpha);
+            w[i] = sinc * window;
+            sum += w[i];
+        }
+        for (int i = 0; i < KAISER_TAPS; i++) w[i] /= sum;
+        return w;
+    }();
+    return weights.data();
+}
+
+// Separable Kaiser-windowed sinc downsample of an RGBA8 image. Sharper than the
+// box filter while still suppressing aliasing. All four channels of a pixel are
+// filtered together in one SSE register.
+void downsample_kaiser(const unsigned char* src, int src_width, int src_height, unsigned char* dst) {
+    int width = std::max(1, src_width / 2);
+    int height = std::max(1, src_height / 2);
+    const float* w = kaiser_weights();
+
+    // Horizontal pass into a float buffer, full source height. Each source row is
+    // widened to float once, padded by clamping so the taps need no bounds checks.
+    std::vector<float> temp((size_t)width * src_height * 4);
+    int padded_width = std::max(src_width, 2 * width) + 4;
+    std::vector<float> row((size_t)padded_width * 4);
+    for (int y = 0; y < src_height; y++) {
+        const unsigned char* src_row = src + (size_t)y * src_width * 4;
+        for (int x = -2; x < padded_width - 2; x++) {
+            const unsigned char* p = src_row + std::min(std::max(x, 0), src_width - 1) * 4;
+            for (int c = 0; c < 4; c++) row[(x + 2) * 4 + c] = p[c];
+        }
+
+        float* out = temp.data() + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            // Taps cover source pixels 2x - 2 .. 2x + 3, i.e. padded 2x .. 2x + 5
+            const float* taps = row.data() + (size_t)(2 * x) * 4;
+#ifdef TEXTURE_USE_SSE2
+            __m128 acc = _mm_mul_ps(_mm_loadu_ps(taps), _mm_set1_ps(w[0]));
+            for (int t = 1; t < KAISER_TAPS; t++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(taps + t * 4), _mm_set1_ps(w[t])));
+            }
+            _mm_storeu_ps(out + x * 4, acc);
+#else
+            for (int c = 0; c < 4; c++) {
+                float acc = 0.0f;
+                for (int t = 0; t < KAISER_TAPS; t++) acc += taps[t * 4 + c] * w[t];
+                out[x * 4 + c] = acc;
+            }
+#endif
+        }
+    }
+
+    // Vertical pass, clamped back to 8 bits
+    for (int y = 0; y < height; y++) {
+        const float* rows[KAISER_TAPS];
+        for (int t = 0; t < KAISER_TAPS; t++) {
+            int sy = std::min(std::max(2 * y - 2 + t, 0), src_height - 1);
+            rows[t] = temp.data() + (size_t)sy * width * 4;
+        }
+
+        unsigned char* out = dst + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+#ifdef TEXTURE_USE_SSE2
+            __m128 acc = _mm_mul_ps(_mm_loadu_ps(rows[0] + x * 4), _mm_set1_ps(w[0]));
+            for (int t = 1; t < KAISER_TAPS; t++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[t] + x * 4), _mm_set1_ps(w[t])));
+            }
+            __m128i v = _mm_cvtps_epi32(acc);
+            v = _mm_packs_epi32(v, v);
+            v = _mm_packus_epi16(v, v);
+            *(int*)(out + x * 4) = _mm_cvtsi128_si32(v);
+#else
+            for (int c = 0; c < 4; c++) {
+                float acc = 0.0f;
+                for (int t = 0; t < KAISER_TAPS; t++) acc += rows[t][x * 4 + c] * w[t];
+                out[x * 4 + c] = (unsigned char)std::min(255.0f, std::max(0.0f, acc + 0.5f));
+            }
+#endif
+        }
+    }
+}
+
+void generate_mips(TextureData& texture, MipFilter filter) {
+    // Level 0 must already be in storage
+    texture.levels.resize(1);
+    int width = texture.width, height = texture.height;
+    size_t offset = texture.levels[0].size;
+
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        texture.levels.push_back({width, height, offset, (size_t)width * height * 4});
+        offset += (size_t)width * height * 4;
+    }
+
+    texture.storage.resize(offset);
+    for (size_t i = 1; i < texture.levels.size(); i++) {
+        const auto& src = texture.levels[i - 1];
+        unsigned char* dst = texture.storage.data() + texture.levels[i].offset;
+        if (filter == MipFilter::Box) downsample_box(texture.storage.data() + src.offset, src.width, src.height, dst);
+        else downsample_kaiser(texture.storage.data() + src.offset, src.width, src.height, dst);
+    }
+}
+
+// Cache container layout: header, level table, then 16-byte aligned level data
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t filter;
+    uint64_t source_size;
+    int64_t source_time;
+};
+
+struct TextureCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+std::string texture_cache_path(const std::string& filename) {
+    std::string name = filename;
+    std::replace(name.begin(), name.end(), '/', '_');
+    std::replace(name.begin(), name.end(), '\\', '_');
+    std::replace(name.begin(), name.end(), ':', '_');
+    return "cache/textures/" + name + ".mips";
+}
+
+bool texture_source_stamp(const std::string& filename, uint64_t& size, int64_t& time) {
+    std::error_code ec;
+    size = std::filesystem::file_size(filename, ec);
+    if (ec) return false;
+    time = (int64_t)std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+    return !ec;
+}
+
+bool write_texture_cache(const std::string& cache_path, const std::string& filename, const TextureData& texture, MipFilter filter) {
+    TextureCacheHeader header = {};
+    std::memcpy(header.magic, "TXMC", 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.level_count = (uint32_t)texture.levels.size();
+    header.filter = (uint32_t)filter;
+    if (!texture_source_stamp(filename, header.source_size, header.source_time)) return false;
+
+    size_t data_start = sizeof(header) + texture.levels.size() * sizeof(TextureCacheLevel);
+    data_start = (data_start + 15) & ~(size_t)15;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+    // Write to a temporary file first so a concurrent reader never sees a partial
+    // cache, one per writer so loaders of the same texture don't write into each other's
+    std::string temp_path = cache_path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary);
+    if (!file) return false;
+
+    file.write((const char*)&header, sizeof(header));
+    for (const auto& level : texture.levels) {
+        TextureCacheLevel entry = {(uint32_t)level.width, (uint32_t)level.height, data_start + level.offset, level.size};
+        file.write((const char*)&entry, sizeof(entry));
+    }
+    std::vector<char> padding(data_start - (size_t)file.tellp(), 0);
+    file.write(padding.data(), padding.size());
+    file.write((const char*)texture.level_data(0), texture.total_bytes());
+    file.close();
+    if (!file) return false;
+
+    std::filesystem::rename(temp_path, cache_path, ec);
+    return !ec;
+}
+
+bool read_texture_cache(const std::string& cache_path, const std::string& filename, MipFilter filter, TextureData& texture) {
+    auto mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(cache_path) || mapping->size < sizeof(TextureCacheHeader)) return false;
+
+    TextureCacheHeader header;
+    std::memcpy(&header, mapping->data, sizeof(header));
+    if (std::memcmp(header.magic, "TXMC", 4) != 0 || header.version != TEXTURE_CACHE_VERSION || header.filter != (uint32_t)filter) return false;
+
+    // Stale if the source image changed since the cache was written
+    uint64_t source_size;
+    int64_t source_time;
+    if (texture_source_stamp(filename, source_size, source_time) &&
+        (source_size != header.source_size || source_time != header.source_time)) {
+        return false;
+    }
+
+    // A full mip chain at most, every level the size its dimensions need
+    uint32_t max_levels = 1;
+    while (max_levels < 32 && (std::max(header.width, header.height) >> max_levels) > 0) max_levels++;
+    size_t table_end = sizeof(header) + header.level_count * sizeof(TextureCacheLevel);
+    if (header.width == 0 || header.height == 0 || header.level_count == 0 || header.level_count > max_levels || mapping->size < table_end) return false;
+
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.levels.clear();
+    for (uint32_t i = 0; i < header.level_count; i++) {
+        TextureCacheLevel entry;
+        std::memcpy(&entry, mapping->data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        uint32_t width = std::max(1u, header.width >> i), height = std::max(1u, header.height >> i);
+        if (entry.width != width || entry.height != height || entry.size != (uint64_t)width * height * 4) return false;
+        if (entry.offset > mapping->size || entry.size > mapping->size - entry.offset) return false;
+        texture.levels.push_back({(int)entry.width, (int)entry.height, (size_t)entry.offset, (size_t)entry.size});
+    }
+
+    texture.storage.clear();
+    texture.mapping = mapping;
+    texture.from_cache = true;
+    return true;
+}
+
+bool load_texture_data(const std::string& filename, TextureData& texture, MipFilter filter, bool use_cache) {
+    auto start = std::chrono::steady_clock::now();
+    std::string cache_path = texture_cache_path(filename);
+
+    bool loaded = use_cache && read_texture_cache(cache_path, filename, filter, texture);
+    if (!loaded) {
+        // Cold path: decode, build mips, write the cache for next time
+        Image image;
+        if (!image.load(filename, 4)) return false;
+
+        texture.width = image.width;
+        texture.height = image.height;
+        texture.levels = {{image.width, image.height, 0, image.pixels.size()}};
+        texture.storage.swap(image.pixels);
+        texture.mapping.reset();
+        texture.from_cache = false;
+        generate_mips(texture, filter);
+
+        if (use_cache && !write_texture_cache(cache_path, filename, texture, filter)) {
+            std::cerr << "Failed to write texture cache " << cache_path << std::endl;
+        }
+    }
+
+    texture.load_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void set_texture_parameters(int levels) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+// Synchronous upload of every level, for tools and small textures
+Texture upload_texture(const TextureData& data) {
+    Texture texture;
+    texture.width = data.width;
+    texture.height = data.height;
+    texture.levels = (int)data.levels.size();
+
+    glGenTextures(1, &texture.ID);
+    glBindTexture(GL_TEXTURE_2D, texture.ID);
+    for (int i = 0; i < texture.levels; i++) {
+        const auto& level = data.levels[i];
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.level_data(i));
+    }
+    set_texture_parameters(texture.levels);
+    return texture;
+}
+
+// 1x1 texture, bound in place of missing material maps
+Texture solid_texture(unsigned char r, unsigned char g, unsigned char b) {
+    TextureData data;
+    data.width = data.height = 1;
+    data.storage = {r, g, b, 255};
+    data.levels = {{1, 1, 0, 4}};
+    return upload_texture(data);
+}